@@ -12,6 +12,10 @@ QML_IMPORT_NAME = BLEPassMan
 QML_IMPORT_MAJOR_VERSION = 1
 QML_IMPORT_PATH = $$OUT_PWD
 
+# Codifica TLV dei comandi utente, condivisa con il firmware
+USER_PROTO_DIR = $$PWD/../ble_hid_kw111/components/user_proto
+INCLUDEPATH += $$USER_PROTO_DIR/include
+
 
 HEADERS += \
     connectionhandler.h \
@@ -19,7 +23,8 @@ HEADERS += \
     devicefinder.h \
     devicehandler.h \
     bluetoothbaseclass.h \
-    placeholderencoder.h
+    placeholderencoder.h \
+    $$USER_PROTO_DIR/include/user_proto.h
 
 SOURCES += main.cpp \
     connectionhandler.cpp \
@@ -27,7 +32,8 @@ SOURCES += main.cpp \
     devicefinder.cpp \
     devicehandler.cpp \
     bluetoothbaseclass.cpp \
-    placeholderencoder.cpp
+    placeholderencoder.cpp \
+    $$USER_PROTO_DIR/user_proto.c
 
 qml_resources.files = \
     qmldir \
@@ -33,6 +33,8 @@ Page {
                     cleanUserObject.autoFinger = users[i].autoFinger;
                     cleanUserObject.fingerprintIndex = users[i].fingerprintIndex;
                     cleanUserObject.loginType = users[i].loginType;
+                    cleanUserObject.layout = users[i].layout;
+                    cleanUserObject.fallback = users[i].fallback;
                     jsArray.push(cleanUserObject);
                 }                
                 // console.log("Contenuto di jsArray convertito:", JSON.stringify(jsArray, null, 2));
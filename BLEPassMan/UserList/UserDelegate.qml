@@ -14,8 +14,11 @@ ItemDelegate {
 
     required property string username
     required property string password    
+    property string loadedPassword: ""     // la lista arriva senza password
     property bool passwordVisible: false
 
+    signal passwordRequested()
+
     background: Rectangle {
         radius: 8
         border.width: 2
@@ -47,7 +50,7 @@ ItemDelegate {
             RowLayout {
                 Layout.fillWidth: true
                 Label {
-                    text: passwordVisible ? delegate.password : "*****************"
+                    text: passwordVisible ? (delegate.password || delegate.loadedPassword) : "*****************"
                     font.bold: true
                     color: "white"
                     elide: Text.ElideRight
@@ -56,7 +59,11 @@ ItemDelegate {
 
                 ToolButton {
                     text: passwordVisible ? "\u{1F441}" : "\u{1F576}" // 👁 / 🕶️
-                    onClicked: passwordVisible = !passwordVisible
+                    onClicked: {
+                        if (!passwordVisible && !delegate.password && !delegate.loadedPassword)
+                            delegate.passwordRequested()
+                        passwordVisible = !passwordVisible
+                    }
                     font.pixelSize: 18
                     contentItem: Text {
                         text: parent.text
@@ -24,6 +24,8 @@ Dialog {
         form.autoFinger.checked = false;
         form.fingerprintIndex.currentIndex = 0;
         form.loginType.currentIndex = 0;
+        form.keyboardLayout.currentIndex = 0;
+        form.missingChars.currentIndex = 0;
 
         dialog.title = qsTr("Add User");
         dialog.open();
@@ -37,11 +39,18 @@ Dialog {
         form.autoFinger.checked = contact.autoFinger;
         form.fingerprintIndex.currentIndex = contact.fingerprintIndex + 1
         form.loginType.currentIndex = contact.loginType
+        form.keyboardLayout.currentIndex = contact.layout !== undefined ? contact.layout : 0
+        form.missingChars.currentIndex = contact.fallback !== undefined ? contact.fallback : 0
 
         dialog.title = qsTr("Edit User");
         dialog.open();
     }
 
+    // Password arrivata dopo l'apertura (la lista non contiene le password)
+    function setPassword(text) {
+        form.password.text = text;
+    }
+
     focus: true
     modal: true
     title: qsTr("Add Contact")
@@ -60,7 +69,9 @@ Dialog {
                 sendEnter: form.sendEnter.checked,
                 autoFinger: form.autoFinger.checked,
                 fingerprintIndex: form.fingerprintIndex.currentValue,
-                loginType: form.loginType.currentIndex
+                loginType: form.loginType.currentIndex,
+                layout: form.keyboardLayout.currentIndex,
+                fallback: form.missingChars.currentIndex
             });
         }
     }
@@ -14,6 +14,8 @@ GridLayout {
     property alias autoFinger: autoFinger
     property alias fingerprintIndex: fingerprintIndex
     property alias loginType: loginType
+    property alias keyboardLayout: keyboardLayout
+    property alias missingChars: missingChars
     property int loginTypeIndex: -1
     property int minimumInputSize: 120
     property color labelColor: "white"
@@ -131,6 +133,28 @@ GridLayout {
         palette.text: grid.labelColor        
     }
 
+    Label {
+        text: qsTr("Keyboard layout")
+        color: grid.labelColor
+    }
+    ComboBox {
+        id: keyboardLayout
+        // Stesso ordine di hid_layout_id_t nel firmware
+        model: [qsTr("Device default"), "IT", "US", "UK", "DE", "FR"]
+        palette.text: grid.labelColor
+    }
+
+    Label {
+        text: qsTr("Missing characters")
+        color: grid.labelColor
+    }
+    ComboBox {
+        id: missingChars
+        // Stesso ordine di hid_fallback_t nel firmware
+        model: [qsTr("Skip"), qsTr("Windows Alt code"), qsTr("Linux Ctrl+Shift+U"), qsTr("Reject")]
+        palette.text: grid.labelColor
+    }
+
     Label {
         text: qsTr("CTRL+ALT+DEL")
         color: grid.labelColor
@@ -25,6 +25,20 @@ Item {
     //     console.log("LOG (UserList.qml): Componente UserList creato.")
     // }
 
+    onUserModelChanged: userView.passwords = ({})
+
+    // Le password non fanno parte della lista: arrivano una alla volta su richiesta
+    Connections {
+        target: deviceHandler
+        function onPasswordReceived(index, password) {
+            var passwords = userView.passwords
+            passwords[index] = password
+            userView.passwords = passwords
+            if (contactDialog.opened && root.currentContact === index)
+                contactDialog.setPassword(password)
+        }
+    }
+
     UserDialog {
         id: contactDialog
         onFinished: function(user) {
@@ -50,7 +64,11 @@ Item {
         }
         MenuItem {
             text: qsTr("Edit...")
-            onTriggered: contactDialog.editContact(userModel[root.currentContact] )
+            onTriggered: {
+                contactDialog.editContact(userModel[root.currentContact])
+                if (!userModel[root.currentContact].password)
+                    deviceHandler.fetchPassword(root.currentContact)
+            }
         }
         MenuItem {
             text: qsTr("Remove")
@@ -69,6 +87,9 @@ Item {
             root.currentContact = index
             contactMenu.open()
         }
+        onPasswordRequested: function(index) {
+            deviceHandler.fetchPassword(index)
+        }
     }
 
     DelayButton {
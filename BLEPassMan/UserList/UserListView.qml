@@ -11,13 +11,17 @@ ListView {
     spacing: 5
 
     property int selectedIndex: -1
+    property var passwords: ({})           // password chieste al dispositivo, per indice
     signal pressAndHold(int index)
+    signal passwordRequested(int index)
 
     delegate: UserDelegate {
         id: delegate
         width: listView.width
         required property int index
         onPressAndHold: listView.pressAndHold(index)
+        loadedPassword: listView.passwords[index] || ""
+        onPasswordRequested: listView.passwordRequested(index)
 
         checked: listView.selectedIndex === index
         onClicked: {
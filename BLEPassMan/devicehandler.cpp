@@ -19,6 +19,10 @@ DeviceHandler::DeviceHandler(QObject *parent) :
 {
     m_customService = QBluetoothUuid(static_cast<quint32>(0xFFF0));
     m_customCharacteristic = QBluetoothUuid(static_cast<quint32>(0xFFF1));
+
+    m_dumpTimer.setSingleShot(true);
+    m_dumpTimer.setInterval(2000);
+    connect(&m_dumpTimer, &QTimer::timeout, this, &DeviceHandler::userDumpTimeout);
 }
 
 void DeviceHandler::setAddressType(AddressType type)
@@ -51,6 +55,7 @@ void DeviceHandler::setDevice(DeviceInfo *device)
         m_control = nullptr;
     }
 
+    m_protoVersion = 0;
     if (m_currentDevice) {
         m_control = QLowEnergyController::createCentral(m_currentDevice->getDevice(), this);
         m_control->setRemoteAddressType(m_addressType);
@@ -70,8 +75,13 @@ void DeviceHandler::setDevice(DeviceInfo *device)
             setError("LowEnergy controller disconnected");
             setIcon(IconError);
         });
+        // Qt non ha una richiesta esplicita dell'MTU: Android chiede il massimo alla
+        // connessione, Windows/macOS/iOS lo negoziano da soli. Il device impacca
+        // la lista utenti in base al valore scelto.
+        connect(m_control, &QLowEnergyController::mtuChanged, this, [](int mtu) {
+            qDebug() << "[BLE] MTU negoziato:" << mtu;
+        });
         m_control->connectToDevice();
-        qDebug() << "[BLE] MTU negoziato:" << m_control->mtu();
     }
 }
 
@@ -228,6 +238,8 @@ QVariantList DeviceHandler::userList() const
         entry["autoFinger"] = ue.autoFinger;
         entry["fingerprintIndex"] = ue.fingerprintIndex;
         entry["loginType"] = ue.loginType;
+        entry["layout"] = ue.layout;
+        entry["fallback"] = ue.fallback;
         list.append(entry);
     }
     return list;
@@ -255,6 +267,56 @@ QByteArray DeviceHandler::buildUserPayload(quint8 cmd, quint8 index, const UserE
     data.append(char(entry.autoFinger ? 1 : 0));
     data.append(char(entry.fingerprintIndex));
     data.append(char(entry.loginType));
+    data.append(char(entry.layout));
+    data.append(char(entry.fallback));
+    return data;
+}
+
+// WRITE_USER: solo i campi diversi da previous (tutti per un nuovo utente)
+QByteArray DeviceHandler::buildUserFrame(quint8 index, const UserEntry &entry, const UserEntry *previous)
+{
+    const QByteArray username = entry.username.toUtf8().left(USER_PROTO_TEXT_MAX);
+    const QByteArray password = entry.rawPassword.left(USER_PROTO_TEXT_MAX);
+
+    user_proto_entry_t fields = {};
+    if (!previous) {
+        for (int tag = USER_TAG_LABEL; tag < USER_TAG_NB; ++tag)
+            fields.fields |= USER_FIELD(tag);
+    } else {
+        auto changed = [&fields](user_tag_t tag, bool differs) {
+            if (differs)
+                fields.fields |= USER_FIELD(tag);
+        };
+        changed(USER_TAG_LABEL, entry.username != previous->username);
+        changed(USER_TAG_PASSWORD, entry.rawPassword != previous->rawPassword);
+        changed(USER_TAG_WINLOGIN, entry.winlogin != previous->winlogin);
+        changed(USER_TAG_SEND_ENTER, entry.sendEnter != previous->sendEnter);
+        changed(USER_TAG_MAGICFINGER, entry.autoFinger != previous->autoFinger);
+        changed(USER_TAG_FINGERPRINT_ID, entry.fingerprintIndex != previous->fingerprintIndex);
+        changed(USER_TAG_LOGIN_TYPE, entry.loginType != previous->loginType);
+        changed(USER_TAG_LAYOUT, entry.layout != previous->layout);
+        changed(USER_TAG_FALLBACK, entry.fallback != previous->fallback);
+    }
+    if (!fields.fields)
+        return QByteArray();
+
+    fields.label_len = quint8(username.size());
+    memcpy(fields.label, username.constData(), username.size());
+    fields.password_len = quint8(password.size());
+    memcpy(fields.password, password.constData(), password.size());
+    fields.winlogin = entry.winlogin;
+    fields.send_enter = entry.sendEnter;
+    fields.magicfinger = entry.autoFinger;
+    fields.fingerprint_id = entry.fingerprintIndex;
+    fields.login_type = entry.loginType;
+    fields.layout = entry.layout;
+    fields.fallback = entry.fallback;
+
+    QByteArray data(USER_PROTO_FRAME_MAX, '\0');
+    const size_t len = user_proto_encode(WRITE_USER, index, &fields,
+                                         reinterpret_cast<uint8_t *>(data.data()), size_t(data.size()));
+    memset(&fields, 0, sizeof(fields));
+    data.truncate(int(len));
     return data;
 }
 
@@ -271,6 +333,8 @@ void DeviceHandler::addUser(const QVariantMap &user)
     entry.autoFinger      = user.value("autoFinger").toBool();
     entry.fingerprintIndex= user.value("fingerprintIndex").toInt();
     entry.loginType       = user.value("loginType").toInt();
+    entry.layout          = user.value("layout").toInt();
+    entry.fallback        = user.value("fallback").toInt();
 
     QString encErr;
     entry.rawPassword = PlaceholderEncoder::encode(entry.password, &encErr);
@@ -280,7 +344,8 @@ void DeviceHandler::addUser(const QVariantMap &user)
         return;
     }
 
-    QByteArray payload = buildUserPayload(ADD_NEW_USER, quint8(newIndex), entry);
+    QByteArray payload = m_protoVersion >= 1 ? buildUserFrame(quint8(newIndex), entry, nullptr)
+                                             : buildUserPayload(ADD_NEW_USER, quint8(newIndex), entry);
     writeCustomCharacteristic(payload);
 
     m_userList[newIndex] = entry;
@@ -293,6 +358,17 @@ void DeviceHandler::editUser(int index, const QVariantMap &user)
     if (!m_userList.contains(index))
         return;
 
+    // Il frame EDIT_USER dei firmware senza WRITE_USER contiene sempre la
+    // password: se non e' ancora stata chiesta al dispositivo si manderebbe
+    // vuota. La modifica aspetta la password (completata da passwordReceived)
+    if (m_protoVersion == 0 && user.value("password").toString().isEmpty()
+        && m_userList[index].rawPassword.isEmpty()) {
+        m_pendingEditIndex = index;
+        m_pendingEdit = user;
+        fetchPassword(index);
+        return;
+    }
+
     UserEntry entry;
     entry.username         = user.value("username").toString();
     entry.password         = user.value("password").toString();
@@ -301,6 +377,8 @@ void DeviceHandler::editUser(int index, const QVariantMap &user)
     entry.autoFinger       = user.value("autoFinger").toBool();
     entry.fingerprintIndex = user.value("fingerprintIndex").toInt();
     entry.loginType        = user.value("loginType").toInt();
+    entry.layout           = user.value("layout").toInt();
+    entry.fallback         = user.value("fallback").toInt();
 
     QString encErr;
     entry.rawPassword = PlaceholderEncoder::encode(entry.password, &encErr);
@@ -310,8 +388,15 @@ void DeviceHandler::editUser(int index, const QVariantMap &user)
         return;
     }
 
-    QByteArray payload = buildUserPayload(EDIT_USER, quint8(index), entry);
-    writeCustomCharacteristic(payload);
+    if (m_protoVersion >= 1) {
+        // Solo i campi modificati; niente da scrivere se non e' cambiato nulla
+        QByteArray payload = buildUserFrame(quint8(index), entry, &m_userList[index]);
+        if (!payload.isEmpty())
+            writeCustomCharacteristic(payload);
+    } else {
+        QByteArray payload = buildUserPayload(EDIT_USER, quint8(index), entry);
+        writeCustomCharacteristic(payload);
+    }
 
     m_userList[index] = entry;
     emit userListUpdated(userList());
@@ -325,6 +410,20 @@ void DeviceHandler::getUserFromDevice(int index)
     writeCustomCharacteristic(data);
 }
 
+// La lista non contiene le password: quella di un utente si chiede al
+// dispositivo solo quando serve e arriva con passwordReceived
+void DeviceHandler::fetchPassword(int index)
+{
+    if (!m_userList.contains(index))
+        return;
+    if (!m_userList[index].rawPassword.isEmpty()) {
+        emit passwordReceived(index, m_userList[index].password);
+        return;
+    }
+    m_passwordFetch = index;
+    getUserFromDevice(index);
+}
+
 void DeviceHandler::removeUser(int index)
 {
     qDebug() << "BACKEND: Rimuovo utente all'indice" << index;
@@ -349,6 +448,16 @@ void DeviceHandler::clearUserDB()
     getUserList();
 }
 
+void DeviceHandler::searchUsers(const QString &query, bool fuzzy)
+{
+    // Il device risponde con gli indici delle etichette corrispondenti (ordine alfabetico)
+    QByteArray data;
+    data.append(char(SEARCH_USERS));
+    data.append(char(fuzzy ? SEARCH_FUZZY : SEARCH_PREFIX));
+    data.append(query.toUtf8().left(MAX_LABEL_LEN));
+    writeCustomCharacteristic(data);
+}
+
 void DeviceHandler::enrollFingerprint()
 {
     setInfo("Follow instructions on devices's display");
@@ -367,30 +476,125 @@ void DeviceHandler::clearFingerprintDB()
 
 void DeviceHandler::getUserList()
 {
-    m_userList.clear();
-    getUserFromDevice(0);
+    // Tutta la lista in un solo flusso di notifiche invece di una richiesta per
+    // utente; con una sincronizzazione precedente solo gli utenti modificati dopo.
+    // Le password non fanno parte della lista (vedi fetchPassword)
+    m_syncDevice = m_currentDevice ? m_currentDevice->getAddress() : QString();
+    const SyncCache cache = m_syncCache.value(m_syncDevice);
+    m_userList = cache.users;
+    m_dumpActive = true;
+    m_passwordFetch = -1;
+    m_pendingEditIndex = -1;
+    m_pendingEdit.clear();
+    m_dumpSince = cache.revision;
+    m_dumpEpoch = cache.epoch;
+    m_dumpSeq = 0;
+    m_dumpNext = 0;
+    m_dumpReceived = 0;
+    m_dumpBuffer.clear();
+    m_dumpElapsed.start();
+    m_dumpTimer.start();
+    if (m_protoVersion == 0)
+        writeCustomCharacteristic(QByteArray(1, char(PROTO_VERSION)));
+    QByteArray data;
+    data.append(char(GET_USERS_META));
+    char revision[8];
+    qToLittleEndian<quint32>(m_dumpSince, revision);
+    qToLittleEndian<quint32>(m_dumpEpoch, revision + 4);
+    data.append(revision, sizeof(revision));
+    writeCustomCharacteristic(data);
+}
+
+void DeviceHandler::userDumpTimeout()
+{
+    if (!m_dumpActive)
+        return;
+    // Nessuna risposta (firmware precedente) o flusso interrotto: si prosegue
+    // con le richieste singole dal primo utente mancante
+    qWarning() << "[BLE] User dump stalled after" << m_dumpSeq << "frames, falling back to single requests";
+    m_dumpActive = false;
+    m_dumpBuffer.clear();
+    m_syncCache.remove(m_syncDevice);
+    if (m_dumpSince != 0) {
+        // un delta ha buchi negli indici: si ricomincia da capo
+        m_userList.clear();
+        m_dumpNext = 0;
+    }
+    getUserFromDevice(m_dumpNext);
 }
 
-UserEntry DeviceHandler::parseUserEntry(const QByteArray &data)
+// Ogni frame e' <cmd><seq><dati>: i dati dei frame consecutivi formano un unico
+// flusso di record <index><entry> (tagliati all'MTU), chiuso da
+// <LIST_EMPTY><count><revision><epoch> (firmware precedenti: senza revisione o
+// senza epoca, nel secondo caso il delta non e' affidabile e non si usa).
+// Con GET_USERS_META i record non contengono la password.
+void DeviceHandler::handleUserDump(const QByteArray &value)
 {
-    UserEntry entry;
+    if (!m_dumpActive || value.size() < 3)
+        return;
 
-    if (data.size() < 2) {
-        qWarning() << "Invalid data size for user entry parsing";
-        return entry;
+    const quint8 seq = quint8(value[1]);
+    if (seq != m_dumpSeq) {
+        qWarning() << "[BLE] User dump: expected frame" << m_dumpSeq << "got" << seq;
+        m_dumpTimer.stop();
+        userDumpTimeout();
+        return;
     }
+    m_dumpSeq++;
+    m_dumpBuffer.append(value.mid(2));
+    const bool withPassword = quint8(value[0]) != GET_USERS_META;
+    const int recordLen = withPassword ? USER_DUMP_RECORD_LEN : USER_META_RECORD_LEN;
 
     int offset = 0;
-    uint8_t cmd = quint8(data[offset++]);
-    if (cmd != GET_USERS_LIST) {
-        qWarning() << "Invalid command byte for user entry:" << QString::number(cmd, 16);
-        return entry;
+    while (offset < m_dumpBuffer.size()) {
+        const quint8 index = quint8(m_dumpBuffer[offset]);
+        if (index == LIST_EMPTY) {
+            // Il record di chiusura non e' mai spezzato tra due frame
+            const int count = m_dumpBuffer.size() > offset + 1 ? quint8(m_dumpBuffer[offset + 1]) : m_dumpNext;
+            quint32 revision = 0, epoch = 0;
+            if (m_dumpBuffer.size() >= offset + 10) {
+                revision = qFromLittleEndian<quint32>(m_dumpBuffer.constData() + offset + 2);
+                epoch = qFromLittleEndian<quint32>(m_dumpBuffer.constData() + offset + 6);
+            }
+            // Dopo un delta restano in cache gli utenti non modificati, ma non quelli
+            // oltre la fine della lista
+            while (!m_userList.isEmpty() && m_userList.lastKey() >= count)
+                m_userList.remove(m_userList.lastKey());
+            if (revision != 0 && epoch != 0)
+                m_syncCache[m_syncDevice] = { epoch, revision, m_userList };
+            else
+                m_syncCache.remove(m_syncDevice);
+
+            m_dumpActive = false;
+            m_dumpTimer.stop();
+            m_dumpBuffer.clear();
+            qDebug() << "[BLE] User sync:" << m_dumpReceived << "of" << m_userList.size() << "users transferred,"
+                     << m_dumpSeq << "frames in" << m_dumpElapsed.elapsed() << "ms, revision" << revision;
+            if (m_userList.isEmpty()) {
+                setInfo("User list empty, please add new user");
+                setIcon(IconSearch);
+            }
+            emit userListUpdated(userList());
+            return;
+        }
+        if (m_dumpBuffer.size() < offset + recordLen)
+            break;      // record a cavallo del frame successivo
+        m_userList[index] = parseUserEntry(m_dumpBuffer, offset + 1, withPassword);
+        m_dumpNext = index + 1;
+        m_dumpReceived++;
+        offset += recordLen;
     }
+    m_dumpBuffer.remove(0, offset);
+    m_dumpTimer.start();
+}
 
-    int index = quint8(data[offset++]);
-    Q_UNUSED(index);
+// data[offset] e' l'inizio dell'utente (etichetta), dopo l'intestazione del comando.
+// Senza password (GET_USERS_META) le opzioni seguono direttamente l'etichetta.
+UserEntry DeviceHandler::parseUserEntry(const QByteArray &data, int offset, bool withPassword)
+{
+    UserEntry entry;
 
-    if (data.size() < offset + MAX_LABEL_LEN + MAX_PASSWORD_LEN + 5) {
+    if (data.size() < offset + MAX_LABEL_LEN + (withPassword ? MAX_PASSWORD_LEN : 0) + 5) {
         qWarning() << "Insufficient data for user entry fields";
         return entry;
     }
@@ -403,24 +607,31 @@ UserEntry DeviceHandler::parseUserEntry(const QByteArray &data)
     entry.username = QString::fromUtf8(labelBytes.constData(), labelLen);
     entry.username = entry.username.trimmed();
 
-    QByteArray passwordRaw = data.mid(offset, MAX_PASSWORD_LEN);
-    offset += MAX_PASSWORD_LEN;
+    if (withPassword) {
+        QByteArray passwordRaw = data.mid(offset, MAX_PASSWORD_LEN);
+        offset += MAX_PASSWORD_LEN;
 
-    // Rimuovo null finali SOLO per la decodifica testuale
-    int rawLen = 0;
-    for (int i=0; i<passwordRaw.size(); ++i) {
-        if (passwordRaw[i] == '\0') break;
-        rawLen++;
+        // Rimuovo null finali SOLO per la decodifica testuale
+        int rawLen = 0;
+        for (int i=0; i<passwordRaw.size(); ++i) {
+            if (passwordRaw[i] == '\0') break;
+            rawLen++;
+        }
+        QByteArray shrink = passwordRaw.left(rawLen);
+        entry.rawPassword = shrink;
+        entry.password = PlaceholderEncoder::decode(shrink);
     }
-    QByteArray shrink = passwordRaw.left(rawLen);
-    entry.rawPassword = shrink;
-    entry.password = PlaceholderEncoder::decode(shrink);
 
     entry.winlogin         = (data[offset++] == 1);
     entry.sendEnter        = (data[offset++] == 1);
     entry.autoFinger       = (data[offset++] == 1);
     entry.fingerprintIndex = quint8(data[offset++]);
     entry.loginType        = quint8(data[offset++]);
+    // Firmware precedenti non inviano layout e fallback
+    if (data.size() > offset)
+        entry.layout       = quint8(data[offset++]);
+    if (data.size() > offset)
+        entry.fallback     = quint8(data[offset++]);
 
     return entry;
 }
@@ -476,6 +687,27 @@ void DeviceHandler::updateCharacteristicValue(const QLowEnergyCharacteristic &c,
     const quint8 index = quint8(value[1]);
     const QByteArray remainder = value.mid(2);
 
+    if (cmd == GET_USERS_DUMP || cmd == GET_USERS_META) {
+        handleUserDump(value);
+        return;
+    }
+
+    if (cmd == PROTO_VERSION) {
+        m_protoVersion = index;
+        qDebug() << "[BLE] User protocol version" << m_protoVersion;
+        return;
+    }
+
+    if (cmd == SEARCH_USERS) {
+        // <cmd><count><index>...: the list may be empty or start with index 0
+        QVariantList indices;
+        for (int i = 0; i < index && i < remainder.size(); ++i)
+            indices.append(int(quint8(remainder[i])));
+        qDebug() << "[BLE] Search result:" << indices;
+        emit searchResult(indices);
+        return;
+    }
+
     if (remainder.isEmpty() || remainder.at(0) == '\0') {
         QVariantList list = userList();
         qDebug() << "[BLE Notify] Lista utenti completata.";
@@ -502,8 +734,25 @@ void DeviceHandler::updateCharacteristicValue(const QLowEnergyCharacteristic &c,
         break;
     }
     case GET_USERS_LIST: {
-        UserEntry user = parseUserEntry(value);
+        UserEntry user = parseUserEntry(value, 2);
         m_userList[index] = user;
+        if (index == m_passwordFetch) {
+            // Risposta a fetchPassword: un solo utente, la lista non prosegue
+            m_passwordFetch = -1;
+            auto cached = m_syncCache.find(m_syncDevice);
+            if (cached != m_syncCache.end() && cached->users.contains(index))
+                cached->users[index] = user;
+            emit passwordReceived(index, user.password);
+            if (index == m_pendingEditIndex) {
+                // Modifica rimasta in attesa della password (firmware legacy)
+                QVariantMap pending = m_pendingEdit;
+                pending["password"] = user.password;
+                m_pendingEditIndex = -1;
+                m_pendingEdit.clear();
+                editUser(index, pending);
+            }
+            break;
+        }
         qDebug() << "User:" << user.username;
         qDebug() << "Winlogin:" << user.winlogin;
         qDebug() << "SendEnter:" << user.sendEnter;
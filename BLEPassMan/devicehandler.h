@@ -6,6 +6,7 @@
 
 #include "bluetoothbaseclass.h"
 #include "placeholderencoder.h"
+#include "user_proto.h"
 
 #include <QLowEnergyController>
 #include <QLowEnergyService>
@@ -13,7 +14,9 @@
 #include <QDateTime>
 #include <QList>
 #include <QMap>
+#include <QHash>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QQmlEngine>
 
 #define NOT_AUTHORIZED  0x99
@@ -22,16 +25,28 @@
 #define EDIT_USER       0xA3
 #define REMOVE_USER     0xA4
 #define CLEAR_USER_DB   0xA5
+#define SEARCH_USERS    0xA6
+#define GET_USERS_DUMP  0xA7    // lista completa (o delta da una revisione) come flusso di notifiche
+#define GET_USERS_META  0xA8    // come GET_USERS_DUMP, ma senza password
+#define WRITE_USER      0xA9    // aggiunta/modifica in formato TLV (user_proto.h), solo i campi cambiati
 #define BLE_MESSAGE     0xAA
 #define BATTERY_MV      0xAB
+#define PROTO_VERSION   0xAC    // versione di user_proto supportata dal firmware
 #define ENROLL_FINGER   0xB0
 #define CLEAR_LIBRARY   0xB2
 
 #define LIST_EMPTY      0xFF
 
+#define SEARCH_PREFIX   0x00
+#define SEARCH_FUZZY    0x01
+
 // Lunghezze fisse lato firmware
 static constexpr int MAX_LABEL_LEN     = 32;
 static constexpr int MAX_PASSWORD_LEN  = 32;
+// Record del dump: <index><label><password><7 byte di opzioni>
+static constexpr int USER_DUMP_RECORD_LEN = 1 + MAX_LABEL_LEN + MAX_PASSWORD_LEN + 7;
+// Record della lista senza password: <index><label><7 byte di opzioni>
+static constexpr int USER_META_RECORD_LEN = 1 + MAX_LABEL_LEN + 7;
 
 struct UserEntry {
     QString username;
@@ -39,6 +54,8 @@ struct UserEntry {
     QByteArray rawPassword; // Byte encoded (placeholder 0x80..0x87 + ASCII)
     quint8 fingerprintIndex = 0;
     quint8 loginType = 0;
+    quint8 layout = 0;    // Layout tastiera dell'host (0: quello del dispositivo, 1 IT, 2 US, 3 UK, 4 DE, 5 FR)
+    quint8 fallback = 0;  // Caratteri assenti nel layout (0 salta, 1 Alt code, 2 Ctrl+Shift+U, 3 rifiuta)
     bool autoFinger = false;
     bool winlogin = false;
     bool sendEnter = false;
@@ -77,6 +94,8 @@ signals:
     Q_SIGNAL void userListUpdated(QVariantList list);
     Q_SIGNAL void serviceReady();
     Q_SIGNAL void batteryLevelChanged();
+    Q_SIGNAL void searchResult(QVariantList indices);
+    Q_SIGNAL void passwordReceived(int index, QString password);
 
 public slots:
     void getUserList();
@@ -86,6 +105,8 @@ public slots:
     Q_INVOKABLE void editUser(int index, const QVariantMap &user);
     Q_INVOKABLE void removeUser(int index);
     Q_INVOKABLE void clearUserDB();
+    Q_INVOKABLE void searchUsers(const QString &query, bool fuzzy = false);
+    Q_INVOKABLE void fetchPassword(int index);
 
     void getUserFromDevice(int index);
 
@@ -103,8 +124,11 @@ private:
     void confirmedDescriptorWrite(const QLowEnergyDescriptor &d, const QByteArray &value);
     void writeCustomCharacteristic(const QByteArray &data);
 
-    UserEntry parseUserEntry(const QByteArray &data);
+    UserEntry parseUserEntry(const QByteArray &data, int offset, bool withPassword = true);
+    void handleUserDump(const QByteArray &value);
+    void userDumpTimeout();
     QByteArray buildUserPayload(quint8 cmd, quint8 index, const UserEntry &entry);
+    QByteArray buildUserFrame(quint8 index, const UserEntry &entry, const UserEntry *previous);
 
     void batteryServiceStateChanged(QLowEnergyService::ServiceState s);
     void updateBatteryLevel(const QLowEnergyCharacteristic &c, const QByteArray &value);
@@ -133,6 +157,42 @@ private:
 
     QMap<int, UserEntry> m_userList;
     int m_currentUserIndex = 0;
+
+    // Versione di user_proto del firmware (PROTO_VERSION): 0 finche' non risponde,
+    // e con un firmware precedente si scrive nel formato a offset fissi
+    int m_protoVersion = 0;
+
+    // Dump della lista (GET_USERS_DUMP): sequenza attesa e watchdog. Con un
+    // firmware precedente o una notifica persa si torna alle richieste singole.
+    bool m_dumpActive = false;
+    quint32 m_dumpSince = 0;            // revisione chiesta (0: lista completa)
+    quint32 m_dumpEpoch = 0;            // epoca del DB di quella revisione
+    quint8 m_dumpSeq = 0;
+    int m_dumpNext = 0;                 // primo utente non ancora ricevuto
+    int m_dumpReceived = 0;
+    QByteArray m_dumpBuffer;            // record incompleto in attesa del frame successivo
+    QTimer m_dumpTimer;
+    QElapsedTimer m_dumpElapsed;
+
+    // La lista arriva senza password (GET_USERS_META): la password di un utente
+    // si chiede con GET_USERS_LIST solo quando serve (modifica, visualizzazione)
+    int m_passwordFetch = -1;
+    // Modifica di un utente in attesa della sua password (EDIT_USER legacy)
+    int m_pendingEditIndex = -1;
+    QVariantMap m_pendingEdit;
+
+    // Ultimo stato sincronizzato per dispositivo: a una nuova connessione si
+    // chiedono solo gli utenti cambiati. Solo in memoria, contiene le password
+    // gia' richieste. Una revisione vale solo con la sua epoca (casuale, cambia
+    // quando il DB del dispositivo viene cancellato o ricreato): se l'epoca non
+    // coincide il firmware manda la lista completa e la cache viene sostituita.
+    struct SyncCache {
+        quint32 epoch = 0;
+        quint32 revision = 0;
+        QMap<int, UserEntry> users;
+    };
+    QHash<QString, SyncCache> m_syncCache;
+    QString m_syncDevice;
 };
 
 #endif // DEVICEHANDLER_H
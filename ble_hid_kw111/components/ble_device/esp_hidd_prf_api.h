@@ -23,6 +23,7 @@ typedef enum {
     ESP_HIDD_EVENT_BLE_DISCONNECT,
     ESP_HIDD_EVENT_BLE_VENDOR_REPORT_WRITE_EVT,
     ESP_HIDD_EVENT_BLE_LED_REPORT_WRITE_EVT,
+    ESP_HIDD_EVENT_BLE_CONGEST,
 } esp_hidd_cb_event_t;
 
 /// HID config status
@@ -78,6 +79,8 @@ typedef union {
     struct hidd_connect_evt_param {
         uint16_t conn_id;
         esp_bd_addr_t remote_bda;                   /*!< HID Remote bluetooth connection index */
+        uint16_t conn_int;                          /*!< Connection interval (unit 1.25 ms) */
+        uint16_t latency;                           /*!< Slave latency (connection events) */
     } connect;									    /*!< HID callback param of ESP_HIDD_EVENT_CONNECT */
 
     /**
@@ -106,6 +109,14 @@ typedef union {
         uint8_t length;
         uint8_t *data;
     } led_write;
+
+    /**
+     * @brief ESP_HIDD_EVENT_BLE_CONGEST
+     */
+    struct hidd_congest_evt_param {
+        uint16_t conn_id;
+        bool congested;                             /*!< true while the controller has no free tx buffers */
+    } congest;
 } esp_hidd_cb_param_t;
 
 
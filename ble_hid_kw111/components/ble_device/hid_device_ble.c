@@ -17,6 +17,7 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "esp_bt.h"
 
@@ -32,6 +33,9 @@
 #include "hid_dev.h"
 #include "hid_device_ble.h"
 #include "hid_device_prf.h"
+#include "hid_output.h"
+#include "hid_layout.h"
+#include "hid_encoder.h"
 
 #include "display_oled.h"
 #include "user_list.h"
@@ -39,7 +43,6 @@
 // --- PLACEHOLDER SUPPORT ----------------------------------------------------
 #include "buttons.h"
 #include "display_oled.h"
-#include "password_placeholders.h"
 
 
 #define HID_DEMO_TAG        "HID BLE"
@@ -62,9 +65,44 @@ static int whitelist_count = 0;
 #define MAX_WHITELIST_SIZE 10
 static esp_bd_addr_t whitelist_devices[MAX_WHITELIST_SIZE];
 
+// Report pacing: the link moves about one keyboard report per connection event,
+// so reports are spent from a small credit that grows with the negotiated interval
+#define BLE_CONN_INT_DEFAULT    0x18    // 30 ms, until the connect/update event tells otherwise
+#define BLE_PACE_BURST          2       // reports the controller can buffer ahead of the link
+#define BLE_PACE_CONGEST_MS     500     // max wait for the stack to drain a congested link
+#define BLE_PACE_UNCONGESTED    BIT0
+
+static volatile uint16_t s_conn_int = BLE_CONN_INT_DEFAULT;    // unit 1.25 ms
+static volatile uint16_t s_conn_latency = 0;
+static EventGroupHandle_t s_pace_events = NULL;
+static int64_t s_pace_last_us = 0;
+static int64_t s_pace_credit_us = 0;
+
+// Connection parameter policy: short interval while typing, long interval with
+// slave latency when idle (the host may refuse or pick other values)
+#define BLE_CONN_FAST_MIN_INT   0x06    // 7.5 ms
+#define BLE_CONN_FAST_MAX_INT   0x0C    // 15 ms
+#define BLE_CONN_IDLE_MIN_INT   0x30    // 60 ms
+#define BLE_CONN_IDLE_MAX_INT   0x3C    // 75 ms
+#define BLE_CONN_IDLE_LATENCY   4       // skip up to 4 events when there is nothing to send
+#define BLE_CONN_TIMEOUT        600     // 6 s, unit 10 ms (> 2 * (1 + latency) * max interval)
+#define BLE_CONN_FAST_WAIT_MS   500     // how long typing waits for the host to switch
+#define BLE_CONN_IDLE_AFTER_MS  3000    // relax after this long without typing
+#define BLE_CONN_UPDATE_DONE    BIT1
+
+static volatile ble_conn_policy_state_t s_conn_state = BLE_CONN_POLICY_IDLE;
+static ble_conn_policy_stats_t s_conn_stats = {0};
+static esp_timer_handle_t s_conn_idle_timer = NULL;
+static portMUX_TYPE s_conn_mux = portMUX_INITIALIZER_UNLOCKED;     // s_conn_state, s_conn_bursts, s_conn_stale
+static int s_conn_bursts = 0;           // trasferimenti in corso (dump della lista): niente relax
+static int s_conn_stale = 0;            // risposte al relax ancora in volo quando e' ripartita la richiesta veloce
+
 
 
 static void hidd_event_callback(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *param);
+static void ble_set_conn_params(uint16_t conn_int, uint16_t latency);
+static void ble_conn_schedule_idle(void);
+static void ble_conn_update_done(bool success, uint16_t conn_int, uint16_t latency);
 
 static uint8_t hidd_service_uuid128[] = {
     /* LSB <--------------------------------------------------------------------------------> MSB */
@@ -172,6 +210,12 @@ static void hidd_event_callback(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *
             }
             
             hid_conn_id = param->connect.conn_id;
+            ble_set_conn_params(param->connect.conn_int, param->connect.latency);
+            portENTER_CRITICAL(&s_conn_mux);
+            s_conn_state = BLE_CONN_POLICY_IDLE;
+            s_conn_stale = 0;
+            portEXIT_CRITICAL(&s_conn_mux);
+            ble_conn_schedule_idle();    // host params until discovery/pairing is over
             // Store the remote device address for potential disconnection
             memcpy(remote_bd_addr, param->connect.remote_bda, sizeof(esp_bd_addr_t));
             ESP_LOGI(HID_DEMO_TAG, "Connected. conn_id: %u, device: "ESP_BD_ADDR_STR"", hid_conn_id, ESP_BD_ADDR_HEX(remote_bd_addr));
@@ -182,6 +226,15 @@ static void hidd_event_callback(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *
             ESP_LOGI(HID_DEMO_TAG, "Remote device was: "ESP_BD_ADDR_STR"", ESP_BD_ADDR_HEX(remote_bd_addr));
             
             hid_conn_id = 0; // Reset connection ID on disconnect
+            ble_set_conn_params(BLE_CONN_INT_DEFAULT, 0);
+            portENTER_CRITICAL(&s_conn_mux);
+            s_conn_state = BLE_CONN_POLICY_IDLE;
+            s_conn_stale = 0;
+            portEXIT_CRITICAL(&s_conn_mux);
+            if (s_conn_idle_timer)
+                esp_timer_stop(s_conn_idle_timer);
+            if (s_pace_events)
+                xEventGroupSetBits(s_pace_events, BLE_PACE_UNCONGESTED | BLE_CONN_UPDATE_DONE);
             memset(remote_bd_addr, 0, sizeof(esp_bd_addr_t)); // Clear remote address
             ble_userlist_authenticated = false; // Reset authentication status
             ESP_LOGI(HID_DEMO_TAG, "ESP_HIDD_EVENT_BLE_DISCONNECT - all connection variables reset");
@@ -198,6 +251,16 @@ static void hidd_event_callback(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *
             ESP_LOG_BUFFER_HEX(HID_DEMO_TAG, param->led_write.data, param->led_write.length);
             break;
         }
+        case ESP_HIDD_EVENT_BLE_CONGEST: {
+            ESP_LOGD(HID_DEMO_TAG, "Link %s", param->congest.congested ? "congested" : "free");
+            if (s_pace_events == NULL)
+                break;
+            if (param->congest.congested)
+                xEventGroupClearBits(s_pace_events, BLE_PACE_UNCONGESTED);
+            else
+                xEventGroupSetBits(s_pace_events, BLE_PACE_UNCONGESTED);
+            break;
+        }
         default:
             break;
     }
@@ -278,6 +341,8 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
                      param->update_conn_params.conn_int,
                      param->update_conn_params.latency,
                      param->update_conn_params.timeout);
+            ble_conn_update_done(param->update_conn_params.status == ESP_BT_STATUS_SUCCESS,
+                                 param->update_conn_params.conn_int, param->update_conn_params.latency);
             break;
         }
         default:
@@ -298,118 +363,336 @@ bool ble_userlist_is_authenticated() {
     return ble_userlist_authenticated;
 }
 
-uint8_t const ble_conv_table[128][2] =  { HID_IT_IT_ASCII_TO_KEYCODE };
+static void ble_set_conn_params(uint16_t conn_int, uint16_t latency) {
+    if (conn_int == 0)
+        return;    // Bluedroid non ha riportato i parametri
+    s_conn_int = conn_int;
+    s_conn_latency = latency;
+    ESP_LOGD(HID_DEMO_TAG, "Report pacing: %u us per report (latency %u)", conn_int * 1250u, latency);
+}
 
-// Invia una sequenza HID: pressione e rilascio
-static void ble_send_hid_key(uint8_t keycode[8]) {    
-    // HID report: [modifier, reserved, key1, key2, key3, key4, key5, key6]
-    // Send key press
-    esp_hidd_send_keyboard_value(hid_conn_id, keycode[0], &keycode[2], 1);
-    vTaskDelay(10 / portTICK_PERIOD_MS);
+static esp_err_t ble_conn_request(uint16_t min_int, uint16_t max_int, uint16_t latency) {
+    esp_ble_conn_update_params_t params = {
+        .min_int = min_int,
+        .max_int = max_int,
+        .latency = latency,
+        .timeout = BLE_CONN_TIMEOUT,
+    };
+    memcpy(params.bda, remote_bd_addr, sizeof(esp_bd_addr_t));
+    esp_err_t ret = esp_ble_gap_update_conn_params(&params);
+    if (ret != ESP_OK)
+        ESP_LOGW(HID_DEMO_TAG, "Connection params request failed: %s", esp_err_to_name(ret));
+    return ret;
+}
 
-    // Send key release
-    uint8_t release_key = 0;
-    esp_hidd_send_keyboard_value(hid_conn_id, 0, &release_key, 0);
+// Moves the policy from one state to another only if nobody changed it meanwhile
+// (the GAP event may arrive before the request returns, or after a timeout)
+static bool ble_conn_transition(ble_conn_policy_state_t from, ble_conn_policy_state_t to) {
+    portENTER_CRITICAL(&s_conn_mux);
+    bool done = s_conn_state == from;
+    if (done)
+        s_conn_state = to;
+    portEXIT_CRITICAL(&s_conn_mux);
+    return done;
 }
 
- 
-void ble_send_char(wint_t chr)
-{    
-    uint8_t keycode[8] = { 0 };
-    keycode[0] = ble_conv_table[chr][0];    
-    keycode[2] = ble_conv_table[chr][1];
-    ble_send_hid_key(keycode);
+static void ble_conn_idle_timer_cb(void* arg) {
+    if (!ble_is_connected())
+        return;
+    portENTER_CRITICAL(&s_conn_mux);
+    bool busy = s_conn_bursts > 0;
+    portEXIT_CRITICAL(&s_conn_mux);
+    if (busy)
+        return;     // ble_conn_end_burst() riprogramma il timer
+    if (s_conn_int >= BLE_CONN_IDLE_MIN_INT && s_conn_latency > 0)
+        return;    // l'host ha gia' scelto parametri a basso consumo
+
+    // Pending before the request: the answer can be dispatched before it returns
+    ble_conn_policy_state_t prev = s_conn_state;
+    if (prev == BLE_CONN_POLICY_FAST_PENDING || prev == BLE_CONN_POLICY_RELAX_PENDING ||
+        !ble_conn_transition(prev, BLE_CONN_POLICY_RELAX_PENDING))
+        return;
+    s_conn_stats.relax_requests++;
+    if (ble_conn_request(BLE_CONN_IDLE_MIN_INT, BLE_CONN_IDLE_MAX_INT, BLE_CONN_IDLE_LATENCY) != ESP_OK)
+        ble_conn_transition(BLE_CONN_POLICY_RELAX_PENDING, prev);
 }
 
+static void ble_conn_schedule_idle(void) {
+    if (s_conn_idle_timer == NULL)
+        return;
+    esp_timer_stop(s_conn_idle_timer);
+    esp_timer_start_once(s_conn_idle_timer, BLE_CONN_IDLE_AFTER_MS * 1000ULL);
+}
 
-void ble_send_key_combination(uint8_t modifiers, uint8_t key)
-{
-    uint8_t keycode[8] = {0}; 
-    keycode[0] = modifiers;  // Modifier combination
-    keycode[2] = key;        // Tasto principale
-    ble_send_hid_key(keycode);
-}
-
-static void ble_handle_placeholder(uint8_t ph) {
-    switch (ph) {
-        case PW_PH_ENTER:
-            ble_send_key_combination(KEYBOARD_MODIFIER_NONE, HID_KEY_ENTER); break;
-        case PW_PH_TAB:
-            ble_send_key_combination(KEYBOARD_MODIFIER_NONE, HID_KEY_TAB); break;
-        case PW_PH_ESC:
-            ble_send_key_combination(KEYBOARD_MODIFIER_NONE, HID_KEY_ESCAPE); break;
-        case PW_PH_BACKSPACE:
-            ble_send_key_combination(KEYBOARD_MODIFIER_NONE, HID_KEY_BACKSPACE); break;
-        case PW_PH_DELAY_500MS:
-            vTaskDelay(pdMS_TO_TICKS(500)); break;
-        case PW_PH_DELAY_1000MS:
-            vTaskDelay(pdMS_TO_TICKS(1000)); break;
-        case PW_PH_CTRL_ALT_DEL:
-            ble_send_key_combination(HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, HID_KEY_DELETE); break;
-        case PW_PH_SHIFT_TAB:
-            ble_send_key_combination(HID_MODIFIER_LEFT_SHIFT, HID_KEY_TAB); break;
-        case PW_PH_SLEEP:
-            // Go to sleep only if data was actually delivered recently or BLE is ready.
-            // If BLE is disconnected, don't sleep; show warning to user.
-            if (!ble_is_connected()) {
-                ESP_LOGW(HID_DEMO_TAG, "Sleep placeholder ignored: BLE not connected/ready");
-                display_oled_post_error("BLE not connected");
-            } else {
-                display_oled_deinit();
-                enter_deep_sleep();
-            }
+// ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT: answer to our request or update started by the host
+static void ble_conn_update_done(bool success, uint16_t conn_int, uint16_t latency) {
+    if (success)
+        ble_set_conn_params(conn_int, latency);
+
+    portENTER_CRITICAL(&s_conn_mux);
+    ble_conn_policy_state_t state = s_conn_state;
+    bool stale = state == BLE_CONN_POLICY_FAST_PENDING && s_conn_stale > 0;
+    switch (state) {
+        case BLE_CONN_POLICY_FAST_PENDING:
+            if (stale)
+                s_conn_stale--;     // risposta al relax: la richiesta veloce e' ancora in attesa
+            else
+                s_conn_state = success ? BLE_CONN_POLICY_FAST : BLE_CONN_POLICY_IDLE;
+            break;
+        case BLE_CONN_POLICY_RELAX_PENDING:
+            s_conn_state = BLE_CONN_POLICY_IDLE;
             break;
         default:
-            break; // Non gestito (futuro)
+            // The host may drop us back to a slow interval on its own
+            if (success && state == BLE_CONN_POLICY_FAST && conn_int > BLE_CONN_FAST_MAX_INT)
+                s_conn_state = BLE_CONN_POLICY_IDLE;
+            break;
+    }
+    portEXIT_CRITICAL(&s_conn_mux);
+
+    if (state == BLE_CONN_POLICY_FAST_PENDING || state == BLE_CONN_POLICY_RELAX_PENDING) {
+        if (success)
+            s_conn_stats.accepted++;
+        else
+            s_conn_stats.rejected++;
+    } else {
+        s_conn_stats.peer_updates++;
     }
+    if (state == BLE_CONN_POLICY_FAST_PENDING && !stale && s_pace_events)
+        xEventGroupSetBits(s_pace_events, BLE_CONN_UPDATE_DONE);
 }
 
-void ble_send_string(const char* str) {
-    size_t i = 0;
-    while (str[i]) {
-        uint8_t b = (uint8_t)str[i];
-        if (PW_IS_PLACEHOLDER(b)) { // Gestione placeholder 0x80-0x8F
-            ble_handle_placeholder(b);
-            i++;
-            continue;
-        }
+// Called before every typing burst: asks for the short interval and waits a bit
+// for the host to apply it, then keeps it until BLE_CONN_IDLE_AFTER_MS of silence
+static void ble_conn_begin_typing(void) {
+    if (!ble_is_connected())
+        return;
+    if (s_conn_idle_timer)
+        esp_timer_stop(s_conn_idle_timer);
+
+    // Check and set in one step: the typing task and a dump (ble_conn_begin_burst)
+    // may get here together, only one of them sends the request. Pending before
+    // the request: the answer can be dispatched before it returns.
+    portENTER_CRITICAL(&s_conn_mux);
+    ble_conn_policy_state_t prev = s_conn_state;
+    bool request = prev == BLE_CONN_POLICY_IDLE || prev == BLE_CONN_POLICY_RELAX_PENDING;
+    if (prev == BLE_CONN_POLICY_IDLE && s_conn_int <= BLE_CONN_FAST_MAX_INT && s_conn_latency == 0) {
+        s_conn_state = BLE_CONN_POLICY_FAST;    // gia' veloce (es. subito dopo la connessione)
+        request = false;
+    } else if (request) {
+        // Relax in volo: il link e' ancora veloce ma la sua risposta lo rallentera',
+        // si chiede di nuovo l'intervallo corto e la risposta al relax si scarta
+        s_conn_stale = prev == BLE_CONN_POLICY_RELAX_PENDING ? 1 : 0;
+        s_conn_state = BLE_CONN_POLICY_FAST_PENDING;
+    }
+    portEXIT_CRITICAL(&s_conn_mux);
+    if (!request)
+        return;
 
-        wint_t wc = (wint_t)b;
-        // ASCII semplice
-        if ((wc & 0x80) == 0) {
-            ble_send_char(wc);
-            i++;
-            continue;
-        }
+    s_conn_stats.fast_requests++;
+    if (s_pace_events)
+        xEventGroupClearBits(s_pace_events, BLE_CONN_UPDATE_DONE);
+    if (ble_conn_request(BLE_CONN_FAST_MIN_INT, BLE_CONN_FAST_MAX_INT, 0) != ESP_OK) {
+        portENTER_CRITICAL(&s_conn_mux);
+        if (s_conn_state == BLE_CONN_POLICY_FAST_PENDING)
+            s_conn_state = prev;
+        s_conn_stale = 0;
+        portEXIT_CRITICAL(&s_conn_mux);
+        return;
+    }
+    if (s_pace_events == NULL)
+        return;
+    EventBits_t bits = xEventGroupWaitBits(s_pace_events, BLE_CONN_UPDATE_DONE, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(BLE_CONN_FAST_WAIT_MS));
+    if (!(bits & BLE_CONN_UPDATE_DONE)) {
+        // Typing goes on at the current interval; a late answer is a peer update
+        s_conn_stats.timeouts++;
+        portENTER_CRITICAL(&s_conn_mux);
+        if (s_conn_state == BLE_CONN_POLICY_FAST_PENDING)
+            s_conn_state = BLE_CONN_POLICY_IDLE;
+        s_conn_stale = 0;
+        portEXIT_CRITICAL(&s_conn_mux);
+        ESP_LOGW(HID_DEMO_TAG, "No answer to the fast interval request in %d ms", BLE_CONN_FAST_WAIT_MS);
+    }
+}
 
-        // Multi-byte UTF-8 (accenti) – logica precedente
-        int len = 1;
-        int pos = i;
-        uint32_t codepoint = 0;
-        if ((wc & 0xE0) == 0xC0) len = 2;
-        else if ((wc & 0xF0) == 0xE0) len = 3;
-        else if ((wc & 0xF8) == 0xF0) len = 4;
-        for (int j = 0; j < len; ++j) {
-            codepoint = (codepoint << 8) | (unsigned char)str[pos + j];
-            i++;
-        }
-        uint8_t keycode[8] = {0};
-        switch (codepoint) {
-            case 'à': keycode[0] = KEYBOARD_MODIFIER_NONE;        keycode[2] = 0x34; break;
-            case 'è': keycode[0] = KEYBOARD_MODIFIER_NONE;        keycode[2] = 0x2F; break;
-            case 'é': keycode[0] = KEYBOARD_MODIFIER_LEFTSHIFT;   keycode[2] = 0x2F; break;
-            case 'ì': keycode[0] = KEYBOARD_MODIFIER_NONE;        keycode[2] = 0x2E; break;
-            case 'ò': keycode[0] = KEYBOARD_MODIFIER_NONE;        keycode[2] = 0x33; break;
-            case 'ù': keycode[0] = KEYBOARD_MODIFIER_NONE;        keycode[2] = 0x31; break;
-            case '€': keycode[0] = KEYBOARD_MODIFIER_RIGHTALT;    keycode[2] = 0x08; break;
-            case '£': keycode[0] = KEYBOARD_MODIFIER_LEFTSHIFT;   keycode[2] = 0x20; break;
-            case 'ç': keycode[0] = KEYBOARD_MODIFIER_LEFTSHIFT;   keycode[2] = 0x33; break;
-            case '§': keycode[0] = KEYBOARD_MODIFIER_LEFTSHIFT;   keycode[2] = 0x31; break;
-            case '°': keycode[0] = KEYBOARD_MODIFIER_LEFTSHIFT;   keycode[2] = 0x34; break;
-            default: break; // ignora se non riconosciuto
+static void ble_conn_end_typing(void) {
+    if (ble_is_connected())
+        ble_conn_schedule_idle();
+}
+
+void ble_conn_begin_burst(void) {
+    portENTER_CRITICAL(&s_conn_mux);
+    s_conn_bursts++;
+    portEXIT_CRITICAL(&s_conn_mux);
+    // Il link puo' essere gia' rilassato (es. dopo una lista letta voce per voce)
+    ble_conn_begin_typing();
+}
+
+void ble_conn_end_burst(void) {
+    portENTER_CRITICAL(&s_conn_mux);
+    if (s_conn_bursts > 0)
+        s_conn_bursts--;
+    bool idle = s_conn_bursts == 0;
+    portEXIT_CRITICAL(&s_conn_mux);
+    if (idle && ble_is_connected())
+        ble_conn_schedule_idle();
+}
+
+void ble_conn_policy_get(ble_conn_policy_stats_t* out) {
+    if (out == NULL)
+        return;
+    *out = s_conn_stats;
+    out->state = s_conn_state;
+    out->conn_int = s_conn_int;
+    out->latency = s_conn_latency;
+}
+
+void ble_conn_policy_reset_stats(void) {
+    memset(&s_conn_stats, 0, sizeof(s_conn_stats));
+}
+
+bool ble_wait_uncongested(uint32_t timeout_ms) {
+    if (s_pace_events == NULL)
+        return false;
+    TickType_t start = xTaskGetTickCount();
+    for (;;) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+        EventBits_t bits = xEventGroupWaitBits(s_pace_events, BLE_PACE_UNCONGESTED, pdFALSE, pdTRUE,
+                                               elapsed < timeout ? timeout - elapsed : 0);
+        if (!(bits & BLE_PACE_UNCONGESTED))
+            return false;
+        // The congest event reaches us through the stack task, after the buffer is
+        // already full: ask the controller, a notification sent now would be dropped
+        if (esp_ble_get_cur_sendable_packets_num(hid_conn_id) > 0)
+            return true;
+        if (!ble_is_connected() || xTaskGetTickCount() - start >= timeout)
+            return false;
+        vTaskDelay(1);
+    }
+}
+
+// Blocks until the link can take one more report without dropping it;
+// false if it is still congested after BLE_PACE_CONGEST_MS
+static bool ble_pace_report(void) {
+    if (s_pace_events && !(xEventGroupGetBits(s_pace_events) & BLE_PACE_UNCONGESTED)) {
+        EventBits_t bits = xEventGroupWaitBits(s_pace_events, BLE_PACE_UNCONGESTED, pdFALSE, pdTRUE,
+                                               pdMS_TO_TICKS(BLE_PACE_CONGEST_MS));
+        if (!(bits & BLE_PACE_UNCONGESTED)) {
+            ESP_LOGW(HID_DEMO_TAG, "Link still congested after %d ms", BLE_PACE_CONGEST_MS);
+            return false;
         }
-        ble_send_hid_key(keycode);
+        s_pace_credit_us = 0;    // il buffer del controller si e' appena svuotato a fatica
+        s_pace_last_us = esp_timer_get_time();
+    }
+
+    const int64_t report_us = (int64_t)s_conn_int * 1250;
+    for (;;) {
+        int64_t now = esp_timer_get_time();
+        s_pace_credit_us += now - s_pace_last_us;
+        s_pace_last_us = now;
+        if (s_pace_credit_us > BLE_PACE_BURST * report_us)
+            s_pace_credit_us = BLE_PACE_BURST * report_us;
+        if (s_pace_credit_us >= report_us)
+            break;
+        // The tick (10 ms) is coarser than short intervals: sleeping one tick earns
+        // more than one report of credit, so the average rate still matches the link
+        int64_t missing_us = report_us - s_pace_credit_us;
+        TickType_t ticks = (missing_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000);
+        vTaskDelay(ticks);
     }
+    s_pace_credit_us -= report_us;
+    return true;
+}
+
+// Sink of the shared encoder: every report waits for its slot on the link.
+// ctx (esp_err_t*, may be NULL) keeps the first error: after it nothing else
+// is sent, a login typed in part must not go on
+static void ble_sink_report(void* ctx, uint8_t modifier, const uint8_t* keys, uint8_t count) {
+    esp_err_t* result = ctx;
+    if (result && *result != ESP_OK)
+        return;
+    esp_err_t err = ESP_OK;
+    if (!ble_is_connected())
+        err = ESP_ERR_INVALID_STATE;
+    else if (!ble_pace_report())
+        err = ESP_ERR_TIMEOUT;
+    else
+        esp_hidd_send_keyboard_value(hid_conn_id, modifier, (uint8_t*)keys, count);
+    if (result && err != ESP_OK)
+        *result = err;
+}
+
+static void ble_sink_delay(void* ctx, uint32_t ms) {
+    const esp_err_t* result = ctx;
+    if (result == NULL || *result == ESP_OK)
+        vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+static void ble_sink_sleep(void* ctx) {
+    const esp_err_t* result = ctx;
+    if (result && *result != ESP_OK)
+        return;
+    // Go to sleep only if data was actually delivered recently or BLE is ready.
+    // If BLE is disconnected, don't sleep; show warning to user.
+    if (!ble_is_connected()) {
+        ESP_LOGW(HID_DEMO_TAG, "Sleep placeholder ignored: BLE not connected/ready");
+        display_oled_post_error("BLE not connected");
+    } else {
+        display_oled_deinit();
+        enter_deep_sleep();
+    }
+}
+
+static const hid_encoder_sink_t s_ble_sink = {
+    .send_report = ble_sink_report,
+    .delay_ms = ble_sink_delay,
+    .sleep = ble_sink_sleep,
+};
+
+ 
+void ble_send_char(wint_t chr)
+{    
+    const hid_layout_key_t* k = hid_layout_lookup(HID_LAYOUT_DEVICE, chr);
+    if (k == NULL)
+        return;     // Carattere non disponibile nel layout
+    ble_conn_begin_typing();
+    hid_encoder_tap(k->modifier, k->key, &s_ble_sink);
+    ble_conn_end_typing();
+}
+
+
+void ble_send_key_combination(uint8_t modifiers, uint8_t key)
+{
+    ble_conn_begin_typing();
+    hid_encoder_tap(modifiers, key, &s_ble_sink);
+    ble_conn_end_typing();
+}
+
+// Esegue un programma precompilato (vedi hid_program.h) con il pacing del link.
+// ESP_ERR_INVALID_STATE: non connesso (anche a meta'), ESP_ERR_TIMEOUT: link congestionato
+esp_err_t ble_send_program(const hid_program_t* prog) {
+    if (!ble_is_connected())
+        return ESP_ERR_INVALID_STATE;
+    esp_err_t result = ESP_OK;
+    hid_encoder_sink_t sink = s_ble_sink;
+    sink.ctx = &result;
+    ble_conn_begin_typing();
+    hid_encoder_run(prog, &sink);
+    ble_conn_end_typing();
+    return result;
+}
+
+void ble_send_string(const char* str) {
+    hid_program_t prog;
+    while (*str) {
+        hid_program_init(&prog);
+        str += hid_program_add_text(&prog, str, HID_LAYOUT_DEVICE, HID_FALLBACK_SKIP);
+        if (ble_send_program(&prog) != ESP_OK)
+            break;
+    }
+    hid_program_wipe(&prog);
 }
 
 esp_err_t ble_device_init(void)
@@ -417,6 +700,22 @@ esp_err_t ble_device_init(void)
     esp_err_t ret;
     ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
 
+    s_pace_events = xEventGroupCreate();
+    if (s_pace_events == NULL) {
+        ESP_LOGE(HID_DEMO_TAG, "%s create pacing event group failed", __func__);
+        return ESP_ERR_NO_MEM;
+    }
+    xEventGroupSetBits(s_pace_events, BLE_PACE_UNCONGESTED);
+
+    const esp_timer_create_args_t idle_timer_args = {
+        .callback = ble_conn_idle_timer_cb,
+        .name = "ble_conn_idle",
+    };
+    if ((ret = esp_timer_create(&idle_timer_args, &s_conn_idle_timer)) != ESP_OK) {
+        ESP_LOGE(HID_DEMO_TAG, "%s create connection idle timer failed", __func__);
+        return ret;
+    }
+
     esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
     ret = esp_bt_controller_init(&bt_cfg);
     if (ret) {
@@ -487,6 +786,14 @@ esp_err_t ble_device_init(void)
     whitelist_enabled = false;
     whitelist_count = 0;
     ESP_LOGI(HID_DEMO_TAG, "Whitelist initialized - accepting all connections (bonded and non-bonded)");
+
+    // Typing task: credentials are queued with hid_output_submit(HID_TRANSPORT_BLE, ...)
+    static const hid_transport_ops_t ble_output_ops = {
+        .send_program = ble_send_program,
+    };
+    if ((ret = hid_output_start(HID_TRANSPORT_BLE, &ble_output_ops)) != ESP_OK) {
+        ESP_LOGE(HID_DEMO_TAG, "%s start output task failed", __func__);
+    }
     
     return ret;
 }
@@ -3,12 +3,13 @@
 #define HID_DEVICE_BLE_H
 
 #include "esp_bt_defs.h"
+#include "hid_program.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define MAX_MTU_SIZE                128
+#define MAX_MTU_SIZE                517     // ESP_GATT_MAX_MTU_SIZE: the peer picks the smaller of the two
 
 esp_err_t ble_device_init(void);
 
@@ -18,8 +19,39 @@ bool ble_userlist_is_authenticated();
 void ble_send_char(wint_t chr);
 void ble_send_key_combination(uint8_t modifiers, uint8_t key);
 void ble_send_string(const char* str);
+esp_err_t ble_send_program(const hid_program_t* prog);
 
 bool ble_is_connected(void);
+// Waits until the controller has free tx buffers (false: still congested after timeout_ms)
+bool ble_wait_uncongested(uint32_t timeout_ms);
+
+// Connection parameter policy (fast interval while typing, relaxed when idle)
+typedef enum {
+    BLE_CONN_POLICY_IDLE,            // parametri scelti dall'host o intervallo lungo
+    BLE_CONN_POLICY_FAST_PENDING,    // richiesto l'intervallo corto, in attesa dell'host
+    BLE_CONN_POLICY_FAST,
+    BLE_CONN_POLICY_RELAX_PENDING,   // richiesto l'intervallo lungo con slave latency
+} ble_conn_policy_state_t;
+
+typedef struct {
+    ble_conn_policy_state_t state;
+    uint16_t conn_int;               // intervallo attuale (unit 1.25 ms)
+    uint16_t latency;                // slave latency attuale
+    uint32_t fast_requests;          // richieste di intervallo corto inviate
+    uint32_t relax_requests;         // richieste di intervallo lungo inviate
+    uint32_t accepted;               // richieste applicate dall'host
+    uint32_t rejected;               // richieste rifiutate dall'host
+    uint32_t timeouts;               // digitazioni partite senza risposta dell'host
+    uint32_t peer_updates;           // aggiornamenti decisi dall'host
+} ble_conn_policy_stats_t;
+
+void ble_conn_policy_get(ble_conn_policy_stats_t* out);
+// Trasferimenti lunghi senza digitazione (dump della lista): chiedono l'intervallo
+// corto come la digitazione e finche' ce n'e' uno in corso il link non viene
+// rilassato, il timer riparte alla fine
+void ble_conn_begin_burst(void);
+void ble_conn_end_burst(void);
+void ble_conn_policy_reset_stats(void);
 
 esp_err_t ble_force_disconnect(void);
 esp_err_t ble_force_disconnect_and_clear(void);  // New function for forced cleanup
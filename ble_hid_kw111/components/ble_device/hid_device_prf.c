@@ -13,8 +13,12 @@
 #include "hid_dev.h"
 #include "hid_device_prf.h"
 #include "hid_device_ble.h"
+#include "hid_layout.h"
+#include "hid_program.h"
+#include "display_oled.h"
 
 #include "user_list.h"
+#include "user_proto.h"
 
 /* HID Report type */
 #define HID_REPORT_TYPE_INPUT       1
@@ -117,6 +121,7 @@ static const uint16_t user_mgmt_char = USER_MGMT_CHAR_UUID;
 // User management service BLE handles
 uint16_t user_mgmt_handle[USER_MGMT_IDX_NB];
 uint16_t user_mgmt_conn_id = 0;
+uint16_t user_mgmt_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
 uint8_t user_mgmt_value[USER_MGMT_PAYLOAD_LEN] = {0};
 int user_list_index = 0;
 
@@ -238,7 +243,7 @@ static const esp_gatts_attr_db_t user_mgmt_att_db[USER_MGMT_IDX_NB] = {
     [USER_MGMT_IDX_VAL] = {
         {ESP_GATT_AUTO_RSP},
         {ESP_UUID_LEN_16, (uint8_t *)&user_mgmt_char,
-        ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, USER_MGMT_PAYLOAD_LEN, USER_MGMT_PAYLOAD_LEN, user_mgmt_value}
+        ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, USER_MGMT_VALUE_MAX, USER_MGMT_PAYLOAD_LEN, user_mgmt_value}
     },
     [USER_MGMT_IDX_CCC] = {
         {ESP_GATT_AUTO_RSP},
@@ -419,6 +424,93 @@ static esp_gatts_attr_db_t hidd_le_gatt_db[HIDD_LE_IDX_NB] = {
 
 static void hid_add_id_tbl(void);
 
+// Salva un utente ricevuto con ADD_NEW_USER, EDIT_USER o WRITE_USER: controllo
+// del layout, cifratura della password e scrittura nel DB. plainPsw NULL: la
+// password cifrata in user resta invariata (WRITE_USER senza password).
+static void user_mgmt_store(uint8_t idx, user_entry_t* user, const char* plainPsw) {
+    // Reject: the password must be typeable with the chosen layout
+    if (user->fallback == HID_FALLBACK_REJECT) {
+        char plain[128] = { 0 };
+        hid_program_t prog;
+        if (plainPsw != NULL)
+            memcpy(plain, plainPsw, MAX_PASSWORD_LEN);
+        else
+            userdb_decrypt_password(user->password_enc, user->password_len, plain);
+        esp_err_t ret = hid_program_compile(plain, false, false, user->layout, user->fallback, &prog);
+        hid_program_wipe(&prog);
+        memset(plain, 0, sizeof(plain));
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Password not typeable with layout %s", hid_layout_name(user->layout));
+            display_oled_post_error("Layout err");
+            return;
+        }
+    }
+
+    if (plainPsw != NULL) {
+        // Encrypt the password before storing it
+        int enc_len = userdb_encrypt_password(plainPsw, user->password_enc);
+        if (enc_len < 0) {
+            ESP_LOGE(TAG, "Password encryption failed");
+            return;
+        }
+        user->password_len = enc_len;
+    }
+
+    if (idx < user_count) {
+        // Edit user
+        userdb_edit(idx, user);
+    } else {
+        // Add new user
+        userdb_add(user);
+    }
+}
+
+// WRITE_USER: un indice oltre la fine della lista aggiunge un utente (etichetta
+// e password obbligatorie), altrimenti cambiano solo i campi presenti nel frame
+static void user_mgmt_write_fields(uint8_t idx, const user_proto_entry_t* fields) {
+    user_entry_t user;
+    memset(&user, 0, sizeof(user));
+    if (idx >= user_count) {
+        const uint16_t required = USER_FIELD(USER_TAG_LABEL) | USER_FIELD(USER_TAG_PASSWORD);
+        if (idx >= MAX_USERS || (fields->fields & required) != required) {
+            ESP_LOGE(TAG, "Write user %d: new user without label or password", idx);
+            return;
+        }
+    } else if (userdb_get(idx, &user) != 0) {
+        ESP_LOGE(TAG, "Write user %d: read failed", idx);
+        return;
+    }
+
+    if (fields->fields & USER_FIELD(USER_TAG_LABEL)) {
+        memset(user.label, 0, sizeof(user.label));
+        memcpy(user.label, fields->label, fields->label_len);
+    }
+    if (fields->fields & USER_FIELD(USER_TAG_WINLOGIN))
+        user.winlogin = fields->winlogin != 0;
+    if (fields->fields & USER_FIELD(USER_TAG_SEND_ENTER))
+        user.sendEnter = fields->send_enter != 0;
+    if (fields->fields & USER_FIELD(USER_TAG_MAGICFINGER))
+        user.magicfinger = fields->magicfinger != 0;
+    if (fields->fields & USER_FIELD(USER_TAG_FINGERPRINT_ID))
+        user.fingerprint_id = fields->fingerprint_id;
+    if (fields->fields & USER_FIELD(USER_TAG_LOGIN_TYPE))
+        user.login_type = fields->login_type;
+    if ((fields->fields & USER_FIELD(USER_TAG_LAYOUT)) && fields->layout < HID_LAYOUT_NB)
+        user.layout = fields->layout;
+    if ((fields->fields & USER_FIELD(USER_TAG_FALLBACK)) && fields->fallback < HID_FALLBACK_NB)
+        user.fallback = fields->fallback;
+
+    if (fields->fields & USER_FIELD(USER_TAG_PASSWORD)) {
+        char plainPsw[MAX_PASSWORD_LEN + 1] = { 0 };
+        memcpy(plainPsw, fields->password, fields->password_len);
+        user_mgmt_store(idx, &user, plainPsw);
+        memset(plainPsw, 0, sizeof(plainPsw));
+    } else {
+        user_mgmt_store(idx, &user, NULL);
+    }
+    memset(&user, 0, sizeof(user));
+}
+
 void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,esp_ble_gatts_cb_param_t *param)
 {
     switch (event) {
@@ -450,6 +542,17 @@ void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,esp_
     {
         break;
     }
+    case ESP_GATTS_CONGEST_EVT:
+    {
+        esp_hidd_cb_param_t cb_param = {0};
+        cb_param.congest.conn_id = param->congest.conn_id;
+        cb_param.congest.congested = param->congest.congested;
+        if (hidd_le_env.hidd_cb != NULL)
+        {
+            (hidd_le_env.hidd_cb)(ESP_HIDD_EVENT_BLE_CONGEST, &cb_param);
+        }
+        break;
+    }
     case ESP_GATTS_CREATE_EVT:
         break;
     case ESP_GATTS_CONNECT_EVT:
@@ -458,7 +561,10 @@ void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,esp_
         ESP_LOGI(HID_LE_PRF_TAG, "HID connection establish, conn_id = %x", param->connect.conn_id);
         memcpy(cb_param.connect.remote_bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
         cb_param.connect.conn_id = param->connect.conn_id;
+        cb_param.connect.conn_int = param->connect.conn_params.interval;
+        cb_param.connect.latency = param->connect.conn_params.latency;
         hidd_clcb_alloc(param->connect.conn_id, param->connect.remote_bda);
+        user_mgmt_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;     // until the client asks for more
         esp_ble_set_encryption(param->connect.remote_bda, ESP_BLE_SEC_ENCRYPT_NO_MITM);
 
         // Track connection for Battery Service notifications
@@ -585,28 +691,62 @@ void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,esp_
                     memcpy(plainPsw, (const char *)&param->write.value[offset], MAX_PASSWORD_LEN);                    
                     offset += MAX_PASSWORD_LEN;
 
-                    // Debug print password bytes in hexadecimal
-                    printf("plainPsw bytes (hex): ");
-                    for (int i = 0; i < MAX_PASSWORD_LEN; i++) {
-                        printf("%02X ", (uint8_t)plainPsw[i]);
-                    }
-                    printf("\n");
-                    
-                    // Encrypt the password before storing it
-                    user.password_len = userdb_encrypt_password(plainPsw, user.password_enc);                
                     user.winlogin = (bool)param->write.value[offset++];
                     user.sendEnter = (bool)param->write.value[offset++];
                     user.magicfinger = (bool)param->write.value[offset++];
                     user.fingerprint_id = (uint8_t)param->write.value[offset++];
                     user.login_type = (uint8_t)param->write.value[offset++];
+                    // Optional trailing bytes: keyboard layout and fallback for the
+                    // characters missing from it (older apps leave the defaults)
+                    if (param->write.len > offset && param->write.value[offset] < HID_LAYOUT_NB)
+                        user.layout = param->write.value[offset];
+                    offset++;
+                    if (param->write.len > offset && param->write.value[offset] < HID_FALLBACK_NB)
+                        user.fallback = param->write.value[offset];
+                    offset++;
+
+                    // EDIT_USER con password tutta a zero: l'app non la conosceva
+                    // (lista senza password), resta quella salvata
+                    bool keep_password = cmd == EDIT_USER && idx < user_count;
+                    for (int i = 0; i < MAX_PASSWORD_LEN && keep_password; i++)
+                        keep_password = plainPsw[i] == 0;
+                    if (keep_password) {
+                        user_entry_t stored;
+                        if (userdb_get(idx, &stored) != 0) {
+                            ESP_LOGE(TAG, "Edit user %d: read failed", idx);
+                            break;
+                        }
+                        memcpy(user.password_enc, stored.password_enc, sizeof(user.password_enc));
+                        user.password_len = stored.password_len;
+                        memset(&stored, 0, sizeof(stored));
+                        user_mgmt_store(idx, &user, NULL);
+                    } else {
+                        user_mgmt_store(idx, &user, plainPsw);
+                    }
+                    memset(plainPsw, 0, sizeof(plainPsw));
+                    memset(&user, 0, sizeof(user));
+                    break;
+                }
 
-                    if (idx < user_count) {
-                        // Edit user
-                        userdb_edit(idx, &user);
+                case WRITE_USER: {
+                    // TLV frame (user_proto.h): only the fields it carries change
+                    uint8_t index;
+                    user_proto_entry_t fields;
+                    user_proto_err_t err = user_proto_decode(param->write.value, param->write.len, &index, &fields);
+                    if (err != USER_PROTO_OK) {
+                        ESP_LOGE(TAG, "Write user: %s", err == USER_PROTO_ERR_VERSION ? "unsupported version" : "malformed frame");
                     } else {
-                        // Add new user
-                        userdb_add(&user);
-                    }                                        
+                        user_mgmt_write_fields(index, &fields);
+                    }
+                    memset(&fields, 0, sizeof(fields));
+                    break;
+                }
+
+                case PROTO_VERSION: {
+                    // The app uses WRITE_USER only once the firmware has answered
+                    uint8_t reply[2] = { PROTO_VERSION, USER_PROTO_VERSION };
+                    esp_ble_gatts_send_indicate(hidd_le_env.gatt_if, user_mgmt_conn_id,
+                                                user_mgmt_handle[USER_MGMT_IDX_VAL], sizeof(reply), reply, false);
                     break;
                 }
 
@@ -636,12 +776,39 @@ void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,esp_
                     break;
                 }
 
+                case SEARCH_USERS: {
+                    // Label lookup: the query is the rest of the write
+                    char query[MAX_LABEL_LEN + 1] = {0};
+                    size_t qlen = param->write.len > 2 ? param->write.len - 2 : 0;
+                    if (qlen > MAX_LABEL_LEN)
+                        qlen = MAX_LABEL_LEN;
+                    memcpy(query, &param->write.value[2], qlen);
+                    send_search_result(idx, query);
+                    break;
+                }
+
                 case GET_USERS_LIST: {                   
                     if (send_user_entry(idx) != -1) {
                         printf("Sending user %d\n", idx);
                     }
                     break;
                 }
+
+                case GET_USERS_DUMP:
+                case GET_USERS_META: {
+                    // Whole list as a notification stream (sent by its own task),
+                    // or only the entries changed after the client's revision and
+                    // epoch (u32 LE each). GET_USERS_META leaves the passwords out.
+                    uint32_t since = 0, epoch = 0;
+                    if (param->write.len >= 5)
+                        since = param->write.value[1] | (param->write.value[2] << 8) |
+                                (param->write.value[3] << 16) | ((uint32_t)param->write.value[4] << 24);
+                    if (param->write.len >= 9)
+                        epoch = param->write.value[5] | (param->write.value[6] << 8) |
+                                (param->write.value[7] << 16) | ((uint32_t)param->write.value[8] << 24);
+                    send_user_dump(cmd, since, epoch);
+                    break;
+                }
                 
                 default: {
                     printf("[BLE] Unrecognized command: %02X\n", cmd);                    
@@ -774,6 +941,7 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
 {
     if (event == ESP_GATTS_MTU_EVT) {
         ESP_LOGI(HID_LE_PRF_TAG, "ESP_GATTS_MTU_EVT, MTU %d", param->mtu.mtu);        
+        user_mgmt_mtu = param->mtu.mtu;
     }
 
     /* If event is register event, store the gatts_if for each profile */
@@ -119,12 +119,21 @@ extern int battery_conn_id;
 #define EDIT_USER       0xA3
 #define REMOVE_USER     0xA4
 #define CLEAR_USER_DB   0xA5
+#define SEARCH_USERS    0xA6    // <cmd><mode><query> -> <cmd><count><index>...
+#define GET_USERS_DUMP  0xA7    // <cmd>[<revision><epoch>] -> notifications <cmd><seq><stream of <index><entry>..., <LIST_EMPTY><count><revision><epoch>>
+#define GET_USERS_META  0xA8    // <cmd>[<revision><epoch>] -> come GET_USERS_DUMP, record <index><label><options> senza password
+#define WRITE_USER      0xA9    // <cmd><version><index><TLV>... (user_proto.h): aggiunta o modifica dei soli campi presenti
 #define BLE_MESSAGE     0xAA
 #define BATTERY_MV      0xAB
+#define PROTO_VERSION   0xAC    // <cmd> -> <cmd><USER_PROTO_VERSION>
 #define ENROLL_FINGER   0xB0
 #define CLEAR_LIBRARY   0xB2 
 #define LIST_EMPTY      0xFF
 
+// SEARCH_USERS modes
+#define SEARCH_PREFIX   0x00
+#define SEARCH_FUZZY    0x01
+
 
 /// HID Service Attributes Indexes
 enum {
@@ -342,6 +351,7 @@ enum {
 };
 
 #define USER_MGMT_PAYLOAD_LEN  20 // <cmd><index><user> | <cmd><index><password>
+#define USER_MGMT_VALUE_MAX    512 // ESP_GATT_MAX_ATTR_LEN: writes and notifications up to MTU - 3
 typedef struct {
     uint8_t cmd;                       // tipo comando
     uint8_t index;                     // indice dell'elemento
@@ -351,6 +361,7 @@ typedef struct {
 
 extern int user_list_index;
 extern uint16_t user_mgmt_conn_id;
+extern uint16_t user_mgmt_mtu;                 // ATT MTU negoziato sulla connessione corrente
 extern uint16_t user_mgmt_handle[USER_MGMT_IDX_NB];
 extern uint8_t user_mgmt_value[USER_MGMT_PAYLOAD_LEN];
 
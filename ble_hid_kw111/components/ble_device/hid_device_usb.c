@@ -5,22 +5,33 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "tinyusb.h"
 
 
 #include "class/hid/hid_device.h"
 #include "hid_device_usb.h"
 #include "hid_dev.h"
+#include "hid_layout.h"
+#include "hid_encoder.h"
+#include "hid_output.h"
+#include "display_oled.h"
+#include "buttons.h"
+#include "config.h"
 
-// --- PLACEHOLDER SUPPORT (USB) ----------------------------------------------
-#include "password_placeholders.h"
 
 
 static const char *TAG = "USB HID";
 
+#define USB_REPORT_TIMEOUT_MS   100     // host suspended or unplugged: stop waiting for the ack
+
+// Given by tud_hid_report_complete_cb once the host has read the IN report
+static SemaphoreHandle_t s_report_done = NULL;
+
 /************* TinyUSB descriptors ****************/
 
 // Enumeration for interface numbers
@@ -62,7 +73,7 @@ static const uint8_t composite_configuration_descriptor[] = {
     TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, TUSB_DESC_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
     // Interface 0: HID
-    TUD_HID_DESCRIPTOR(ITF_NUM_HID, 4, false, sizeof(hid_report_descriptor), EPNUM_HID, 16, 10),
+    TUD_HID_DESCRIPTOR(ITF_NUM_HID, 4, false, sizeof(hid_report_descriptor), EPNUM_HID, 16, USB_HID_POLL_INTERVAL_MS),
 
     // Interface 1-2: CDC
     TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_CTRL, 5, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
@@ -135,97 +146,109 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_
 {
 }
 
-/********* Application ***************/
-uint8_t const usb_conv_table[128][2] =  { HID_IT_IT_ASCII_TO_KEYCODE };
-
-// Invia una sequenza HID: pressione e rilascio
-void usb_send_hid_key(uint8_t modifier, uint8_t keycode[6]) {
-    // Send key press
-    while (!tud_hid_ready()) vTaskDelay(pdMS_TO_TICKS(1));
-    tud_hid_keyboard_report(HID_ITF_PROTOCOL_KEYBOARD, modifier, keycode);
-    vTaskDelay(pdMS_TO_TICKS(20));
-    // Send key release
-    uint8_t empty[6] = {0};
-    while (!tud_hid_ready()) vTaskDelay(pdMS_TO_TICKS(1));
-    tud_hid_keyboard_report(HID_ITF_PROTOCOL_KEYBOARD, 0, empty);
-    vTaskDelay(pdMS_TO_TICKS(5));
+// Invoked when a report has been sent to the host (IN transfer completed)
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len)
+{
+    (void) instance;
+    (void) report;
+    (void) len;
+
+    if (s_report_done != NULL)
+        xSemaphoreGive(s_report_done);
 }
- 
-void usb_send_char(wint_t chr)
-{    
+
+/********* Application ***************/
+// Sink of the shared encoder: one report in flight, the next one goes out as
+// soon as the host has polled the previous one (one report per bInterval)
+// instead of fixed 20/5 ms delays per key. ctx (esp_err_t*, may be NULL)
+// keeps the first error, after which nothing else is sent
+static void usb_sink_report(void* ctx, uint8_t modifier, const uint8_t* keys, uint8_t count) {
+    esp_err_t* result = ctx;
+    if (result && *result != ESP_OK)
+        return;
     // HID report: [modifier, key1, key2, key3, key4, key5, key6]
-    uint8_t keycode[6] = { 0 }; 
-    uint8_t modifier   = 0;
-    modifier = usb_conv_table[chr][0];    
-    keycode[0] = usb_conv_table[chr][1];
-    usb_send_hid_key(modifier, keycode);
+    uint8_t keycode[6] = {0};
+    memcpy(keycode, keys, count);
+
+    esp_err_t err = ESP_OK;
+    TickType_t start = xTaskGetTickCount();
+    xSemaphoreTake(s_report_done, 0);       // ack of a report sent by someone else
+    while (!tud_hid_keyboard_report(HID_ITF_PROTOCOL_KEYBOARD, modifier, keycode)) {
+        if (!tud_mounted() || xTaskGetTickCount() - start > pdMS_TO_TICKS(USB_REPORT_TIMEOUT_MS)) {
+            ESP_LOGW(TAG, "HID endpoint busy, report dropped");
+            err = tud_mounted() ? ESP_ERR_TIMEOUT : ESP_ERR_INVALID_STATE;
+            break;
+        }
+        vTaskDelay(1);
+    }
+    if (err == ESP_OK && xSemaphoreTake(s_report_done, pdMS_TO_TICKS(USB_REPORT_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "HID report not acknowledged by the host");
+        err = ESP_ERR_TIMEOUT;
+    }
+    if (result && err != ESP_OK)
+        *result = err;
 }
 
+static void usb_sink_delay(void* ctx, uint32_t ms) {
+    const esp_err_t* result = ctx;
+    if (result == NULL || *result == ESP_OK)
+        vTaskDelay(pdMS_TO_TICKS(ms));
+}
 
+static void usb_sink_sleep(void* ctx) {
+    const esp_err_t* result = ctx;
+    if (result && *result != ESP_OK)
+        return;
+    // Same rule as BLE: sleep only once the host has actually received the keys
+    if (!tud_mounted()) {
+        ESP_LOGW(TAG, "Sleep placeholder ignored: USB not mounted");
+        display_oled_post_error("USB not connected");
+    } else {
+        display_oled_deinit();
+        enter_deep_sleep();
+    }
+}
 
+static const hid_encoder_sink_t s_usb_sink = {
+    .send_report = usb_sink_report,
+    .delay_ms = usb_sink_delay,
+    .sleep = usb_sink_sleep,
+};
+
+void usb_send_char(wint_t chr)
+{    
+    const hid_layout_key_t* k = hid_layout_lookup(HID_LAYOUT_DEVICE, chr);
+    if (k == NULL)
+        return;     // Carattere non disponibile nel layout
+    hid_encoder_tap(k->modifier, k->key, &s_usb_sink);
+}
+
+// Esegue un programma precompilato (vedi hid_program.h).
+// ESP_ERR_INVALID_STATE: device non montato, ESP_ERR_TIMEOUT: report non preso dall'host
+esp_err_t usb_send_program(const hid_program_t* prog) {
+    if (!tud_mounted())
+        return ESP_ERR_INVALID_STATE;
+    esp_err_t result = ESP_OK;
+    hid_encoder_sink_t sink = s_usb_sink;
+    sink.ctx = &result;
+    hid_encoder_run(prog, &sink);
+    return result;
+}
 
 void usb_send_string(const char* str) {
-    size_t i = 0;
-    while (str[i]) {
-        uint8_t b = (uint8_t)str[i];
-        if (PW_IS_PLACEHOLDER(b)) {
-            usb_handle_placeholder(b);
-            i++;
-            continue;
-        }
-        wint_t wc = (wint_t)b;
-        if ((wc & 0x80) == 0) { // ASCII semplice
-            usb_send_char(wc);
-            i++;
-            continue;
-        }
-        // Multi-byte UTF-8
-        int len = 1; int pos = i; uint32_t codepoint = 0;
-        if ((wc & 0xE0) == 0xC0) len = 2; else if ((wc & 0xF0) == 0xE0) len = 3; else if ((wc & 0xF8) == 0xF0) len = 4;
-        for (int j = 0; j < len; ++j) { codepoint = (codepoint << 8) | (unsigned char)str[pos + j]; i++; }
-        uint8_t keycode[6] = {0}; uint8_t modifier = 0;
-        switch (codepoint) {
-            case 'à': modifier = KEYBOARD_MODIFIER_NONE;        keycode[1] = 0x34; break;
-            case 'è': modifier = KEYBOARD_MODIFIER_NONE;        keycode[1] = 0x2F; break;
-            case 'é': modifier = KEYBOARD_MODIFIER_LEFTSHIFT;   keycode[1] = 0x2F; break;
-            case 'ì': modifier = KEYBOARD_MODIFIER_NONE;        keycode[1] = 0x2E; break;
-            case 'ò': modifier = KEYBOARD_MODIFIER_NONE;        keycode[1] = 0x33; break;
-            case 'ù': modifier = KEYBOARD_MODIFIER_NONE;        keycode[1] = 0x31; break;
-            case '€': modifier = KEYBOARD_MODIFIER_RIGHTALT;    keycode[1] = 0x08; break;
-            case '£': modifier = KEYBOARD_MODIFIER_LEFTSHIFT;   keycode[1] = 0x20; break;
-            case 'ç': modifier = KEYBOARD_MODIFIER_LEFTSHIFT;   keycode[1] = 0x33; break;
-            case '§': modifier = KEYBOARD_MODIFIER_LEFTSHIFT;   keycode[1] = 0x31; break;
-            case '°': modifier = KEYBOARD_MODIFIER_LEFTSHIFT;   keycode[1] = 0x34; break;
-            default: break;
-        }
-        usb_send_hid_key(modifier, keycode);
+    hid_program_t prog;
+    while (*str) {
+        hid_program_init(&prog);
+        str += hid_program_add_text(&prog, str, HID_LAYOUT_DEVICE, HID_FALLBACK_SKIP);
+        if (usb_send_program(&prog) != ESP_OK)
+            break;
     }
+    hid_program_wipe(&prog);
 }
 
 void usb_send_key_combination(uint8_t modifiers, uint8_t key)
 {
-    uint8_t keycode[6] = {0};    
-    keycode[1] = key;       
-    usb_send_hid_key(modifiers, keycode);
-}
-
-void usb_handle_placeholder(uint8_t ph) {
-    switch (ph) {
-        case PW_PH_ENTER:
-            usb_send_key_combination(KEYBOARD_MODIFIER_NONE, HID_KEY_ENTER); break;
-        case PW_PH_TAB:
-            usb_send_key_combination(KEYBOARD_MODIFIER_NONE, HID_KEY_TAB); break;
-        case PW_PH_ESC:
-            usb_send_key_combination(KEYBOARD_MODIFIER_NONE, HID_KEY_ESCAPE); break;
-        case PW_PH_BACKSPACE:
-            usb_send_key_combination(KEYBOARD_MODIFIER_NONE, HID_KEY_BACKSPACE); break;
-
-        case PW_PH_CTRL_ALT_DEL:
-            usb_send_key_combination(HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, HID_KEY_DELETE); break;
-        case PW_PH_SHIFT_TAB:
-            usb_send_key_combination(HID_MODIFIER_LEFT_SHIFT, HID_KEY_TAB); break;
-        default: break; // future use
-    }
+    hid_encoder_tap(modifiers, key, &s_usb_sink);
 }
 
 
@@ -237,6 +260,12 @@ esp_err_t usb_device_init(void)
     
     // Delay initialization to allow system to stabilize
     vTaskDelay(pdMS_TO_TICKS(2000));
+
+    s_report_done = xSemaphoreCreateBinary();
+    if (s_report_done == NULL) {
+        ESP_LOGE(TAG, "Report semaphore allocation failed");
+        return ESP_ERR_NO_MEM;
+    }
     
     const tinyusb_config_t tusb_cfg = {
         .device_descriptor = NULL,
@@ -258,6 +287,15 @@ esp_err_t usb_device_init(void)
         return ret;
     }
     
+    static const hid_transport_ops_t usb_output_ops = {
+        .send_program = usb_send_program,
+    };
+    ret = hid_output_start(HID_TRANSPORT_USB, &usb_output_ops);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "USB output task start failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
     ESP_LOGI(TAG, "USB initialization DONE");
     return ESP_OK;
     
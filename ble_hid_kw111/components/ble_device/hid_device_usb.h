@@ -2,7 +2,9 @@
 #define HID_DEVICE_USB_H
 
 #include <stdint.h>
+#include <wchar.h>
 #include "esp_err.h"
+#include "hid_program.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -11,7 +13,7 @@ extern "C" {
 void usb_send_char(wint_t chr);
 void usb_send_key_combination(uint8_t modifiers, uint8_t key);
 void usb_send_string(const char* str);
-void usb_handle_placeholder(uint8_t ph);
+esp_err_t usb_send_program(const hid_program_t* prog);
 esp_err_t usb_device_init(void);
 
 #ifdef __cplusplus
@@ -5,5 +5,6 @@
 void usb_send_char(wint_t chr) { (void)chr; }
 void usb_send_key_combination(uint8_t modifiers, uint8_t key) { (void)modifiers; (void)key; }
 void usb_send_string(const char* str) { (void)str; }
+esp_err_t usb_send_program(const hid_program_t* prog) { (void)prog; return ESP_ERR_NOT_SUPPORTED; }
 
 esp_err_t usb_device_init(void) { return ESP_OK; }
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_bit_defs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+#include "hid_output.h"
+
+static const char *TAG = "HID OUT";
+
+#define HID_OUTPUT_TASK_STACK   4096
+#define HID_OUTPUT_TASK_PRIO    5
+
+typedef struct {
+    hid_program_t prog;
+    hid_output_done_cb_t cb;
+    void* arg;
+    int64_t queued_at;
+} hid_output_item_t;
+
+typedef struct {
+    hid_transport_ops_t ops;
+    QueueHandle_t queue;            // hid_output_item_t* (in heap, azzerato dopo l'invio)
+    TaskHandle_t task;
+    SemaphoreHandle_t lock;         // pending + bit di idle
+    int pending;
+    hid_output_stats_t stats;
+} hid_output_t;
+
+static hid_output_t s_out[HID_TRANSPORT_NB];
+static EventGroupHandle_t s_idle_events = NULL;     // bit n: trasporto n senza job
+
+static const char* const s_transport_name[HID_TRANSPORT_NB] = { "BLE", "USB" };
+
+static void hid_output_task(void* pvParameters) {
+    hid_transport_t transport = (hid_transport_t)(intptr_t)pvParameters;
+    hid_output_t* out = &s_out[transport];
+    hid_output_item_t* item = NULL;
+
+    while (1) {
+        if (xQueueReceive(out->queue, &item, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        int64_t start = esp_timer_get_time();
+        esp_err_t result = out->ops.send_program(&item->prog);
+        int64_t end = esp_timer_get_time();
+
+        uint32_t queued_us = (uint32_t)(start - item->queued_at);
+        uint32_t typing_us = (uint32_t)(end - start);
+        out->stats.jobs++;
+        out->stats.last_result = result;
+        if (result != ESP_OK)
+            out->stats.failed++;
+        out->stats.last_queued_us = queued_us;
+        out->stats.last_typing_us = typing_us;
+        out->stats.total_typing_us += typing_us;
+        if (typing_us > out->stats.max_typing_us)
+            out->stats.max_typing_us = typing_us;
+        if (result == ESP_OK)
+            ESP_LOGI(TAG, "%s job done: %lu us in queue, %lu us typing", s_transport_name[transport],
+                     (unsigned long)queued_us, (unsigned long)typing_us);
+        else
+            ESP_LOGW(TAG, "%s job failed after %lu us: %s", s_transport_name[transport],
+                     (unsigned long)typing_us, esp_err_to_name(result));
+
+        hid_output_done_cb_t cb = item->cb;
+        void* arg = item->arg;
+        memset(item, 0, sizeof(*item));     // il programma equivale alla password in chiaro
+        free(item);
+        item = NULL;
+
+        if (cb)
+            cb(transport, result, queued_us, typing_us, arg);
+
+        xSemaphoreTake(out->lock, portMAX_DELAY);
+        if (--out->pending == 0)
+            xEventGroupSetBits(s_idle_events, BIT(transport));
+        xSemaphoreGive(out->lock);
+    }
+}
+
+esp_err_t hid_output_start(hid_transport_t transport, const hid_transport_ops_t* ops) {
+    if (transport >= HID_TRANSPORT_NB || ops == NULL || ops->send_program == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    hid_output_t* out = &s_out[transport];
+    if (out->task != NULL) {
+        ESP_LOGW(TAG, "%s output already started", s_transport_name[transport]);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (s_idle_events == NULL) {
+        s_idle_events = xEventGroupCreate();
+        if (s_idle_events == NULL) {
+            ESP_LOGE(TAG, "Failed to create event group");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    out->ops = *ops;
+    out->pending = 0;
+    out->lock = xSemaphoreCreateMutex();
+    out->queue = xQueueCreate(HID_OUTPUT_QUEUE_LEN, sizeof(hid_output_item_t*));
+    if (out->lock == NULL || out->queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create %s output queue", s_transport_name[transport]);
+        return ESP_ERR_NO_MEM;
+    }
+    xEventGroupSetBits(s_idle_events, BIT(transport));
+
+    char name[16];
+    snprintf(name, sizeof(name), "hid_out_%s", s_transport_name[transport]);
+    if (xTaskCreate(hid_output_task, name, HID_OUTPUT_TASK_STACK, (void*)(intptr_t)transport,
+                    HID_OUTPUT_TASK_PRIO, &out->task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create %s output task", s_transport_name[transport]);
+        out->task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t hid_output_submit(hid_transport_t transport, const hid_program_t* prog,
+                            hid_output_done_cb_t cb, void* arg) {
+    if (transport >= HID_TRANSPORT_NB || prog == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    hid_output_t* out = &s_out[transport];
+    if (out->task == NULL) {
+        ESP_LOGE(TAG, "%s output not started", s_transport_name[transport]);
+        out->stats.dropped++;
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    hid_output_item_t* item = malloc(sizeof(hid_output_item_t));
+    if (item == NULL) {
+        out->stats.dropped++;
+        return ESP_ERR_NO_MEM;
+    }
+    item->prog = *prog;
+    item->cb = cb;
+    item->arg = arg;
+    item->queued_at = esp_timer_get_time();
+
+    xSemaphoreTake(out->lock, portMAX_DELAY);
+    if (xQueueSend(out->queue, &item, 0) != pdTRUE) {
+        xSemaphoreGive(out->lock);
+        ESP_LOGW(TAG, "%s output queue full", s_transport_name[transport]);
+        memset(item, 0, sizeof(*item));
+        free(item);
+        out->stats.dropped++;
+        return ESP_ERR_TIMEOUT;
+    }
+    if (out->pending++ == 0)
+        xEventGroupClearBits(s_idle_events, BIT(transport));
+    xSemaphoreGive(out->lock);
+    return ESP_OK;
+}
+
+bool hid_output_is_idle(hid_transport_t transport) {
+    if (transport >= HID_TRANSPORT_NB || s_idle_events == NULL)
+        return true;
+    return (xEventGroupGetBits(s_idle_events) & BIT(transport)) != 0;
+}
+
+esp_err_t hid_output_wait_idle(hid_transport_t transport, TickType_t timeout) {
+    if (transport >= HID_TRANSPORT_NB)
+        return ESP_ERR_INVALID_ARG;
+    if (s_idle_events == NULL)
+        return ESP_OK;
+    EventBits_t bits = xEventGroupWaitBits(s_idle_events, BIT(transport), pdFALSE, pdTRUE, timeout);
+    return (bits & BIT(transport)) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void hid_output_stats_get(hid_transport_t transport, hid_output_stats_t* out) {
+    if (transport >= HID_TRANSPORT_NB || out == NULL)
+        return;
+    *out = s_out[transport].stats;
+}
+
+void hid_output_stats_reset(hid_transport_t transport) {
+    if (transport >= HID_TRANSPORT_NB)
+        return;
+    memset(&s_out[transport].stats, 0, sizeof(hid_output_stats_t));
+}
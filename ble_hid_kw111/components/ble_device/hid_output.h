@@ -0,0 +1,69 @@
+#pragma once
+#ifndef HID_OUTPUT_H
+#define HID_OUTPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "hid_program.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Coda di uscita HID.
+Chi deve digitare (es. fingerprint_task) prepara un programma di tasti
+(vedi hid_program.h) e lo accoda al trasporto scelto: un task
+dedicato per ogni trasporto (BLE, USB) lo esegue e segnala la fine con una
+callback e con il bit di idle. Il task del sensore non resta bloccato per tutta
+la durata della digitazione.
+*/
+
+typedef enum {
+    HID_TRANSPORT_BLE = 0,
+    HID_TRANSPORT_USB,
+    HID_TRANSPORT_NB,
+} hid_transport_t;
+
+#define HID_OUTPUT_QUEUE_LEN    2
+
+// Funzioni del trasporto usate dal task di invio. send_program ritorna ESP_OK
+// solo se tutti i report sono arrivati all'host (disconnessione, report persi
+// o timeout: errore, il resto del programma non viene digitato)
+typedef struct {
+    esp_err_t (*send_program)(const hid_program_t* prog);
+} hid_transport_ops_t;
+
+// Chiamata dal task del trasporto a job terminato (non bloccare)
+typedef void (*hid_output_done_cb_t)(hid_transport_t transport, esp_err_t result,
+                                     uint32_t queued_us, uint32_t typing_us, void* arg);
+
+typedef struct {
+    uint32_t jobs;              // job eseguiti
+    uint32_t failed;            // di questi, interrotti da un errore del trasporto
+    esp_err_t last_result;      // esito dell'ultimo job
+    uint32_t dropped;           // job rifiutati (coda piena o trasporto assente)
+    uint32_t last_queued_us;    // attesa in coda dell'ultimo job
+    uint32_t last_typing_us;    // durata della digitazione dell'ultimo job
+    uint32_t max_typing_us;
+    uint64_t total_typing_us;
+} hid_output_stats_t;
+
+esp_err_t hid_output_start(hid_transport_t transport, const hid_transport_ops_t* ops);
+
+// Copia il programma nella coda del trasporto e ritorna subito (il chiamante puo' azzerare il proprio)
+esp_err_t hid_output_submit(hid_transport_t transport, const hid_program_t* prog,
+                            hid_output_done_cb_t cb, void* arg);
+bool hid_output_is_idle(hid_transport_t transport);
+esp_err_t hid_output_wait_idle(hid_transport_t transport, TickType_t timeout);
+
+void hid_output_stats_get(hid_transport_t transport, hid_output_stats_t* out);
+void hid_output_stats_reset(hid_transport_t transport);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,140 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hid_encoder.h"
+#include "hid_keys.h"
+#include "hid_layout.h"
+
+// Report packer: every report adds exactly one new key to the keys already
+// held (so the host sees them in typing order) and a release is sent only when
+// the next key is already held, needs other modifiers or the six slots are
+// full. "Password1" goes out in 12 reports instead of 18.
+typedef struct {
+    const hid_encoder_sink_t* sink;
+    uint8_t modifier;
+    uint8_t keys[HID_ENCODER_ROLLOVER_KEYS];
+    uint8_t count;
+} hid_packer_t;
+
+static void hid_packer_release(hid_packer_t* p) {
+    if (p->count == 0 && p->modifier == 0)
+        return;
+    p->count = 0;
+    p->modifier = 0;
+    memset(p->keys, 0, sizeof(p->keys));
+    p->sink->send_report(p->sink->ctx, 0, p->keys, 0);
+}
+
+static void hid_packer_add(hid_packer_t* p, uint8_t modifier, uint8_t key) {
+    bool conflict = p->count == HID_ENCODER_ROLLOVER_KEYS || ((p->count || p->modifier) && modifier != p->modifier);
+    for (int i = 0; i < p->count && !conflict; ++i)
+        conflict = p->keys[i] == key;
+    if (conflict)
+        hid_packer_release(p);
+
+    p->modifier = modifier;
+    p->keys[p->count++] = key;
+    p->sink->send_report(p->sink->ctx, p->modifier, p->keys, p->count);
+}
+
+/************* Fallback per caratteri fuori layout ****************/
+
+// Windows-1252 0x80-0x9F: the only codes where cp1252 differs from Latin-1
+static const uint16_t s_cp1252_high[32] = {
+    0x20AC, 0,      0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0,      0x017D, 0,
+    0,      0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0,      0x017E, 0x0178,
+};
+
+// Digits to type with ALT held: "0nnn" (ANSI code page, every Windows app) when
+// the character is in cp1252, the plain decimal codepoint otherwise (understood
+// by RichEdit based applications)
+static int hid_alt_code_digits(uint32_t codepoint, char digits[8]) {
+    int code = -1;
+    if (codepoint < 0x80 || (codepoint >= 0xA0 && codepoint <= 0xFF)) {
+        code = codepoint;
+    } else {
+        for (int i = 0; i < 32; ++i) {
+            if (s_cp1252_high[i] == codepoint)
+                code = 0x80 + i;
+        }
+    }
+    if (code >= 0)
+        return snprintf(digits, 8, "0%03d", code);
+    return snprintf(digits, 8, "%lu", (unsigned long)codepoint);
+}
+
+// ALT premuto da solo, ogni cifra premuta e rilasciata tenendo ALT, il
+// carattere arriva al rilascio di ALT
+static void hid_encoder_alt_code(hid_packer_t* p, uint32_t codepoint) {
+    char digits[8];
+    int n = hid_alt_code_digits(codepoint, digits);
+
+    hid_packer_release(p);
+    p->modifier = HID_MODIFIER_LEFT_ALT;
+    p->sink->send_report(p->sink->ctx, p->modifier, p->keys, 0);
+    for (int i = 0; i < n; ++i) {
+        p->keys[0] = digits[i] == '0' ? HID_KEY_KEYPAD_0 : HID_KEY_KEYPAD_1 + (digits[i] - '1');
+        p->sink->send_report(p->sink->ctx, p->modifier, p->keys, 1);
+        p->keys[0] = 0;
+        p->sink->send_report(p->sink->ctx, p->modifier, p->keys, 0);
+    }
+    hid_packer_release(p);
+}
+
+// CTRL+SHIFT+U, cifre esadecimali (tasti del layout dell'host), SPAZIO per confermare
+static void hid_encoder_hex_code(hid_packer_t* p, uint32_t codepoint, uint8_t layout) {
+    char digits[8];
+    int n = snprintf(digits, sizeof(digits), "%lx", (unsigned long)codepoint);
+
+    hid_packer_release(p);
+    hid_packer_add(p, HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_SHIFT, HID_KEY_U);
+    hid_packer_release(p);
+    for (int i = 0; i < n; ++i) {
+        const hid_layout_key_t* k = hid_layout_lookup(layout, (uint8_t)digits[i]);
+        if (k != NULL)
+            hid_packer_add(p, k->modifier, k->key);
+    }
+    hid_packer_release(p);
+    hid_packer_add(p, HID_MODIFIER_NONE, HID_KEY_SPACE);
+    hid_packer_release(p);
+}
+
+void hid_encoder_run(const hid_program_t* prog, const hid_encoder_sink_t* sink) {
+    hid_packer_t packer = { .sink = sink };
+
+    for (int i = 0; i < prog->count; ++i) {
+        const hid_op_t* op = &prog->ops[i];
+        if (op->flags & HID_OP_ALT_CODE) {
+            hid_encoder_alt_code(&packer, hid_op_codepoint(op));
+            continue;
+        }
+        if (op->flags & HID_OP_HEX_CODE) {
+            hid_encoder_hex_code(&packer, hid_op_codepoint(op), prog->layout);
+            continue;
+        }
+        if (op->flags & HID_OP_ALONE)
+            hid_packer_release(&packer);
+        if (op->key)
+            hid_packer_add(&packer, op->modifier, op->key);
+        if ((op->flags & (HID_OP_ALONE | HID_OP_SLEEP)) || op->delay)
+            hid_packer_release(&packer);
+        if (op->delay)
+            sink->delay_ms(sink->ctx, op->delay * HID_OP_DELAY_UNIT_MS);
+        if ((op->flags & HID_OP_SLEEP) && sink->sleep)
+            sink->sleep(sink->ctx);
+    }
+    hid_packer_release(&packer);
+    memset(&packer, 0, sizeof(packer));     // ultimi tasti della password
+}
+
+void hid_encoder_tap(uint8_t modifier, uint8_t key, const hid_encoder_sink_t* sink) {
+    if (modifier == 0 && key == 0)
+        return;     // Carattere non mappato nel layout
+    uint8_t keys[HID_ENCODER_ROLLOVER_KEYS] = { key };
+    sink->send_report(sink->ctx, modifier, keys, key ? 1 : 0);
+    keys[0] = 0;
+    sink->send_report(sink->ctx, 0, keys, 0);
+}
@@ -0,0 +1,301 @@
+#include <stddef.h>
+
+#include "hid_layout.h"
+#include "hid_keys.h"
+
+typedef struct {
+    uint16_t codepoint;
+    hid_layout_key_t key;
+} hid_layout_cp_t;
+
+typedef struct {
+    const char* name;
+    hid_layout_key_t ascii[128];        // indice: codice ASCII
+    const hid_layout_cp_t* extra;       // ordinati per codepoint (ricerca per bisezione)
+    size_t extra_count;
+} hid_layout_t;
+
+#define MOD_NONE    HID_MODIFIER_NONE
+#define MOD_SHIFT   HID_MODIFIER_LEFT_SHIFT
+#define MOD_ALTGR   HID_MODIFIER_RIGHT_ALT
+
+#define K(mod, key)     { (mod), (key), 0 }
+#define DEAD(mod, key)  { (mod), (key), HID_LAYOUT_F_DEAD }
+
+// Lettera minuscola c sul tasto key, la maiuscola con SHIFT
+#define LETTER(c, key)  [c] = K(MOD_NONE, key), [(c) - 0x20] = K(MOD_SHIFT, key)
+
+// Tasti che non cambiano tra i layout
+#define CONTROLS \
+    ['\b'] = K(MOD_NONE, HID_KEY_BACKSPACE), \
+    ['\t'] = K(MOD_NONE, HID_KEY_TAB),       \
+    ['\n'] = K(MOD_NONE, HID_KEY_ENTER),     \
+    ['\r'] = K(MOD_NONE, HID_KEY_ENTER),     \
+    [0x1B] = K(MOD_NONE, HID_KEY_ESCAPE),    \
+    [' ']  = K(MOD_NONE, HID_KEY_SPACE),     \
+    [0x7F] = K(MOD_NONE, HID_KEY_DELETE)
+
+// Lettere nella stessa posizione in QWERTY, QWERTZ e AZERTY
+#define LETTERS_COMMON \
+    LETTER('b', HID_KEY_B), LETTER('c', HID_KEY_C), LETTER('d', HID_KEY_D), LETTER('e', HID_KEY_E), \
+    LETTER('f', HID_KEY_F), LETTER('g', HID_KEY_G), LETTER('h', HID_KEY_H), LETTER('i', HID_KEY_I), \
+    LETTER('j', HID_KEY_J), LETTER('k', HID_KEY_K), LETTER('l', HID_KEY_L), LETTER('n', HID_KEY_N), \
+    LETTER('o', HID_KEY_O), LETTER('p', HID_KEY_P), LETTER('r', HID_KEY_R), LETTER('s', HID_KEY_S), \
+    LETTER('t', HID_KEY_T), LETTER('u', HID_KEY_U), LETTER('v', HID_KEY_V), LETTER('x', HID_KEY_X)
+
+#define LETTERS_QWERTY \
+    LETTERS_COMMON, \
+    LETTER('a', HID_KEY_A), LETTER('m', HID_KEY_M), LETTER('q', HID_KEY_Q), \
+    LETTER('w', HID_KEY_W), LETTER('y', HID_KEY_Y), LETTER('z', HID_KEY_Z)
+
+#define DIGITS(mod) \
+    ['0'] = K(mod, HID_KEY_0), ['1'] = K(mod, HID_KEY_1), ['2'] = K(mod, HID_KEY_2), \
+    ['3'] = K(mod, HID_KEY_3), ['4'] = K(mod, HID_KEY_4), ['5'] = K(mod, HID_KEY_5), \
+    ['6'] = K(mod, HID_KEY_6), ['7'] = K(mod, HID_KEY_7), ['8'] = K(mod, HID_KEY_8), \
+    ['9'] = K(mod, HID_KEY_9)
+
+#define ARRAY_LEN(a)    (sizeof(a) / sizeof((a)[0]))
+
+/************* Italiano ****************/
+
+static const hid_layout_cp_t s_extra_it[] = {
+    { 0x00A3, K(MOD_SHIFT, HID_KEY_3) },                /* £ */
+    { 0x00A7, K(MOD_SHIFT, HID_KEY_BACKSLASH) },        /* § */
+    { 0x00B0, K(MOD_SHIFT, HID_KEY_APOSTROPHE) },       /* ° */
+    { 0x00E0, K(MOD_NONE, HID_KEY_APOSTROPHE) },        /* à */
+    { 0x00E7, K(MOD_SHIFT, HID_KEY_SEMICOLON) },        /* ç */
+    { 0x00E8, K(MOD_NONE, HID_KEY_BRACKET_LEFT) },      /* è */
+    { 0x00E9, K(MOD_SHIFT, HID_KEY_BRACKET_LEFT) },     /* é */
+    { 0x00EC, K(MOD_NONE, HID_KEY_EQUAL) },             /* ì */
+    { 0x00F2, K(MOD_NONE, HID_KEY_SEMICOLON) },         /* ò */
+    { 0x00F9, K(MOD_NONE, HID_KEY_BACKSLASH) },         /* ù */
+    { 0x20AC, K(MOD_ALTGR, HID_KEY_E) },                /* € */
+};
+
+// Backtick e tilde non esistono sul layout italiano standard
+static const hid_layout_t s_layout_it = {
+    .name = "IT",
+    .ascii = {
+        CONTROLS, LETTERS_QWERTY, DIGITS(MOD_NONE),
+        ['!'] = K(MOD_SHIFT, HID_KEY_1),            ['"'] = K(MOD_SHIFT, HID_KEY_2),
+        ['#'] = K(MOD_ALTGR, HID_KEY_APOSTROPHE),   ['$'] = K(MOD_SHIFT, HID_KEY_4),
+        ['%'] = K(MOD_SHIFT, HID_KEY_5),            ['&'] = K(MOD_SHIFT, HID_KEY_6),
+        ['\''] = K(MOD_NONE, HID_KEY_MINUS),        ['('] = K(MOD_SHIFT, HID_KEY_8),
+        [')'] = K(MOD_SHIFT, HID_KEY_9),            ['*'] = K(MOD_SHIFT, HID_KEY_BRACKET_RIGHT),
+        ['+'] = K(MOD_NONE, HID_KEY_BRACKET_RIGHT), [','] = K(MOD_NONE, HID_KEY_COMMA),
+        ['-'] = K(MOD_NONE, HID_KEY_SLASH),         ['.'] = K(MOD_NONE, HID_KEY_PERIOD),
+        ['/'] = K(MOD_SHIFT, HID_KEY_7),            [':'] = K(MOD_SHIFT, HID_KEY_PERIOD),
+        [';'] = K(MOD_SHIFT, HID_KEY_COMMA),        ['<'] = K(MOD_NONE, HID_KEY_EUROPE_2),
+        ['='] = K(MOD_SHIFT, HID_KEY_0),            ['>'] = K(MOD_SHIFT, HID_KEY_EUROPE_2),
+        ['?'] = K(MOD_SHIFT, HID_KEY_MINUS),        ['@'] = K(MOD_ALTGR, HID_KEY_SEMICOLON),
+        ['['] = K(MOD_ALTGR, HID_KEY_BRACKET_LEFT), ['\\'] = K(MOD_NONE, HID_KEY_GRAVE),
+        [']'] = K(MOD_ALTGR, HID_KEY_BRACKET_RIGHT),['^'] = K(MOD_SHIFT, HID_KEY_EQUAL),
+        ['_'] = K(MOD_SHIFT, HID_KEY_SLASH),        ['|'] = K(MOD_SHIFT, HID_KEY_GRAVE),
+        // CTRL+ALT vale AltGr anche sugli host che non distinguono l'ALT destro
+        ['{'] = K(HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT | HID_MODIFIER_RIGHT_SHIFT, HID_KEY_BRACKET_LEFT),
+        ['}'] = K(HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT | HID_MODIFIER_RIGHT_SHIFT, HID_KEY_BRACKET_RIGHT),
+    },
+    .extra = s_extra_it,
+    .extra_count = ARRAY_LEN(s_extra_it),
+};
+
+/************* US English ****************/
+
+static const hid_layout_t s_layout_us = {
+    .name = "US",
+    .ascii = {
+        CONTROLS, LETTERS_QWERTY, DIGITS(MOD_NONE),
+        ['!'] = K(MOD_SHIFT, HID_KEY_1),            ['"'] = K(MOD_SHIFT, HID_KEY_APOSTROPHE),
+        ['#'] = K(MOD_SHIFT, HID_KEY_3),            ['$'] = K(MOD_SHIFT, HID_KEY_4),
+        ['%'] = K(MOD_SHIFT, HID_KEY_5),            ['&'] = K(MOD_SHIFT, HID_KEY_7),
+        ['\''] = K(MOD_NONE, HID_KEY_APOSTROPHE),   ['('] = K(MOD_SHIFT, HID_KEY_9),
+        [')'] = K(MOD_SHIFT, HID_KEY_0),            ['*'] = K(MOD_SHIFT, HID_KEY_8),
+        ['+'] = K(MOD_SHIFT, HID_KEY_EQUAL),        [','] = K(MOD_NONE, HID_KEY_COMMA),
+        ['-'] = K(MOD_NONE, HID_KEY_MINUS),         ['.'] = K(MOD_NONE, HID_KEY_PERIOD),
+        ['/'] = K(MOD_NONE, HID_KEY_SLASH),         [':'] = K(MOD_SHIFT, HID_KEY_SEMICOLON),
+        [';'] = K(MOD_NONE, HID_KEY_SEMICOLON),     ['<'] = K(MOD_SHIFT, HID_KEY_COMMA),
+        ['='] = K(MOD_NONE, HID_KEY_EQUAL),         ['>'] = K(MOD_SHIFT, HID_KEY_PERIOD),
+        ['?'] = K(MOD_SHIFT, HID_KEY_SLASH),        ['@'] = K(MOD_SHIFT, HID_KEY_2),
+        ['['] = K(MOD_NONE, HID_KEY_BRACKET_LEFT),  ['\\'] = K(MOD_NONE, HID_KEY_BACKSLASH),
+        [']'] = K(MOD_NONE, HID_KEY_BRACKET_RIGHT), ['^'] = K(MOD_SHIFT, HID_KEY_6),
+        ['_'] = K(MOD_SHIFT, HID_KEY_MINUS),        ['`'] = K(MOD_NONE, HID_KEY_GRAVE),
+        ['{'] = K(MOD_SHIFT, HID_KEY_BRACKET_LEFT), ['|'] = K(MOD_SHIFT, HID_KEY_BACKSLASH),
+        ['}'] = K(MOD_SHIFT, HID_KEY_BRACKET_RIGHT),['~'] = K(MOD_SHIFT, HID_KEY_GRAVE),
+    },
+    .extra = NULL,
+    .extra_count = 0,
+};
+
+/************* UK English ****************/
+
+static const hid_layout_cp_t s_extra_uk[] = {
+    { 0x00A3, K(MOD_SHIFT, HID_KEY_3) },                /* £ */
+    { 0x00A6, K(MOD_ALTGR, HID_KEY_GRAVE) },            /* ¦ */
+    { 0x00AC, K(MOD_SHIFT, HID_KEY_GRAVE) },            /* ¬ */
+    { 0x00C1, K(MOD_ALTGR | MOD_SHIFT, HID_KEY_A) },    /* Á */
+    { 0x00C9, K(MOD_ALTGR | MOD_SHIFT, HID_KEY_E) },    /* É */
+    { 0x00CD, K(MOD_ALTGR | MOD_SHIFT, HID_KEY_I) },    /* Í */
+    { 0x00D3, K(MOD_ALTGR | MOD_SHIFT, HID_KEY_O) },    /* Ó */
+    { 0x00DA, K(MOD_ALTGR | MOD_SHIFT, HID_KEY_U) },    /* Ú */
+    { 0x00E1, K(MOD_ALTGR, HID_KEY_A) },                /* á */
+    { 0x00E9, K(MOD_ALTGR, HID_KEY_E) },                /* é */
+    { 0x00ED, K(MOD_ALTGR, HID_KEY_I) },                /* í */
+    { 0x00F3, K(MOD_ALTGR, HID_KEY_O) },                /* ó */
+    { 0x00FA, K(MOD_ALTGR, HID_KEY_U) },                /* ú */
+    { 0x20AC, K(MOD_ALTGR, HID_KEY_4) },                /* € */
+};
+
+static const hid_layout_t s_layout_uk = {
+    .name = "UK",
+    .ascii = {
+        CONTROLS, LETTERS_QWERTY, DIGITS(MOD_NONE),
+        ['!'] = K(MOD_SHIFT, HID_KEY_1),            ['"'] = K(MOD_SHIFT, HID_KEY_2),
+        ['#'] = K(MOD_NONE, HID_KEY_EUROPE_1),      ['$'] = K(MOD_SHIFT, HID_KEY_4),
+        ['%'] = K(MOD_SHIFT, HID_KEY_5),            ['&'] = K(MOD_SHIFT, HID_KEY_7),
+        ['\''] = K(MOD_NONE, HID_KEY_APOSTROPHE),   ['('] = K(MOD_SHIFT, HID_KEY_9),
+        [')'] = K(MOD_SHIFT, HID_KEY_0),            ['*'] = K(MOD_SHIFT, HID_KEY_8),
+        ['+'] = K(MOD_SHIFT, HID_KEY_EQUAL),        [','] = K(MOD_NONE, HID_KEY_COMMA),
+        ['-'] = K(MOD_NONE, HID_KEY_MINUS),         ['.'] = K(MOD_NONE, HID_KEY_PERIOD),
+        ['/'] = K(MOD_NONE, HID_KEY_SLASH),         [':'] = K(MOD_SHIFT, HID_KEY_SEMICOLON),
+        [';'] = K(MOD_NONE, HID_KEY_SEMICOLON),     ['<'] = K(MOD_SHIFT, HID_KEY_COMMA),
+        ['='] = K(MOD_NONE, HID_KEY_EQUAL),         ['>'] = K(MOD_SHIFT, HID_KEY_PERIOD),
+        ['?'] = K(MOD_SHIFT, HID_KEY_SLASH),        ['@'] = K(MOD_SHIFT, HID_KEY_APOSTROPHE),
+        ['['] = K(MOD_NONE, HID_KEY_BRACKET_LEFT),  ['\\'] = K(MOD_NONE, HID_KEY_EUROPE_2),
+        [']'] = K(MOD_NONE, HID_KEY_BRACKET_RIGHT), ['^'] = K(MOD_SHIFT, HID_KEY_6),
+        ['_'] = K(MOD_SHIFT, HID_KEY_MINUS),        ['`'] = K(MOD_NONE, HID_KEY_GRAVE),
+        ['{'] = K(MOD_SHIFT, HID_KEY_BRACKET_LEFT), ['|'] = K(MOD_SHIFT, HID_KEY_EUROPE_2),
+        ['}'] = K(MOD_SHIFT, HID_KEY_BRACKET_RIGHT),['~'] = K(MOD_SHIFT, HID_KEY_EUROPE_1),
+    },
+    .extra = s_extra_uk,
+    .extra_count = ARRAY_LEN(s_extra_uk),
+};
+
+/************* Tedesco (QWERTZ) ****************/
+
+static const hid_layout_cp_t s_extra_de[] = {
+    { 0x00A7, K(MOD_SHIFT, HID_KEY_3) },                /* § */
+    { 0x00B0, K(MOD_SHIFT, HID_KEY_GRAVE) },            /* ° */
+    { 0x00B2, K(MOD_ALTGR, HID_KEY_2) },                /* ² */
+    { 0x00B3, K(MOD_ALTGR, HID_KEY_3) },                /* ³ */
+    { 0x00B4, DEAD(MOD_NONE, HID_KEY_EQUAL) },          /* ´ */
+    { 0x00B5, K(MOD_ALTGR, HID_KEY_M) },                /* µ */
+    { 0x00C4, K(MOD_SHIFT, HID_KEY_APOSTROPHE) },       /* Ä */
+    { 0x00D6, K(MOD_SHIFT, HID_KEY_SEMICOLON) },        /* Ö */
+    { 0x00DC, K(MOD_SHIFT, HID_KEY_BRACKET_LEFT) },     /* Ü */
+    { 0x00DF, K(MOD_NONE, HID_KEY_MINUS) },             /* ß */
+    { 0x00E4, K(MOD_NONE, HID_KEY_APOSTROPHE) },        /* ä */
+    { 0x00F6, K(MOD_NONE, HID_KEY_SEMICOLON) },         /* ö */
+    { 0x00FC, K(MOD_NONE, HID_KEY_BRACKET_LEFT) },      /* ü */
+    { 0x20AC, K(MOD_ALTGR, HID_KEY_E) },                /* € */
+};
+
+static const hid_layout_t s_layout_de = {
+    .name = "DE",
+    .ascii = {
+        CONTROLS, LETTERS_COMMON, DIGITS(MOD_NONE),
+        LETTER('a', HID_KEY_A), LETTER('m', HID_KEY_M), LETTER('q', HID_KEY_Q),
+        LETTER('w', HID_KEY_W), LETTER('y', HID_KEY_Z), LETTER('z', HID_KEY_Y),
+        ['!'] = K(MOD_SHIFT, HID_KEY_1),            ['"'] = K(MOD_SHIFT, HID_KEY_2),
+        ['#'] = K(MOD_NONE, HID_KEY_EUROPE_1),      ['$'] = K(MOD_SHIFT, HID_KEY_4),
+        ['%'] = K(MOD_SHIFT, HID_KEY_5),            ['&'] = K(MOD_SHIFT, HID_KEY_6),
+        ['\''] = K(MOD_SHIFT, HID_KEY_EUROPE_1),    ['('] = K(MOD_SHIFT, HID_KEY_8),
+        [')'] = K(MOD_SHIFT, HID_KEY_9),            ['*'] = K(MOD_SHIFT, HID_KEY_BRACKET_RIGHT),
+        ['+'] = K(MOD_NONE, HID_KEY_BRACKET_RIGHT), [','] = K(MOD_NONE, HID_KEY_COMMA),
+        ['-'] = K(MOD_NONE, HID_KEY_SLASH),         ['.'] = K(MOD_NONE, HID_KEY_PERIOD),
+        ['/'] = K(MOD_SHIFT, HID_KEY_7),            [':'] = K(MOD_SHIFT, HID_KEY_PERIOD),
+        [';'] = K(MOD_SHIFT, HID_KEY_COMMA),        ['<'] = K(MOD_NONE, HID_KEY_EUROPE_2),
+        ['='] = K(MOD_SHIFT, HID_KEY_0),            ['>'] = K(MOD_SHIFT, HID_KEY_EUROPE_2),
+        ['?'] = K(MOD_SHIFT, HID_KEY_MINUS),        ['@'] = K(MOD_ALTGR, HID_KEY_Q),
+        ['['] = K(MOD_ALTGR, HID_KEY_8),            ['\\'] = K(MOD_ALTGR, HID_KEY_MINUS),
+        [']'] = K(MOD_ALTGR, HID_KEY_9),            ['^'] = DEAD(MOD_NONE, HID_KEY_GRAVE),
+        ['_'] = K(MOD_SHIFT, HID_KEY_SLASH),        ['`'] = DEAD(MOD_SHIFT, HID_KEY_EQUAL),
+        ['{'] = K(MOD_ALTGR, HID_KEY_7),            ['|'] = K(MOD_ALTGR, HID_KEY_EUROPE_2),
+        ['}'] = K(MOD_ALTGR, HID_KEY_0),            ['~'] = K(MOD_ALTGR, HID_KEY_BRACKET_RIGHT),
+    },
+    .extra = s_extra_de,
+    .extra_count = ARRAY_LEN(s_extra_de),
+};
+
+/************* Francese (AZERTY) ****************/
+
+static const hid_layout_cp_t s_extra_fr[] = {
+    { 0x00A3, K(MOD_SHIFT, HID_KEY_BRACKET_RIGHT) },    /* £ */
+    { 0x00A4, K(MOD_ALTGR, HID_KEY_BRACKET_RIGHT) },    /* ¤ */
+    { 0x00A7, K(MOD_SHIFT, HID_KEY_SLASH) },            /* § */
+    { 0x00A8, DEAD(MOD_SHIFT, HID_KEY_BRACKET_LEFT) },  /* ¨ */
+    { 0x00B0, K(MOD_SHIFT, HID_KEY_MINUS) },            /* ° */
+    { 0x00B2, K(MOD_NONE, HID_KEY_GRAVE) },             /* ² */
+    { 0x00B5, K(MOD_SHIFT, HID_KEY_EUROPE_1) },         /* µ */
+    { 0x00E0, K(MOD_NONE, HID_KEY_0) },                 /* à */
+    { 0x00E7, K(MOD_NONE, HID_KEY_9) },                 /* ç */
+    { 0x00E8, K(MOD_NONE, HID_KEY_7) },                 /* è */
+    { 0x00E9, K(MOD_NONE, HID_KEY_2) },                 /* é */
+    { 0x00F9, K(MOD_NONE, HID_KEY_APOSTROPHE) },        /* ù */
+    { 0x20AC, K(MOD_ALTGR, HID_KEY_E) },                /* € */
+};
+
+static const hid_layout_t s_layout_fr = {
+    .name = "FR",
+    .ascii = {
+        CONTROLS, LETTERS_COMMON, DIGITS(MOD_SHIFT),
+        LETTER('a', HID_KEY_Q), LETTER('m', HID_KEY_SEMICOLON), LETTER('q', HID_KEY_A),
+        LETTER('w', HID_KEY_Z), LETTER('y', HID_KEY_Y), LETTER('z', HID_KEY_W),
+        ['!'] = K(MOD_NONE, HID_KEY_SLASH),         ['"'] = K(MOD_NONE, HID_KEY_3),
+        ['#'] = K(MOD_ALTGR, HID_KEY_3),            ['$'] = K(MOD_NONE, HID_KEY_BRACKET_RIGHT),
+        ['%'] = K(MOD_SHIFT, HID_KEY_APOSTROPHE),   ['&'] = K(MOD_NONE, HID_KEY_1),
+        ['\''] = K(MOD_NONE, HID_KEY_4),            ['('] = K(MOD_NONE, HID_KEY_5),
+        [')'] = K(MOD_NONE, HID_KEY_MINUS),         ['*'] = K(MOD_NONE, HID_KEY_EUROPE_1),
+        ['+'] = K(MOD_SHIFT, HID_KEY_EQUAL),        [','] = K(MOD_NONE, HID_KEY_M),
+        ['-'] = K(MOD_NONE, HID_KEY_6),             ['.'] = K(MOD_SHIFT, HID_KEY_COMMA),
+        ['/'] = K(MOD_SHIFT, HID_KEY_PERIOD),       [':'] = K(MOD_NONE, HID_KEY_PERIOD),
+        [';'] = K(MOD_NONE, HID_KEY_COMMA),         ['<'] = K(MOD_NONE, HID_KEY_EUROPE_2),
+        ['='] = K(MOD_NONE, HID_KEY_EQUAL),         ['>'] = K(MOD_SHIFT, HID_KEY_EUROPE_2),
+        ['?'] = K(MOD_SHIFT, HID_KEY_M),            ['@'] = K(MOD_ALTGR, HID_KEY_0),
+        ['['] = K(MOD_ALTGR, HID_KEY_5),            ['\\'] = K(MOD_ALTGR, HID_KEY_8),
+        [']'] = K(MOD_ALTGR, HID_KEY_MINUS),        ['^'] = K(MOD_ALTGR, HID_KEY_9),
+        ['_'] = K(MOD_NONE, HID_KEY_8),             ['`'] = DEAD(MOD_ALTGR, HID_KEY_7),
+        ['{'] = K(MOD_ALTGR, HID_KEY_4),            ['|'] = K(MOD_ALTGR, HID_KEY_6),
+        ['}'] = K(MOD_ALTGR, HID_KEY_EQUAL),        ['~'] = DEAD(MOD_ALTGR, HID_KEY_2),
+    },
+    .extra = s_extra_fr,
+    .extra_count = ARRAY_LEN(s_extra_fr),
+};
+
+static const hid_layout_t* const s_layouts[HID_LAYOUT_NB] = {
+    [HID_LAYOUT_IT] = &s_layout_it,
+    [HID_LAYOUT_US] = &s_layout_us,
+    [HID_LAYOUT_UK] = &s_layout_uk,
+    [HID_LAYOUT_DE] = &s_layout_de,
+    [HID_LAYOUT_FR] = &s_layout_fr,
+};
+
+uint8_t hid_layout_resolve(uint8_t layout) {
+    if (layout == HID_LAYOUT_DEFAULT || layout >= HID_LAYOUT_NB)
+        return HID_LAYOUT_DEVICE;
+    return layout;
+}
+
+const char* hid_layout_name(uint8_t layout) {
+    return s_layouts[hid_layout_resolve(layout)]->name;
+}
+
+const hid_layout_key_t* hid_layout_lookup(uint8_t layout, uint32_t codepoint) {
+    const hid_layout_t* l = s_layouts[hid_layout_resolve(layout)];
+    const hid_layout_key_t* k = NULL;
+
+    if (codepoint < 128) {
+        k = &l->ascii[codepoint];
+    } else {
+        size_t lo = 0, hi = l->extra_count;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (l->extra[mid].codepoint < codepoint)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo < l->extra_count && l->extra[lo].codepoint == codepoint)
+            k = &l->extra[lo].key;
+    }
+    return (k != NULL && k->key != 0) ? k : NULL;
+}
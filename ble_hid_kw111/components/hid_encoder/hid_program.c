@@ -0,0 +1,370 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mbedtls/aes.h"
+
+#include "hid_program.h"
+#include "hid_keys.h"
+#include "hid_layout.h"
+#include "password_placeholders.h"
+
+static const char *TAG = "HID PROG";
+
+typedef struct {
+    bool used;
+    int16_t index;                                      // account (valido solo se used)
+    uint8_t count;
+    uint8_t layout;
+    uint32_t last_use;
+    uint8_t nonce[16];                                  // contatore iniziale AES-CTR
+    uint8_t enc[sizeof(hid_op_t) * HID_PROGRAM_MAX_OPS];
+} hid_program_slot_t;
+
+static hid_program_slot_t s_cache[HID_PROGRAM_CACHE_SIZE];
+static uint32_t s_cache_clock = 0;
+static uint32_t s_generation = 0;       // bumped by every invalidation
+static mbedtls_aes_context s_aes;
+static SemaphoreHandle_t s_cache_lock = NULL;         // s_cache, s_aes, s_cache_ready e le statistiche
+static bool s_cache_ready = false;                      // s_aes ha la chiave
+static hid_program_stats_t s_stats = {0};
+
+/************* Compiler ****************/
+
+void hid_program_init(hid_program_t* prog) {
+    memset(prog, 0, sizeof(*prog));
+}
+
+void hid_program_wipe(hid_program_t* prog) {
+    memset(prog, 0, sizeof(*prog));
+}
+
+static hid_op_t* hid_program_next(hid_program_t* prog) {
+    if (prog->count >= HID_PROGRAM_MAX_OPS)
+        return NULL;
+    hid_op_t* op = &prog->ops[prog->count++];
+    memset(op, 0, sizeof(*op));
+    return op;
+}
+
+esp_err_t hid_program_add_key(hid_program_t* prog, uint8_t modifiers, uint8_t key) {
+    hid_op_t* op = hid_program_next(prog);
+    if (op == NULL)
+        return ESP_ERR_NO_MEM;
+    op->modifier = modifiers;
+    op->key = key;
+    op->flags = HID_OP_ALONE;
+    return ESP_OK;
+}
+
+esp_err_t hid_program_add_delay(hid_program_t* prog, uint16_t delay_ms) {
+    // Pause longer than one op can hold are split on several ops
+    do {
+        uint16_t units = delay_ms / HID_OP_DELAY_UNIT_MS;
+        if (units > UINT8_MAX)
+            units = UINT8_MAX;
+        hid_op_t* op = hid_program_next(prog);
+        if (op == NULL)
+            return ESP_ERR_NO_MEM;
+        op->delay = units;
+        delay_ms -= units * HID_OP_DELAY_UNIT_MS;
+    } while (delay_ms >= HID_OP_DELAY_UNIT_MS);
+    return ESP_OK;
+}
+
+static esp_err_t hid_program_add_placeholder(hid_program_t* prog, uint8_t ph) {
+    switch (ph) {
+        case PW_PH_ENTER:        return hid_program_add_key(prog, KEYBOARD_MODIFIER_NONE, HID_KEY_ENTER);
+        case PW_PH_TAB:          return hid_program_add_key(prog, KEYBOARD_MODIFIER_NONE, HID_KEY_TAB);
+        case PW_PH_ESC:          return hid_program_add_key(prog, KEYBOARD_MODIFIER_NONE, HID_KEY_ESCAPE);
+        case PW_PH_BACKSPACE:    return hid_program_add_key(prog, KEYBOARD_MODIFIER_NONE, HID_KEY_BACKSPACE);
+        case PW_PH_DELAY_500MS:  return hid_program_add_delay(prog, 500);
+        case PW_PH_DELAY_1000MS: return hid_program_add_delay(prog, 1000);
+        case PW_PH_CTRL_ALT_DEL: return hid_program_add_key(prog, HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, HID_KEY_DELETE);
+        case PW_PH_SHIFT_TAB:    return hid_program_add_key(prog, HID_MODIFIER_LEFT_SHIFT, HID_KEY_TAB);
+        case PW_PH_SLEEP: {
+            hid_op_t* op = hid_program_next(prog);
+            if (op == NULL)
+                return ESP_ERR_NO_MEM;
+            op->flags = HID_OP_SLEEP;
+            return ESP_OK;
+        }
+        default:
+            return ESP_OK;  // Non gestito (futuro)
+    }
+}
+
+#define HID_CODEPOINT_INVALID   0xFFFFFFFFu
+
+// Decodes the UTF-8 scalar at text[*i] and moves *i past it. Malformed input
+// (missing or bad continuation, overlong forms, surrogates, values above
+// U+10FFFF) gives HID_CODEPOINT_INVALID and consumes only the bytes examined,
+// so the terminator is never skipped
+static uint32_t hid_program_next_codepoint(const char* text, size_t* i) {
+    const uint8_t* s = (const uint8_t*)&text[*i];
+    uint32_t codepoint, min;
+    int len;
+
+    if (s[0] < 0x80) {
+        *i += 1;
+        return s[0];
+    } else if (s[0] >= 0xC2 && s[0] <= 0xDF) {
+        len = 2; codepoint = s[0] & 0x1F; min = 0x80;
+    } else if ((s[0] & 0xF0) == 0xE0) {
+        len = 3; codepoint = s[0] & 0x0F; min = 0x800;
+    } else if (s[0] >= 0xF0 && s[0] <= 0xF4) {
+        len = 4; codepoint = s[0] & 0x07; min = 0x10000;
+    } else {
+        *i += 1;    // continuation isolata, C0/C1 (overlong), F5-FF
+        return HID_CODEPOINT_INVALID;
+    }
+
+    for (int j = 1; j < len; ++j) {
+        if ((s[j] & 0xC0) != 0x80) {    // anche '\0'
+            *i += j;
+            return HID_CODEPOINT_INVALID;
+        }
+        codepoint = (codepoint << 6) | (s[j] & 0x3F);
+    }
+    *i += len;
+    if (codepoint < min || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+        return HID_CODEPOINT_INVALID;
+    return codepoint;
+}
+
+// Compiles text until the end, a full program (ESP_ERR_NO_MEM) or a rejected
+// character (ESP_ERR_NOT_SUPPORTED); *consumed stops at a character boundary
+static esp_err_t hid_program_add_text_ex(hid_program_t* prog, const char* text, uint8_t layout,
+                                         uint8_t fallback, size_t* consumed) {
+    esp_err_t ret = ESP_OK;
+    size_t i = 0;
+    prog->layout = layout;
+    while (text[i]) {
+        uint8_t b = (uint8_t)text[i];
+        if (PW_IS_PLACEHOLDER(b)) { // Gestione placeholder 0x80-0x8F (una op, le pause di testo stanno in 2.5 s)
+            if (prog->count >= HID_PROGRAM_MAX_OPS) {
+                ret = ESP_ERR_NO_MEM;
+                break;
+            }
+            hid_program_add_placeholder(prog, b);
+            i++;
+            continue;
+        }
+
+        size_t next = i;
+        uint32_t codepoint = hid_program_next_codepoint(text, &next);
+        const hid_layout_key_t* k = hid_layout_lookup(layout, codepoint);
+        if (k != NULL) {
+            // Tasto morto: premuto da solo e seguito da SPAZIO per ottenere il carattere
+            bool dead = k->flags & HID_LAYOUT_F_DEAD;
+            if (prog->count + (dead ? 2 : 1) > HID_PROGRAM_MAX_OPS) {
+                ret = ESP_ERR_NO_MEM;
+                break;
+            }
+            hid_op_t* op = hid_program_next(prog);
+            op->modifier = k->modifier;
+            op->key = k->key;
+            if (dead) {
+                op->flags = HID_OP_ALONE;
+                op = hid_program_next(prog);
+                op->key = HID_KEY_SPACE;
+            }
+        } else if (fallback == HID_FALLBACK_REJECT) {
+            ret = ESP_ERR_NOT_SUPPORTED;
+            break;
+        } else if ((fallback == HID_FALLBACK_ALT_CODE || fallback == HID_FALLBACK_HEX_CODE) &&
+                   codepoint != HID_CODEPOINT_INVALID && codepoint >= 0x20 && codepoint != 0x7F) {
+            // Una op: la sequenza di tasti viene generata dall'encoder
+            hid_op_t* op = hid_program_next(prog);
+            if (op == NULL) {
+                ret = ESP_ERR_NO_MEM;
+                break;
+            }
+            op->flags = fallback == HID_FALLBACK_ALT_CODE ? HID_OP_ALT_CODE : HID_OP_HEX_CODE;
+            op->modifier = codepoint & 0xFF;
+            op->key = (codepoint >> 8) & 0xFF;
+            op->delay = codepoint >> 16;
+        }   // altrimenti ignorato (non valido, controllo o HID_FALLBACK_SKIP)
+        i = next;
+    }
+    *consumed = i;
+    return ret;
+}
+
+size_t hid_program_add_text(hid_program_t* prog, const char* text, uint8_t layout, uint8_t fallback) {
+    size_t consumed;
+    hid_program_add_text_ex(prog, text, layout, fallback, &consumed);
+    return consumed;
+}
+
+esp_err_t hid_program_compile(const char* password, bool winlogin, bool send_enter,
+                              uint8_t layout, uint8_t fallback, hid_program_t* out) {
+    hid_program_init(out);
+    if (winlogin) {  // CTRL+ALT+DELETE, then wait for the Windows login screen
+        hid_program_add_key(out, HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, HID_KEY_DELETE);
+        hid_program_add_delay(out, 1000);
+    }
+    size_t consumed;
+    esp_err_t ret = hid_program_add_text_ex(out, password, layout, fallback, &consumed);
+    if (ret == ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGE(TAG, "Character not available in layout %s", hid_layout_name(layout));
+        hid_program_wipe(out);
+        return ret;
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Password too long for a program (%d ops)", HID_PROGRAM_MAX_OPS);
+        hid_program_wipe(out);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (send_enter && hid_program_add_key(out, KEYBOARD_MODIFIER_NONE, HID_KEY_ENTER) != ESP_OK) {
+        hid_program_wipe(out);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+/************* Encrypted cache ****************/
+
+static void hid_program_cache_lock(void) {
+    if (s_cache_lock == NULL) {
+        // First use: two tasks may get here together, only one mutex survives
+        static portMUX_TYPE create_mux = portMUX_INITIALIZER_UNLOCKED;
+        SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+        portENTER_CRITICAL(&create_mux);
+        if (s_cache_lock == NULL) {
+            s_cache_lock = lock;
+            lock = NULL;
+        }
+        portEXIT_CRITICAL(&create_mux);
+        if (lock)
+            vSemaphoreDelete(lock);
+    }
+    xSemaphoreTake(s_cache_lock, portMAX_DELAY);
+}
+
+static void hid_program_cache_unlock(void) {
+    xSemaphoreGive(s_cache_lock);
+}
+
+// Keys the cache on first use; call with the cache lock held
+static esp_err_t hid_program_cache_init_locked(void) {
+    if (s_cache_ready)
+        return ESP_OK;
+
+    // Chiave casuale valida solo fino al prossimo reset: i programmi non escono mai dalla RAM
+    uint8_t key[16];
+    esp_fill_random(key, sizeof(key));
+    mbedtls_aes_init(&s_aes);
+    int rc = mbedtls_aes_setkey_enc(&s_aes, key, 128);
+    memset(key, 0, sizeof(key));
+    if (rc != 0) {
+        ESP_LOGE(TAG, "AES setkey failed: -0x%04x", -rc);
+        mbedtls_aes_free(&s_aes);
+        return ESP_FAIL;
+    }
+    memset(s_cache, 0, sizeof(s_cache));
+    s_cache_ready = true;
+    return ESP_OK;
+}
+
+// CTR: la stessa chiamata cifra e decifra
+static void hid_program_crypt(const uint8_t nonce[16], const uint8_t* in, uint8_t* out, size_t len) {
+    uint8_t counter[16], stream[16];
+    size_t nc_off = 0;
+    memcpy(counter, nonce, sizeof(counter));
+    mbedtls_aes_crypt_ctr(&s_aes, len, &nc_off, counter, stream, in, out);
+    memset(stream, 0, sizeof(stream));
+}
+
+static void hid_program_cache_store(int index, const hid_program_t* prog) {
+    hid_program_slot_t* victim = &s_cache[0];
+    for (int i = 0; i < HID_PROGRAM_CACHE_SIZE; ++i) {
+        if (!s_cache[i].used) {
+            victim = &s_cache[i];
+            break;
+        }
+        if (s_cache[i].last_use < victim->last_use)
+            victim = &s_cache[i];
+    }
+    victim->used = true;
+    victim->index = index;
+    victim->count = prog->count;
+    victim->layout = prog->layout;
+    victim->last_use = ++s_cache_clock;
+    esp_fill_random(victim->nonce, sizeof(victim->nonce));
+    hid_program_crypt(victim->nonce, (const uint8_t*)prog->ops, victim->enc, sizeof(victim->enc));
+}
+
+esp_err_t hid_program_load(int index, hid_program_t* out) {
+    int64_t start = esp_timer_get_time();
+    hid_program_cache_lock();
+    esp_err_t ret = hid_program_cache_init_locked();
+    if (ret != ESP_OK) {
+        hid_program_cache_unlock();
+        return ret;
+    }
+    for (int i = 0; i < HID_PROGRAM_CACHE_SIZE; ++i) {
+        if (s_cache[i].used && s_cache[i].index == index) {
+            hid_program_init(out);
+            hid_program_crypt(s_cache[i].nonce, s_cache[i].enc, (uint8_t*)out->ops, sizeof(out->ops));
+            out->count = s_cache[i].count;
+            out->layout = s_cache[i].layout;
+            s_cache[i].last_use = ++s_cache_clock;
+            s_stats.hits++;
+            s_stats.last_load_us = (uint32_t)(esp_timer_get_time() - start);
+            hid_program_cache_unlock();
+            return ESP_OK;
+        }
+    }
+    uint32_t generation = s_generation;
+    hid_program_cache_unlock();
+
+    // Compiled without holding the cache lock: userdb_* may call hid_program_invalidate
+    user_entry_t user;
+    char plain[MAX_PASSWORD_LEN + 1];
+    if (userdb_get(index, &user) != 0) {
+        ret = ESP_ERR_NOT_FOUND;
+    } else if (userdb_decrypt_password(user.password_enc, user.password_len, plain) != 0) {
+        ESP_LOGE(TAG, "Decrypt error for user %d", index);
+        ret = ESP_ERR_INVALID_RESPONSE;
+    } else {
+        ret = hid_program_compile(plain, user.winlogin, user.sendEnter, user.layout, user.fallback, out);
+        memset(plain, 0, sizeof(plain));
+    }
+    memset(&user, 0, sizeof(user));
+    if (ret != ESP_OK)
+        return ret;
+
+    uint32_t compile_us = (uint32_t)(esp_timer_get_time() - start);
+    hid_program_cache_lock();
+    if (generation == s_generation)     // the account did not change in the meantime
+        hid_program_cache_store(index, out);
+    s_stats.misses++;
+    s_stats.last_compile_us = compile_us;
+    s_stats.last_load_us = compile_us;
+    if (compile_us > s_stats.max_compile_us)
+        s_stats.max_compile_us = compile_us;
+    hid_program_cache_unlock();
+    ESP_LOGI(TAG, "User %d compiled to %u ops in %lu us", index, out->count, (unsigned long)compile_us);
+    return ESP_OK;
+}
+
+void hid_program_invalidate(int index) {
+    hid_program_cache_lock();
+    s_generation++;
+    for (int i = 0; i < HID_PROGRAM_CACHE_SIZE; ++i) {
+        if (s_cache[i].used && (index == -1 || s_cache[i].index == index))
+            memset(&s_cache[i], 0, sizeof(s_cache[i]));
+    }
+    hid_program_cache_unlock();
+}
+
+void hid_program_stats_get(hid_program_stats_t* out) {
+    if (out == NULL)
+        return;
+    hid_program_cache_lock();
+    *out = s_stats;
+    hid_program_cache_unlock();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#ifndef HID_ENCODER_H
+#define HID_ENCODER_H
+
+#include <stdint.h>
+#include "hid_program.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Esecuzione dei programmi di tasti (hid_program.h) come sequenza di report
+tastiera. Il packer dei tasti, le pause e i placeholder sono gestiti qui una
+volta sola; il trasporto (BLE, USB) fornisce solo l'invio di un report, con il
+proprio pacing, e le azioni che dipendono dalla piattaforma.
+*/
+
+#define HID_ENCODER_ROLLOVER_KEYS   6       // tasti per report (boot keyboard)
+
+typedef struct {
+    // Un report tastiera: count 0 = tutti i tasti rilasciati
+    void (*send_report)(void* ctx, uint8_t modifier, const uint8_t* keys, uint8_t count);
+    void (*delay_ms)(void* ctx, uint32_t ms);
+    void (*sleep)(void* ctx);               // placeholder HID_OP_SLEEP (NULL: ignorato)
+    void* ctx;
+} hid_encoder_sink_t;
+
+// Esegue il programma e lascia tutti i tasti rilasciati
+void hid_encoder_run(const hid_program_t* prog, const hid_encoder_sink_t* sink);
+// Un solo tasto: pressione e rilascio
+void hid_encoder_tap(uint8_t modifier, uint8_t key, const hid_encoder_sink_t* sink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+#ifndef HID_KEYS_H
+#define HID_KEYS_H
+
+// Usage ID della pagina Keyboard/Keypad (HID Usage Tables) e bit dei modifier,
+// comuni all'encoder e ai trasporti BLE/USB
+
+#define HID_KEY_A                 0x04
+#define HID_KEY_B                 0x05
+#define HID_KEY_C                 0x06
+#define HID_KEY_D                 0x07
+#define HID_KEY_E                 0x08
+#define HID_KEY_F                 0x09
+#define HID_KEY_G                 0x0A
+#define HID_KEY_H                 0x0B
+#define HID_KEY_I                 0x0C
+#define HID_KEY_J                 0x0D
+#define HID_KEY_K                 0x0E
+#define HID_KEY_L                 0x0F
+#define HID_KEY_M                 0x10
+#define HID_KEY_N                 0x11
+#define HID_KEY_O                 0x12
+#define HID_KEY_P                 0x13
+#define HID_KEY_Q                 0x14
+#define HID_KEY_R                 0x15
+#define HID_KEY_S                 0x16
+#define HID_KEY_T                 0x17
+#define HID_KEY_U                 0x18
+#define HID_KEY_V                 0x19
+#define HID_KEY_W                 0x1A
+#define HID_KEY_X                 0x1B
+#define HID_KEY_Y                 0x1C
+#define HID_KEY_Z                 0x1D
+#define HID_KEY_1                 0x1E
+#define HID_KEY_2                 0x1F
+#define HID_KEY_3                 0x20
+#define HID_KEY_4                 0x21
+#define HID_KEY_5                 0x22
+#define HID_KEY_6                 0x23
+#define HID_KEY_7                 0x24
+#define HID_KEY_8                 0x25
+#define HID_KEY_9                 0x26
+#define HID_KEY_0                 0x27
+#define HID_KEY_ENTER             0x28
+#define HID_KEY_ESCAPE            0x29
+#define HID_KEY_BACKSPACE         0x2A
+#define HID_KEY_TAB               0x2B
+#define HID_KEY_SPACE             0x2C
+#define HID_KEY_MINUS             0x2D
+#define HID_KEY_EQUAL             0x2E
+#define HID_KEY_BRACKET_LEFT      0x2F
+#define HID_KEY_BRACKET_RIGHT     0x30
+#define HID_KEY_BACKSLASH         0x31
+#define HID_KEY_SEMICOLON         0x33
+#define HID_KEY_APOSTROPHE        0x34
+#define HID_KEY_GRAVE             0x35
+#define HID_KEY_COMMA             0x36
+#define HID_KEY_PERIOD            0x37
+#define HID_KEY_SLASH             0x38
+// Non-US hash/tilde (aka Europe 1), the key left of ENTER on ISO keyboards
+#define HID_KEY_EUROPE_1          0x32
+// Non-US backslash/pipe (aka Europe 2) commonly 0x64 in USB HID Usage Tables
+#define HID_KEY_EUROPE_2          0x64
+#define HID_KEY_DELETE            0x4C
+#define HID_KEY_KEYPAD_1          0x59      // 1..9: 0x59..0x61
+#define HID_KEY_KEYPAD_0          0x62
+
+#define HID_MODIFIER_NONE           0x00
+#define HID_MODIFIER_LEFT_CTRL      0x01
+#define HID_MODIFIER_LEFT_SHIFT     0x02
+#define HID_MODIFIER_LEFT_ALT       0x04
+#define HID_MODIFIER_RIGHT_CTRL     0x10
+#define HID_MODIFIER_RIGHT_SHIFT    0x20
+#define HID_MODIFIER_RIGHT_ALT      0x40
+
+#define KEYBOARD_MODIFIER_NONE      HID_MODIFIER_NONE
+
+#endif
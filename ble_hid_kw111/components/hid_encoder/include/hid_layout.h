@@ -0,0 +1,52 @@
+#pragma once
+#ifndef HID_LAYOUT_H
+#define HID_LAYOUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Layout di tastiera dell'host.
+Ogni layout e' una tabella costante (in flash): accesso diretto per l'ASCII e
+una lista di codepoint Unicode ordinata, cercata per bisezione, per i
+caratteri nazionali. Il layout si sceglie per account (user_entry_t.layout);
+HID_LAYOUT_DEFAULT usa quello del dispositivo.
+*/
+
+typedef enum {
+    HID_LAYOUT_DEFAULT = 0,     // layout del dispositivo (HID_LAYOUT_DEVICE)
+    HID_LAYOUT_IT,
+    HID_LAYOUT_US,
+    HID_LAYOUT_UK,
+    HID_LAYOUT_DE,
+    HID_LAYOUT_FR,
+    HID_LAYOUT_NB,
+} hid_layout_id_t;
+
+// Layout usato dagli account senza layout proprio e da ble/usb_send_string
+#define HID_LAYOUT_DEVICE   HID_LAYOUT_IT
+
+// hid_layout_key_t.flags
+#define HID_LAYOUT_F_DEAD   0x01    // tasto morto: il carattere esce solo con uno SPAZIO dopo
+
+typedef struct {
+    uint8_t modifier;
+    uint8_t key;                // 0: carattere non disponibile nel layout
+    uint8_t flags;
+} hid_layout_key_t;
+
+// NULL se il carattere non si puo' digitare con il layout
+const hid_layout_key_t* hid_layout_lookup(uint8_t layout, uint32_t codepoint);
+const char* hid_layout_name(uint8_t layout);
+// Layout effettivo: HID_LAYOUT_DEFAULT e valori sconosciuti diventano HID_LAYOUT_DEVICE
+uint8_t hid_layout_resolve(uint8_t layout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
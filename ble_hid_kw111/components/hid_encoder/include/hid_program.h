@@ -0,0 +1,92 @@
+#pragma once
+#ifndef HID_PROGRAM_H
+#define HID_PROGRAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "user_list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Programmi di tasti precompilati.
+La password decifrata (UTF-8 + placeholder) e i flag winlogin/sendEnter vengono
+tradotti una sola volta in una lista di op (modifier, key, pausa); i trasporti
+eseguono la lista senza riconvertire i caratteri. I programmi degli account usati
+di recente restano in RAM cifrati (AES-CTR, chiave casuale per ogni avvio) e
+vengono invalidati da userdb_edit/remove/clear/load.
+*/
+
+// Password (due op per carattere con i tasti morti) + CTRL+ALT+DEL, pausa e ENTER aggiunti dai flag
+#define HID_PROGRAM_MAX_OPS     (2 * MAX_PASSWORD_LEN + 4)
+#define HID_PROGRAM_CACHE_SIZE  4
+#define HID_OP_DELAY_UNIT_MS    10
+
+// hid_op_t.flags
+#define HID_OP_ALONE    0x01    // tasto da solo: rilascia gli altri prima e dopo (combinazioni, placeholder)
+#define HID_OP_SLEEP    0x02    // placeholder deep sleep, eseguito dal trasporto
+#define HID_OP_ALT_CODE 0x04    // carattere fuori layout: ALT + codice sul tastierino (vedi hid_op_codepoint)
+#define HID_OP_HEX_CODE 0x08    // carattere fuori layout: CTRL+SHIFT+U, codice esadecimale, SPAZIO
+
+// Caratteri assenti dal layout dell'account (user_entry_t.fallback)
+typedef enum {
+    HID_FALLBACK_SKIP = 0,      // carattere ignorato
+    HID_FALLBACK_ALT_CODE,      // Windows: ALT+0nnn (cp1252) o ALT+codepoint decimale
+    HID_FALLBACK_HEX_CODE,      // Linux (IBus/GTK): CTRL+SHIFT+U, codepoint esadecimale, SPAZIO
+    HID_FALLBACK_REJECT,        // password rifiutata alla registrazione (e al login)
+    HID_FALLBACK_NB,
+} hid_fallback_t;
+
+typedef struct {
+    uint8_t modifier;
+    uint8_t key;                // 0: nessun tasto, solo pausa/azione
+    uint8_t flags;
+    uint8_t delay;              // pausa dopo il tasto (unita' HID_OP_DELAY_UNIT_MS), i tasti vengono rilasciati prima
+} hid_op_t;
+
+// HID_OP_ALT_CODE/HID_OP_HEX_CODE: il codepoint (21 bit) occupa modifier, key e delay
+static inline uint32_t hid_op_codepoint(const hid_op_t* op) {
+    return op->modifier | ((uint32_t)op->key << 8) | ((uint32_t)op->delay << 16);
+}
+
+typedef struct {
+    hid_op_t ops[HID_PROGRAM_MAX_OPS];
+    uint8_t count;
+    uint8_t layout;             // layout usato per compilare (cifre esadecimali di HID_OP_HEX_CODE)
+} hid_program_t;
+
+typedef struct {
+    uint32_t hits;              // login serviti dalla cache
+    uint32_t misses;            // login che hanno richiesto decifratura + compilazione
+    uint32_t last_compile_us;   // userdb_get + decrypt + compile dell'ultimo miss
+    uint32_t max_compile_us;
+    uint32_t last_load_us;      // tempo totale dell'ultimo hid_program_load
+} hid_program_stats_t;
+
+void hid_program_init(hid_program_t* prog);
+void hid_program_wipe(hid_program_t* prog);
+
+esp_err_t hid_program_add_key(hid_program_t* prog, uint8_t modifiers, uint8_t key);
+esp_err_t hid_program_add_delay(hid_program_t* prog, uint16_t delay_ms);
+// Compila quanto piu' testo possibile, ritorna i byte consumati (si ferma a fine carattere).
+// layout: hid_layout_id_t (HID_LAYOUT_DEFAULT: quello del dispositivo), fallback: hid_fallback_t
+size_t hid_program_add_text(hid_program_t* prog, const char* text, uint8_t layout, uint8_t fallback);
+// ESP_ERR_NOT_SUPPORTED: carattere fuori layout con HID_FALLBACK_REJECT
+esp_err_t hid_program_compile(const char* password, bool winlogin, bool send_enter,
+                              uint8_t layout, uint8_t fallback, hid_program_t* out);
+
+// Programma di login dell'account (cache o userdb_get + decifratura + compilazione)
+esp_err_t hid_program_load(int index, hid_program_t* out);
+void hid_program_invalidate(int index);     // -1: tutti (indici spostati o DB ricaricato)
+
+void hid_program_stats_get(hid_program_stats_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,148 +1,1125 @@
 #include <string.h>
+#include <stdlib.h>
 #include <stdio.h>
+#include <stddef.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 #include "esp_system.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_hmac.h"
+#include "esp_timer.h"
+#include "esp_random.h"
 #include "mbedtls/aes.h"
+#include "mbedtls/gcm.h"
 
 #include "hid_device_prf.h"
+#include "hid_device_ble.h"
+#include "hid_program.h"
+#include "hid_layout.h"
 #include "user_list.h"
 #include "display_oled.h"
 #include "buzzer.h"
 
 
-user_entry_t user_list[MAX_USERS];  // Lista degli account
 size_t user_count = 0;              // Numero totale degli account memorizzati
 int user_index = -1;                // Indice dell'account attualmente selezionato
 
 #define NVS_NAMESPACE "userdb"
-#define NVS_KEY "users"
+#define NVS_KEY "users"          // Layout precedente: tutto l'array in un unico blob
+#define NVS_INDEX_KEY "index"
+#define NVS_REVISION_KEY "rev"
+#define NVS_REINDEX_KEY "reindex_rev"
+#define NVS_EPOCH_KEY "epoch"
 #define AES_BLOCK_SIZE 16
 uint8_t decrypt_key[16];
 
 static const char *TAG = "USER_DB";
 
+#if USERDB_STATS
+static userdb_op_stats_t s_stats[USERDB_OP_NB];
+static const char *s_op_names[USERDB_OP_NB] = {
+    "load", "save", "add", "edit", "remove", "increment_usage", "sort_by_usage", "flush", "encrypt", "decrypt"
+};
+
+// Operations currently running on the call path of each task (e.g. add -> save
+// -> load): flash writes are charged to every enclosing operation of the task
+// that writes. Logins, the GATT handler and the flush task update the counters
+// concurrently, so everything here is taken under s_stats_mux.
+#define STATS_MAX_DEPTH 4
+#define STATS_MAX_TASKS 6
+typedef struct {
+    TaskHandle_t task;                 // NULL: slot libero
+    int depth;
+    userdb_op_t ops[STATS_MAX_DEPTH];
+} stats_path_t;
+static stats_path_t s_stats_paths[STATS_MAX_TASKS];
+static portMUX_TYPE s_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Call path of the running task, with s_stats_mux held (NULL: table full)
+static stats_path_t* stats_path(bool create) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    stats_path_t* free_slot = NULL;
+    for (int i = 0; i < STATS_MAX_TASKS; ++i) {
+        if (s_stats_paths[i].task == self)
+            return &s_stats_paths[i];
+        if (s_stats_paths[i].task == NULL && free_slot == NULL)
+            free_slot = &s_stats_paths[i];
+    }
+    if (create && free_slot != NULL) {
+        free_slot->task = self;
+        free_slot->depth = 0;
+    }
+    return create ? free_slot : NULL;
+}
+
+static int64_t stats_begin(userdb_op_t op) {
+    portENTER_CRITICAL(&s_stats_mux);
+    stats_path_t* path = stats_path(true);
+    if (path != NULL) {
+        if (path->depth < STATS_MAX_DEPTH)
+            path->ops[path->depth] = op;
+        path->depth++;
+    }
+    portEXIT_CRITICAL(&s_stats_mux);
+    return esp_timer_get_time();
+}
+
+static void stats_end(userdb_op_t op, int64_t start) {
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+    // On ESP-IDF the high water mark is already expressed in bytes
+    uint32_t free_stack = uxTaskGetStackHighWaterMark(NULL);
+
+    portENTER_CRITICAL(&s_stats_mux);
+    userdb_op_stats_t *st = &s_stats[op];
+    st->calls++;
+    st->total_us += elapsed;
+    if (elapsed > st->max_us)
+        st->max_us = elapsed;
+    if (st->min_free_stack == 0 || free_stack < st->min_free_stack)
+        st->min_free_stack = free_stack;
+    stats_path_t* path = stats_path(false);
+    if (path != NULL && --path->depth <= 0)
+        path->task = NULL;
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+static void stats_flash(size_t bytes) {
+    portENTER_CRITICAL(&s_stats_mux);
+    stats_path_t* path = stats_path(false);
+    for (int i = 0; path != NULL && i < path->depth && i < STATS_MAX_DEPTH; ++i)
+        s_stats[path->ops[i]].flash_bytes += bytes;
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+static void stats_commit() {
+    portENTER_CRITICAL(&s_stats_mux);
+    stats_path_t* path = stats_path(false);
+    for (int i = 0; path != NULL && i < path->depth && i < STATS_MAX_DEPTH; ++i)
+        s_stats[path->ops[i]].commits++;
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+#define STATS_BEGIN(op)  int64_t _stats_start = stats_begin(op)
+#define STATS_END(op)    stats_end(op, _stats_start)
+#else
+#define STATS_BEGIN(op)
+#define STATS_END(op)
+#define stats_flash(bytes)
+#define stats_commit()
+#endif
+
+// NVS write helpers: every byte written to flash by the user DB goes through here
+static esp_err_t userdb_nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t len) {
+    stats_flash(len);
+    return nvs_set_blob(handle, key, value, len);
+}
+
+static esp_err_t userdb_nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value) {
+    stats_flash(sizeof(value));
+    return nvs_set_u32(handle, key, value);
+}
+
+static esp_err_t userdb_nvs_commit(nvs_handle_t handle) {
+    stats_commit();
+    return nvs_commit(handle);
+}
+
 // Derives a secure 128-bit key from eFuse HMAC_KEY0
 esp_err_t get_device_key_hmac(uint8_t out_key[16]) {
     const char* context = "userdb-password-key";
-    return esp_hmac_calculate(HMAC_KEY0, (const uint8_t*)context, strlen(context), out_key);
+    uint8_t hmac[32];                  // HMAC-SHA256: the key is the first half
+    esp_err_t err = esp_hmac_calculate(HMAC_KEY0, (const uint8_t*)context, strlen(context), hmac);
+    if (err == ESP_OK)
+        memcpy(out_key, hmac, 16);
+    memset(hmac, 0, sizeof(hmac));
+    return err;
 }
 
+// Cipher contexts keyed once from decrypt_key and reused by every password
+// operation (logins, GATT listing, edits) until userdb_crypto_wipe().
+// With CONFIG_MBEDTLS_HARDWARE_AES/GCM mbedTLS runs them on the AES peripheral.
+static mbedtls_gcm_context s_gcm;
+static mbedtls_aes_context s_aes_dec;  // Only to read back the old CBC records
+static bool s_aes_ready = false;
+
+// Guards the contexts and s_aes_ready: logins, the GATT tasks and the typing
+// tasks all encrypt/decrypt, and any of them may run before userdb_load().
+// Taken after DB_LOCK when both are needed, never the other way round.
+static SemaphoreHandle_t s_crypto_lock = NULL;
+
+static void userdb_crypto_lock() {
+    if (s_crypto_lock == NULL) {
+        // First use: two tasks may get here together, only one mutex survives
+        static portMUX_TYPE create_mux = portMUX_INITIALIZER_UNLOCKED;
+        SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+        portENTER_CRITICAL(&create_mux);
+        if (s_crypto_lock == NULL) {
+            s_crypto_lock = lock;
+            lock = NULL;
+        }
+        portEXIT_CRITICAL(&create_mux);
+        if (lock)
+            vSemaphoreDelete(lock);
+    }
+    xSemaphoreTake(s_crypto_lock, portMAX_DELAY);
+}
+
+static void userdb_crypto_unlock() {
+    xSemaphoreGive(s_crypto_lock);
+}
+
+// Keys the contexts on first use; call with the crypto lock held
+static bool userdb_crypto_init_locked() {
+    if (s_aes_ready)
+        return true;
+    if (get_device_key_hmac(decrypt_key) != ESP_OK) {
+        ESP_LOGE(TAG, "Error getting decrypt key");
+        return false;
+    }
+    mbedtls_gcm_init(&s_gcm);
+    mbedtls_aes_init(&s_aes_dec);
+    if (mbedtls_gcm_setkey(&s_gcm, MBEDTLS_CIPHER_ID_AES, decrypt_key, 128) != 0 ||
+        mbedtls_aes_setkey_dec(&s_aes_dec, decrypt_key, 128) != 0) {
+        ESP_LOGE(TAG, "Error setting AES key");
+        mbedtls_gcm_free(&s_gcm);
+        mbedtls_aes_free(&s_aes_dec);
+        return false;
+    }
+    s_aes_ready = true;
+    return true;
+}
+
+static bool userdb_crypto_init() {
+    userdb_crypto_lock();
+    bool ready = userdb_crypto_init_locked();
+    userdb_crypto_unlock();
+    return ready;
+}
+
+void userdb_crypto_wipe() {
+    userdb_crypto_lock();
+    if (s_aes_ready) {
+        mbedtls_gcm_free(&s_gcm);       // mbedTLS zeroizes the key schedules on free
+        mbedtls_aes_free(&s_aes_dec);
+        s_aes_ready = false;
+    }
+    memset(decrypt_key, 0, sizeof(decrypt_key));
+    userdb_crypto_unlock();
+}
+
+// Encrypted password: nonce (12 byte, random per encryption) | tag (16 byte) | ciphertext
 int userdb_encrypt_password(const char* plain, uint8_t* out_encrypted) {
-    size_t len = strlen(plain);
-    size_t padded_len = ((len + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE) * AES_BLOCK_SIZE;
-    if (padded_len > MAX_PASSWORD_LEN) 
+    size_t len = strnlen(plain, MAX_PASSWORD_LEN);
+    userdb_crypto_lock();
+    if (!userdb_crypto_init_locked()) {
+        userdb_crypto_unlock();
         return -1;
+    }
 
-    uint8_t iv[16] = {0};  // Static IV; for more security it can be randomized
-    uint8_t input[128] = {0};
-    memcpy(input, plain, len);  // padding with 0 (you can use PKCS#7 if you prefer)
-    mbedtls_aes_context aes;
-    mbedtls_aes_init(&aes);
-    mbedtls_aes_setkey_enc(&aes, decrypt_key, 128);
-    mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_ENCRYPT, padded_len, iv, input, out_encrypted);
-    mbedtls_aes_free(&aes);
-    return padded_len;
+    STATS_BEGIN(USERDB_OP_ENCRYPT);
+    uint8_t* nonce = out_encrypted;
+    uint8_t* tag = out_encrypted + USERDB_GCM_NONCE_LEN;
+    uint8_t* cipher = tag + USERDB_GCM_TAG_LEN;
+    esp_fill_random(nonce, USERDB_GCM_NONCE_LEN);
+    int ret = mbedtls_gcm_crypt_and_tag(&s_gcm, MBEDTLS_GCM_ENCRYPT, len, nonce, USERDB_GCM_NONCE_LEN,
+                                        NULL, 0, (const uint8_t*)plain, cipher, USERDB_GCM_TAG_LEN, tag);
+    STATS_END(USERDB_OP_ENCRYPT);
+    userdb_crypto_unlock();
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Password encryption failed (%d)", ret);
+        return -1;
+    }
+    return USERDB_GCM_NONCE_LEN + USERDB_GCM_TAG_LEN + len;
 }
 
 int userdb_decrypt_password(const uint8_t* encrypted, size_t len, char* out_plain) {
-    if (len % AES_BLOCK_SIZE != 0 || len > MAX_PASSWORD_LEN) 
+    if (len < USERDB_GCM_NONCE_LEN + USERDB_GCM_TAG_LEN || len > USERDB_PASSWORD_ENC_LEN)
+        return -1;
+    userdb_crypto_lock();
+    if (!userdb_crypto_init_locked()) {
+        userdb_crypto_unlock();
+        return -1;
+    }
+    STATS_BEGIN(USERDB_OP_DECRYPT);
+    const uint8_t* nonce = encrypted;
+    const uint8_t* tag = encrypted + USERDB_GCM_NONCE_LEN;
+    const uint8_t* cipher = tag + USERDB_GCM_TAG_LEN;
+    size_t plain_len = len - USERDB_GCM_NONCE_LEN - USERDB_GCM_TAG_LEN;
+    int ret = mbedtls_gcm_auth_decrypt(&s_gcm, plain_len, nonce, USERDB_GCM_NONCE_LEN, NULL, 0,
+                                       tag, USERDB_GCM_TAG_LEN, cipher, (uint8_t*)out_plain);
+    STATS_END(USERDB_OP_DECRYPT);
+    userdb_crypto_unlock();
+    if (ret != 0) {
+        // mbedTLS has already wiped the output
+        ESP_LOGE(TAG, "Password authentication failed (%d)", ret);
+        out_plain[0] = '\0';
+        return -1;
+    }
+    out_plain[plain_len] = '\0';
+    return 0;
+}
+
+// Decrypts a password of the old format (AES-128-CBC, zero IV, zero padding)
+static int userdb_decrypt_cbc(const uint8_t* encrypted, size_t len, char* out_plain) {
+    if (len % AES_BLOCK_SIZE != 0 || len > MAX_PASSWORD_LEN)
+        return -1;
+    userdb_crypto_lock();
+    if (!userdb_crypto_init_locked()) {
+        userdb_crypto_unlock();
         return -1;
+    }
     uint8_t iv[16] = {0};
-    uint8_t output[128] = {0};
-    mbedtls_aes_context aes;
-    mbedtls_aes_init(&aes);
-    mbedtls_aes_setkey_dec(&aes, decrypt_key, 128);
-    mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_DECRYPT, len, iv, encrypted, output);
-    mbedtls_aes_free(&aes);
+    uint8_t output[MAX_PASSWORD_LEN] = {0};
+    mbedtls_aes_crypt_cbc(&s_aes_dec, MBEDTLS_AES_DECRYPT, len, iv, encrypted, output);
+    userdb_crypto_unlock();
     memcpy(out_plain, output, len);
     out_plain[len] = '\0';
+    memset(output, 0, sizeof(output));
     return 0;
 }
 
+void user_print(user_entry_t* user) {
+    printf("     User: %s\n", user->label);
+    #if DEBUG_PASSWD
+    printf("     Password (hex): ");
+    for (size_t j = 0; j < user->password_len; ++j) {
+        printf("%02X ", user->password_enc[j]);
+    }
+    printf("\n");
+    #endif
+    printf("     Usage count: %lu\n", (unsigned long)user->usage_count);
+    printf("     Fingerprint ID: %02d\n", user->fingerprint_id);
+    printf("     MagicFinder: %s\n", user->magicfinger ? "enabled" : "disabled");
+    printf("     Winlogin: %s\n", user->winlogin ? "enabled" : "disabled");
+    printf("     Send ENTER: %s\n", user->sendEnter ? "enabled" : "disabled");
+    printf("     Login type: %d\n", user->login_type);
+    printf("     Layout: %s%s\n", hid_layout_name(user->layout), user->layout == HID_LAYOUT_DEFAULT ? " (device)" : "");
+    printf("     Fallback: %d\n", user->fallback);
+}
 
-void user_print(user_entry_t* user) {    
-    for (size_t i = 0; i < user_count; ++i) {
-        printf(" [%d] User: %s\n", (int)i, user->label);
-        #if DEBUG_PASSWD
-        printf("     Password (hex): ");
-        for (size_t j = 0; j < user->password_len; ++j) {
-            printf("%02X ", user->password_enc[j]);
+// NVS layout: one blob per record ("u00".."u249", keyed by a stable slot) plus a
+// small index record with the list order, so a change only rewrites what it touches
+typedef struct {
+    uint8_t version;
+    uint8_t count;
+    uint8_t slot[MAX_USERS];           // slot NVS del record in posizione i
+} userdb_index_t;
+
+#define USERDB_INDEX_VERSION 1
+
+// Resident directory: the few fields the ranking, the fingerprint login and the
+// USB check need, so that RAM doesn't grow with the size of the full records
+#define USERDB_DIR_MAGICFINGER  0x01
+
+typedef struct {
+    uint32_t usage_count;              // fonte di verita' per il contatore (vedi write-back)
+    uint32_t revision;                 // delta sync senza leggere i record dalla flash
+    uint8_t slot;                      // il record e' salvato nella chiave "u<slot>"
+    uint8_t fingerprint_id;
+    uint8_t flags;                     // USERDB_DIR_*
+    uint8_t login_type;
+    char key[USERDB_LABEL_KEY_LEN];    // inizio della label in minuscolo (ordinamento e ricerca)
+} userdb_dir_t;
+
+static userdb_dir_t user_dir[MAX_USERS];
+
+// Delta sync revisions (saved as NVS_REVISION_KEY / NVS_REINDEX_KEY)
+static uint32_t s_db_revision = 0;
+static uint32_t s_reindex_revision = 0;
+static uint32_t s_db_epoch = 0;        // NVS_EPOCH_KEY, casuale: nuovo a ogni DB creato o cancellato
+
+// Usage ranking: records never move on a login, only these 1-byte indices do
+static uint8_t user_rank[MAX_USERS];   // user_rank[r] = indice dell'r-esimo account piu' usato
+static uint8_t rank_of[MAX_USERS];     // inverso di user_rank
+
+// Fingerprint login: template id -> first account with magicfinger on that template
+#define USERDB_NO_USER  0xFF
+static uint8_t s_finger_map[USERDB_FINGER_IDS];
+
+// Alphabetical order of the labels, by the resident key (ties: list order)
+static uint8_t s_alpha[MAX_USERS];     // s_alpha[p] = indice dell'account in posizione p
+static uint8_t alpha_of[MAX_USERS];    // inverso di s_alpha
+
+// Full records are read from flash on demand and kept in a small LRU cache
+typedef struct {
+    int16_t slot;                      // -1: libero
+    uint32_t last_use;
+    user_entry_t entry;
+} userdb_cache_t;
+
+static userdb_cache_t s_cache[USERDB_CACHE_SIZE];
+static uint32_t s_cache_clock = 0;
+static uint32_t s_cache_hits = 0;
+static uint32_t s_cache_misses = 0;
+
+// Usage counters are bumped in RAM on login and written back by
+// userdb_flush_task (too many bumps pending, or idle timeout) or by
+// userdb_flush(). The login never waits for an NVS commit.
+#define USERDB_NOTIFY_BUMP   (1U << 0)  // new bump: restart the idle timeout
+#define USERDB_NOTIFY_FLUSH  (1U << 1)  // USERDB_USAGE_FLUSH_PENDING reached: write now
+
+static SemaphoreHandle_t s_db_lock = NULL;
+static TaskHandle_t s_flush_task = NULL;
+static uint8_t s_dirty_slots[(MAX_USERS + 7) / 8];  // bit n: record "u<n>" has an unsaved usage count
+static uint32_t s_pending_usage = 0;   // usage bumps not yet on flash
+
+#define DIRTY_SET(slot)   (s_dirty_slots[(slot) / 8] |= (uint8_t)(1U << ((slot) % 8)))
+#define DIRTY_CLEAR(slot) (s_dirty_slots[(slot) / 8] &= (uint8_t)~(1U << ((slot) % 8)))
+#define DIRTY_TEST(slot)  (s_dirty_slots[(slot) / 8] & (1U << ((slot) % 8)))
+
+#define DB_LOCK()   do { if (s_db_lock) xSemaphoreTakeRecursive(s_db_lock, portMAX_DELAY); } while (0)
+#define DB_UNLOCK() do { if (s_db_lock) xSemaphoreGiveRecursive(s_db_lock); } while (0)
+
+// Partition holding the user DB: USERDB_PARTITION, or the default NVS
+// partition when the flashed partition table doesn't have it yet
+static bool s_own_partition = false;
+
+static esp_err_t userdb_open(nvs_open_mode_t mode, nvs_handle_t *handle) {
+    const char *part = s_own_partition ? USERDB_PARTITION : NVS_DEFAULT_PART_NAME;
+    return nvs_open_from_partition(part, NVS_NAMESPACE, mode, handle);
+}
+
+static void userdb_record_key(uint8_t slot, char key[8]) {
+    snprintf(key, 8, "u%02u", slot);
+}
+
+// Raw struct layouts dumped to NVS by older firmware: before AES-GCM (CBC
+// password in a 48 byte field) and after it, up to the packed format below
+typedef struct {
+    char label[MAX_LABEL_LEN];
+    uint8_t password_enc[MAX_PASSWORD_LEN + 16];
+    size_t password_len;
+    uint32_t usage_count;
+    uint8_t fingerprint_id;
+    bool magicfinger;
+    bool winlogin;
+    bool sendEnter;
+    uint8_t login_type;
+} user_entry_cbc_t;
+
+typedef struct {
+    char label[MAX_LABEL_LEN];
+    uint8_t password_enc[USERDB_PASSWORD_ENC_LEN];
+    size_t password_len;
+    uint32_t usage_count;
+    uint8_t fingerprint_id;
+    bool magicfinger;
+    bool winlogin;
+    bool sendEnter;
+    uint8_t login_type;
+} user_entry_raw_t;
+
+// Packed record (integers little endian):
+//   0  magic 0xA5 (never the first byte of a UTF-8 label: raw records are told apart)
+//   1  version
+//   2  flags (USERDB_REC_F_*)
+//   3  login_type
+//   4  fingerprint_id
+//   5  usage_count (u32)
+//   9  label length, label (no terminator)
+//   .. password length, password_enc
+//   .. layout (v2, hid_layout_id_t)
+//   .. fallback (v3, hid_fallback_t)
+//   .. revision (v4, u32)
+// New versions only append fields: older readers ignore the tail and newer
+// readers leave the fields missing from an old record at their default.
+#define USERDB_RECORD_MAGIC     0xA5
+#define USERDB_RECORD_VERSION   4
+#define USERDB_RECORD_MAX       (9 + 1 + MAX_LABEL_LEN + 1 + USERDB_PASSWORD_ENC_LEN + 2 + 4)
+
+#define USERDB_REC_F_MAGICFINGER  0x01
+#define USERDB_REC_F_WINLOGIN     0x02
+#define USERDB_REC_F_SENDENTER    0x04
+
+typedef enum {
+    USERDB_REC_PACKED,
+    USERDB_REC_RAW,                    // raw struct, GCM password
+    USERDB_REC_RAW_CBC,                // raw struct, CBC password
+} userdb_rec_fmt_t;
+
+static size_t userdb_pack(const user_entry_t* entry, uint8_t* out) {
+    size_t n = 0;
+    size_t label_len = strnlen(entry->label, MAX_LABEL_LEN);
+    size_t pwd_len = entry->password_len <= USERDB_PASSWORD_ENC_LEN ? entry->password_len : 0;
+
+    out[n++] = USERDB_RECORD_MAGIC;
+    out[n++] = USERDB_RECORD_VERSION;
+    out[n++] = (entry->magicfinger ? USERDB_REC_F_MAGICFINGER : 0) |
+               (entry->winlogin ? USERDB_REC_F_WINLOGIN : 0) |
+               (entry->sendEnter ? USERDB_REC_F_SENDENTER : 0);
+    out[n++] = entry->login_type;
+    out[n++] = entry->fingerprint_id;
+    for (int i = 0; i < 4; ++i)
+        out[n++] = (uint8_t)(entry->usage_count >> (8 * i));
+    out[n++] = label_len;
+    memcpy(&out[n], entry->label, label_len);
+    n += label_len;
+    out[n++] = pwd_len;
+    memcpy(&out[n], entry->password_enc, pwd_len);
+    n += pwd_len;
+    out[n++] = entry->layout;
+    out[n++] = entry->fallback;
+    for (int i = 0; i < 4; ++i)
+        out[n++] = (uint8_t)(entry->revision >> (8 * i));
+    return n;
+}
+
+static esp_err_t userdb_unpack(const uint8_t* in, size_t len, user_entry_t* out) {
+    size_t n = 9;
+    if (len < n + 2 || in[0] != USERDB_RECORD_MAGIC || in[1] == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(out, 0, sizeof(*out));
+    out->magicfinger = in[2] & USERDB_REC_F_MAGICFINGER;
+    out->winlogin = in[2] & USERDB_REC_F_WINLOGIN;
+    out->sendEnter = in[2] & USERDB_REC_F_SENDENTER;
+    out->login_type = in[3];
+    out->fingerprint_id = in[4];
+    out->usage_count = in[5] | (in[6] << 8) | (in[7] << 16) | ((uint32_t)in[8] << 24);
+
+    size_t label_len = in[n++];
+    if (label_len > MAX_LABEL_LEN || n + label_len + 1 > len)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(out->label, &in[n], label_len);
+    n += label_len;
+
+    size_t pwd_len = in[n++];
+    if (pwd_len > USERDB_PASSWORD_ENC_LEN || n + pwd_len > len)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(out->password_enc, &in[n], pwd_len);
+    out->password_len = pwd_len;
+    n += pwd_len;
+
+    // v2: layout, v3: fallback, v4: revision (default for older records and unknown values)
+    if (n < len && in[n] < HID_LAYOUT_NB)
+        out->layout = in[n];
+    n++;
+    if (n < len && in[n] < HID_FALLBACK_NB)
+        out->fallback = in[n];
+    n++;
+    if (n + 4 <= len)
+        out->revision = in[n] | (in[n + 1] << 8) | (in[n + 2] << 16) | ((uint32_t)in[n + 3] << 24);
+    return ESP_OK;
+}
+
+#define USERDB_FROM_RAW(old, out) do {                                    \
+        memset((out), 0, sizeof(*(out)));                                 \
+        memcpy((out)->label, (old)->label, MAX_LABEL_LEN);                \
+        memcpy((out)->password_enc, (old)->password_enc, sizeof((old)->password_enc)); \
+        (out)->password_len = (old)->password_len;                        \
+        (out)->usage_count = (old)->usage_count;                          \
+        (out)->fingerprint_id = (old)->fingerprint_id;                    \
+        (out)->magicfinger = (old)->magicfinger;                          \
+        (out)->winlogin = (old)->winlogin;                                \
+        (out)->sendEnter = (old)->sendEnter;                              \
+        (out)->login_type = (old)->login_type;                            \
+    } while (0)
+
+// Re-encrypts the CBC password of a converted old record with AES-GCM
+static int userdb_upgrade_password(user_entry_t* entry) {
+    char plain[MAX_PASSWORD_LEN + 1];
+    if (userdb_decrypt_cbc(entry->password_enc, entry->password_len, plain) != 0)
+        return -1;
+    int len = userdb_encrypt_password(plain, entry->password_enc);
+    memset(plain, 0, sizeof(plain));
+    if (len < 0)
+        return -1;
+    entry->password_len = len;
+    return 0;
+}
+
+// Reads record "u<slot>" in any of the formats above. *fmt tells the caller
+// whether the record should be rewritten (and a CBC password upgraded first)
+static esp_err_t userdb_read_record(nvs_handle_t handle, uint8_t slot, user_entry_t* out, userdb_rec_fmt_t* fmt) {
+    char key[8];
+    union {
+        uint8_t packed[USERDB_RECORD_MAX];
+        user_entry_raw_t raw;
+        user_entry_cbc_t cbc;
+    } buf;
+    size_t size = sizeof(buf);
+    userdb_rec_fmt_t found = USERDB_REC_PACKED;
+    userdb_record_key(slot, key);
+    esp_err_t err = nvs_get_blob(handle, key, &buf, &size);
+    if (err == ESP_OK) {
+        if (size > 0 && buf.packed[0] == USERDB_RECORD_MAGIC) {
+            err = userdb_unpack(buf.packed, size, out);
+        } else if (size == sizeof(user_entry_raw_t)) {
+            USERDB_FROM_RAW(&buf.raw, out);
+            found = USERDB_REC_RAW;
+        } else if (size == sizeof(user_entry_cbc_t)) {
+            USERDB_FROM_RAW(&buf.cbc, out);
+            found = USERDB_REC_RAW_CBC;
+        } else {
+            err = ESP_ERR_INVALID_SIZE;
         }
-        printf("\n");
-        #endif
-        printf("     Usage count: %lu\n", user->usage_count);
-        printf("     Fingerprint ID: %02d\n", user->fingerprint_id);
-        printf("     MagicFinder: %s\n", user->magicfinger ? "enabled" : "disabled");
-        printf("     Winlogin: %s\n", user->winlogin ? "enabled" : "disabled");
-        printf("     Send ENTER: %s\n", user->sendEnter ? "enabled" : "disabled");
-        printf("     Login type: %d\n", user->login_type);
     }
+    if (fmt)
+        *fmt = found;
+    memset(&buf, 0, sizeof(buf));
+    return err;
 }
 
-void userdb_dump() {
-    printf("=== USER LIST (%d users) ===\n", (int)user_count);
-    for (size_t i = 0; i < user_count; ++i) {
-        user_print(&user_list[i]);
+static esp_err_t userdb_write_record(nvs_handle_t handle, uint8_t slot, const user_entry_t* entry) {
+    char key[8];
+    uint8_t packed[USERDB_RECORD_MAX];
+    size_t len = userdb_pack(entry, packed);
+    userdb_record_key(slot, key);
+    esp_err_t err = userdb_nvs_set_blob(handle, key, packed, len);
+    memset(packed, 0, sizeof(packed));
+    return err;
+}
+
+static esp_err_t userdb_write_index(nvs_handle_t handle) {
+    userdb_index_t idx = {0};
+    idx.version = USERDB_INDEX_VERSION;
+    idx.count = user_count;
+    for (size_t i = 0; i < user_count; ++i)
+        idx.slot[i] = user_dir[i].slot;
+    return userdb_nvs_set_blob(handle, NVS_INDEX_KEY, &idx, offsetof(userdb_index_t, slot) + user_count);
+}
+
+// Case folding used by the label index (ASCII only, UTF-8 bytes are kept)
+static char userdb_fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+static void userdb_dir_set(size_t index, const user_entry_t* entry) {
+    user_dir[index].usage_count = entry->usage_count;
+    user_dir[index].revision = entry->revision;
+    user_dir[index].fingerprint_id = entry->fingerprint_id;
+    user_dir[index].flags = entry->magicfinger ? USERDB_DIR_MAGICFINGER : 0;
+    user_dir[index].login_type = entry->login_type;
+    memset(user_dir[index].key, 0, USERDB_LABEL_KEY_LEN);
+    for (size_t i = 0; i < USERDB_LABEL_KEY_LEN && i < MAX_LABEL_LEN && entry->label[i]; ++i)
+        user_dir[index].key[i] = userdb_fold(entry->label[i]);
+}
+
+static int userdb_alpha_cmp(const void* a, const void* b) {
+    uint8_t ia = *(const uint8_t*)a, ib = *(const uint8_t*)b;
+    int c = memcmp(user_dir[ia].key, user_dir[ib].key, USERDB_LABEL_KEY_LEN);
+    return c ? c : (int)ia - (int)ib;
+}
+
+// Rebuilds the alphabetical order (after a load, add, edit or remove)
+static void userdb_alpha_rebuild() {
+    for (size_t i = 0; i < user_count; ++i)
+        s_alpha[i] = i;
+    qsort(s_alpha, user_count, sizeof(s_alpha[0]), userdb_alpha_cmp);
+    for (size_t p = 0; p < user_count; ++p)
+        alpha_of[s_alpha[p]] = p;
+}
+
+// Rebuilds s_finger_map from the directory (after a load, edit or remove)
+static void userdb_finger_map_rebuild() {
+    memset(s_finger_map, USERDB_NO_USER, sizeof(s_finger_map));
+    for (size_t i = user_count; i-- > 0; ) {
+        if (user_dir[i].flags & USERDB_DIR_MAGICFINGER)
+            s_finger_map[user_dir[i].fingerprint_id] = i;
+    }
+}
+
+// First slot not used by any record
+static uint8_t userdb_free_slot() {
+    bool used[MAX_USERS] = {false};
+    for (size_t i = 0; i < user_count; ++i)
+        used[user_dir[i].slot] = true;
+    uint8_t slot = 0;
+    while (slot < MAX_USERS && used[slot])
+        slot++;
+    return slot;
+}
+
+static void userdb_cache_reset() {
+    for (int i = 0; i < USERDB_CACHE_SIZE; ++i) {
+        s_cache[i].slot = -1;
+        memset(&s_cache[i].entry, 0, sizeof(user_entry_t));
+    }
+}
+
+static userdb_cache_t* userdb_cache_find(uint8_t slot) {
+    for (int i = 0; i < USERDB_CACHE_SIZE; ++i) {
+        if (s_cache[i].slot == slot)
+            return &s_cache[i];
+    }
+    return NULL;
+}
+
+// Stores a record in the cache, evicting the least recently used one
+static userdb_cache_t* userdb_cache_put(uint8_t slot, const user_entry_t* entry) {
+    userdb_cache_t* c = userdb_cache_find(slot);
+    if (c == NULL) {
+        c = &s_cache[0];
+        for (int i = 0; i < USERDB_CACHE_SIZE; ++i) {
+            if (s_cache[i].slot == -1) {
+                c = &s_cache[i];
+                break;
+            }
+            if (s_cache[i].last_use < c->last_use)
+                c = &s_cache[i];
+        }
+    }
+    c->slot = slot;
+    c->last_use = ++s_cache_clock;
+    c->entry = *entry;
+    return c;
+}
+
+static void userdb_cache_drop(uint8_t slot) {
+    userdb_cache_t* c = userdb_cache_find(slot);
+    if (c) {
+        c->slot = -1;
+        memset(&c->entry, 0, sizeof(user_entry_t));
+    }
+}
+
+// Full record at position index, from the cache or from flash. The pointer is
+// valid until the next cache access: call with the DB lock held
+static user_entry_t* userdb_fetch(size_t index) {
+    uint8_t slot = user_dir[index].slot;
+    userdb_cache_t* c = userdb_cache_find(slot);
+    if (c) {
+        s_cache_hits++;
+        c->last_use = ++s_cache_clock;
+    } else {
+        s_cache_misses++;
+        user_entry_t entry;
+        userdb_rec_fmt_t fmt;
+        nvs_handle_t handle;
+        if (userdb_open(NVS_READWRITE, &handle) != ESP_OK)
+            return NULL;
+        esp_err_t err = userdb_read_record(handle, slot, &entry, &fmt);
+        if (err == ESP_OK && fmt == USERDB_REC_RAW_CBC && userdb_upgrade_password(&entry) != 0)
+            err = ESP_FAIL;
+        if (err == ESP_OK && fmt != USERDB_REC_PACKED) {
+            // First access to a record of an older firmware: rewrite it packed (and AES-GCM)
+            entry.usage_count = user_dir[index].usage_count;
+            userdb_write_record(handle, slot, &entry);
+            userdb_nvs_commit(handle);
+            DIRTY_CLEAR(slot);
+            ESP_LOGI(TAG, "Record u%02u migrated to the packed format", slot);
+        }
+        nvs_close(handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Error reading user %d", (int)index);
+            memset(&entry, 0, sizeof(entry));
+            return NULL;
+        }
+        c = userdb_cache_put(slot, &entry);
+        memset(&entry, 0, sizeof(entry));
+    }
+    c->entry.usage_count = user_dir[index].usage_count;
+    return &c->entry;
+}
+
+// Next DB revision; reindex: the positions of the records changed (remove, clear).
+// The caller saves it with userdb_write_revision in the same commit.
+static uint32_t userdb_bump_revision(bool reindex) {
+    s_db_revision++;
+    if (reindex)
+        s_reindex_revision = s_db_revision;
+    return s_db_revision;
+}
+
+static void userdb_write_revision(nvs_handle_t handle) {
+    userdb_nvs_set_u32(handle, NVS_REVISION_KEY, s_db_revision);
+    userdb_nvs_set_u32(handle, NVS_REINDEX_KEY, s_reindex_revision);
+}
+
+// New random epoch: revisions of another DB (flash erased, DB cleared) are
+// not comparable with ours even when the numbers match
+static void userdb_new_epoch(nvs_handle_t handle) {
+    do {
+        s_db_epoch = esp_random();
+    } while (s_db_epoch == 0);
+    userdb_nvs_set_u32(handle, NVS_EPOCH_KEY, s_db_epoch);
+}
+
+uint32_t userdb_revision() {
+    return s_db_revision;
+}
+
+uint32_t userdb_epoch() {
+    return s_db_epoch;
+}
+
+uint32_t userdb_reindex_revision() {
+    return s_reindex_revision;
+}
+
+// Writes a single record (and optionally the index) and commits
+static void userdb_save_entry(size_t index, const user_entry_t* entry, bool with_index) {
+    nvs_handle_t handle;
+    if (userdb_open(NVS_READWRITE, &handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Error saving user %d", (int)index);
+        return;
+    }
+    userdb_write_record(handle, user_dir[index].slot, entry);
+    if (with_index)
+        userdb_write_index(handle);
+    userdb_write_revision(handle);
+    userdb_nvs_commit(handle);
+    nvs_close(handle);
+}
+
+// Copies the user DB found in src into dst: the per-record layout of the default
+// NVS partition, or the legacy single "users" blob (+ "count"). src may be dst.
+static void userdb_import(nvs_handle_t dst, nvs_handle_t src) {
+    user_entry_t entry;
+    userdb_rec_fmt_t fmt;
+    userdb_index_t idx = {0};
+    size_t size = sizeof(idx);
+    size_t count = 0;
+
+    if (src != dst && nvs_get_blob(src, NVS_INDEX_KEY, &idx, &size) == ESP_OK) {
+        for (size_t i = 0; i < idx.count && i < MAX_USERS; ++i) {
+            if (idx.slot[i] >= MAX_USERS || userdb_read_record(src, idx.slot[i], &entry, &fmt) != ESP_OK)
+                continue;
+            if (fmt == USERDB_REC_RAW_CBC && userdb_upgrade_password(&entry) != 0)
+                ESP_LOGW(TAG, "Record u%02u: password not migrated", idx.slot[i]);
+            userdb_write_record(dst, idx.slot[i], &entry);
+            idx.slot[count++] = idx.slot[i];
+        }
+    } else if (nvs_get_blob(src, NVS_KEY, NULL, &size) == ESP_OK) {
+        uint8_t* blob = malloc(size);
+        uint32_t legacy_count = 0;
+        if (blob == NULL || nvs_get_blob(src, NVS_KEY, blob, &size) != ESP_OK) {
+            ESP_LOGE(TAG, "Error reading legacy users blob");
+            free(blob);
+            return;
+        }
+        nvs_get_u32(src, "count", &legacy_count);
+        for (size_t i = 0; i < legacy_count && i < size / sizeof(user_entry_cbc_t) && i < MAX_USERS; ++i) {
+            user_entry_cbc_t old;
+            memcpy(&old, blob + i * sizeof(user_entry_cbc_t), sizeof(old));
+            USERDB_FROM_RAW(&old, &entry);
+            memset(&old, 0, sizeof(old));
+            if (userdb_upgrade_password(&entry) != 0)
+                ESP_LOGW(TAG, "Record %d: password not migrated", (int)i);
+            userdb_write_record(dst, i, &entry);
+            idx.slot[count++] = i;
+        }
+        memset(blob, 0, size);
+        free(blob);
+    } else {
+        return;   // Nothing to import
+    }
+    memset(&entry, 0, sizeof(entry));
+
+    idx.version = USERDB_INDEX_VERSION;
+    idx.count = count;
+    userdb_nvs_set_blob(dst, NVS_INDEX_KEY, &idx, offsetof(userdb_index_t, slot) + count);
+    if (userdb_nvs_commit(dst) != ESP_OK) {
+        ESP_LOGE(TAG, "Error importing users, source left untouched");
+        return;
+    }
+    if (src != dst) {
+        nvs_erase_all(src);
+    } else {
+        nvs_erase_key(src, NVS_KEY);
+        nvs_erase_key(src, "count");
+    }
+    nvs_commit(src);
+    ESP_LOGI(TAG, "User DB imported (%d records)", (int)count);
+}
+
+// Mounts the dedicated partition, falling back to the default one
+static void userdb_partition_init() {
+    esp_err_t err = nvs_flash_init_partition(USERDB_PARTITION);
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_LOGW(TAG, "Partition %s unreadable, erasing it", USERDB_PARTITION);
+        nvs_flash_erase_partition(USERDB_PARTITION);
+        err = nvs_flash_init_partition(USERDB_PARTITION);
+    }
+    if (err == ESP_OK) {
+        s_own_partition = true;
+    } else {
+        ESP_LOGW(TAG, "Partition %s not available (%s), using the default NVS partition",
+                 USERDB_PARTITION, esp_err_to_name(err));
+        s_own_partition = false;
     }
-    printf("============================\n");
 }
 
-// Saves the user list and count to NVS
+static void userdb_writeback_init();
+
+// Saves the whole user list (every record and the index) to NVS
 void userdb_save() {
     nvs_handle_t handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    esp_err_t err = userdb_open(NVS_READWRITE, &handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Error saving users list");
         return;
     }
-    nvs_set_blob(handle, NVS_KEY, user_list, sizeof(user_entry_t) * user_count);
-    nvs_set_u32(handle, "count", user_count);
-    nvs_commit(handle);
+    DB_LOCK();
+    STATS_BEGIN(USERDB_OP_SAVE);
+    for (size_t i = 0; i < user_count; ++i) {
+        user_entry_t* entry = userdb_fetch(i);
+        if (entry)
+            userdb_write_record(handle, user_dir[i].slot, entry);
+    }
+    userdb_write_index(handle);
+    if (userdb_nvs_commit(handle) == ESP_OK) {
+        memset(s_dirty_slots, 0, sizeof(s_dirty_slots));
+        s_pending_usage = 0;
+    }
     nvs_close(handle);
-    printf("Users list saved (%d records)\n", user_count);
+    STATS_END(USERDB_OP_SAVE);
+    DB_UNLOCK();
+    printf("Users list saved (%d records)\n", (int)user_count);
 }
 
-// Loads the user list and count from NVS
+// Loads the user directory from NVS (importing older layouts if found).
+// Only the directory stays resident: full records are read on demand.
 void userdb_load() {
-    if (get_device_key_hmac(decrypt_key) != ESP_OK)
-        ESP_LOGE(TAG, "Error getting decrypt key");
+    userdb_writeback_init();
+    DB_LOCK();
+    STATS_BEGIN(USERDB_OP_LOAD);
+    userdb_crypto_wipe();
+    userdb_crypto_init();
+
+    memset(s_dirty_slots, 0, sizeof(s_dirty_slots));
+    s_pending_usage = 0;
+    user_count = 0;
+    user_index = -1;  // Reset index at startup
+    memset(user_dir, 0, sizeof(user_dir));
+    userdb_cache_reset();
+    userdb_partition_init();
 
     nvs_handle_t handle;
-    size_t required_size = sizeof(user_list);
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    esp_err_t err = userdb_open(NVS_READWRITE, &handle);
     if (err != ESP_OK) {
-        user_count = 0;
         ESP_LOGE(TAG, "Error loading users list");
+        STATS_END(USERDB_OP_LOAD);
+        DB_UNLOCK();
         return;
     }
-    
-    user_count = 0;
-    memset(user_list, 0, sizeof(user_list));
 
-    nvs_get_blob(handle, NVS_KEY, user_list, &required_size);
-    uint32_t count = 0;
-    nvs_get_u32(handle, "count", &count);
-    user_count = count;
+    userdb_index_t idx = {0};
+    size_t idx_size = sizeof(idx);
+    if (nvs_get_blob(handle, NVS_INDEX_KEY, &idx, &idx_size) != ESP_OK) {
+        nvs_handle_t old_handle;
+        if (!s_own_partition) {
+            userdb_import(handle, handle);
+        } else if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &old_handle) == ESP_OK) {
+            userdb_import(handle, old_handle);
+            nvs_close(old_handle);
+        }
+        idx_size = sizeof(idx);
+        nvs_get_blob(handle, NVS_INDEX_KEY, &idx, &idx_size);
+    }
+
+    s_db_revision = 0;
+    s_reindex_revision = 0;
+    nvs_get_u32(handle, NVS_REVISION_KEY, &s_db_revision);
+    nvs_get_u32(handle, NVS_REINDEX_KEY, &s_reindex_revision);
+    s_db_epoch = 0;
+    nvs_get_u32(handle, NVS_EPOCH_KEY, &s_db_epoch);
+    if (s_db_epoch == 0) {
+        userdb_new_epoch(handle);       // DB nuovo (o scritto da un firmware precedente)
+        userdb_nvs_commit(handle);
+    }
+
+    user_entry_t entry;
+    for (size_t i = 0; i < idx.count && i < MAX_USERS; ++i) {
+        if (idx.slot[i] >= MAX_USERS || userdb_read_record(handle, idx.slot[i], &entry, NULL) != ESP_OK) {
+            ESP_LOGW(TAG, "Record u%02u missing, skipped", idx.slot[i]);
+            continue;
+        }
+        user_dir[user_count].slot = idx.slot[i];
+        userdb_dir_set(user_count, &entry);
+        if (entry.revision > s_db_revision)
+            s_db_revision = entry.revision;     // revision key not committed with the record
+        user_count++;
+    }
+    memset(&entry, 0, sizeof(entry));
     nvs_close(handle);
-    user_index = -1;  // Reset index at startup
+    userdb_sort_by_usage();
+    userdb_finger_map_rebuild();
+    userdb_alpha_rebuild();
+    STATS_END(USERDB_OP_LOAD);
+    DB_UNLOCK();
+    hid_program_invalidate(-1);
 }
 
-// Adds a new user 
+// Copies the record at position index into out
+int userdb_get(int index, user_entry_t* out) {
+    if (index < 0 || index >= user_count || out == NULL)
+        return -1;
+    DB_LOCK();
+    user_entry_t* entry = userdb_fetch(index);
+    if (entry)
+        *out = *entry;
+    DB_UNLOCK();
+    return entry ? 0 : -1;
+}
+
+int userdb_get_login_type(int index) {
+    if (index < 0 || index >= user_count)
+        return -1;
+    return user_dir[index].login_type;
+}
+
+// Account logged in automatically by the fingerprint template finger_id
+int userdb_find_magicfinger(uint16_t finger_id) {
+    if (finger_id >= USERDB_FINGER_IDS || s_finger_map[finger_id] >= user_count)
+        return -1;   // USERDB_NO_USER, or the DB isn't loaded
+    return s_finger_map[finger_id];
+}
+
+// True if the folded label starts with the folded prefix (reads the record
+// only when the prefix is longer than the resident key)
+static bool userdb_label_has_prefix(nvs_handle_t handle, size_t index, const char* prefix, size_t plen) {
+    if (plen <= USERDB_LABEL_KEY_LEN)
+        return true;   // Already matched on the key
+    user_entry_t entry;
+    if (userdb_read_record(handle, user_dir[index].slot, &entry, NULL) != ESP_OK)
+        return false;
+    bool match = plen <= MAX_LABEL_LEN;
+    for (size_t i = 0; match && i < plen; ++i)
+        match = userdb_fold(entry.label[i]) == prefix[i];
+    memset(&entry, 0, sizeof(entry));
+    return match;
+}
+
+// Accounts whose label starts with prefix (case insensitive), in alphabetical
+// order. Binary search on the resident keys; returns the number of matches
+int userdb_search_prefix(const char* prefix, uint8_t* out, int max) {
+    char folded[MAX_LABEL_LEN];
+    size_t plen = strnlen(prefix, MAX_LABEL_LEN);
+    for (size_t i = 0; i < plen; ++i)
+        folded[i] = userdb_fold(prefix[i]);
+    size_t klen = plen < USERDB_LABEL_KEY_LEN ? plen : USERDB_LABEL_KEY_LEN;
+
+    DB_LOCK();
+    // First position whose key is >= the prefix
+    size_t lo = 0, hi = user_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (memcmp(user_dir[s_alpha[mid]].key, folded, klen) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    int found = 0;
+    nvs_handle_t handle = 0;
+    bool full_labels = plen > USERDB_LABEL_KEY_LEN;
+    if (full_labels && userdb_open(NVS_READONLY, &handle) != ESP_OK) {
+        DB_UNLOCK();
+        return 0;
+    }
+    for (size_t p = lo; p < user_count && found < max; ++p) {
+        uint8_t index = s_alpha[p];
+        if (memcmp(user_dir[index].key, folded, klen) != 0)
+            break;
+        if (userdb_label_has_prefix(handle, index, folded, plen))
+            out[found++] = index;
+    }
+    if (full_labels)
+        nvs_close(handle);
+    DB_UNLOCK();
+    return found;
+}
+
+// Accounts whose label contains the characters of pattern in the same order
+// (case insensitive, e.g. "gml" matches "Gmail"), in alphabetical order.
+// Needs the full labels: every record is read once
+int userdb_search_fuzzy(const char* pattern, uint8_t* out, int max) {
+    size_t plen = strnlen(pattern, MAX_LABEL_LEN);
+    nvs_handle_t handle;
+    int found = 0;
+    if (userdb_open(NVS_READONLY, &handle) != ESP_OK)
+        return 0;
+    DB_LOCK();
+    user_entry_t entry;
+    for (size_t p = 0; p < user_count && found < max; ++p) {
+        uint8_t index = s_alpha[p];
+        if (userdb_read_record(handle, user_dir[index].slot, &entry, NULL) != ESP_OK)
+            continue;
+        size_t j = 0;
+        for (size_t i = 0; i < MAX_LABEL_LEN && entry.label[i] && j < plen; ++i) {
+            if (userdb_fold(entry.label[i]) == userdb_fold(pattern[j]))
+                j++;
+        }
+        if (j == plen)
+            out[found++] = index;
+    }
+    memset(&entry, 0, sizeof(entry));
+    DB_UNLOCK();
+    nvs_close(handle);
+    return found;
+}
+
+// First account of the next (dir > 0) or previous (dir < 0) initial letter,
+// wrapping around. index -1 starts from the top of the list
+int userdb_label_group_next(int index, int dir) {
+    if (user_count == 0)
+        return -1;
+    if (index < 0 || index >= user_count)
+        return s_alpha[0];
+    int p = alpha_of[index];
+    int n = user_count;
+    char letter = user_dir[index].key[0];
+    if (dir > 0) {
+        while (++p < n && user_dir[s_alpha[p]].key[0] == letter)
+            ;
+        return s_alpha[p < n ? p : 0];
+    }
+    // Start of the current group, then step into the previous one and find its start
+    while (p > 0 && user_dir[s_alpha[p - 1]].key[0] == letter)
+        p--;
+    p = (p + n - 1) % n;
+    letter = user_dir[s_alpha[p]].key[0];
+    while (p > 0 && user_dir[s_alpha[p - 1]].key[0] == letter)
+        p--;
+    return s_alpha[p];
+}
+
+// Adds a new user
 int userdb_add(user_entry_t* user) {
-    if (user_count >= MAX_USERS) 
+    if (user_count >= MAX_USERS)
         return -1;
+    DB_LOCK();
+    STATS_BEGIN(USERDB_OP_ADD);
     user_print(user);
-    user_list[user_count] = *user; // Copy the complete structure
-    user_list[user_count].usage_count = 0; // Initialize usage counter
+    user->usage_count = 0; // Initialize usage counter
+    user->revision = userdb_bump_revision(false);
+    user_dir[user_count].slot = userdb_free_slot();
+    userdb_dir_set(user_count, user);
+    user_rank[user_count] = user_count;  // Never used: last in the ranking
+    rank_of[user_count] = user_count;
+    if (user->magicfinger && s_finger_map[user->fingerprint_id] == USERDB_NO_USER)
+        s_finger_map[user->fingerprint_id] = user_count;
     user_count++;
-    userdb_save();
-    userdb_load();
+    userdb_alpha_rebuild();
+    userdb_save_entry(user_count - 1, user, true);
+    userdb_cache_put(user_dir[user_count - 1].slot, user);
+    user_index = -1;
+    STATS_END(USERDB_OP_ADD);
+    DB_UNLOCK();
     display_oled_post_info("User added");
     buzzer_feedback_success();
     ESP_LOGI(TAG, "User added: %s", user->label);
@@ -152,117 +1129,368 @@ int userdb_add(user_entry_t* user) {
 
 
 void userdb_edit(int index, user_entry_t* user){
-    if (index < 0 || index >= user_count) 
+    if (index < 0 || index >= user_count)
         return ;
 
+    DB_LOCK();
+    STATS_BEGIN(USERDB_OP_EDIT);
     user_print(user);
-    user_list[index] = *user; // Copy the complete structure
-    userdb_save();
-    userdb_load();
+    user->usage_count = user_dir[index].usage_count; // The client doesn't know the usage counter
+    user->revision = userdb_bump_revision(false);
+    userdb_dir_set(index, user);
+    userdb_finger_map_rebuild();
+    userdb_alpha_rebuild();
+    userdb_save_entry(index, user, false);
+    userdb_cache_put(user_dir[index].slot, user);
+    DIRTY_CLEAR(user_dir[index].slot);
+    STATS_END(USERDB_OP_EDIT);
+    DB_UNLOCK();
+    hid_program_invalidate(index);      // password o flag di login cambiati
     display_oled_post_info("User update");
     buzzer_feedback_success();
-    ESP_LOGI(TAG, "User updated: %s", user->label);    
+    ESP_LOGI(TAG, "User updated: %s", user->label);
 }
 
 
 // Removes a user given the index
-int userdb_remove(int index) {    
+int userdb_remove(int index) {
 
-    display_oled_post_info("rem user");    
+    display_oled_post_info("rem user");
     if (index < 0 || index >= user_count) return -1;
-    for (size_t i = index; i < user_count - 1; ++i) {
-        user_list[i] = user_list[i + 1];
-    }
+    DB_LOCK();
+    STATS_BEGIN(USERDB_OP_REMOVE);
+    uint8_t removed_slot = user_dir[index].slot;
+    DIRTY_CLEAR(removed_slot);
+    userdb_cache_drop(removed_slot);
+    for (size_t i = index; i < user_count - 1; ++i)
+        user_dir[i] = user_dir[i + 1];
+    // Drop the entry from the ranking and shift the indices that followed it
+    for (size_t r = rank_of[index]; r < user_count - 1; ++r)
+        user_rank[r] = user_rank[r + 1];
     user_count--;
-    userdb_save();
-    userdb_load(); 
+    for (size_t r = 0; r < user_count; ++r) {
+        if (user_rank[r] > index)
+            user_rank[r]--;
+        rank_of[user_rank[r]] = r;
+    }
+    memset(&user_dir[user_count], 0, sizeof(userdb_dir_t));
+    userdb_finger_map_rebuild();
+    userdb_alpha_rebuild();
+    user_index = -1;
+    userdb_bump_revision(true);         // the following records moved up
+
+    nvs_handle_t handle;
+    if (userdb_open(NVS_READWRITE, &handle) == ESP_OK) {
+        char key[8];
+        userdb_record_key(removed_slot, key);
+        nvs_erase_key(handle, key);
+        userdb_write_index(handle);
+        userdb_write_revision(handle);
+        userdb_nvs_commit(handle);
+        nvs_close(handle);
+    } else {
+        ESP_LOGE(TAG, "Error removing user %d", index);
+    }
+    STATS_END(USERDB_OP_REMOVE);
+    DB_UNLOCK();
+    hid_program_invalidate(-1);         // gli indici successivi sono scalati
     display_oled_post_info("User removed");
     buzzer_feedback_success();
-    ESP_LOGI(TAG, "User removed at index: %d", index);    
+    ESP_LOGI(TAG, "User removed at index: %d", index);
     return 0;
 }
 
-// Increments the usage counter of a user
+// Increments the usage counter of a user. Only RAM is touched here: the
+// counters reach flash through the write-back task (see userdb_flush_task)
 void userdb_increment_usage(int index) {
     if (index < 0 || index >= user_count) return;
-    user_list[index].usage_count++;
-    userdb_sort_by_usage();
-    userdb_save();
+    DB_LOCK();
+    STATS_BEGIN(USERDB_OP_INCREMENT_USAGE);
+    DIRTY_SET(user_dir[index].slot);
+    user_dir[index].usage_count++;
+
+    // Bubble the entry up past the accounts it now outranks (usually 0 or 1 moves)
+    uint32_t usage = user_dir[index].usage_count;
+    int r = rank_of[index];
+    while (r > 0 && user_dir[user_rank[r - 1]].usage_count < usage) {
+        user_rank[r] = user_rank[r - 1];
+        rank_of[user_rank[r]] = r;
+        r--;
+    }
+    user_rank[r] = index;
+    rank_of[index] = r;
+
+    s_pending_usage++;
+    bool flush_now = s_pending_usage >= USERDB_USAGE_FLUSH_PENDING;
+    STATS_END(USERDB_OP_INCREMENT_USAGE);
+    DB_UNLOCK();
+
+    if (s_flush_task) {
+        xTaskNotify(s_flush_task, flush_now ? USERDB_NOTIFY_FLUSH : USERDB_NOTIFY_BUMP, eSetBits);
+    } else if (flush_now) {
+        // No write-back task (creation failed): the login writes them
+        userdb_flush();
+    }
 }
 
-// Sorts the user list by usage frequency (descending)
+// Writes the pending usage counters to flash
+void userdb_flush() {
+    DB_LOCK();
+    if (s_pending_usage == 0) {
+        DB_UNLOCK();
+        return;
+    }
+    STATS_BEGIN(USERDB_OP_FLUSH);
+    nvs_handle_t handle;
+    if (userdb_open(NVS_READWRITE, &handle) == ESP_OK) {
+        for (size_t i = 0; i < user_count; ++i) {
+            if (!DIRTY_TEST(user_dir[i].slot))
+                continue;
+            user_entry_t* entry = userdb_fetch(i);
+            if (entry)
+                userdb_write_record(handle, user_dir[i].slot, entry);
+        }
+        if (userdb_nvs_commit(handle) == ESP_OK) {
+            ESP_LOGI(TAG, "Usage counters flushed (%lu pending)", (unsigned long)s_pending_usage);
+            memset(s_dirty_slots, 0, sizeof(s_dirty_slots));
+            s_pending_usage = 0;
+        }
+        nvs_close(handle);
+    } else {
+        ESP_LOGE(TAG, "Error flushing usage counters");
+    }
+    STATS_END(USERDB_OP_FLUSH);
+    DB_UNLOCK();
+}
+
+// Write-back: at USERDB_USAGE_FLUSH_PENDING bumps the counters are written as
+// soon as this task runs (one NVS commit), otherwise after
+// USERDB_USAGE_FLUSH_IDLE_MS without logins. A reset loses the bumps not yet
+// committed: fewer than USERDB_USAGE_FLUSH_PENDING once the flush requested
+// by the login that reached the limit has completed.
+static void userdb_flush_task(void *arg) {
+    for (;;) {
+        DB_LOCK();
+        bool pending = s_pending_usage != 0;
+        DB_UNLOCK();
+
+        uint32_t bits = 0;
+        TickType_t wait = pending ? pdMS_TO_TICKS(USERDB_USAGE_FLUSH_IDLE_MS) : portMAX_DELAY;
+        if (xTaskNotifyWait(0, UINT32_MAX, &bits, wait) == pdFALSE || (bits & USERDB_NOTIFY_FLUSH)) {
+            // Idle timeout expired, or too many bumps pending
+            userdb_flush();
+        }
+    }
+}
+
+static void userdb_writeback_init() {
+    if (s_db_lock == NULL)
+        s_db_lock = xSemaphoreCreateRecursiveMutex();
+    if (s_flush_task == NULL) {
+        if (xTaskCreate(userdb_flush_task, "userdb_flush", 3072, NULL, 2, &s_flush_task) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create write-back task, usage counters are saved synchronously");
+            s_flush_task = NULL;
+        }
+    }
+}
+
+// Rebuilds the usage ranking (descending, ties keep the list order).
+// Records stay where they are: only the rank indices are sorted.
 void userdb_sort_by_usage() {
-    for (size_t i = 0; i < user_count - 1; ++i) {
-        for (size_t j = i + 1; j < user_count; ++j) {
-            if (user_list[j].usage_count > user_list[i].usage_count) {
-                user_entry_t tmp = user_list[i];
-                user_list[i] = user_list[j];
-                user_list[j] = tmp;
-            }
+    STATS_BEGIN(USERDB_OP_SORT);
+    for (size_t i = 0; i < user_count; ++i) {
+        size_t r = i;
+        while (r > 0 && user_dir[user_rank[r - 1]].usage_count < user_dir[i].usage_count) {
+            user_rank[r] = user_rank[r - 1];
+            r--;
         }
+        user_rank[r] = i;
     }
+    for (size_t r = 0; r < user_count; ++r)
+        rank_of[user_rank[r]] = r;
+    STATS_END(USERDB_OP_SORT);
+}
+
+int userdb_rank_to_index(int rank) {
+    if (rank < 0 || rank >= user_count)
+        return -1;
+    return user_rank[rank];
+}
+
+int userdb_index_to_rank(int index) {
+    if (index < 0 || index >= user_count)
+        return -1;
+    return rank_of[index];
+}
+
+// Prints every record, reading them straight from flash (the cache is left alone)
+void userdb_dump() {
+    printf("=== USER LIST (%d users) ===\n", (int)user_count);
+    nvs_handle_t handle;
+    if (user_count && userdb_open(NVS_READONLY, &handle) == ESP_OK) {
+        user_entry_t entry;
+        DB_LOCK();
+        for (size_t i = 0; i < user_count; ++i) {
+            if (userdb_read_record(handle, user_dir[i].slot, &entry, NULL) != ESP_OK)
+                continue;
+            entry.usage_count = user_dir[i].usage_count;
+            printf(" [%d]\n", (int)i);
+            user_print(&entry);
+        }
+        DB_UNLOCK();
+        memset(&entry, 0, sizeof(entry));
+        nvs_close(handle);
+    }
+    printf("============================\n");
+    userdb_stats_dump();
 }
 
 // Cancella tutto il DB degli utenti dalla flash
 void userdb_clear() {
     display_oled_post_info("clear users");
+    DB_LOCK();
     user_count = 0;
     user_index = -1;
-    memset(user_list, 0, sizeof(user_list));
+    memset(user_dir, 0, sizeof(user_dir));
+    memset(s_finger_map, USERDB_NO_USER, sizeof(s_finger_map));
+    userdb_cache_reset();
+    memset(s_dirty_slots, 0, sizeof(s_dirty_slots));
+    s_pending_usage = 0;
+    hid_program_invalidate(-1);
+    userdb_bump_revision(true);         // la revisione continua: i client vedono la cancellazione
     nvs_handle_t handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    esp_err_t err = userdb_open(NVS_READWRITE, &handle);
     if (err != ESP_OK) {
         ESP_LOGE("userdb", "Errore apertura NVS: %s", esp_err_to_name(err));
+        DB_UNLOCK();
         return;
     }
-    nvs_erase_key(handle, NVS_KEY);     // "users"
-    nvs_erase_key(handle, "count");     // contatore utenti
-    nvs_commit(handle);
+    nvs_erase_all(handle);              // record, indice e vecchio blob "users"
+    userdb_write_revision(handle);
+    userdb_new_epoch(handle);
+    userdb_nvs_commit(handle);
     nvs_close(handle);
+    DB_UNLOCK();
     ESP_LOGI("userdb", "Database utenti cancellato");
     display_oled_post_info("DB cleared!");
     buzzer_feedback_success();
 }
 
 
+void userdb_stats_get(userdb_op_t op, userdb_op_stats_t* out) {
+    if (op >= USERDB_OP_NB || out == NULL)
+        return;
+#if USERDB_STATS
+    portENTER_CRITICAL(&s_stats_mux);
+    *out = s_stats[op];
+    portEXIT_CRITICAL(&s_stats_mux);
+#else
+    memset(out, 0, sizeof(*out));
+#endif
+}
+
+size_t userdb_ram_usage() {
+    return sizeof(user_dir) + sizeof(user_rank) + sizeof(rank_of) + sizeof(s_finger_map) +
+           sizeof(s_alpha) + sizeof(alpha_of) + sizeof(s_dirty_slots) + sizeof(s_cache);
+}
+
+void userdb_stats_reset() {
+#if USERDB_STATS
+    portENTER_CRITICAL(&s_stats_mux);
+    memset(s_stats, 0, sizeof(s_stats));
+    portEXIT_CRITICAL(&s_stats_mux);
+#endif
+}
+
+void userdb_stats_dump() {
+#if USERDB_STATS
+    printf("=== USERDB STATS ===\n");
+    printf(" %-16s %6s %10s %8s %10s %7s %6s\n", "op", "calls", "avg_us", "max_us", "flash_B/op", "commits", "stack");
+    userdb_op_stats_t stats[USERDB_OP_NB];
+    portENTER_CRITICAL(&s_stats_mux);
+    memcpy(stats, s_stats, sizeof(stats));
+    portEXIT_CRITICAL(&s_stats_mux);
+    for (int op = 0; op < USERDB_OP_NB; ++op) {
+        const userdb_op_stats_t *st = &stats[op];
+        if (st->calls == 0)
+            continue;
+        printf(" %-16s %6lu %10lu %8lu %10lu %7lu %6lu\n", s_op_names[op],
+               (unsigned long)st->calls,
+               (unsigned long)(st->total_us / st->calls),
+               (unsigned long)st->max_us,
+               (unsigned long)(st->flash_bytes / st->calls),
+               (unsigned long)st->commits,
+               (unsigned long)st->min_free_stack);
+    }
+    printf(" cache: %lu hit, %lu miss\n", (unsigned long)s_cache_hits, (unsigned long)s_cache_misses);
+    printf(" RAM: %u B directory + ranking, %u B record cache\n",
+           (unsigned)(sizeof(user_dir) + sizeof(user_rank) + sizeof(rank_of)), (unsigned)sizeof(s_cache));
+    printf("====================\n");
+#endif
+}
+
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-int send_user_entry(int8_t index) {
+// Entry fields as sent to the client: label, password, flags, layout, fallback.
+// Without the password (metadata listing) nothing is decrypted.
+// Returns 0 if the password does not decrypt (record tampered or corrupted):
+// the entry must not go out with an empty password, a legacy EDIT_USER with an
+// all-zero password would keep the broken record as it is.
+#define USER_ENTRY_META_LEN     (MAX_LABEL_LEN + 7)
+#define USER_ENTRY_PAYLOAD_LEN  (USER_ENTRY_META_LEN + MAX_PASSWORD_LEN)
+
+static size_t user_entry_payload(user_entry_t* entry, uint8_t* out, bool with_password) {
+    size_t n = 0;
+    memcpy(&out[n], entry->label, MAX_LABEL_LEN);
+    n += MAX_LABEL_LEN;
+
+    if (with_password) {
+        char plain[128] = {0};
+        if (userdb_decrypt_password(entry->password_enc, entry->password_len, plain) != 0) {
+            memset(plain, 0, sizeof(plain));
+            memset(out, 0, n);
+            memset(entry, 0, sizeof(*entry));
+            return 0;
+        }
+        memcpy(&out[n], plain, MAX_PASSWORD_LEN);
+        n += MAX_PASSWORD_LEN;
+        memset(plain, 0, sizeof(plain));
+    }
+
+    out[n++] = entry->winlogin ? 1 : 0;
+    out[n++] = entry->sendEnter ? 1 : 0;
+    out[n++] = entry->magicfinger ? 1 : 0;
+    out[n++] = entry->fingerprint_id;
+    out[n++] = entry->login_type;
+    out[n++] = entry->layout;
+    out[n++] = entry->fallback;
+    memset(entry, 0, sizeof(*entry));
+    return n;
+}
+
+int send_user_entry(int index) {
     if (index < 0 || index >= user_count) {
-        ESP_LOGW(TAG, "Index not valid or end of list (%d)\n", user_count);
+        ESP_LOGW(TAG, "Index not valid or end of list (%d)\n", (int)user_count);
     }
     
     size_t payload_size = 0;
-    uint8_t payload_data[128] = {0};
+    uint8_t payload_data[2 + USER_ENTRY_PAYLOAD_LEN] = {0};
+    user_entry_t entry;
 
-    if (index < MAX_USERS && user_count ) {
-        user_entry_t entry = user_list[index];
-        size_t size = sizeof(entry);
-
-        payload_data[payload_size++] = 0xA1; // Command to send a user
+    if (userdb_get(index, &entry) == 0) {
+        payload_data[payload_size++] = GET_USERS_LIST; // Command to send a user
         payload_data[payload_size++] = index; // Current user index
-        if (size > sizeof(payload_data) - 2) {
-            ESP_LOGE(TAG, "User entry size exceeds maximum payload size");
-            return -1;
+        size_t len = user_entry_payload(&entry, &payload_data[payload_size], true);
+        if (len == 0) {
+            ESP_LOGE(TAG, "Password of user %d unreadable, entry not sent", index);
+            char message[USER_MGMT_PAYLOAD_LEN - 2];
+            snprintf(message, sizeof(message), "User %d corrupted", index);
+            send_ble_message(message, 1);
+            return user_count;
         }
-
-        // Set label and password in the payload
-        memcpy(&payload_data[payload_size], entry.label, MAX_LABEL_LEN);
-        payload_size += MAX_LABEL_LEN;
-
-        char plain[128] = {0};
-        userdb_decrypt_password(entry.password_enc, entry.password_len, plain);
-        memcpy(&payload_data[payload_size], plain, MAX_PASSWORD_LEN);
-        payload_size += MAX_PASSWORD_LEN;
-
-        payload_data[payload_size++] = entry.winlogin ? 1 : 0; 
-        payload_data[payload_size++] = entry.sendEnter ? 1 : 0; 
-        payload_data[payload_size++] = entry.magicfinger ? 1 : 0;         
-        payload_data[payload_size++] = entry.fingerprint_id;
-        payload_data[payload_size++] = entry.login_type;
-
-        memset(plain, 0, sizeof(plain));        
+        payload_size += len;
     }
     
     esp_ble_gatts_send_indicate(
@@ -274,9 +1502,187 @@ int send_user_entry(int8_t index) {
         true
     );
 
+    memset(payload_data, 0, sizeof(payload_data));
     return (index >= user_count) ? -1 : user_count;
 }
 
+// Bulk dump: the whole list as back-to-back notifications instead of one
+// GET_USERS_LIST round-trip per entry. Every frame is <cmd><seq><data>: the
+// data of consecutive frames is one stream of <index><entry> records ended by
+// <LIST_EMPTY><count><revision u32><epoch u32>, cut at the negotiated MTU (records span
+// frames, so it works from the default 23 up to 517; the end record never
+// does). The sequence number lets the client tell a lost notification from
+// the end of the list.
+// Delta sync: with a client revision only the records changed after it are
+// sent and count is the size of the list; a full dump is sent instead when the
+// revision is 0, unknown or older than the last remove/clear, or when the
+// client's epoch is missing or another one (flash erased, DB cleared: the
+// revisions started again and the same numbers mean other records).
+// GET_USERS_META is the same stream with <index><label><options> records: the
+// list view never needs the passwords, the edit form asks for one entry with
+// GET_USERS_LIST.
+#define USER_DUMP_CONGEST_MS    1000
+#define USER_DUMP_RECORD_LEN    (1 + USER_ENTRY_PAYLOAD_LEN)
+
+typedef struct {
+    uint8_t cmd;                       // GET_USERS_DUMP or GET_USERS_META
+    uint8_t frame[USER_MGMT_VALUE_MAX];
+    size_t len;
+    size_t room;                       // notification payload: MTU - 3
+    size_t frames;
+    uint8_t seq;
+} user_dump_t;
+
+static volatile bool s_dump_running = false;
+static uint8_t s_dump_cmd;              // request of the running dump task
+static uint32_t s_dump_since;
+static uint32_t s_dump_epoch;
+
+static bool user_dump_flush(user_dump_t* d) {
+    size_t len = d->len;
+    d->len = 0;
+    if (len == 0)
+        return true;
+    // Notifications have no ack: wait for free controller buffers instead
+    if (!ble_is_connected() || !ble_wait_uncongested(USER_DUMP_CONGEST_MS))
+        return false;
+    d->frames++;
+    return esp_ble_gatts_send_indicate(hidd_le_env.gatt_if, user_mgmt_conn_id,
+                                       user_mgmt_handle[USER_MGMT_IDX_VAL], len, d->frame, false) == ESP_OK;
+}
+
+static bool user_dump_write(user_dump_t* d, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        if (d->len == 0) {
+            d->frame[d->len++] = d->cmd;
+            d->frame[d->len++] = d->seq++;
+        }
+        size_t n = d->room - d->len < len ? d->room - d->len : len;
+        memcpy(&d->frame[d->len], data, n);
+        d->len += n;
+        data += n;
+        len -= n;
+        if (d->len == d->room && !user_dump_flush(d))
+            return false;
+    }
+    return true;
+}
+
+static void user_dump_task(void *arg) {
+    user_dump_t d = { .cmd = s_dump_cmd };
+    bool with_password = d.cmd != GET_USERS_META;
+    d.room = user_mgmt_mtu - 3;
+    if (d.room > sizeof(d.frame))
+        d.room = sizeof(d.frame);
+
+    // Changes made while dumping have a later revision: the next sync gets them
+    uint32_t since = s_dump_since;
+    DB_LOCK();
+    uint32_t revision = s_db_revision;
+    uint32_t epoch = s_db_epoch;
+    bool full = since == 0 || since > s_db_revision || since < s_reindex_revision || s_dump_epoch != s_db_epoch;
+    size_t count = user_count;
+    DB_UNLOCK();
+
+    uint8_t record[USER_DUMP_RECORD_LEN];
+    size_t index = 0, sent = 0, unreadable = 0;
+    bool ok = true;
+    int64_t start = esp_timer_get_time();
+    ble_conn_begin_burst();     // no relax with latency in the middle of the stream
+
+    for (; index < count; ++index) {
+        // user_dir changes under the lock (edit from the GATT task, remove, clear)
+        DB_LOCK();
+        bool gone = index >= user_count;
+        uint32_t changed = gone ? 0 : user_dir[index].revision;
+        DB_UNLOCK();
+        if (gone) {
+            count = index;
+            break;
+        }
+        if (!full && changed <= since)
+            continue;
+        user_entry_t entry;
+        if (userdb_get(index, &entry) != 0) {
+            count = index;  // list changed while dumping: the end record tells how many went out
+            break;
+        }
+        record[0] = index;
+        size_t len = user_entry_payload(&entry, &record[1], with_password);
+        if (len == 0) {
+            // Left out: the client keeps its cached copy, if any
+            ESP_LOGE(TAG, "Password of user %u unreadable, left out of the dump", (unsigned)index);
+            unreadable++;
+            continue;
+        }
+        ok = user_dump_write(&d, record, 1 + len);
+        memset(record, 0, sizeof(record));
+        if (!ok)
+            break;
+        sent++;
+    }
+    if (ok) {
+        const uint8_t end[10] = { LIST_EMPTY, count, revision, revision >> 8, revision >> 16, revision >> 24,
+                                  epoch, epoch >> 8, epoch >> 16, epoch >> 24 };
+        if (d.len + sizeof(end) > d.room)
+            ok = user_dump_flush(&d);
+        ok = ok && user_dump_write(&d, end, sizeof(end)) && user_dump_flush(&d);
+    }
+    memset(&d.frame, 0, sizeof(d.frame));
+    ble_conn_end_burst();
+
+    if (ok)
+        ESP_LOGI(TAG, "User %s%s: %u of %u entries in %u frames (MTU %u, rev %lu), %lld ms", full ? "dump" : "delta", with_password ? "" : " (metadata)",
+                 (unsigned)sent, (unsigned)count, (unsigned)d.frames, user_mgmt_mtu, (unsigned long)revision,
+                 (long long)((esp_timer_get_time() - start) / 1000));
+    else
+        ESP_LOGW(TAG, "User dump aborted after %u entries", (unsigned)sent);
+    if (ok && unreadable) {
+        char message[USER_MGMT_PAYLOAD_LEN - 2];
+        snprintf(message, sizeof(message), "Corrupted: %u", (unsigned)unreadable);
+        send_ble_message(message, 1);
+    }
+    s_dump_running = false;
+    vTaskDelete(NULL);
+}
+
+void send_user_dump(uint8_t cmd, uint32_t since_revision, uint32_t since_epoch) {
+    if (s_dump_running) {
+        ESP_LOGW(TAG, "User dump already running");
+        return;
+    }
+    s_dump_running = true;
+    s_dump_cmd = cmd;
+    s_dump_since = since_revision;
+    s_dump_epoch = since_epoch;
+    if (xTaskCreate(user_dump_task, "user_dump", 4096 + USER_MGMT_VALUE_MAX,
+                    NULL, 2, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create user dump task");
+        s_dump_running = false;
+    }
+}
+
+
+// Answers a SEARCH_USERS request: <cmd><count><index>...
+void send_search_result(uint8_t mode, const char* query) {
+    uint8_t payload_data[2 + USERDB_SEARCH_MAX] = {0};
+    int found = (mode == SEARCH_FUZZY)
+        ? userdb_search_fuzzy(query, &payload_data[2], USERDB_SEARCH_MAX)
+        : userdb_search_prefix(query, &payload_data[2], USERDB_SEARCH_MAX);
+    payload_data[0] = SEARCH_USERS;
+    payload_data[1] = found;
+    ESP_LOGI(TAG, "Search '%s' (%s): %d matches", query, mode == SEARCH_FUZZY ? "fuzzy" : "prefix", found);
+
+    esp_ble_gatts_send_indicate(
+        hidd_le_env.gatt_if,
+        user_mgmt_conn_id,
+        user_mgmt_handle[USER_MGMT_IDX_VAL],
+        2 + found,
+        payload_data,
+        true
+    );
+}
+
 
 void send_authenticated(bool auth) {
     user_mgmt_payload_t payload = {0};
@@ -299,26 +1705,24 @@ void send_authenticated(bool auth) {
 }
 
 
-// void send_ble_message(const char* message, uint8_t type) {
-//     user_mgmt_payload_t payload = {0};
-//     payload.cmd = 0xAA;  // Command to send a generic message
-//     payload.index = type; // 0x00 Info, 0x01 Warning, 0x02 Error
-
-//     strncpy(payload.data, message, sizeof(payload.data) - 1);        
-//     ESP_LOGI(TAG, "[%s] Message: %s", type ? "error": "info", (char*) payload.data);
+// type: 0x00 info, 0x01 error (shown by the app as such)
+void send_ble_message(const char* message, uint8_t type) {
+    user_mgmt_payload_t payload = {0};
+    payload.cmd = BLE_MESSAGE;  // Command to send a generic message
+    payload.index = type;
 
-//     esp_ble_gatts_send_indicate(
-//         hidd_le_env.gatt_if,
-//         user_mgmt_conn_id,
-//         user_mgmt_handle[USER_MGMT_IDX_VAL],
-//         sizeof(payload),
-//         (uint8_t *)&payload,
-//         true
-//     );
+    strncpy(payload.data, message, sizeof(payload.data) - 1);
+    ESP_LOGI(TAG, "[%s] Message: %s", type ? "error": "info", (char*) payload.data);
 
-//     ESP_LOGI(TAG, "gatt_if: %d, conn_id: %d, handle: %d\n",
-//              hidd_le_env.gatt_if, user_mgmt_conn_id, user_mgmt_handle[USER_MGMT_IDX_VAL]);
-// }
+    esp_ble_gatts_send_indicate(
+        hidd_le_env.gatt_if,
+        user_mgmt_conn_id,
+        user_mgmt_handle[USER_MGMT_IDX_VAL],
+        sizeof(payload),
+        (uint8_t *)&payload,
+        true
+    );
+}
 
 void send_db_cleared() {
     user_mgmt_payload_t payload = {0};
@@ -12,49 +12,123 @@ extern "C" {
 
 #define DEBUG_PASSWD 0
 #define SLEEP_ENABLE 1
+#define USERDB_STATS 1     // Collect time/flash/stack counters for every userdb operation
 
 #define MAX_LABEL_LEN    32
 #define MAX_PASSWORD_LEN 32
-#define MAX_USERS        10
+
+// Password encryption: AES-128-GCM, random nonce per record
+#define USERDB_GCM_NONCE_LEN     12
+#define USERDB_GCM_TAG_LEN       16
+#define USERDB_PASSWORD_ENC_LEN  (USERDB_GCM_NONCE_LEN + USERDB_GCM_TAG_LEN + MAX_PASSWORD_LEN)
+#define MAX_USERS        250     // < 255: indices travel as one byte in the GATT protocol
+
+// Records live in their own NVS partition (see partitions.csv); only a small
+// directory per account and USERDB_CACHE_SIZE full records are kept in RAM
+#define USERDB_PARTITION   "userdb"
+#define USERDB_CACHE_SIZE  8
+#define USERDB_FINGER_IDS  256     // fingerprint_id is one byte (record and GATT protocol)
+#define USERDB_LABEL_KEY_LEN 8      // label chars kept in RAM for the alphabetical index
+#define USERDB_SEARCH_MAX  64       // indices returned by a SEARCH_USERS request
+
+// Write-back of the usage counters bumped at every login
+#define USERDB_USAGE_FLUSH_PENDING  8       // N pending bumps wake the write-back task (< N lost once it has run)
+#define USERDB_USAGE_FLUSH_IDLE_MS  30000   // flush after this long without new bumps
 
 typedef struct {
     char label[MAX_LABEL_LEN];                   // es: username o descrizione
-    uint8_t password_enc[MAX_PASSWORD_LEN + 16]; // password crittografata
-    size_t password_len;               // lunghezza reale della password cifrata
+    uint8_t password_enc[USERDB_PASSWORD_ENC_LEN]; // nonce | tag | password cifrata
+    size_t password_len;               // lunghezza di password_enc usata
     uint32_t usage_count;              // frequenza di utilizzo
     uint8_t fingerprint_id;            // indice del fingerprint associato (0-9)
     bool magicfinger;                  // true se è un login con fingerprint (0-9) automatico
     bool winlogin;                     // true se è un login Windows
     bool sendEnter;                    // true se deve inviare ENTER alla fine
     uint8_t login_type;                // tipo di login (0: BLE, 1: USB, 2: Both)
+    uint8_t layout;                    // layout tastiera dell'host (hid_layout_id_t, 0: quello del dispositivo)
+    uint8_t fallback;                  // caratteri assenti nel layout (hid_fallback_t, 0: saltati)
+    uint32_t revision;                 // revisione del DB all'ultima modifica del record (delta sync)
 } user_entry_t;
 
-extern user_entry_t user_list[MAX_USERS];
 extern size_t user_count;
 extern int user_index;
 
-// Funzioni di crittografia password
+// Funzioni di crittografia password (out_plain: almeno MAX_PASSWORD_LEN + 1 byte)
 int userdb_encrypt_password(const char* plain, uint8_t* out_encrypted);
 int userdb_decrypt_password(const uint8_t* encrypted, size_t len, char* out_plain);
+void userdb_crypto_wipe();             // Drops the cached key schedule (re-derived on next use)
 
 // Management functions
 void userdb_load();
 void userdb_save();
 
+int userdb_get(int index, user_entry_t* out);   // 0 if ok, reads flash on a cache miss
+int userdb_get_login_type(int index);
+int userdb_find_magicfinger(uint16_t finger_id);
+
+// Label lookups (case insensitive, results in alphabetical order)
+int userdb_search_prefix(const char* prefix, uint8_t* out, int max);
+int userdb_search_fuzzy(const char* pattern, uint8_t* out, int max);
+int userdb_label_group_next(int index, int dir);   // jump to the next/previous initial letter
+
 int userdb_remove(int index);
 int userdb_add(user_entry_t* user);
 void userdb_edit(int index, user_entry_t* user);
 
+// Usage ranking: account indices are stable, the order by usage is kept apart
 void userdb_increment_usage(int index);
 void userdb_sort_by_usage();
+int userdb_rank_to_index(int rank);    // Indice dell'account in posizione rank (0 = piu' usato)
+int userdb_index_to_rank(int index);
+void userdb_flush();                   // Writes pending usage counters (call before sleep/reset)
 
 // Test data initialization
 void user_print(user_entry_t* user);
 void userdb_dump();
 void userdb_clear();
 
+// Per-operation counters (baseline for storage and crypto changes)
+typedef enum {
+    USERDB_OP_LOAD,
+    USERDB_OP_SAVE,
+    USERDB_OP_ADD,
+    USERDB_OP_EDIT,
+    USERDB_OP_REMOVE,
+    USERDB_OP_INCREMENT_USAGE,
+    USERDB_OP_SORT,
+    USERDB_OP_FLUSH,
+    USERDB_OP_ENCRYPT,
+    USERDB_OP_DECRYPT,
+    USERDB_OP_NB,
+} userdb_op_t;
+
+typedef struct {
+    uint32_t calls;                    // numero di chiamate
+    uint64_t total_us;                 // tempo totale (inclusi i sotto-passi, es. add -> save)
+    uint32_t max_us;                   // chiamata piu' lenta
+    uint64_t flash_bytes;              // byte passati a nvs_set_*
+    uint32_t commits;                  // numero di nvs_commit
+    uint32_t min_free_stack;           // minimo stack libero del task chiamante (byte)
+} userdb_op_stats_t;
+
+// Delta sync: the DB revision grows at every add/edit/remove/clear and each
+// record keeps the revision of its last change. Before the reindex revision
+// (last remove or clear) the indices known by a client are no longer valid.
+// The epoch is random and changes when the DB is created or cleared: a
+// revision is only meaningful together with it.
+uint32_t userdb_revision();
+uint32_t userdb_reindex_revision();
+uint32_t userdb_epoch();
+
+void userdb_stats_get(userdb_op_t op, userdb_op_stats_t* out);
+size_t userdb_ram_usage();             // RAM held by the DB (directory, indices, record cache)
+void userdb_stats_reset();
+void userdb_stats_dump();
+
 // Funzioni per l'invio della lista utenti al client BLE
-int send_user_entry(int8_t index);
+int send_user_entry(int index);
+void send_user_dump(uint8_t cmd, uint32_t since_revision, uint32_t since_epoch);   // GET_USERS_DUMP o GET_USERS_META
+void send_search_result(uint8_t mode, const char* query);
 
 void send_db_cleared();
 void send_authenticated(bool auth);
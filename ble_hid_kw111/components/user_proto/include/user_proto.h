@@ -0,0 +1,78 @@
+#pragma once
+#ifndef USER_PROTO_H
+#define USER_PROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Scrittura di un utente in formato TLV, condivisa tra firmware e app (il file .c
+e' C portabile, senza dipendenze da ESP-IDF, e viene compilato anche dal
+progetto Qt).
+
+    <WRITE_USER><version><index> { <tag><len><value> }...
+
+Solo i campi presenti vengono scritti: un'aggiunta porta tutti i campi, una
+modifica solo quelli cambiati (un flag sono 6 byte invece di 73). Chi decodifica
+salta i tag che non conosce, quindi nuovi campi non rompono i firmware
+precedenti; una modifica incompatibile del formato incrementa la versione, e le
+versioni superiori a USER_PROTO_VERSION vengono rifiutate.
+*/
+
+#define USER_PROTO_VERSION      1
+#define USER_PROTO_HEADER_LEN   3       // cmd, versione, indice
+#define USER_PROTO_TEXT_MAX     32      // MAX_LABEL_LEN / MAX_PASSWORD_LEN
+#define USER_PROTO_FRAME_MAX    (USER_PROTO_HEADER_LEN + 2 * (2 + USER_PROTO_TEXT_MAX) + 7 * (2 + 1))
+
+// Tag dei campi (valori di un byte salvo etichetta e password)
+typedef enum {
+    USER_TAG_LABEL = 1,
+    USER_TAG_PASSWORD,                  // testo in chiaro con i placeholder (0x80..)
+    USER_TAG_WINLOGIN,
+    USER_TAG_SEND_ENTER,
+    USER_TAG_MAGICFINGER,
+    USER_TAG_FINGERPRINT_ID,
+    USER_TAG_LOGIN_TYPE,
+    USER_TAG_LAYOUT,
+    USER_TAG_FALLBACK,
+    USER_TAG_NB
+} user_tag_t;
+
+#define USER_FIELD(tag)         (1u << (tag))
+
+typedef struct {
+    uint16_t fields;                    // USER_FIELD() dei campi presenti
+    uint8_t label_len;
+    uint8_t password_len;
+    char label[USER_PROTO_TEXT_MAX];    // non terminati
+    char password[USER_PROTO_TEXT_MAX];
+    uint8_t winlogin;
+    uint8_t send_enter;
+    uint8_t magicfinger;
+    uint8_t fingerprint_id;
+    uint8_t login_type;
+    uint8_t layout;
+    uint8_t fallback;
+} user_proto_entry_t;
+
+typedef enum {
+    USER_PROTO_OK = 0,
+    USER_PROTO_ERR_LENGTH,              // frame troncato o campo troppo lungo
+    USER_PROTO_ERR_VERSION,             // versione successiva a USER_PROTO_VERSION
+} user_proto_err_t;
+
+// Frame dei campi presenti in entry, 0 se out non basta (USER_PROTO_FRAME_MAX basta sempre)
+size_t user_proto_encode(uint8_t cmd, uint8_t index, const user_proto_entry_t* entry, uint8_t* out, size_t size);
+// frame parte dal comando; i tag sconosciuti vengono ignorati, out e' azzerato prima
+user_proto_err_t user_proto_decode(const uint8_t* frame, size_t len, uint8_t* index, user_proto_entry_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
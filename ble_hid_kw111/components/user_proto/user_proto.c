@@ -0,0 +1,90 @@
+#include <string.h>
+
+#include "user_proto.h"
+
+static size_t user_proto_put(uint8_t* out, size_t size, size_t n, uint8_t tag, const void* value, uint8_t len) {
+    if (n == 0 || n + 2 + len > size)
+        return 0;
+    out[n++] = tag;
+    out[n++] = len;
+    memcpy(&out[n], value, len);
+    return n + len;
+}
+
+size_t user_proto_encode(uint8_t cmd, uint8_t index, const user_proto_entry_t* entry, uint8_t* out, size_t size) {
+    if (size < USER_PROTO_HEADER_LEN || entry->label_len > USER_PROTO_TEXT_MAX ||
+        entry->password_len > USER_PROTO_TEXT_MAX)
+        return 0;
+
+    size_t n = 0;
+    out[n++] = cmd;
+    out[n++] = USER_PROTO_VERSION;
+    out[n++] = index;
+
+    const uint8_t bytes[USER_TAG_NB] = {
+        [USER_TAG_WINLOGIN] = entry->winlogin,
+        [USER_TAG_SEND_ENTER] = entry->send_enter,
+        [USER_TAG_MAGICFINGER] = entry->magicfinger,
+        [USER_TAG_FINGERPRINT_ID] = entry->fingerprint_id,
+        [USER_TAG_LOGIN_TYPE] = entry->login_type,
+        [USER_TAG_LAYOUT] = entry->layout,
+        [USER_TAG_FALLBACK] = entry->fallback,
+    };
+    for (uint8_t tag = USER_TAG_LABEL; tag < USER_TAG_NB && n; ++tag) {
+        if (!(entry->fields & USER_FIELD(tag)))
+            continue;
+        if (tag == USER_TAG_LABEL)
+            n = user_proto_put(out, size, n, tag, entry->label, entry->label_len);
+        else if (tag == USER_TAG_PASSWORD)
+            n = user_proto_put(out, size, n, tag, entry->password, entry->password_len);
+        else
+            n = user_proto_put(out, size, n, tag, &bytes[tag], 1);
+    }
+    return n;
+}
+
+user_proto_err_t user_proto_decode(const uint8_t* frame, size_t len, uint8_t* index, user_proto_entry_t* out) {
+    memset(out, 0, sizeof(*out));
+    if (len < USER_PROTO_HEADER_LEN)
+        return USER_PROTO_ERR_LENGTH;
+    if (frame[1] > USER_PROTO_VERSION)
+        return USER_PROTO_ERR_VERSION;
+    *index = frame[2];
+
+    size_t n = USER_PROTO_HEADER_LEN;
+    while (n < len) {
+        if (len - n < 2 || len - n - 2 < frame[n + 1])
+            return USER_PROTO_ERR_LENGTH;
+        const uint8_t tag = frame[n];
+        const uint8_t size = frame[n + 1];
+        const uint8_t* value = &frame[n + 2];
+        n += 2 + size;
+
+        switch (tag) {
+            case USER_TAG_LABEL:
+            case USER_TAG_PASSWORD: {
+                if (size > USER_PROTO_TEXT_MAX)
+                    return USER_PROTO_ERR_LENGTH;
+                char* text = tag == USER_TAG_LABEL ? out->label : out->password;
+                memset(text, 0, USER_PROTO_TEXT_MAX);
+                memcpy(text, value, size);
+                if (tag == USER_TAG_LABEL)
+                    out->label_len = size;
+                else
+                    out->password_len = size;
+                break;
+            }
+            case USER_TAG_WINLOGIN:         out->winlogin = size ? value[0] : 0; break;
+            case USER_TAG_SEND_ENTER:       out->send_enter = size ? value[0] : 0; break;
+            case USER_TAG_MAGICFINGER:      out->magicfinger = size ? value[0] : 0; break;
+            case USER_TAG_FINGERPRINT_ID:   out->fingerprint_id = size ? value[0] : 0; break;
+            case USER_TAG_LOGIN_TYPE:       out->login_type = size ? value[0] : 0; break;
+            case USER_TAG_LAYOUT:           out->layout = size ? value[0] : 0; break;
+            case USER_TAG_FALLBACK:         out->fallback = size ? value[0] : 0; break;
+            default:
+                continue;       // campo di una versione successiva
+        }
+        out->fields |= USER_FIELD(tag);
+    }
+    return USER_PROTO_OK;
+}
@@ -0,0 +1,112 @@
+// user-006: cost of a password decrypt with the context keyed once per
+// session, against keying a fresh context on every call as before.
+// user-007: AES-GCM and the old AES-CBC throughput. Only the software
+// back-end exists on the host; on the ESP32-S3 the same calls go through the
+// AES peripheral (CONFIG_MBEDTLS_HARDWARE_AES/GCM) and must be measured there.
+#include "esp_hmac.h"
+#include "mbedtls/aes.h"
+#include "mbedtls/gcm.h"
+#include "test_util.h"
+
+#define OPS 20000
+
+static void device_key(uint8_t key[16]) {
+    uint8_t hmac[32];
+    const char* context = "userdb-password-key";
+    esp_hmac_calculate(HMAC_KEY0, context, strlen(context), hmac);
+    memcpy(key, hmac, 16);
+}
+
+// Previous userdb_decrypt_password: derive, init, setkey, decrypt, free
+static int decrypt_per_call(const uint8_t* enc, size_t len, char* out) {
+    uint8_t key[16];
+    device_key(key);
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    int ret = mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, 128);
+    size_t plain_len = len - USERDB_GCM_NONCE_LEN - USERDB_GCM_TAG_LEN;
+    if (ret == 0)
+        ret = mbedtls_gcm_auth_decrypt(&gcm, plain_len, enc, USERDB_GCM_NONCE_LEN, NULL, 0,
+                                       enc + USERDB_GCM_NONCE_LEN, USERDB_GCM_TAG_LEN,
+                                       enc + USERDB_GCM_NONCE_LEN + USERDB_GCM_TAG_LEN, (uint8_t*)out);
+    mbedtls_gcm_free(&gcm);
+    memset(key, 0, sizeof(key));
+    out[plain_len] = '\0';
+    return ret;
+}
+
+#define BULK_LEN   4096
+#define BULK_ROUNDS 2000
+
+static double mib_per_s(uint64_t ns) {
+    return (double)BULK_LEN * BULK_ROUNDS / (1024.0 * 1024.0) / (ns / 1e9);
+}
+
+static void throughput(FILE* out) {
+    static uint8_t in[BULK_LEN], buf[BULK_LEN];
+    uint8_t key[16], iv[16], tag[16];
+    device_key(key);
+    memset(in, 0x5a, sizeof(in));
+
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, 128);
+    uint64_t start = test_now_ns();
+    for (int i = 0; i < BULK_ROUNDS; ++i)
+        mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, BULK_LEN, iv, 12, NULL, 0, in, buf, 16, tag);
+    uint64_t gcm_enc = test_now_ns() - start;
+    start = test_now_ns();
+    for (int i = 0; i < BULK_ROUNDS; ++i)
+        mbedtls_gcm_auth_decrypt(&gcm, BULK_LEN, iv, 12, NULL, 0, tag, 16, buf, in);
+    uint64_t gcm_dec = test_now_ns() - start;
+    mbedtls_gcm_free(&gcm);
+
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, key, 128);
+    start = test_now_ns();
+    for (int i = 0; i < BULK_ROUNDS; ++i) {
+        memset(iv, 0, sizeof(iv));
+        mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_ENCRYPT, BULK_LEN, iv, in, buf);
+    }
+    uint64_t cbc_enc = test_now_ns() - start;
+    mbedtls_aes_setkey_dec(&aes, key, 128);
+    start = test_now_ns();
+    for (int i = 0; i < BULK_ROUNDS; ++i) {
+        memset(iv, 0, sizeof(iv));
+        mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_DECRYPT, BULK_LEN, iv, buf, in);
+    }
+    uint64_t cbc_dec = test_now_ns() - start;
+    mbedtls_aes_free(&aes);
+
+    fprintf(out, "software back-end, %d byte buffers:\n", BULK_LEN);
+    fprintf(out, "  AES-GCM encrypt %8.1f MiB/s, decrypt %8.1f MiB/s\n", mib_per_s(gcm_enc), mib_per_s(gcm_dec));
+    fprintf(out, "  AES-CBC encrypt %8.1f MiB/s, decrypt %8.1f MiB/s\n", mib_per_s(cbc_enc), mib_per_s(cbc_dec));
+}
+
+int main(void) {
+    FILE* out = host_stdout();
+    host_stdout_mute(true);
+    test_storage_boot();
+
+    uint8_t enc[USERDB_PASSWORD_ENC_LEN];
+    char plain[MAX_PASSWORD_LEN + 1];
+    int len = userdb_encrypt_password("correct horse battery staple", enc);
+
+    uint64_t start = test_now_ns();
+    for (int i = 0; i < OPS; ++i)
+        decrypt_per_call(enc, len, plain);
+    uint64_t per_call = (test_now_ns() - start) / OPS;
+
+    start = test_now_ns();
+    for (int i = 0; i < OPS; ++i)
+        userdb_decrypt_password(enc, len, plain);
+    uint64_t cached = (test_now_ns() - start) / OPS;
+
+    fprintf(out, "decrypt, keyed per call:     %6llu ns/op\n", (unsigned long long)per_call);
+    fprintf(out, "decrypt, keyed once/session: %6llu ns/op\n", (unsigned long long)cached);
+    throughput(out);
+    fflush(out);
+    host_stdout_mute(false);
+    return 0;
+}
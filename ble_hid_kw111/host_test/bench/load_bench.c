@@ -0,0 +1,33 @@
+// user-005: boot-time load and RAM footprint of the paged store. The DB
+// stops at MAX_USERS (indices travel as one byte), so 250 replaces 500.
+#include <malloc.h>
+
+#include "test_util.h"
+
+static const int s_sizes[] = { 10, 100, MAX_USERS };
+
+#define LOADS 50
+
+int main(void) {
+    FILE* out = host_stdout();
+    host_stdout_mute(true);
+    fprintf(out, "%8s %12s %12s %12s %12s\n", "accounts", "load us", "flash KiB", "RAM B", "heap B");
+    for (size_t s = 0; s < sizeof(s_sizes) / sizeof(s_sizes[0]); ++s) {
+        int n = s_sizes[s];
+        test_storage_boot();
+        test_populate("bench", n);
+
+        size_t heap = mallinfo2().uordblks;
+        uint64_t start = test_now_ns();
+        for (int i = 0; i < LOADS; ++i)
+            userdb_load();
+        uint64_t load = (test_now_ns() - start) / LOADS;
+        heap = mallinfo2().uordblks - heap;
+
+        fprintf(out, "%8d %12.1f %12.1f %12zu %12zu\n", n, load / 1000.0,
+                host_nvs_stored_bytes(USERDB_PARTITION) / 1024.0, userdb_ram_usage(), heap);
+    }
+    fflush(out);
+    host_stdout_mute(false);
+    return 0;
+}
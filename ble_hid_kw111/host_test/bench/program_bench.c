@@ -0,0 +1,63 @@
+// user-015: cost of compiling a login program, of a cached load and of the
+// send path (encoder loop over the ready-made ops, no transport)
+#include "hid_layout.h"
+#include "hid_program.h"
+#include "test_util.h"
+
+#define ROUNDS  2000
+
+static const char* s_passwords[] = { "short1!", "Medium_length_16", "àèìòù long pass 32 bytes" };
+
+static void null_report(void* ctx, uint8_t modifier, const uint8_t* keys, uint8_t count) {
+    (*(uint32_t*)ctx)++;
+}
+
+static void null_delay(void* ctx, uint32_t ms) {
+}
+
+int main(void) {
+    FILE* out = host_stdout();
+    host_stdout_mute(true);
+    test_storage_boot();
+    for (size_t i = 0; i < sizeof(s_passwords) / sizeof(s_passwords[0]); ++i)
+        test_add_user("bench", s_passwords[i]);
+
+    fprintf(out, "%6s %5s %12s %12s %12s %12s %8s\n", "bytes", "ops", "compile us", "miss us",
+            "hit us", "send us", "reports");
+    for (size_t i = 0; i < sizeof(s_passwords) / sizeof(s_passwords[0]); ++i) {
+        hid_program_t prog;
+        uint64_t start = test_now_ns();
+        for (int r = 0; r < ROUNDS; ++r)
+            hid_program_compile(s_passwords[i], false, true, HID_LAYOUT_DEFAULT, HID_FALLBACK_SKIP, &prog);
+        double compile_us = (test_now_ns() - start) / 1000.0 / ROUNDS;
+
+        // Miss: userdb_get + decrypt + compile + cache store
+        double miss_us = 0;
+        for (int r = 0; r < ROUNDS / 10; ++r) {
+            hid_program_invalidate(i);
+            start = test_now_ns();
+            hid_program_load(i, &prog);
+            miss_us += (test_now_ns() - start) / 1000.0;
+        }
+        miss_us /= ROUNDS / 10;
+
+        start = test_now_ns();
+        for (int r = 0; r < ROUNDS; ++r)
+            hid_program_load(i, &prog);
+        double hit_us = (test_now_ns() - start) / 1000.0 / ROUNDS;
+
+        uint32_t reports = 0;
+        hid_encoder_sink_t sink = { .send_report = null_report, .delay_ms = null_delay, .ctx = &reports };
+        start = test_now_ns();
+        for (int r = 0; r < ROUNDS; ++r)
+            hid_encoder_run(&prog, &sink);
+        double send_us = (test_now_ns() - start) / 1000.0 / ROUNDS;
+
+        fprintf(out, "%6zu %5u %12.2f %12.2f %12.2f %12.2f %8u\n", strlen(s_passwords[i]), prog.count,
+                compile_us, miss_us, hit_us, send_us, reports / ROUNDS);
+        hid_program_wipe(&prog);
+    }
+    fflush(out);
+    host_stdout_mute(false);
+    return 0;
+}
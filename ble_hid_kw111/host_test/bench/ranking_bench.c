@@ -0,0 +1,66 @@
+// user-004: cost of a login bump and of a full ranking rebuild, against the
+// exchange sort of whole records used before. The DB stops at MAX_USERS
+// (indices travel as one byte in the GATT protocol), so 250 replaces 1000.
+#include <stdlib.h>
+
+#include "test_util.h"
+
+static const int s_sizes[] = { 10, 100, MAX_USERS };
+
+#define BUMPS 20000
+#define SORTS 200
+
+// Previous userdb_sort_by_usage: swaps whole records
+static void legacy_sort(user_entry_t* list, size_t count) {
+    for (size_t i = 0; i + 1 < count; ++i) {
+        for (size_t j = i + 1; j < count; ++j) {
+            if (list[j].usage_count > list[i].usage_count) {
+                user_entry_t tmp = list[i];
+                list[i] = list[j];
+                list[j] = tmp;
+            }
+        }
+    }
+}
+
+int main(void) {
+    FILE* out = host_stdout();
+    host_stdout_mute(true);
+    fprintf(out, "%8s %14s %14s %16s\n", "accounts", "bump ns/op", "rebuild ns", "legacy sort ns");
+    for (size_t s = 0; s < sizeof(s_sizes) / sizeof(s_sizes[0]); ++s) {
+        int n = s_sizes[s];
+        test_storage_boot();
+        test_populate("bench", n);
+
+        // Bumps only touch RAM, the write-back task flushes every USERDB_USAGE_FLUSH_PENDING
+        uint32_t lcg = 1;
+        uint64_t start = test_now_ns();
+        for (int i = 0; i < BUMPS; ++i) {
+            lcg = lcg * 1103515245u + 12345u;
+            userdb_increment_usage((lcg >> 16) % n);
+        }
+        uint64_t bump = (test_now_ns() - start) / BUMPS;
+
+        start = test_now_ns();
+        for (int i = 0; i < SORTS; ++i)
+            userdb_sort_by_usage();
+        uint64_t rebuild = (test_now_ns() - start) / SORTS;
+
+        user_entry_t* list = calloc(n, sizeof(user_entry_t));
+        uint64_t legacy = 0;
+        for (int i = 0; i < SORTS; ++i) {
+            for (int k = 0; k < n; ++k)
+                list[k].usage_count = (uint32_t)((k * 2654435761u) >> 20);
+            start = test_now_ns();
+            legacy_sort(list, n);
+            legacy += test_now_ns() - start;
+        }
+        free(list);
+
+        fprintf(out, "%8d %14llu %14llu %16llu\n", n, (unsigned long long)bump,
+                (unsigned long long)rebuild, (unsigned long long)(legacy / SORTS));
+    }
+    fflush(out);
+    host_stdout_mute(false);
+    return 0;
+}
@@ -0,0 +1,83 @@
+// user-011: keyboard reports per password, one press + one release per
+// character (before) against the rollover packer (after), and the typing
+// time at one report per connection event.
+#include <stdlib.h>
+
+#include "hid_layout.h"
+#include "hid_program.h"
+#include "test_util.h"
+
+#define PASSWORDS 1000
+
+static const char s_charset[] =
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789!@#$%&*()-_=+";
+
+static const struct { const char* name; int lower, upper, digits, symbols; } s_kinds[] = {
+    { "lowercase", 26, 0, 0, 0 },
+    { "mixed", 26, 26, 10, 0 },
+    { "full", 26, 26, 10, 13 },
+};
+
+static void random_password(char* out, int len, int kind) {
+    int lower = s_kinds[kind].lower, upper = s_kinds[kind].upper;
+    int digits = s_kinds[kind].digits, symbols = s_kinds[kind].symbols;
+    int span = lower + upper + digits + symbols;
+    for (int i = 0; i < len; ++i) {
+        int r = rand() % span;
+        if (r < lower)
+            out[i] = s_charset[r];
+        else if (r < lower + upper)
+            out[i] = s_charset[26 + r - lower];
+        else if (r < lower + upper + digits)
+            out[i] = s_charset[52 + r - lower - upper];
+        else
+            out[i] = s_charset[62 + r - lower - upper - digits];
+    }
+    out[len] = 0;
+}
+
+int main(void) {
+    FILE* out = host_stdout();
+    static const int lengths[] = { 8, 16, 32 };
+    static const double intervals_ms[] = { 7.5, 15, 30 };
+
+    srand(1);
+    fprintf(out, "%-10s %4s %10s %10s %8s", "charset", "len", "before", "after", "saved");
+    for (size_t i = 0; i < sizeof(intervals_ms) / sizeof(intervals_ms[0]); ++i)
+        fprintf(out, "  ms@%-4.1f", intervals_ms[i]);
+    fprintf(out, "\n");
+
+    for (size_t k = 0; k < sizeof(s_kinds) / sizeof(s_kinds[0]); ++k) {
+        for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+            uint64_t before = 0, after = 0;
+            for (int p = 0; p < PASSWORDS; ++p) {
+                char password[MAX_PASSWORD_LEN + 1];
+                random_password(password, lengths[l], k);
+                hid_program_t prog;
+                hid_program_compile(password, false, false, HID_LAYOUT_US, HID_FALLBACK_SKIP, &prog);
+
+                test_kbd_t kbd;
+                hid_encoder_sink_t sink = test_kbd_sink(&kbd);
+                test_kbd_reset(&kbd, HID_LAYOUT_US);
+                for (int i = 0; i < prog.count; ++i)
+                    hid_encoder_tap(prog.ops[i].modifier, prog.ops[i].key, &sink);
+                before += kbd.reports;
+
+                test_kbd_reset(&kbd, HID_LAYOUT_US);
+                hid_encoder_run(&prog, &sink);
+                after += kbd.reports;
+                if (strcmp(kbd.text, password) != 0)
+                    fprintf(out, "mismatch: \"%s\" typed as \"%s\"\n", password, kbd.text);
+                hid_program_wipe(&prog);
+            }
+            double b = (double)before / PASSWORDS, a = (double)after / PASSWORDS;
+            fprintf(out, "%-10s %4d %10.1f %10.1f %7.0f%%", s_kinds[k].name, lengths[l], b, a,
+                    100.0 * (b - a) / b);
+            for (size_t i = 0; i < sizeof(intervals_ms) / sizeof(intervals_ms[0]); ++i)
+                fprintf(out, "  %4.0f>%-4.0f", b * intervals_ms[i], a * intervals_ms[i]);
+            fprintf(out, "\n");
+        }
+    }
+    fflush(out);
+    return 0;
+}
@@ -0,0 +1,44 @@
+// user-010: latency of the label search behind SEARCH_USERS. The DB stops
+// at MAX_USERS (indices travel as one byte), so 250 replaces 1000.
+#include "test_util.h"
+
+static const int s_sizes[] = { 100, MAX_USERS };
+
+#define QUERIES 2000
+
+static double time_query(int (*search)(const char*, uint8_t*, int), const char* query, int* hits) {
+    uint8_t out[USERDB_SEARCH_MAX];
+    uint64_t start = test_now_ns();
+    for (int i = 0; i < QUERIES; ++i)
+        *hits = search(query, out, USERDB_SEARCH_MAX);
+    return (test_now_ns() - start) / (double)QUERIES / 1000.0;
+}
+
+int main(void) {
+    FILE* out = host_stdout();
+    host_stdout_mute(true);
+    fprintf(out, "%8s %-8s %-12s %8s %10s\n", "accounts", "mode", "query", "hits", "us/query");
+    for (size_t s = 0; s < sizeof(s_sizes) / sizeof(s_sizes[0]); ++s) {
+        int n = s_sizes[s];
+        test_storage_boot();
+        test_populate("bench", n);
+
+        static const struct { const char* mode; int (*fn)(const char*, uint8_t*, int); const char* query; } cases[] = {
+            { "prefix", userdb_search_prefix, "b" },
+            { "prefix", userdb_search_prefix, "bench1" },
+            { "prefix", userdb_search_prefix, "bench042" },
+            { "prefix", userdb_search_prefix, "bench0420x" },
+            { "fuzzy",  userdb_search_fuzzy,  "bh9" },
+            { "fuzzy",  userdb_search_fuzzy,  "bnch24" },
+            { "fuzzy",  userdb_search_fuzzy,  "zz" },
+        };
+        for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+            int hits = 0;
+            double us = time_query(cases[c].fn, cases[c].query, &hits);
+            fprintf(out, "%8d %-8s %-12s %8d %10.2f\n", n, cases[c].mode, cases[c].query, hits, us);
+        }
+    }
+    fflush(out);
+    host_stdout_mute(false);
+    return 0;
+}
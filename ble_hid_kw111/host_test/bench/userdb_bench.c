@@ -0,0 +1,120 @@
+// user-001: cost of every userdb operation on the host build.
+// ns/op is wall time on the host (relative numbers only: the device runs the
+// same code ~20x slower), flash B/op counts the 32-byte NVS entries written
+// by the fake flash, peak stack is what the calling task used (each case runs
+// in a fresh task, so the high water mark belongs to that operation alone).
+#include <stdlib.h>
+
+#include "test_util.h"
+
+#define BENCH_STACK 16384     // host libc is hungrier than newlib: leave headroom
+
+typedef struct {
+    const char* name;
+    userdb_op_t op;
+    void (*run)(int i);
+    int ops;
+} bench_case_t;
+
+static uint8_t s_enc[USERDB_PASSWORD_ENC_LEN];
+static int s_enc_len;
+
+static void run_add(int i) {
+    char label[MAX_LABEL_LEN];
+    snprintf(label, sizeof(label), "account-%03d", i);
+    test_add_user(label, "correct horse battery");
+}
+
+static void run_edit(int i) {
+    user_entry_t user;
+    if (userdb_get(i % user_count, &user) == 0) {
+        user.sendEnter = !user.sendEnter;
+        userdb_edit(i % user_count, &user);
+    }
+}
+
+static void run_increment(int i) {
+    userdb_increment_usage((i * 7) % user_count);
+}
+
+static void run_flush(int i) {
+    for (int k = 0; k < USERDB_USAGE_FLUSH_PENDING - 1; ++k)
+        userdb_increment_usage((i + k * 13) % user_count);
+    userdb_flush();
+}
+
+static void run_sort(int i) {
+    userdb_sort_by_usage();
+}
+
+static void run_encrypt(int i) {
+    s_enc_len = userdb_encrypt_password("correct horse battery", s_enc);
+}
+
+static void run_decrypt(int i) {
+    char plain[MAX_PASSWORD_LEN + 1];
+    userdb_decrypt_password(s_enc, s_enc_len, plain);
+}
+
+static void run_load(int i) {
+    userdb_load();
+}
+
+static void run_remove(int i) {
+    userdb_remove(user_count - 1);
+}
+
+static bench_case_t s_cases[] = {
+    { "add",             USERDB_OP_ADD,             run_add,       200 },
+    { "edit",            USERDB_OP_EDIT,            run_edit,      200 },
+    { "increment_usage", USERDB_OP_INCREMENT_USAGE, run_increment, 2000 },
+    { "flush",           USERDB_OP_FLUSH,           run_flush,     100 },
+    { "sort",            USERDB_OP_SORT,            run_sort,      200 },
+    { "encrypt",         USERDB_OP_ENCRYPT,         run_encrypt,   5000 },
+    { "decrypt",         USERDB_OP_DECRYPT,         run_decrypt,   5000 },
+    { "load",            USERDB_OP_LOAD,            run_load,      50 },
+    { "remove",          USERDB_OP_REMOVE,          run_remove,    100 },
+};
+
+typedef struct {
+    bench_case_t* bc;
+    uint64_t elapsed_ns;
+} bench_run_t;
+
+static void bench_task(void* arg) {
+    bench_run_t* run = arg;
+    uint64_t start = test_now_ns();
+    for (int i = 0; i < run->bc->ops; ++i)
+        run->bc->run(i);
+    run->elapsed_ns = test_now_ns() - start;
+}
+
+static void bench_case(bench_case_t* bc, FILE* out) {
+    bench_run_t run = { bc, 0 };
+    userdb_stats_reset();
+    host_nvs_reset_stats();
+    test_run_in_task(bc->name, bench_task, &run, BENCH_STACK);
+
+    userdb_op_stats_t st;
+    host_nvs_stats_t nvs;
+    userdb_stats_get(bc->op, &st);
+    host_nvs_get_stats(&nvs);
+    uint32_t calls = st.calls ? st.calls : 1;
+    fprintf(out, "%-16s %8lu %12.0f %12.1f %12.1f %10lu\n", bc->name,
+            (unsigned long)st.calls, (double)run.elapsed_ns / bc->ops,
+            (double)st.flash_bytes / calls, (double)nvs.bytes_written / calls,
+            (unsigned long)(BENCH_STACK - st.min_free_stack));
+}
+
+int main(void) {
+    host_stdout_mute(true);             // user_print/userdb_dump of every add
+    test_storage_boot();
+    FILE* out = host_stdout();
+    fprintf(out, "%-16s %8s %12s %12s %12s %10s\n",
+            "op", "ops", "ns/op", "flash B/op", "nvs B/op", "stack B");
+    for (size_t c = 0; c < sizeof(s_cases) / sizeof(s_cases[0]); ++c)
+        bench_case(&s_cases[c], out);
+    fflush(out);
+    host_stdout_mute(false);
+    return 0;
+}
@@ -0,0 +1,54 @@
+// user-018: throughput of the UTF-8 decoding in the keystroke compiler,
+// characters per second through hid_program_add_text for ASCII, Latin-1,
+// mixed text and characters outside the layout (fallback)
+#include "hid_layout.h"
+#include "hid_program.h"
+#include "test_util.h"
+
+#define ROUNDS  20000
+
+typedef struct {
+    const char* name;
+    const char* text;
+    uint8_t layout;
+    uint8_t fallback;
+} utf8_case_t;
+
+static const utf8_case_t s_cases[] = {
+    { "ascii",    "The quick brown fox jumps over the lazy dog 0123456789", HID_LAYOUT_US, HID_FALLBACK_SKIP },
+    { "latin1",   "àèéìòùçàèéìòùçàèéìòùçàèéìòù", HID_LAYOUT_IT, HID_FALLBACK_SKIP },
+    { "mixed",    "Perché è così? Però sì, città 42!", HID_LAYOUT_IT, HID_FALLBACK_SKIP },
+    { "fallback", "€ñ€ñ€ñ€ñ€ñ€ñ€ñ€ñ", HID_LAYOUT_US, HID_FALLBACK_HEX_CODE },
+};
+
+static size_t count_chars(const char* s) {
+    size_t n = 0;
+    for (; *s; ++s)
+        n += ((uint8_t)*s & 0xC0) != 0x80;
+    return n;
+}
+
+int main(void) {
+    printf("%-10s %6s %6s %12s %14s\n", "text", "bytes", "chars", "ns/char", "chars/s");
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); ++i) {
+        const utf8_case_t* c = &s_cases[i];
+        size_t bytes = strlen(c->text), chars = count_chars(c->text);
+        hid_program_t prog;
+        uint64_t start = test_now_ns();
+        for (int r = 0; r < ROUNDS; ++r) {
+            // Un programma contiene al piu' HID_PROGRAM_MAX_OPS op: il testo passa a pezzi
+            const char* p = c->text;
+            while (*p) {
+                hid_program_init(&prog);
+                size_t used = hid_program_add_text(&prog, p, c->layout, c->fallback);
+                if (used == 0)
+                    break;
+                p += used;
+            }
+        }
+        double ns = (double)(test_now_ns() - start) / ROUNDS / chars;
+        printf("%-10s %6zu %6zu %12.1f %14.0f\n", c->name, bytes, chars, ns, 1e9 / ns);
+        hid_program_wipe(&prog);
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+// Board peripherals on the host: display, buzzer, deep sleep and the
+// fingerprint sensor entry points used by the BLE profile do nothing
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "display_oled.h"
+#include "buzzer.h"
+#include "host_fakes.h"
+
+static volatile uint32_t s_sleep_requests = 0;
+static volatile uint32_t s_enroll_requests = 0;
+
+esp_err_t display_oled_init(void) { return ESP_OK; }
+void display_oled_set_text(const char* text) {}
+void display_oled_printf(const char* format, ...) {}
+void display_oled_post_info(const char* format, ...) {}
+void display_oled_post_error(const char* format, ...) {}
+void display_oled_set_battery_percent(int percent) {}
+void display_oled_set_battery_level(int level) {}
+void display_oled_set_charging(bool charging) {}
+void display_oled_set_ble_connected(bool connected) {}
+void display_oled_set_usb_initialized(bool initialized) {}
+void display_oled_deinit(void) {}
+
+esp_err_t buzzer_init(void) { return ESP_OK; }
+void buzzer_feedback_success(void) {}
+void buzzer_feedback_fail(void) {}
+void buzzer_feedback_noauth(void) {}
+void buzzer_feedback_lift(void) {}
+void buzzer_feedback_long(void) {}
+
+void enter_deep_sleep(void) {
+    __atomic_add_fetch(&s_sleep_requests, 1, __ATOMIC_RELAXED);
+}
+
+bool enrollFinger(void) {
+    __atomic_add_fetch(&s_enroll_requests, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+bool clearFingerprintDB(void) {
+    return true;
+}
+
+uint32_t host_board_sleep_requests(void) {
+    return __atomic_load_n(&s_sleep_requests, __ATOMIC_RELAXED);
+}
+
+uint32_t host_board_enroll_requests(void) {
+    return __atomic_load_n(&s_enroll_requests, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,756 @@
+// Bluedroid and the BLE peer on the host.
+//
+// Like Bluedroid, GAP/GATTS callbacks run on one stack thread ("btc") fed by a
+// queue, so an API call returns before its event is handled. Notifications go
+// to a controller buffer of a few packets that a link thread drains at the
+// connection interval; a full buffer raises ESP_GATTS_CONGEST_EVT and further
+// packets are dropped and counted as lost. The peer answers connection
+// parameter requests as set with host_ble_set_update_mode().
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_bt_device.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gatts_api.h"
+#include "esp_gatt_common_api.h"
+#include "host_fakes.h"
+
+#define FIRST_GATTS_IF      3
+#define FIRST_HANDLE        40
+#define MAX_HANDLES         256
+#define MAX_TX_BUFFERS      64
+#define DEFAULT_TX_BUFFERS  8
+
+typedef struct bt_event {
+    struct bt_event* next;
+    bool gap;
+    int event;
+    esp_gatt_if_t gatts_if;
+    union {
+        esp_ble_gap_cb_param_t gap;
+        esp_ble_gatts_cb_param_t gatts;
+    } param;
+    void* owned;                    // handles of a table, value of a write
+    bool set_link;                  // the peer applies new connection parameters
+    uint16_t conn_int;
+    uint16_t latency;
+} bt_event_t;
+
+typedef struct packet {
+    struct packet* next;
+    uint16_t handle;
+    uint16_t len;
+    uint64_t t_us;
+    uint8_t data[ESP_GATT_MAX_MTU_SIZE];
+} packet_t;
+
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_event_cond;     // btc: new event / queue drained
+static pthread_cond_t s_link_cond;      // link: packets queued, parameters changed
+static pthread_cond_t s_peer_cond;      // test: notification received
+
+static esp_gap_ble_cb_t s_gap_cb = NULL;
+static esp_gatts_cb_t s_gatts_cb = NULL;
+static bt_event_t* s_events_head = NULL;
+static bt_event_t* s_events_tail = NULL;
+static bool s_btc_busy = false;
+static pthread_t s_btc_thread;
+
+static esp_gatt_if_t s_next_if = FIRST_GATTS_IF;
+static esp_gatt_if_t s_app_if = ESP_GATT_IF_NONE;      // interfaccia dell'ultima app registrata
+static uint16_t s_next_handle = FIRST_HANDLE;
+static struct { uint16_t len; uint8_t* value; } s_attr[MAX_HANDLES];
+
+static const esp_bd_addr_t s_peer_addr = { 0x5c, 0xf3, 0x70, 0x11, 0x22, 0x33 };
+static const uint8_t s_local_addr[6] = { 0x24, 0x58, 0x7c, 0x12, 0x34, 0x58 };
+static bool s_connected = false;
+static uint16_t s_conn_int = 0x18;
+static uint16_t s_latency = 0;
+static uint16_t s_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+static uint64_t s_anchor_us = 0;        // istante di un connection event
+static host_ble_update_mode_t s_update_mode = HOST_BLE_UPDATE_ASYNC;
+static bool s_write_timing = false;     // host_ble_set_write_timing
+static bt_event_t* s_held_update = NULL;    // HOST_BLE_UPDATE_HOLD: risposta non ancora consegnata
+
+static packet_t* s_tx_head = NULL;
+static packet_t* s_tx_tail = NULL;
+static unsigned s_tx_count = 0;
+static unsigned s_tx_buffers = DEFAULT_TX_BUFFERS;
+static unsigned s_per_event = 1;
+static bool s_congested = false;
+static uint16_t s_report_handle = 0;
+static host_ble_report_cb_t s_report_cb = NULL;
+static void* s_report_arg = NULL;
+
+static packet_t* s_rx_head = NULL;      // notifiche ricevute dal peer (non report)
+static packet_t* s_rx_tail = NULL;
+static host_ble_stats_t s_stats;
+
+static void* btc_thread(void* arg);
+static void* link_thread(void* arg);
+
+static void init_cond(pthread_cond_t* cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void bt_start(void) {
+    pthread_t link;
+    init_cond(&s_event_cond);
+    init_cond(&s_link_cond);
+    init_cond(&s_peer_cond);
+    pthread_create(&s_btc_thread, NULL, btc_thread, NULL);
+    pthread_create(&link, NULL, link_thread, NULL);
+    pthread_detach(link);
+}
+
+static void wait_until(pthread_cond_t* cond, uint64_t at_us) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t delta = (int64_t)at_us - (int64_t)host_now_us();
+    if (delta < 0)
+        delta = 0;
+    uint64_t ns = (uint64_t)ts.tv_nsec + (uint64_t)delta * 1000u;
+    ts.tv_sec += ns / 1000000000u;
+    ts.tv_nsec = ns % 1000000000u;
+    pthread_cond_timedwait(cond, &s_lock, &ts);
+}
+
+/************* Stack thread ****************/
+
+static bt_event_t* new_event(bool gap, int event) {
+    bt_event_t* ev = calloc(1, sizeof(*ev));
+    ev->gap = gap;
+    ev->event = event;
+    ev->gatts_if = s_app_if;
+    return ev;
+}
+
+// With s_lock held
+static void post_locked(bt_event_t* ev) {
+    if (s_events_tail)
+        s_events_tail->next = ev;
+    else
+        s_events_head = ev;
+    s_events_tail = ev;
+    pthread_cond_broadcast(&s_event_cond);
+}
+
+static void post(bt_event_t* ev) {
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    post_locked(ev);
+    pthread_mutex_unlock(&s_lock);
+}
+
+// With s_lock held: the peer starts using new parameters
+static void apply_link_locked(uint16_t conn_int, uint16_t latency) {
+    s_conn_int = conn_int;
+    s_latency = latency;
+    s_anchor_us = host_now_us();
+    pthread_cond_broadcast(&s_link_cond);
+}
+
+static void dispatch(bt_event_t* ev) {
+    if (ev->set_link) {
+        pthread_mutex_lock(&s_lock);
+        apply_link_locked(ev->conn_int, ev->latency);
+        pthread_mutex_unlock(&s_lock);
+    }
+    if (ev->gap) {
+        if (s_gap_cb)
+            s_gap_cb(ev->event, &ev->param.gap);
+    } else if (s_gatts_cb) {
+        s_gatts_cb(ev->event, ev->gatts_if, &ev->param.gatts);
+    }
+    free(ev->owned);
+    free(ev);
+}
+
+static void* btc_thread(void* arg) {
+    pthread_mutex_lock(&s_lock);
+    for (;;) {
+        while (s_events_head == NULL)
+            pthread_cond_wait(&s_event_cond, &s_lock);
+        bt_event_t* ev = s_events_head;
+        s_events_head = ev->next;
+        if (s_events_head == NULL)
+            s_events_tail = NULL;
+        s_btc_busy = true;
+        pthread_mutex_unlock(&s_lock);
+        dispatch(ev);
+        pthread_mutex_lock(&s_lock);
+        s_btc_busy = false;
+        pthread_cond_broadcast(&s_event_cond);
+    }
+    return NULL;
+}
+
+void host_ble_sync(void) {
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    while (s_events_head != NULL || s_btc_busy)
+        pthread_cond_wait(&s_event_cond, &s_lock);
+    pthread_mutex_unlock(&s_lock);
+}
+
+/************* Link ****************/
+
+static void free_packets(packet_t** head, packet_t** tail) {
+    while (*head) {
+        packet_t* p = *head;
+        *head = p->next;
+        free(p);
+    }
+    *tail = NULL;
+}
+
+static void* link_thread(void* arg) {
+    pthread_mutex_lock(&s_lock);
+    for (;;) {
+        if (!s_connected || s_tx_head == NULL) {
+            pthread_cond_wait(&s_link_cond, &s_lock);
+            continue;
+        }
+        // Prossimo connection event
+        uint64_t interval_us = (uint64_t)s_conn_int * 1250u;
+        uint64_t now = host_now_us();
+        uint64_t next = s_anchor_us + ((now - s_anchor_us) / interval_us + 1) * interval_us;
+        uint16_t conn_int = s_conn_int;
+        wait_until(&s_link_cond, next);
+        if (!s_connected || conn_int != s_conn_int || host_now_us() < next)
+            continue;
+
+        packet_t* sent = NULL;
+        packet_t** sent_tail = &sent;
+        for (unsigned i = 0; i < s_per_event && s_tx_head; ++i) {
+            packet_t* p = s_tx_head;
+            s_tx_head = p->next;
+            if (s_tx_head == NULL)
+                s_tx_tail = NULL;
+            s_tx_count--;
+            p->next = NULL;
+            p->t_us = host_now_us();
+            *sent_tail = p;
+            sent_tail = &p->next;
+        }
+        if (s_congested && s_tx_count <= s_tx_buffers / 2) {
+            s_congested = false;
+            bt_event_t* ev = new_event(false, ESP_GATTS_CONGEST_EVT);
+            ev->param.gatts.congest.congested = false;
+            post_locked(ev);
+        }
+        host_ble_report_cb_t report_cb = s_report_cb;
+        void* report_arg = s_report_arg;
+        uint16_t report_handle = s_report_handle;
+        pthread_mutex_unlock(&s_lock);
+
+        // Il peer riceve: i report alla tastiera virtuale, il resto alla coda del test
+        while (sent) {
+            packet_t* p = sent;
+            sent = p->next;
+            p->next = NULL;
+            if (report_handle != 0 && p->handle == report_handle) {
+                if (report_cb)
+                    report_cb(p->data, p->len, p->t_us, report_arg);
+                pthread_mutex_lock(&s_lock);
+                s_stats.reports++;
+                pthread_mutex_unlock(&s_lock);
+                free(p);
+            } else {
+                pthread_mutex_lock(&s_lock);
+                s_stats.notifications++;
+                s_stats.notification_bytes += p->len;
+                if (s_rx_tail)
+                    s_rx_tail->next = p;
+                else
+                    s_rx_head = p;
+                s_rx_tail = p;
+                pthread_cond_broadcast(&s_peer_cond);
+                pthread_mutex_unlock(&s_lock);
+            }
+        }
+        pthread_mutex_lock(&s_lock);
+    }
+    return NULL;
+}
+
+size_t host_ble_take_notification(uint16_t handle, uint8_t* out, size_t max, uint32_t timeout_ms) {
+    uint64_t deadline = host_now_us() + (uint64_t)timeout_ms * 1000u;
+    size_t len = 0;
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    for (;;) {
+        packet_t** link = &s_rx_head;
+        packet_t* prev = NULL;
+        while (*link && (*link)->handle != handle) {
+            prev = *link;
+            link = &(*link)->next;
+        }
+        if (*link) {
+            packet_t* p = *link;
+            *link = p->next;
+            if (s_rx_tail == p)
+                s_rx_tail = prev;
+            len = p->len < max ? p->len : max;
+            memcpy(out, p->data, len);
+            free(p);
+            break;
+        }
+        if (host_now_us() >= deadline)
+            break;
+        wait_until(&s_peer_cond, deadline);
+    }
+    pthread_mutex_unlock(&s_lock);
+    return len;
+}
+
+// With s_lock held: sleeps until the connection event after now
+static void wait_next_event_locked(void) {
+    uint64_t interval_us = (uint64_t)s_conn_int * 1250u;
+    uint64_t now = host_now_us();
+    uint64_t next = s_anchor_us + ((now - s_anchor_us) / interval_us + 1) * interval_us;
+    while (s_connected && host_now_us() < next)
+        wait_until(&s_peer_cond, next);
+}
+
+/************* Test controls ****************/
+
+void host_ble_reset(void) {
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    s_connected = false;
+    s_update_mode = HOST_BLE_UPDATE_ASYNC;
+    s_tx_buffers = DEFAULT_TX_BUFFERS;
+    s_per_event = 1;
+    s_congested = false;
+    s_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+    s_write_timing = false;
+    free(s_held_update);
+    s_held_update = NULL;
+    free_packets(&s_tx_head, &s_tx_tail);
+    free_packets(&s_rx_head, &s_rx_tail);
+    s_tx_count = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_ble_set_update_mode(host_ble_update_mode_t mode) {
+    pthread_mutex_lock(&s_lock);
+    s_update_mode = mode;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_ble_set_tx_buffers(unsigned count) {
+    pthread_mutex_lock(&s_lock);
+    s_tx_buffers = count == 0 ? 1 : count > MAX_TX_BUFFERS ? MAX_TX_BUFFERS : count;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_ble_set_packets_per_event(unsigned count) {
+    pthread_mutex_lock(&s_lock);
+    s_per_event = count == 0 ? 1 : count;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_ble_set_report_handle(uint16_t handle) {
+    pthread_mutex_lock(&s_lock);
+    s_report_handle = handle;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_ble_set_report_cb(host_ble_report_cb_t cb, void* arg) {
+    pthread_mutex_lock(&s_lock);
+    s_report_cb = cb;
+    s_report_arg = arg;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_ble_set_write_timing(bool enabled) {
+    pthread_mutex_lock(&s_lock);
+    s_write_timing = enabled;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_ble_get_stats(host_ble_stats_t* out) {
+    pthread_mutex_lock(&s_lock);
+    *out = s_stats;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_ble_reset_stats(void) {
+    pthread_mutex_lock(&s_lock);
+    memset(&s_stats, 0, sizeof(s_stats));
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_ble_connect(uint16_t conn_int, uint16_t latency) {
+    bt_event_t* ev = new_event(false, ESP_GATTS_CONNECT_EVT);
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    s_connected = true;
+    s_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+    s_congested = false;
+    apply_link_locked(conn_int, latency);
+    ev->gatts_if = s_app_if;
+    ev->param.gatts.connect.conn_id = 0;
+    memcpy(ev->param.gatts.connect.remote_bda, s_peer_addr, sizeof(esp_bd_addr_t));
+    ev->param.gatts.connect.conn_params.interval = conn_int;
+    ev->param.gatts.connect.conn_params.latency = latency;
+    ev->param.gatts.connect.conn_params.timeout = 400;
+    post_locked(ev);
+    pthread_mutex_unlock(&s_lock);
+}
+
+// With s_lock held
+static void disconnect_locked(int reason) {
+    if (!s_connected)
+        return;
+    s_connected = false;
+    free(s_held_update);
+    s_held_update = NULL;
+    free_packets(&s_tx_head, &s_tx_tail);
+    s_tx_count = 0;
+    s_congested = false;
+    bt_event_t* ev = new_event(false, ESP_GATTS_DISCONNECT_EVT);
+    ev->param.gatts.disconnect.conn_id = 0;
+    ev->param.gatts.disconnect.reason = reason;
+    memcpy(ev->param.gatts.disconnect.remote_bda, s_peer_addr, sizeof(esp_bd_addr_t));
+    post_locked(ev);
+    pthread_cond_broadcast(&s_link_cond);
+}
+
+void host_ble_disconnect(void) {
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    disconnect_locked(0x13);        // remote user terminated
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_ble_set_mtu(uint16_t mtu) {
+    bt_event_t* ev = new_event(false, ESP_GATTS_MTU_EVT);
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    s_mtu = mtu > ESP_GATT_MAX_MTU_SIZE ? ESP_GATT_MAX_MTU_SIZE : mtu;
+    ev->gatts_if = s_app_if;
+    ev->param.gatts.mtu.mtu = s_mtu;
+    post_locked(ev);
+    pthread_mutex_unlock(&s_lock);
+}
+
+static bt_event_t* conn_update_event(bool success, uint16_t conn_int, uint16_t latency) {
+    bt_event_t* ev = new_event(true, ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT);
+    ev->param.gap.update_conn_params.status = success ? ESP_BT_STATUS_SUCCESS : ESP_BT_STATUS_FAIL;
+    memcpy(ev->param.gap.update_conn_params.bda, s_peer_addr, sizeof(esp_bd_addr_t));
+    ev->param.gap.update_conn_params.conn_int = conn_int;
+    ev->param.gap.update_conn_params.latency = latency;
+    ev->param.gap.update_conn_params.timeout = 600;
+    ev->set_link = success;
+    ev->conn_int = conn_int;
+    ev->latency = latency;
+    return ev;
+}
+
+void host_ble_release_update(void) {
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    if (s_held_update && s_connected)
+        post_locked(s_held_update);
+    else
+        free(s_held_update);
+    s_held_update = NULL;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_ble_peer_update(uint16_t conn_int, uint16_t latency) {
+    post(conn_update_event(true, conn_int, latency));
+}
+
+void host_ble_write(uint16_t handle, const uint8_t* data, size_t len) {
+    bt_event_t* ev = new_event(false, ESP_GATTS_WRITE_EVT);
+    uint8_t* value = malloc(len ? len : 1);
+    memcpy(value, data, len);
+    ev->owned = value;
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    ev->gatts_if = s_app_if;
+    ev->param.gatts.write.conn_id = 0;
+    memcpy(ev->param.gatts.write.bda, s_peer_addr, sizeof(esp_bd_addr_t));
+    ev->param.gatts.write.handle = handle;
+    ev->param.gatts.write.len = len;
+    ev->param.gatts.write.value = value;
+    s_stats.writes++;
+    // Write request: sent at the next connection event, the response comes back at the following one
+    bool timing = s_write_timing;
+    if (timing)
+        wait_next_event_locked();
+    post_locked(ev);
+    pthread_mutex_unlock(&s_lock);
+    host_ble_sync();
+    if (timing) {
+        pthread_mutex_lock(&s_lock);
+        wait_next_event_locked();
+        pthread_mutex_unlock(&s_lock);
+    }
+}
+
+/************* Controller, Bluedroid ****************/
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode) { return ESP_OK; }
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t* cfg) { return ESP_OK; }
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode) { return ESP_OK; }
+
+esp_err_t esp_bluedroid_init(void) {
+    pthread_once(&s_once, bt_start);
+    return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_enable(void) { return ESP_OK; }
+
+const uint8_t* esp_bt_dev_get_address(void) {
+    return s_local_addr;
+}
+
+esp_err_t esp_ble_gatt_set_local_mtu(uint16_t mtu) {
+    return mtu >= ESP_GATT_DEF_BLE_MTU_SIZE && mtu <= ESP_GATT_MAX_MTU_SIZE ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+/************* GAP ****************/
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback) {
+    s_gap_cb = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_config_adv_data(esp_ble_adv_data_t* adv_data) {
+    bt_event_t* ev = new_event(true, adv_data->set_scan_rsp ? ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT
+                                                           : ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT);
+    post(ev);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_config_local_icon(uint16_t icon) { return ESP_OK; }
+
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t* adv_params) {
+    bt_event_t* ev = new_event(true, ESP_GAP_BLE_ADV_START_COMPLETE_EVT);
+    ev->param.gap.adv_start_cmpl.status = ESP_BT_STATUS_SUCCESS;
+    post(ev);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_stop_advertising(void) { return ESP_OK; }
+esp_err_t esp_ble_gap_security_rsp(esp_bd_addr_t bd_addr, bool accept) { return ESP_OK; }
+
+esp_err_t esp_ble_gap_disconnect(esp_bd_addr_t remote_device) {
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    disconnect_locked(0x16);        // terminated by local host
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+// Free controller buffers right now (the congest event only follows through the stack thread)
+uint16_t esp_ble_get_cur_sendable_packets_num(uint16_t connid) {
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    uint16_t n = s_connected && s_tx_count < s_tx_buffers ? s_tx_buffers - s_tx_count : 0;
+    pthread_mutex_unlock(&s_lock);
+    return n;
+}
+
+esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t* params) {
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    s_stats.update_requests++;
+    s_stats.last_min_int = params->min_int;
+    s_stats.last_max_int = params->max_int;
+    s_stats.last_latency = params->latency;
+    host_ble_update_mode_t mode = s_update_mode;
+    bool connected = s_connected;
+    uint16_t conn_int = s_conn_int;
+    uint16_t latency = s_latency;
+    // One procedure at a time: the held answer comes before this one
+    if (s_held_update && connected)
+        post_locked(s_held_update);
+    s_held_update = NULL;
+    pthread_mutex_unlock(&s_lock);
+    if (!connected)
+        return ESP_OK;      // come Bluedroid: l'errore arriverebbe solo nel log del controller
+
+    switch (mode) {
+        case HOST_BLE_UPDATE_HOLD: {
+            bt_event_t* ev = conn_update_event(true, params->max_int, params->latency);
+            pthread_mutex_lock(&s_lock);
+            s_held_update = ev;
+            pthread_mutex_unlock(&s_lock);
+            break;
+        }
+        case HOST_BLE_UPDATE_ASYNC:
+            post(conn_update_event(true, params->max_int, params->latency));
+            break;
+        case HOST_BLE_UPDATE_BEFORE_RETURN:
+            // The stack thread runs before the caller gets back from the API
+            dispatch(conn_update_event(true, params->max_int, params->latency));
+            break;
+        case HOST_BLE_UPDATE_REJECT:
+            post(conn_update_event(false, conn_int, latency));
+            break;
+        case HOST_BLE_UPDATE_NEVER:
+            break;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_set_device_name(const char* name) { return ESP_OK; }
+
+esp_err_t esp_ble_gap_set_security_param(esp_ble_sm_param_t param_type, void* value, uint8_t len) {
+    return value != NULL && len > 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_ble_gap_update_whitelist(bool add_remove, esp_bd_addr_t remote_bda, int wl_addr_type) { return ESP_OK; }
+esp_err_t esp_ble_gap_clear_whitelist(void) { return ESP_OK; }
+esp_err_t esp_ble_gap_set_pkt_data_len(esp_bd_addr_t remote_device, uint16_t tx_data_length) { return ESP_OK; }
+esp_err_t esp_ble_set_encryption(esp_bd_addr_t bd_addr, int sec_act) { return ESP_OK; }
+int esp_ble_get_bond_device_num(void) { return 0; }
+
+esp_err_t esp_ble_get_bond_device_list(int* dev_num, esp_ble_bond_dev_t* dev_list) {
+    *dev_num = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_remove_bond_device(esp_bd_addr_t bd_addr) { return ESP_OK; }
+
+/************* GATTS ****************/
+
+esp_err_t esp_ble_gatts_register_callback(esp_gatts_cb_t callback) {
+    s_gatts_cb = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_app_register(uint16_t app_id) {
+    bt_event_t* ev = new_event(false, ESP_GATTS_REG_EVT);
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    ev->gatts_if = s_next_if++;
+    s_app_if = ev->gatts_if;
+    ev->param.gatts.reg.status = ESP_GATT_OK;
+    ev->param.gatts.reg.app_id = app_id;
+    post_locked(ev);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_app_unregister(esp_gatt_if_t gatts_if) { return ESP_OK; }
+
+esp_err_t esp_ble_gatts_create_attr_tab(const esp_gatts_attr_db_t* gatts_attr_db, esp_gatt_if_t gatts_if,
+                                        uint16_t max_nb_attr, uint8_t srvc_inst_id) {
+    bt_event_t* ev = new_event(false, ESP_GATTS_CREAT_ATTR_TAB_EVT);
+    uint16_t* handles = calloc(max_nb_attr, sizeof(uint16_t));
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    if (s_next_handle + max_nb_attr > MAX_HANDLES) {
+        pthread_mutex_unlock(&s_lock);
+        free(handles);
+        free(ev);
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint16_t i = 0; i < max_nb_attr; ++i) {
+        uint16_t h = s_next_handle++;
+        const esp_attr_desc_t* desc = &gatts_attr_db[i].att_desc;
+        handles[i] = h;
+        s_attr[h].len = desc->value ? desc->length : 0;
+        s_attr[h].value = calloc(1, desc->max_length > desc->length ? desc->max_length : desc->length + 1);
+        if (desc->value)
+            memcpy(s_attr[h].value, desc->value, desc->length);
+    }
+    const esp_attr_desc_t* svc = &gatts_attr_db[0].att_desc;
+    ev->gatts_if = gatts_if;
+    ev->owned = handles;
+    ev->param.gatts.add_attr_tab.status = ESP_GATT_OK;
+    ev->param.gatts.add_attr_tab.svc_uuid.len = ESP_UUID_LEN_16;
+    if (svc->value && svc->length == 2)
+        ev->param.gatts.add_attr_tab.svc_uuid.uuid.uuid16 = svc->value[0] | (svc->value[1] << 8);
+    ev->param.gatts.add_attr_tab.svc_inst_id = srvc_inst_id;
+    ev->param.gatts.add_attr_tab.num_handle = max_nb_attr;
+    ev->param.gatts.add_attr_tab.handles = handles;
+    post_locked(ev);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_start_service(uint16_t service_handle) { return ESP_OK; }
+esp_err_t esp_ble_gatts_stop_service(uint16_t service_handle) { return ESP_OK; }
+esp_err_t esp_ble_gatts_delete_service(uint16_t service_handle) { return ESP_OK; }
+
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id, uint16_t attr_handle,
+                                      uint16_t value_len, uint8_t* value, bool need_confirm) {
+    pthread_once(&s_once, bt_start);
+    pthread_mutex_lock(&s_lock);
+    if (!s_connected) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_OK;      // scartato dallo stack, come sul dispositivo
+    }
+    if (s_tx_count >= s_tx_buffers) {
+        s_stats.lost++;
+        pthread_mutex_unlock(&s_lock);
+        return ESP_OK;
+    }
+    packet_t* p = calloc(1, sizeof(*p));
+    p->handle = attr_handle;
+    if (need_confirm && attr_handle != s_report_handle)
+        s_stats.indications++;
+    // The ATT payload of a notification is at most MTU - 3 bytes
+    p->len = value_len > s_mtu - 3 ? s_mtu - 3 : value_len;
+    memcpy(p->data, value, p->len);
+    if (s_tx_tail)
+        s_tx_tail->next = p;
+    else
+        s_tx_head = p;
+    s_tx_tail = p;
+    s_tx_count++;
+    if (s_tx_count > s_stats.max_queued)
+        s_stats.max_queued = s_tx_count;
+    if (s_tx_count >= s_tx_buffers && !s_congested) {
+        s_congested = true;
+        s_stats.congest_events++;
+        bt_event_t* ev = new_event(false, ESP_GATTS_CONGEST_EVT);
+        ev->param.gatts.congest.congested = true;
+        post_locked(ev);
+    }
+    pthread_cond_broadcast(&s_link_cond);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_send_response(esp_gatt_if_t gatts_if, uint16_t conn_id, uint32_t trans_id,
+                                      esp_gatt_status_t status, esp_gatt_rsp_t* rsp) {
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_set_attr_value(uint16_t attr_handle, uint16_t length, const uint8_t* value) {
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (attr_handle < MAX_HANDLES && s_attr[attr_handle].value) {
+        memcpy(s_attr[attr_handle].value, value, length);
+        s_attr[attr_handle].len = length;
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_gatt_status_t esp_ble_gatts_get_attr_value(uint16_t attr_handle, uint16_t* length, const uint8_t** value) {
+    if (attr_handle >= MAX_HANDLES || s_attr[attr_handle].value == NULL)
+        return 1;       // ESP_GATT_INVALID_HANDLE
+    *length = s_attr[attr_handle].len;
+    *value = s_attr[attr_handle].value;
+    return ESP_GATT_OK;
+}
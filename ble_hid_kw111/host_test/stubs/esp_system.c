@@ -0,0 +1,218 @@
+// esp_err, esp_log, esp_random, esp_hmac and esp_mac on the host
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_hmac.h"
+#include "esp_mac.h"
+#include "host_fakes.h"
+
+/************* esp_err ****************/
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:                        return "ESP_OK";
+        case ESP_FAIL:                      return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:                return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:           return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:         return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:          return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:             return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:         return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:               return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE:      return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_NVS_NOT_INITIALIZED:   return "ESP_ERR_NVS_NOT_INITIALIZED";
+        case ESP_ERR_NVS_NOT_FOUND:         return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_INVALID_HANDLE:    return "ESP_ERR_NVS_INVALID_HANDLE";
+        case ESP_ERR_NVS_KEY_TOO_LONG:      return "ESP_ERR_NVS_KEY_TOO_LONG";
+        case ESP_ERR_NVS_INVALID_LENGTH:    return "ESP_ERR_NVS_INVALID_LENGTH";
+        case ESP_ERR_NVS_READ_ONLY:         return "ESP_ERR_NVS_READ_ONLY";
+        case ESP_ERR_NVS_PART_NOT_FOUND:    return "ESP_ERR_NVS_PART_NOT_FOUND";
+        case ESP_ERR_NVS_TYPE_MISMATCH:     return "ESP_ERR_NVS_TYPE_MISMATCH";
+        default:                            return "ESP_ERR_UNKNOWN";
+    }
+}
+
+/************* esp_log ****************/
+
+static int s_log_level = -1;
+static FILE* s_stdout_saved = NULL;
+
+void host_log_set_level(esp_log_level_t level) {
+    s_log_level = level;
+}
+
+static int host_log_level(void) {
+    if (s_log_level < 0) {
+        const char* env = getenv("HOST_LOG_LEVEL");
+        s_log_level = env ? atoi(env) : ESP_LOG_WARN;
+    }
+    return s_log_level;
+}
+
+void host_log(esp_log_level_t level, const char* tag, const char* format, ...) {
+    static const char letters[] = "NEWIDV";
+    if ((int)level > host_log_level())
+        return;
+    va_list ap;
+    va_start(ap, format);
+    flockfile(stderr);
+    fprintf(stderr, "%c (%llu) %s: ", letters[level], (unsigned long long)(host_now_us() / 1000), tag);
+    vfprintf(stderr, format, ap);
+    fputc('\n', stderr);
+    funlockfile(stderr);
+    va_end(ap);
+}
+
+void host_log_buffer_hex(const char* tag, const void* buffer, size_t len) {
+    if (host_log_level() < ESP_LOG_INFO)
+        return;
+    const uint8_t* b = buffer;
+    flockfile(stderr);
+    fprintf(stderr, "I %s: ", tag);
+    for (size_t i = 0; i < len; ++i)
+        fprintf(stderr, "%02x ", b[i]);
+    fputc('\n', stderr);
+    funlockfile(stderr);
+}
+
+// The firmware prints with printf: benchmarks send stdout to /dev/null and
+// keep their own report on a duplicate of the original descriptor
+static int s_stdout_fd = -1;
+static bool s_stdout_muted = false;
+
+FILE* host_stdout(void) {
+    if (s_stdout_saved == NULL) {
+        fflush(stdout);
+        s_stdout_fd = dup(STDOUT_FILENO);
+        s_stdout_saved = fdopen(dup(s_stdout_fd), "w");
+    }
+    return s_stdout_saved;
+}
+
+void host_stdout_mute(bool mute) {
+    host_stdout();
+    fflush(stdout);
+    if (mute && !s_stdout_muted) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        close(null_fd);
+    } else if (!mute && s_stdout_muted) {
+        dup2(s_stdout_fd, STDOUT_FILENO);
+    }
+    s_stdout_muted = mute;
+}
+
+bool host_stdout_muted(void) {
+    return s_stdout_muted;
+}
+
+/************* Interleaving ****************/
+
+static volatile bool s_interleave = false;
+
+void host_set_interleave(bool on) {
+    s_interleave = on;
+}
+
+void host_interleave_point(void) {
+    if (s_interleave)
+        sched_yield();
+}
+
+/************* esp_random ****************/
+
+static pthread_mutex_t s_random_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t s_random_state = 0x853c49e6748fea9bULL;
+
+void host_random_seed(uint32_t seed) {
+    pthread_mutex_lock(&s_random_lock);
+    s_random_state = 0x853c49e6748fea9bULL ^ ((uint64_t)seed << 17) ^ seed;
+    pthread_mutex_unlock(&s_random_lock);
+}
+
+// splitmix64: reproducible runs, not a CSPRNG
+uint32_t esp_random(void) {
+    pthread_mutex_lock(&s_random_lock);
+    uint64_t z = (s_random_state += 0x9e3779b97f4a7c15ULL);
+    pthread_mutex_unlock(&s_random_lock);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (uint32_t)(z ^ (z >> 31));
+}
+
+void esp_fill_random(void* buf, size_t len) {
+    host_interleave_point();
+    uint8_t* out = buf;
+    while (len > 0) {
+        uint32_t r = esp_random();
+        size_t n = len < sizeof(r) ? len : sizeof(r);
+        memcpy(out, &r, n);
+        out += n;
+        len -= n;
+    }
+}
+
+/************* esp_hmac ****************/
+
+static uint8_t s_efuse_key[32] = {
+    0x42, 0x4c, 0x45, 0x20, 0x50, 0x61, 0x73, 0x73, 0x4d, 0x61, 0x6e, 0x20, 0x68, 0x6f, 0x73, 0x74,
+    0x20, 0x65, 0x46, 0x75, 0x73, 0x65, 0x20, 0x6b, 0x65, 0x79, 0x20, 0x30, 0x00, 0x01, 0x02, 0x03,
+};
+static bool s_hmac_fail = false;
+static volatile uint32_t s_hmac_calls = 0;
+
+void host_hmac_set_key(const uint8_t key[32]) {
+    memcpy(s_efuse_key, key, sizeof(s_efuse_key));
+}
+
+void host_hmac_set_fail(bool fail) {
+    s_hmac_fail = fail;
+}
+
+uint32_t host_hmac_calls(void) {
+    return s_hmac_calls;
+}
+
+// Deterministic keyed mix standing in for HMAC-SHA256: what matters to the
+// firmware is that it is a function of key and message writing 32 bytes
+esp_err_t esp_hmac_calculate(hmac_key_id_t key_id, const void* message, size_t message_len, uint8_t* hmac) {
+    __atomic_add_fetch(&s_hmac_calls, 1, __ATOMIC_RELAXED);
+    host_interleave_point();            // the HMAC peripheral is shared, the caller may block
+    if (s_hmac_fail || key_id != HMAC_KEY0)
+        return ESP_FAIL;
+    uint64_t h[4];
+    for (int i = 0; i < 4; ++i)
+        memcpy(&h[i], &s_efuse_key[i * 8], 8);
+    const uint8_t* m = message;
+    for (size_t i = 0; i < message_len; ++i) {
+        h[i % 4] ^= m[i];
+        h[i % 4] *= 0x100000001b3ULL;
+        h[(i + 1) % 4] += h[i % 4] >> 29;
+    }
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            h[i] ^= h[(i + 3) % 4] >> 31;
+            h[i] *= 0x9e3779b97f4a7c15ULL;
+        }
+    }
+    memcpy(hmac, h, 32);
+    return ESP_OK;
+}
+
+/************* esp_mac ****************/
+
+esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type) {
+    static const uint8_t base[6] = { 0x24, 0x58, 0x7c, 0x12, 0x34, 0x56 };
+    memcpy(mac, base, 6);
+    mac[5] += type == ESP_MAC_BT ? 2 : 0;
+    return ESP_OK;
+}
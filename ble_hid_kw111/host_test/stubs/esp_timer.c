@@ -0,0 +1,150 @@
+// esp_timer on the host: one thread per timer, callbacks run on it like on
+// the esp_timer task (one at a time per timer, never concurrently with stop)
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "esp_timer.h"
+#include "host_fakes.h"
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool armed;
+    bool periodic;
+    bool quit;
+    uint64_t period_us;
+    uint64_t deadline_us;
+    uint32_t generation;        // bumped by start/stop: a late wakeup never fires a stale arm
+};
+
+int64_t esp_timer_get_time(void) {
+    return (int64_t)host_now_us();
+}
+
+static void timer_deadline(uint64_t at_us, struct timespec* ts) {
+    // host_now_us() counts from a CLOCK_MONOTONIC origin: rebase on the clock
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t delta = (int64_t)at_us - (int64_t)host_now_us();
+    if (delta < 0)
+        delta = 0;
+    uint64_t ns = (uint64_t)now.tv_nsec + (uint64_t)delta * 1000u;
+    ts->tv_sec = now.tv_sec + ns / 1000000000u;
+    ts->tv_nsec = ns % 1000000000u;
+}
+
+static void* timer_thread(void* arg) {
+    struct esp_timer* t = arg;
+    pthread_mutex_lock(&t->lock);
+    while (!t->quit) {
+        if (!t->armed) {
+            pthread_cond_wait(&t->cond, &t->lock);
+            continue;
+        }
+        struct timespec ts;
+        timer_deadline(t->deadline_us, &ts);
+        uint32_t generation = t->generation;
+        int rc = pthread_cond_timedwait(&t->cond, &t->lock, &ts);
+        if (rc != ETIMEDOUT || !t->armed || generation != t->generation || t->quit)
+            continue;
+        if (host_now_us() < t->deadline_us)
+            continue;
+        if (t->periodic)
+            t->deadline_us += t->period_us;
+        else
+            t->armed = false;
+        esp_timer_cb_t cb = t->callback;
+        void* cb_arg = t->arg;
+        pthread_mutex_unlock(&t->lock);
+        cb(cb_arg);
+        pthread_mutex_lock(&t->lock);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+    if (args == NULL || args->callback == NULL || out == NULL)
+        return ESP_ERR_INVALID_ARG;
+    struct esp_timer* t = calloc(1, sizeof(*t));
+    if (t == NULL)
+        return ESP_ERR_NO_MEM;
+    t->callback = args->callback;
+    t->arg = args->arg;
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&t->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&t->thread, NULL, timer_thread, t) != 0) {
+        free(t);
+        return ESP_ERR_NO_MEM;
+    }
+    *out = t;
+    return ESP_OK;
+}
+
+static esp_err_t timer_arm(esp_timer_handle_t t, uint64_t us, bool periodic) {
+    if (t == NULL)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&t->lock);
+    if (t->armed) {
+        pthread_mutex_unlock(&t->lock);
+        return ESP_ERR_INVALID_STATE;    // like ESP-IDF: stop first
+    }
+    t->armed = true;
+    t->periodic = periodic;
+    t->period_us = us;
+    t->deadline_us = host_now_us() + us;
+    t->generation++;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us) {
+    return timer_arm(t, timeout_us, false);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t period_us) {
+    return timer_arm(t, period_us, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t) {
+    if (t == NULL)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&t->lock);
+    bool was_armed = t->armed;
+    t->armed = false;
+    t->generation++;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    return was_armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t t) {
+    if (t == NULL)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&t->lock);
+    t->quit = true;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    pthread_join(t->thread, NULL);
+    pthread_mutex_destroy(&t->lock);
+    pthread_cond_destroy(&t->cond);
+    free(t);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t t) {
+    pthread_mutex_lock(&t->lock);
+    bool armed = t->armed;
+    pthread_mutex_unlock(&t->lock);
+    return armed;
+}
@@ -0,0 +1,518 @@
+// FreeRTOS API on POSIX threads (see include/freertos/FreeRTOS.h).
+// Scheduling is preemptive and truly parallel, which is harsher than the
+// two ESP32-S3 cores: races in the firmware show up here too.
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+
+#define HOST_STACK_PAINT    0xA5
+#define HOST_STACK_EXTRA    (16 * 1024)     // libc (printf, malloc) is hungrier on the host
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void* arg;
+    char name[16];
+    uint8_t* stack;             // NULL: thread not created by xTaskCreate (test main, stack threads)
+    size_t stack_size;
+    uint32_t depth;             // stack_depth asked to xTaskCreate
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+    bool notified;              // notification pending (xTaskNotifyWait)
+};
+
+static __thread struct host_task* s_current = NULL;
+static pthread_mutex_t s_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+/************* Time ****************/
+
+static struct timespec s_start;
+static pthread_once_t s_start_once = PTHREAD_ONCE_INIT;
+
+static void host_start_init(void) {
+    clock_gettime(CLOCK_MONOTONIC, &s_start);
+}
+
+// Microseconds since the first call, shared with esp_timer_get_time()
+uint64_t host_now_us(void) {
+    struct timespec now;
+    pthread_once(&s_start_once, host_start_init);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - s_start.tv_sec) * 1000000u + (now.tv_nsec - s_start.tv_nsec) / 1000;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(host_now_us() / (1000u * portTICK_PERIOD_MS));
+}
+
+// Absolute CLOCK_MONOTONIC deadline after ticks
+static struct timespec host_deadline(TickType_t ticks) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t)ticks * portTICK_PERIOD_MS * 1000000u;
+    ts.tv_sec += ns / 1000000000u;
+    ts.tv_nsec += ns % 1000000000u;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+static void host_cond_init(pthread_cond_t* cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// Waits on cond until pred() or the timeout; the mutex is held on entry and exit
+#define HOST_WAIT(cond, mutex, timeout, pred) ({                                \
+        bool ok_ = true;                                                        \
+        if ((timeout) == portMAX_DELAY) {                                       \
+            while (!(pred))                                                     \
+                pthread_cond_wait(cond, mutex);                                 \
+        } else {                                                                \
+            struct timespec dl_ = host_deadline(timeout);                       \
+            while (!(pred)) {                                                   \
+                if (pthread_cond_timedwait(cond, mutex, &dl_) == ETIMEDOUT) {   \
+                    ok_ = (pred);                                               \
+                    break;                                                      \
+                }                                                               \
+            }                                                                   \
+        }                                                                       \
+        ok_;                                                                    \
+    })
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = {
+        .tv_sec = (ticks * portTICK_PERIOD_MS) / 1000,
+        .tv_nsec = (long)((ticks * portTICK_PERIOD_MS) % 1000) * 1000000,
+    };
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        ;
+}
+
+void vTaskYield(void) {
+    sched_yield();
+}
+
+void vPortEnterCritical(portMUX_TYPE* mux) {
+    (void)mux;
+    pthread_mutex_lock(&s_critical);
+}
+
+void vPortExitCritical(portMUX_TYPE* mux) {
+    (void)mux;
+    pthread_mutex_unlock(&s_critical);
+}
+
+/************* Tasks ****************/
+
+static void* host_task_entry(void* arg) {
+    struct host_task* task = arg;
+    s_current = task;
+    task->fn(task->arg);
+    // A FreeRTOS task must not return
+    fprintf(stderr, "task %s returned without vTaskDelete\n", task->name);
+    abort();
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* arg,
+                       UBaseType_t priority, TaskHandle_t* out) {
+    (void)priority;
+    struct host_task* task = calloc(1, sizeof(*task));
+    if (task == NULL)
+        return pdFAIL;
+    task->fn = fn;
+    task->arg = arg;
+    snprintf(task->name, sizeof(task->name), "%s", name ? name : "task");
+    pthread_mutex_init(&task->lock, NULL);
+    host_cond_init(&task->cond);
+
+    // Painted stack: the high water mark is the unpainted depth
+    task->depth = stack_depth;
+    task->stack_size = stack_depth + HOST_STACK_EXTRA;
+    if (task->stack_size < PTHREAD_STACK_MIN)
+        task->stack_size = PTHREAD_STACK_MIN;
+    task->stack_size = (task->stack_size + 4095) & ~(size_t)4095;
+    if (posix_memalign((void**)&task->stack, 4096, task->stack_size) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    memset(task->stack, HOST_STACK_PAINT, task->stack_size);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, task->stack, task->stack_size);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&task->thread, &attr, host_task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        free(task->stack);
+        free(task);
+        return pdFAIL;
+    }
+    if (out)
+        *out = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* out, BaseType_t core) {
+    (void)core;
+    return xTaskCreate(fn, name, stack_depth, arg, priority, out);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task != NULL && task != s_current) {
+        fprintf(stderr, "vTaskDelete of another task is not supported on the host\n");
+        abort();
+    }
+    // The stack is the one we are running on: it is leaked with the handle,
+    // which may still be held by whoever created the task
+    pthread_exit(NULL);
+}
+
+// On the device every thread is a task: other host threads get a handle too
+static struct host_task* host_self(void) {
+    if (s_current == NULL) {
+        struct host_task* task = calloc(1, sizeof(*task));
+        task->thread = pthread_self();
+        snprintf(task->name, sizeof(task->name), "host");
+        pthread_mutex_init(&task->lock, NULL);
+        host_cond_init(&task->cond);
+        s_current = task;
+    }
+    return s_current;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return host_self();
+}
+
+// Free bytes never touched since the task started (HOST_STACK_EXTRA excluded,
+// so the figure compares with the stack_depth given to xTaskCreate)
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    if (task == NULL)
+        task = host_self();
+    if (task->stack == NULL)
+        return UINT32_MAX;      // not a task (test main thread)
+    size_t untouched = 0;
+    size_t extra = task->stack_size - task->depth;
+    while (untouched < task->stack_size && task->stack[untouched] == HOST_STACK_PAINT)
+        untouched++;
+    return untouched > extra ? (UBaseType_t)(untouched - extra) : 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t timeout) {
+    struct host_task* task = host_self();
+    pthread_mutex_lock(&task->lock);
+    HOST_WAIT(&task->cond, &task->lock, timeout, task->notify != 0);
+    uint32_t value = task->notify;
+    if (value)
+        task->notify = clear_on_exit ? 0 : value - 1;
+    task->notified = false;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    pthread_mutex_lock(&task->lock);
+    switch (action) {
+        case eSetBits:                  task->notify |= value; break;
+        case eIncrement:                task->notify++; break;
+        case eSetValueWithOverwrite:    task->notify = value; break;
+        case eNoAction:                 break;
+    }
+    task->notified = true;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t timeout) {
+    struct host_task* task = host_self();
+    pthread_mutex_lock(&task->lock);
+    if (!task->notified)
+        task->notify &= ~clear_on_entry;
+    bool ok = HOST_WAIT(&task->cond, &task->lock, timeout, task->notified);
+    if (value)
+        *value = task->notify;
+    if (ok) {
+        task->notify &= ~clear_on_exit;
+        task->notified = false;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+/************* Semaphores ****************/
+
+typedef enum { SEM_COUNTING, SEM_MUTEX, SEM_RECURSIVE } host_sem_kind_t;
+
+struct host_sem {
+    host_sem_kind_t kind;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max;
+    pthread_t owner;            // mutexes
+    bool owned;
+    UBaseType_t depth;          // recursive mutexes
+};
+
+static SemaphoreHandle_t host_sem_create(host_sem_kind_t kind, UBaseType_t max, UBaseType_t initial) {
+    struct host_sem* sem = calloc(1, sizeof(*sem));
+    if (sem == NULL)
+        return NULL;
+    sem->kind = kind;
+    sem->max = max;
+    sem->count = initial;
+    pthread_mutex_init(&sem->lock, NULL);
+    host_cond_init(&sem->cond);
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return host_sem_create(SEM_COUNTING, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+    return host_sem_create(SEM_COUNTING, max, initial);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return host_sem_create(SEM_MUTEX, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+    return host_sem_create(SEM_RECURSIVE, 1, 1);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    if (sem == NULL)
+        return;
+    pthread_mutex_destroy(&sem->lock);
+    pthread_cond_destroy(&sem->cond);
+    free(sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t timeout) {
+    pthread_mutex_lock(&sem->lock);
+    if (sem->kind == SEM_RECURSIVE)
+        abort();                // FreeRTOS asserts too: use xSemaphoreTakeRecursive
+    bool ok = HOST_WAIT(&sem->cond, &sem->lock, timeout, sem->count > 0);
+    if (ok) {
+        sem->count--;
+        if (sem->kind == SEM_MUTEX) {
+            sem->owner = pthread_self();
+            sem->owned = true;
+        }
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    BaseType_t ret = pdTRUE;
+    pthread_mutex_lock(&sem->lock);
+    if (sem->kind == SEM_MUTEX && (!sem->owned || !pthread_equal(sem->owner, pthread_self()))) {
+        ret = pdFALSE;          // only the holder gives a mutex back
+    } else if (sem->count >= sem->max) {
+        ret = pdFALSE;
+    } else {
+        sem->count++;
+        sem->owned = false;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t* woken) {
+    if (woken)
+        *woken = pdFALSE;
+    return xSemaphoreGive(sem);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t timeout) {
+    pthread_mutex_lock(&sem->lock);
+    if (sem->owned && pthread_equal(sem->owner, pthread_self())) {
+        sem->depth++;
+        pthread_mutex_unlock(&sem->lock);
+        return pdTRUE;
+    }
+    bool ok = HOST_WAIT(&sem->cond, &sem->lock, timeout, !sem->owned);
+    if (ok) {
+        sem->owned = true;
+        sem->owner = pthread_self();
+        sem->depth = 1;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) {
+    BaseType_t ret = pdTRUE;
+    pthread_mutex_lock(&sem->lock);
+    if (!sem->owned || !pthread_equal(sem->owner, pthread_self())) {
+        ret = pdFALSE;
+    } else if (--sem->depth == 0) {
+        sem->owned = false;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+/************* Queues ****************/
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t* items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct host_queue* q = calloc(1, sizeof(*q));
+    if (q == NULL)
+        return NULL;
+    q->items = calloc(length, item_size);
+    if (q->items == NULL) {
+        free(q);
+        return NULL;
+    }
+    q->length = length;
+    q->item_size = item_size;
+    pthread_mutex_init(&q->lock, NULL);
+    host_cond_init(&q->cond);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q) {
+    if (q == NULL)
+        return;
+    free(q->items);
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->cond);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t timeout) {
+    pthread_mutex_lock(&q->lock);
+    bool ok = HOST_WAIT(&q->cond, &q->lock, timeout, q->count < q->length);
+    if (ok) {
+        UBaseType_t tail = (q->head + q->count) % q->length;
+        memcpy(q->items + tail * q->item_size, item, q->item_size);
+        q->count++;
+        pthread_cond_broadcast(&q->cond);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t timeout) {
+    pthread_mutex_lock(&q->lock);
+    bool ok = HOST_WAIT(&q->cond, &q->lock, timeout, q->count > 0);
+    if (ok) {
+        memcpy(item, q->items + q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_broadcast(&q->cond);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+/************* Event groups ****************/
+
+struct host_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    struct host_event_group* g = calloc(1, sizeof(*g));
+    if (g == NULL)
+        return NULL;
+    pthread_mutex_init(&g->lock, NULL);
+    host_cond_init(&g->cond);
+    return g;
+}
+
+void vEventGroupDelete(EventGroupHandle_t g) {
+    if (g == NULL)
+        return;
+    pthread_mutex_destroy(&g->lock);
+    pthread_cond_destroy(&g->cond);
+    free(g);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits) {
+    pthread_mutex_lock(&g->lock);
+    g->bits |= bits;
+    EventBits_t now = g->bits;
+    pthread_cond_broadcast(&g->cond);
+    pthread_mutex_unlock(&g->lock);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits) {
+    pthread_mutex_lock(&g->lock);
+    EventBits_t before = g->bits;
+    g->bits &= ~bits;
+    pthread_mutex_unlock(&g->lock);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t g) {
+    pthread_mutex_lock(&g->lock);
+    EventBits_t bits = g->bits;
+    pthread_mutex_unlock(&g->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_all, TickType_t timeout) {
+    pthread_mutex_lock(&g->lock);
+    bool ok = HOST_WAIT(&g->cond, &g->lock, timeout,
+                        wait_all ? (g->bits & bits) == bits : (g->bits & bits) != 0);
+    EventBits_t now = g->bits;
+    if (ok && clear_on_exit)
+        g->bits &= ~bits;
+    pthread_mutex_unlock(&g->lock);
+    return now;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    HID_ITF_PROTOCOL_NONE = 0,
+    HID_ITF_PROTOCOL_KEYBOARD = 1,
+    HID_ITF_PROTOCOL_MOUSE = 2,
+} hid_interface_protocol_enum_t;
+
+typedef enum {
+    HID_REPORT_TYPE_INVALID = 0,
+    HID_REPORT_TYPE_INPUT,
+    HID_REPORT_TYPE_OUTPUT,
+    HID_REPORT_TYPE_FEATURE,
+} hid_report_type_t;
+
+typedef enum {
+    KEYBOARD_MODIFIER_LEFTCTRL   = 1 << 0,
+    KEYBOARD_MODIFIER_LEFTSHIFT  = 1 << 1,
+    KEYBOARD_MODIFIER_LEFTALT    = 1 << 2,
+    KEYBOARD_MODIFIER_LEFTGUI    = 1 << 3,
+    KEYBOARD_MODIFIER_RIGHTCTRL  = 1 << 4,
+    KEYBOARD_MODIFIER_RIGHTSHIFT = 1 << 5,
+    KEYBOARD_MODIFIER_RIGHTALT   = 1 << 6,
+    KEYBOARD_MODIFIER_RIGHTGUI   = 1 << 7,
+} hid_keyboard_modifier_bm_t;
+
+bool tud_hid_ready(void);
+// false while the previous report has not been read by the host
+bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, const uint8_t keycode[6]);
+
+// Application callbacks (hid_device_usb.c)
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,5 @@
+#pragma once
+// Only what main/include/config.h needs
+typedef int gpio_num_t;
+#define GPIO_PULLDOWN_DISABLE   0
+#define GPIO_PULLDOWN_ENABLE    1
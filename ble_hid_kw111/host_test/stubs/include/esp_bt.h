@@ -0,0 +1,9 @@
+#pragma once
+#include "esp_bt_defs.h"
+
+typedef struct { int unused; } esp_bt_controller_config_t;
+#define BT_CONTROLLER_INIT_CONFIG_DEFAULT()     { 0 }
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode);
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t* cfg);
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode);
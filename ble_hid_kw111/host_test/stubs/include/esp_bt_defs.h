@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <wchar.h>      // wint_t: newlib gets it from the headers the firmware already includes
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_BD_ADDR_LEN     6
+typedef uint8_t esp_bd_addr_t[ESP_BD_ADDR_LEN];
+#define ESP_BD_ADDR_STR         "%02x:%02x:%02x:%02x:%02x:%02x"
+#define ESP_BD_ADDR_HEX(addr)   addr[0], addr[1], addr[2], addr[3], addr[4], addr[5]
+
+typedef enum {
+    ESP_BT_STATUS_SUCCESS = 0,
+    ESP_BT_STATUS_FAIL,
+} esp_bt_status_t;
+
+typedef enum {
+    ESP_BT_MODE_IDLE,
+    ESP_BT_MODE_BLE,
+    ESP_BT_MODE_CLASSIC_BT,
+    ESP_BT_MODE_BTDM,
+} esp_bt_mode_t;
+
+typedef uint8_t esp_ble_addr_type_t;
+
+#define ESP_UUID_LEN_16     2
+#define ESP_UUID_LEN_32     4
+#define ESP_UUID_LEN_128    16
+
+typedef struct {
+    uint16_t len;
+    union {
+        uint16_t uuid16;
+        uint32_t uuid32;
+        uint8_t uuid128[ESP_UUID_LEN_128];
+    } uuid;
+} esp_bt_uuid_t;
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,4 @@
+#pragma once
+#include "esp_bt_defs.h"
+
+const uint8_t* esp_bt_dev_get_address(void);
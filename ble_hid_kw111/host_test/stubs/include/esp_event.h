@@ -0,0 +1,4 @@
+#pragma once
+#include <inttypes.h>
+#include "esp_err.h"
+#include "esp_bit_defs.h"
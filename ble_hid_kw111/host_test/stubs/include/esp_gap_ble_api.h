@@ -0,0 +1,143 @@
+#pragma once
+#include "esp_bt_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT,
+    ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT,
+    ESP_GAP_BLE_ADV_START_COMPLETE_EVT,
+    ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT,
+    ESP_GAP_BLE_SEC_REQ_EVT,
+    ESP_GAP_BLE_PASSKEY_NOTIF_EVT,
+    ESP_GAP_BLE_AUTH_CMPL_EVT,
+    ESP_GAP_BLE_REMOVE_BOND_DEV_COMPLETE_EVT,
+    ESP_GAP_BLE_SET_LOCAL_PRIVACY_COMPLETE_EVT,
+    ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT,
+    ESP_GAP_BLE_UPDATE_WHITELIST_COMPLETE_EVT,
+    ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT,
+} esp_gap_ble_cb_event_t;
+
+typedef union {
+    struct { esp_bt_status_t status; } adv_start_cmpl;
+    struct { esp_bt_status_t status; } local_privacy_cmpl;
+    struct { esp_bt_status_t status; esp_bd_addr_t bd_addr; } remove_bond_dev_cmpl;
+    union {
+        struct { esp_bd_addr_t bd_addr; } ble_req;
+        struct { esp_bd_addr_t bd_addr; uint32_t passkey; } key_notif;
+        struct { esp_bd_addr_t bd_addr; bool success; uint8_t fail_reason; uint8_t addr_type; } auth_cmpl;
+    } ble_security;
+    struct {
+        esp_bt_status_t status;
+        esp_bd_addr_t bda;
+        uint16_t min_int;
+        uint16_t max_int;
+        uint16_t latency;
+        uint16_t conn_int;
+        uint16_t timeout;
+    } update_conn_params;
+    struct { esp_bt_status_t status; uint8_t wl_operation; } update_whitelist_cmpl;
+    struct { esp_bt_status_t status; struct { uint16_t rx_len, tx_len; } params; } pkt_data_length_cmpl;
+} esp_ble_gap_cb_param_t;
+
+typedef void (*esp_gap_ble_cb_t)(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param);
+
+typedef struct {
+    bool set_scan_rsp;
+    bool include_name;
+    bool include_txpower;
+    int min_interval;
+    int max_interval;
+    int appearance;
+    uint16_t manufacturer_len;
+    uint8_t* p_manufacturer_data;
+    uint16_t service_data_len;
+    uint8_t* p_service_data;
+    uint16_t service_uuid_len;
+    uint8_t* p_service_uuid;
+    uint8_t flag;
+} esp_ble_adv_data_t;
+
+typedef struct {
+    uint16_t adv_int_min;
+    uint16_t adv_int_max;
+    int adv_type;
+    int own_addr_type;
+    esp_bd_addr_t peer_addr;
+    int peer_addr_type;
+    int channel_map;
+    int adv_filter_policy;
+} esp_ble_adv_params_t;
+
+typedef struct {
+    esp_bd_addr_t bda;
+    uint16_t min_int;
+    uint16_t max_int;
+    uint16_t latency;
+    uint16_t timeout;
+} esp_ble_conn_update_params_t;
+
+typedef struct {
+    esp_bd_addr_t bd_addr;
+    int bd_addr_type;
+} esp_ble_bond_dev_t;
+
+#define ADV_TYPE_IND                        0
+#define BLE_ADDR_TYPE_PUBLIC                0
+#define BLE_ADDR_TYPE_RANDOM                1
+#define ADV_CHNL_ALL                        7
+#define ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY   0
+#define ADV_FILTER_ALLOW_SCAN_ANY_CON_WLST  2
+#define ESP_BLE_ADV_FLAG_GEN_DISC           0x02
+#define ESP_BLE_ADV_FLAG_BREDR_NOT_SPT      0x04
+#define ESP_BLE_APPEARANCE_GENERIC_HID      0x03C0
+#define ESP_BLE_APPEARANCE_HID_KEYBOARD     0x03C1
+#define ESP_BLE_SEC_ENCRYPT_NO_MITM         2
+#define ESP_LE_AUTH_BOND                    0x01
+#define ESP_LE_AUTH_REQ_SC_MITM_BOND        0x0D
+#define ESP_IO_CAP_OUT                      0
+#define ESP_IO_CAP_NONE                     3
+#define ESP_BLE_ENC_KEY_MASK                0x01
+#define ESP_BLE_ID_KEY_MASK                 0x02
+#define ESP_BLE_ONLY_ACCEPT_SPECIFIED_AUTH_DISABLE  0
+#define ESP_BLE_OOB_DISABLE                 0
+
+typedef enum {
+    ESP_BLE_SM_PASSKEY,
+    ESP_BLE_SM_AUTHEN_REQ_MODE,
+    ESP_BLE_SM_IOCAP_MODE,
+    ESP_BLE_SM_SET_INIT_KEY,
+    ESP_BLE_SM_SET_RSP_KEY,
+    ESP_BLE_SM_MAX_KEY_SIZE,
+    ESP_BLE_SM_SET_STATIC_PASSKEY,
+    ESP_BLE_SM_ONLY_ACCEPT_SPECIFIED_SEC_AUTH,
+    ESP_BLE_SM_OOB_SUPPORT,
+} esp_ble_sm_param_t;
+
+typedef uint8_t esp_ble_auth_req_t;
+typedef uint8_t esp_ble_io_cap_t;
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback);
+esp_err_t esp_ble_gap_config_adv_data(esp_ble_adv_data_t* adv_data);
+esp_err_t esp_ble_gap_config_local_icon(uint16_t icon);
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t* adv_params);
+esp_err_t esp_ble_gap_stop_advertising(void);
+esp_err_t esp_ble_gap_security_rsp(esp_bd_addr_t bd_addr, bool accept);
+esp_err_t esp_ble_gap_disconnect(esp_bd_addr_t remote_device);
+esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t* params);
+esp_err_t esp_ble_gap_set_device_name(const char* name);
+esp_err_t esp_ble_gap_set_security_param(esp_ble_sm_param_t param_type, void* value, uint8_t len);
+esp_err_t esp_ble_gap_update_whitelist(bool add_remove, esp_bd_addr_t remote_bda, int wl_addr_type);
+esp_err_t esp_ble_gap_clear_whitelist(void);
+esp_err_t esp_ble_gap_set_pkt_data_len(esp_bd_addr_t remote_device, uint16_t tx_data_length);
+esp_err_t esp_ble_set_encryption(esp_bd_addr_t bd_addr, int sec_act);
+int esp_ble_get_bond_device_num(void);
+esp_err_t esp_ble_get_bond_device_list(int* dev_num, esp_ble_bond_dev_t* dev_list);
+esp_err_t esp_ble_remove_bond_device(esp_bd_addr_t bd_addr);
+uint16_t esp_ble_get_cur_sendable_packets_num(uint16_t connid);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,104 @@
+#pragma once
+#include "esp_bt_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t esp_gatt_if_t;
+typedef uint16_t esp_gatt_perm_t;
+typedef uint8_t esp_gatt_char_prop_t;
+typedef int esp_gatt_status_t;
+
+#define ESP_GATT_OK                         0
+#define ESP_GATT_IF_NONE                    0xff
+#define ESP_GATT_DEF_BLE_MTU_SIZE           23
+#define ESP_GATT_MAX_MTU_SIZE               517
+
+#define ESP_GATT_PERM_READ                  0x0001
+#define ESP_GATT_PERM_READ_ENCRYPTED        0x0002
+#define ESP_GATT_PERM_WRITE                 0x0010
+#define ESP_GATT_PERM_WRITE_ENCRYPTED       0x0020
+
+#define ESP_GATT_CHAR_PROP_BIT_READ         0x02
+#define ESP_GATT_CHAR_PROP_BIT_WRITE_NR     0x04
+#define ESP_GATT_CHAR_PROP_BIT_WRITE        0x08
+#define ESP_GATT_CHAR_PROP_BIT_NOTIFY       0x10
+#define ESP_GATT_CHAR_PROP_BIT_INDICATE     0x20
+
+#define ESP_GATT_RSP_BY_APP                 0
+#define ESP_GATT_AUTO_RSP                   1
+
+#define ESP_GATT_UUID_PRI_SERVICE           0x2800
+#define ESP_GATT_UUID_INCLUDE_SERVICE       0x2802
+#define ESP_GATT_UUID_CHAR_DECLARE          0x2803
+#define ESP_GATT_UUID_CHAR_CLIENT_CONFIG    0x2902
+#define ESP_GATT_UUID_CHAR_PRESENT_FORMAT   0x2904
+#define ESP_GATT_UUID_EXT_RPT_REF_DESCR     0x2907
+#define ESP_GATT_UUID_RPT_REF_DESCR         0x2908
+#define ESP_GATT_UUID_BATTERY_SERVICE_SVC   0x180F
+#define ESP_GATT_UUID_BATTERY_LEVEL         0x2A19
+#define ESP_GATT_UUID_HID_INFORMATION       0x2A4A
+#define ESP_GATT_UUID_HID_REPORT_MAP        0x2A4B
+#define ESP_GATT_UUID_HID_CONTROL_POINT     0x2A4C
+#define ESP_GATT_UUID_HID_REPORT            0x2A4D
+#define ESP_GATT_UUID_HID_PROTO_MODE        0x2A4E
+#define ESP_GATT_UUID_HID_BT_KB_INPUT       0x2A22
+#define ESP_GATT_UUID_HID_BT_KB_OUTPUT      0x2A32
+
+typedef struct {
+    uint8_t auto_rsp;
+} esp_attr_control_t;
+
+typedef struct {
+    uint16_t uuid_length;
+    uint8_t* uuid_p;
+    uint16_t perm;
+    uint16_t max_length;
+    uint16_t length;
+    uint8_t* value;
+} esp_attr_desc_t;
+
+typedef struct {
+    esp_attr_control_t attr_control;
+    esp_attr_desc_t att_desc;
+} esp_gatts_attr_db_t;
+
+typedef struct {
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t timeout;
+} esp_gatt_conn_params_t;
+
+typedef struct {
+    uint8_t value[ESP_GATT_MAX_MTU_SIZE];
+    uint16_t handle;
+    uint16_t offset;
+    uint16_t len;
+    uint8_t auth_req;
+} esp_gatt_value_t;
+
+typedef union {
+    esp_gatt_value_t attr_value;
+    uint16_t handle;
+} esp_gatt_rsp_t;
+
+typedef struct {
+    uint16_t start_hdl;
+    uint16_t end_hdl;
+    uint16_t uuid;
+} esp_gatts_incl_svc_desc_t;
+
+typedef struct {
+    esp_bt_uuid_t uuid;
+    uint8_t inst_id;
+} esp_gatt_id_t;
+
+typedef struct {
+    esp_gatt_id_t id;
+    bool is_primary;
+} esp_gatt_srvc_id_t;
+
+#ifdef __cplusplus
+}
+#endif
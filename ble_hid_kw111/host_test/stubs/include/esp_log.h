@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+// Messages above the level set by HOST_LOG_LEVEL (default: warnings) are dropped
+void host_log(esp_log_level_t level, const char* tag, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+void host_log_buffer_hex(const char* tag, const void* buffer, size_t len);
+
+#define ESP_LOGE(tag, format, ...)  host_log(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)  host_log(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)  host_log(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)  host_log(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)  host_log(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+#define ESP_LOG_BUFFER_HEX(tag, buffer, len)    host_log_buffer_hex(tag, buffer, len)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+// Host stand-in for the FreeRTOS API used by the firmware: tasks are pthreads,
+// the tick is 10 ms like CONFIG_FREERTOS_HZ=100 (see stubs/freertos.c)
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t StackType_t;
+
+#define configTICK_RATE_HZ      100
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define pdTICKS_TO_MS(t)        ((uint32_t)(((uint64_t)(t) * 1000) / configTICK_RATE_HZ))
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdFAIL                  pdFALSE
+#define pdPASS                  pdTRUE
+#define tskNO_AFFINITY          0x7FFFFFFF
+
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+void vPortEnterCritical(portMUX_TYPE* mux);
+void vPortExitCritical(portMUX_TYPE* mux);
+#define portENTER_CRITICAL(mux)         vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)          vPortExitCritical(mux)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_queue* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t timeout);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t timeout);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+#define xQueueSendToBack(q, item, timeout)  xQueueSend(q, item, timeout)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+#include "FreeRTOS.h"
+#include "queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_sem* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t timeout);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t timeout);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t* woken);
+
+#ifdef __cplusplus
+}
+#endif
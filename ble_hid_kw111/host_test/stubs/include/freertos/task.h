@@ -0,0 +1,40 @@
+#pragma once
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_task* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+// usStackDepth is in bytes, as on ESP-IDF. The host stack is painted so that
+// uxTaskGetStackHighWaterMark() reports the real minimum of free bytes.
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* arg,
+                       UBaseType_t priority, TaskHandle_t* out);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* out, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);        // only NULL (the calling task) is supported
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+typedef enum {
+    eNoAction = 0,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+} eNotifyAction;
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t timeout);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t timeout);
+
+void vTaskYield(void);
+#define taskYIELD()     vTaskYield()
+
+#ifdef __cplusplus
+}
+#endif
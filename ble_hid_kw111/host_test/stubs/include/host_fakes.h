@@ -0,0 +1,128 @@
+#pragma once
+// Controls of the host stand-ins (stubs/*.c): what the tests and benchmarks
+// use to look at flash writes, drive the BLE peer and the USB host, etc.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Microseconds since start (same clock as esp_timer_get_time)
+uint64_t host_now_us(void);
+
+/************* Log, random, eFuse ****************/
+
+// Yield points in the stand-ins (flash writes, RNG): on a single-CPU host
+// they give other tasks the chance to run in the middle of an operation,
+// as the second core and the flash wait states do on the device
+void host_set_interleave(bool on);
+void host_interleave_point(void);
+
+void host_log_set_level(esp_log_level_t level);     // default: HOST_LOG_LEVEL env or warnings
+void host_stdout_mute(bool mute);                   // firmware printf() to /dev/null (benchmarks)
+bool host_stdout_muted(void);
+FILE* host_stdout(void);                            // the real stdout, also while muted
+void host_random_seed(uint32_t seed);               // esp_random() is a seeded PRNG
+void host_hmac_set_key(const uint8_t key[32]);      // HMAC_KEY0 eFuse block
+void host_hmac_set_fail(bool fail);                 // eFuse key not burned
+uint32_t host_hmac_calls(void);                     // esp_hmac_calculate() calls (key derivations)
+
+/************* NVS ****************/
+
+typedef struct {
+    uint64_t bytes_written;     // 32-byte entries written by every set (what wears the flash)
+    uint32_t sets;
+    uint32_t commits;
+    uint32_t erases;
+} host_nvs_stats_t;
+
+void host_nvs_format(void);                         // empty flash, partitions "nvs" and "userdb"
+void host_nvs_drop_partition(const char* part);     // partition table without it
+void host_nvs_add_partition(const char* part);      // new partition table: it is back, empty
+void host_nvs_set_powered(bool powered);            // off: every write fails (a power cut)
+void host_nvs_get_stats(host_nvs_stats_t* out);
+void host_nvs_reset_stats(void);
+size_t host_nvs_stored_bytes(const char* part);     // bytes of the live entries
+
+/************* BLE stack and peer ****************/
+
+typedef enum {
+    HOST_BLE_UPDATE_ASYNC,          // answer from the stack task, after the request returned
+    HOST_BLE_UPDATE_BEFORE_RETURN,  // answer delivered before esp_ble_gap_update_conn_params returns
+    HOST_BLE_UPDATE_NEVER,          // the peer ignores the request
+    HOST_BLE_UPDATE_REJECT,         // answered with an error status
+    HOST_BLE_UPDATE_HOLD,           // accepted, answer held until the next request or host_ble_release_update()
+} host_ble_update_mode_t;
+
+typedef struct {
+    uint32_t update_requests;       // esp_ble_gap_update_conn_params calls
+    uint16_t last_min_int;
+    uint16_t last_max_int;
+    uint16_t last_latency;
+    uint32_t reports;               // HID reports delivered to the peer
+    uint32_t notifications;         // other notifications delivered to the peer
+    uint64_t notification_bytes;    // ATT payload of those notifications
+    uint32_t indications;           // of those, sent with need_confirm (one round-trip each)
+    uint32_t writes;                // host_ble_write calls
+    uint32_t lost;                  // packets dropped on a full controller buffer
+    uint32_t congest_events;
+    uint32_t max_queued;
+} host_ble_stats_t;
+
+// Called on the link thread for every keyboard input report the peer receives
+typedef void (*host_ble_report_cb_t)(const uint8_t* report, size_t len, uint64_t t_us, void* arg);
+
+void host_ble_reset(void);                          // no peer, default link model, stats cleared
+void host_ble_set_update_mode(host_ble_update_mode_t mode);
+void host_ble_set_tx_buffers(unsigned count);       // controller buffers (default 8)
+void host_ble_set_packets_per_event(unsigned count);// packets moved per connection event (default 1)
+void host_ble_set_report_handle(uint16_t handle);   // notifications on it are keyboard reports
+void host_ble_set_report_cb(host_ble_report_cb_t cb, void* arg);
+
+void host_ble_connect(uint16_t conn_int, uint16_t latency);
+void host_ble_disconnect(void);
+void host_ble_set_mtu(uint16_t mtu);                // ATT MTU exchange started by the peer
+void host_ble_peer_update(uint16_t conn_int, uint16_t latency);  // update decided by the peer
+void host_ble_release_update(void);                 // delivers the answer held by HOST_BLE_UPDATE_HOLD
+void host_ble_write(uint16_t handle, const uint8_t* data, size_t len);  // returns once handled
+// On: a write goes out at the next connection event and host_ble_write returns at
+// the one after (write with response); off (default): delivered at once
+void host_ble_set_write_timing(bool enabled);
+void host_ble_sync(void);                           // waits for every queued stack event
+void host_ble_get_stats(host_ble_stats_t* out);
+void host_ble_reset_stats(void);
+
+// Next notification received on handle (not a keyboard report), 0 on timeout
+size_t host_ble_take_notification(uint16_t handle, uint8_t* out, size_t max, uint32_t timeout_ms);
+
+/************* USB host ****************/
+
+typedef struct {
+    uint32_t reports;               // IN reports read by the host (at most one per poll)
+    uint32_t completions;           // tud_hid_report_complete_cb calls
+    uint32_t polls;                 // IN polls while mounted, with or without a report
+    uint32_t busy;                  // tud_hid_keyboard_report calls refused (previous not read yet)
+    uint32_t early;                 // reports handed over before the previous completion callback
+    uint8_t interval_ms;            // bInterval of the configuration descriptor
+} host_usb_stats_t;
+
+void host_usb_set_mounted(bool mounted);
+void host_usb_set_report_cb(host_ble_report_cb_t cb, void* arg);
+// Polls every ms instead of the descriptor bInterval (0: back to bInterval)
+void host_usb_set_poll_interval(uint8_t ms);
+void host_usb_get_stats(host_usb_stats_t* out);
+void host_usb_reset_stats(void);
+
+/************* Board ****************/
+
+uint32_t host_board_sleep_requests(void);          // enter_deep_sleep() calls
+uint32_t host_board_enroll_requests(void);         // enrollFinger() calls
+
+#ifdef __cplusplus
+}
+#endif
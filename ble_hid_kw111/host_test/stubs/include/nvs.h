@@ -0,0 +1,39 @@
+#pragma once
+// Host stand-in for the NVS API: an in-memory store (see stubs/nvs.c)
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NVS_DEFAULT_PART_NAME   "nvs"
+#define NVS_KEY_NAME_MAX_SIZE   16
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t mode, nvs_handle_t* out);
+esp_err_t nvs_open_from_partition(const char* part, const char* name, nvs_open_mode_t mode, nvs_handle_t* out);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key);
+esp_err_t nvs_erase_all(nvs_handle_t handle);
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value);
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char* key, uint16_t value);
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t len);
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out);
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char* key, uint16_t* out);
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out, size_t* len);
+
+#ifdef __cplusplus
+}
+#endif
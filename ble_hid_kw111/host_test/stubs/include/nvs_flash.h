@@ -0,0 +1,15 @@
+#pragma once
+#include "nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+esp_err_t nvs_flash_init_partition(const char* part);
+esp_err_t nvs_flash_erase_partition(const char* part);
+
+#ifdef __cplusplus
+}
+#endif
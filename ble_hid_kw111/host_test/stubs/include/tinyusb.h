@@ -0,0 +1,60 @@
+#pragma once
+// Host stand-in for esp_tinyusb + TinyUSB device HID: the fake host polls the
+// IN endpoint every bInterval ms of the configuration descriptor (stubs/tinyusb.c)
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TUD_OPT_HIGH_SPEED                  0
+#define TU_BIT(n)                           (1UL << (n))
+#define TU_U16_LOW(u16)                     ((uint8_t)((u16) & 0xff))
+#define TU_U16_HIGH(u16)                    ((uint8_t)(((u16) >> 8) & 0xff))
+#define U16_TO_U8S_LE(u16)                  TU_U16_LOW(u16), TU_U16_HIGH(u16)
+
+#define TUSB_DESC_CONFIGURATION             0x02
+#define TUSB_DESC_INTERFACE                 0x04
+#define TUSB_DESC_ENDPOINT                  0x05
+#define TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP  0x20
+#define HID_DESC_TYPE_HID                   0x21
+#define HID_DESC_TYPE_REPORT                0x22
+
+#define TUD_CONFIG_DESC_LEN                 9
+#define TUD_HID_DESC_LEN                    (9 + 9 + 7)
+#define TUD_CDC_DESC_LEN                    9       // only the control interface in the fake
+
+#define TUD_CONFIG_DESCRIPTOR(config_num, itf_count, stridx, total_len, attribute, power_ma) \
+    9, TUSB_DESC_CONFIGURATION, U16_TO_U8S_LE(total_len), itf_count, config_num, stridx, \
+    TU_BIT(7) | (attribute), (power_ma) / 2
+
+// Interface, HID and endpoint descriptors: the last byte is bInterval
+#define TUD_HID_DESCRIPTOR(itfnum, stridx, boot_protocol, report_desc_len, epin, epsize, ep_interval) \
+    9, TUSB_DESC_INTERFACE, itfnum, 0, 1, 0x03, (boot_protocol) ? 1 : 0, boot_protocol, stridx, \
+    9, HID_DESC_TYPE_HID, U16_TO_U8S_LE(0x0111), 0, 1, HID_DESC_TYPE_REPORT, U16_TO_U8S_LE(report_desc_len), \
+    7, TUSB_DESC_ENDPOINT, epin, 0x03, U16_TO_U8S_LE(epsize), ep_interval
+
+#define TUD_CDC_DESCRIPTOR(itfnum, stridx, ep_notif, ep_notif_size, epout, epin, epsize) \
+    9, TUSB_DESC_INTERFACE, itfnum, 0, 1, 0x02, 0x02, 0, stridx
+
+#define HID_REPORT_ID(x)                    0x85, x,
+#define TUD_HID_REPORT_DESC_KEYBOARD(...)   0x05, 0x01, 0x09, 0x06, 0xa1, 0x01, __VA_ARGS__ 0xc0
+#define TUD_HID_REPORT_DESC_MOUSE(...)      0x05, 0x01, 0x09, 0x02, 0xa1, 0x01, __VA_ARGS__ 0xc0
+
+typedef struct {
+    const void* device_descriptor;
+    const char** string_descriptor;
+    int string_descriptor_count;
+    bool external_phy;
+    const uint8_t* configuration_descriptor;
+} tinyusb_config_t;
+
+esp_err_t tinyusb_driver_install(const tinyusb_config_t* config);
+bool tud_mounted(void);
+
+#ifdef __cplusplus
+}
+#endif
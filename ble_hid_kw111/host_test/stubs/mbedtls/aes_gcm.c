@@ -0,0 +1,207 @@
+// mbedTLS AES/GCM subset on OpenSSL libcrypto (see include/mbedtls/aes.h).
+// The EVP context lives in the mbedTLS context and is reused by every call,
+// so two threads sharing a context race exactly like they would on mbedTLS.
+#include <string.h>
+#include <openssl/evp.h>
+
+#include "mbedtls/aes.h"
+#include "mbedtls/gcm.h"
+#include "host_fakes.h"
+
+static const EVP_CIPHER* aes_ecb(unsigned int keybits) {
+    switch (keybits) {
+        case 128: return EVP_aes_128_ecb();
+        case 192: return EVP_aes_192_ecb();
+        case 256: return EVP_aes_256_ecb();
+        default:  return NULL;
+    }
+}
+
+static const EVP_CIPHER* aes_gcm(unsigned int keybits) {
+    switch (keybits) {
+        case 128: return EVP_aes_128_gcm();
+        case 192: return EVP_aes_192_gcm();
+        case 256: return EVP_aes_256_gcm();
+        default:  return NULL;
+    }
+}
+
+/************* AES ****************/
+
+void mbedtls_aes_init(mbedtls_aes_context* ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_aes_free(mbedtls_aes_context* ctx) {
+    if (ctx == NULL)
+        return;
+    if (ctx->evp)
+        EVP_CIPHER_CTX_free(ctx->evp);      // clears the key schedule
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+static int aes_setkey(mbedtls_aes_context* ctx, const unsigned char* key, unsigned int keybits, int mode) {
+    const EVP_CIPHER* cipher = aes_ecb(keybits);
+    if (cipher == NULL)
+        return MBEDTLS_ERR_AES_INVALID_KEY_LENGTH;
+    if (ctx->evp == NULL && (ctx->evp = EVP_CIPHER_CTX_new()) == NULL)
+        return MBEDTLS_ERR_AES_BAD_INPUT_DATA;
+    if (EVP_CipherInit_ex(ctx->evp, cipher, NULL, key, NULL, mode == MBEDTLS_AES_ENCRYPT) != 1)
+        return MBEDTLS_ERR_AES_BAD_INPUT_DATA;
+    EVP_CIPHER_CTX_set_padding(ctx->evp, 0);
+    ctx->mode = mode;
+    return 0;
+}
+
+int mbedtls_aes_setkey_enc(mbedtls_aes_context* ctx, const unsigned char* key, unsigned int keybits) {
+    return aes_setkey(ctx, key, keybits, MBEDTLS_AES_ENCRYPT);
+}
+
+int mbedtls_aes_setkey_dec(mbedtls_aes_context* ctx, const unsigned char* key, unsigned int keybits) {
+    return aes_setkey(ctx, key, keybits, MBEDTLS_AES_DECRYPT);
+}
+
+int mbedtls_aes_crypt_ecb(mbedtls_aes_context* ctx, int mode, const unsigned char input[16], unsigned char output[16]) {
+    int len = 0;
+    // As in mbedTLS the direction comes from the key schedule, mode must agree
+    if (ctx->evp == NULL || mode != ctx->mode)
+        return MBEDTLS_ERR_AES_BAD_INPUT_DATA;
+    if (EVP_CipherUpdate(ctx->evp, output, &len, input, 16) != 1 || len != 16)
+        return MBEDTLS_ERR_AES_BAD_INPUT_DATA;
+    return 0;
+}
+
+int mbedtls_aes_crypt_cbc(mbedtls_aes_context* ctx, int mode, size_t length, unsigned char iv[16],
+                          const unsigned char* input, unsigned char* output) {
+    unsigned char temp[16];
+    if (length % 16)
+        return MBEDTLS_ERR_AES_INVALID_INPUT_LENGTH;
+    while (length > 0) {
+        if (mode == MBEDTLS_AES_DECRYPT) {
+            memcpy(temp, input, 16);
+            int ret = mbedtls_aes_crypt_ecb(ctx, mode, input, output);
+            if (ret != 0)
+                return ret;
+            for (int i = 0; i < 16; ++i)
+                output[i] ^= iv[i];
+            memcpy(iv, temp, 16);
+        } else {
+            for (int i = 0; i < 16; ++i)
+                output[i] = input[i] ^ iv[i];
+            int ret = mbedtls_aes_crypt_ecb(ctx, mode, output, output);
+            if (ret != 0)
+                return ret;
+            memcpy(iv, output, 16);
+        }
+        input += 16;
+        output += 16;
+        length -= 16;
+    }
+    return 0;
+}
+
+int mbedtls_aes_crypt_ctr(mbedtls_aes_context* ctx, size_t length, size_t* nc_off, unsigned char nonce_counter[16],
+                          unsigned char stream_block[16], const unsigned char* input, unsigned char* output) {
+    size_t n = *nc_off;
+    if (n > 15)
+        return MBEDTLS_ERR_AES_BAD_INPUT_DATA;
+    while (length--) {
+        if (n == 0) {
+            int ret = mbedtls_aes_crypt_ecb(ctx, MBEDTLS_AES_ENCRYPT, nonce_counter, stream_block);
+            if (ret != 0)
+                return ret;
+            for (int i = 16; i > 0; --i) {
+                if (++nonce_counter[i - 1] != 0)
+                    break;
+            }
+        }
+        *output++ = *input++ ^ stream_block[n];
+        n = (n + 1) & 0x0F;
+    }
+    *nc_off = n;
+    return 0;
+}
+
+/************* GCM ****************/
+
+void mbedtls_gcm_init(mbedtls_gcm_context* ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_gcm_free(mbedtls_gcm_context* ctx) {
+    if (ctx == NULL)
+        return;
+    if (ctx->evp)
+        EVP_CIPHER_CTX_free(ctx->evp);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_gcm_setkey(mbedtls_gcm_context* ctx, mbedtls_cipher_id_t cipher, const unsigned char* key,
+                       unsigned int keybits) {
+    const EVP_CIPHER* evp_cipher = aes_gcm(keybits);
+    if (cipher != MBEDTLS_CIPHER_ID_AES || evp_cipher == NULL)
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    if (ctx->evp == NULL && (ctx->evp = EVP_CIPHER_CTX_new()) == NULL)
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    if (EVP_EncryptInit_ex(ctx->evp, evp_cipher, NULL, key, NULL) != 1)
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    return 0;
+}
+
+// Restarts the keyed context with a new IV in the given direction
+static int gcm_start(mbedtls_gcm_context* ctx, int enc, const unsigned char* iv, size_t iv_len,
+                     const unsigned char* add, size_t add_len) {
+    int len;
+    if (ctx->evp == NULL || iv_len == 0)
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    if (EVP_CipherInit_ex(ctx->evp, NULL, NULL, NULL, NULL, enc) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx->evp, EVP_CTRL_GCM_SET_IVLEN, (int)iv_len, NULL) != 1 ||
+        EVP_CipherInit_ex(ctx->evp, NULL, NULL, NULL, iv, enc) != 1)
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    if (add_len > 0 && EVP_CipherUpdate(ctx->evp, NULL, &len, add, (int)add_len) != 1)
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    return 0;
+}
+
+int mbedtls_gcm_crypt_and_tag(mbedtls_gcm_context* ctx, int mode, size_t length, const unsigned char* iv,
+                              size_t iv_len, const unsigned char* add, size_t add_len, const unsigned char* input,
+                              unsigned char* output, size_t tag_len, unsigned char* tag) {
+    int len;
+    if (mode != MBEDTLS_GCM_ENCRYPT) {
+        // Decryption without verification is not used by the firmware
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    }
+    if (tag_len < 4 || tag_len > 16)
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    int ret = gcm_start(ctx, 1, iv, iv_len, add, add_len);
+    if (ret != 0)
+        return ret;
+    host_interleave_point();            // the AES peripheral is shared, the caller may block
+    if (length > 0 && EVP_CipherUpdate(ctx->evp, output, &len, input, (int)length) != 1)
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    if (EVP_CipherFinal_ex(ctx->evp, output + length, &len) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx->evp, EVP_CTRL_GCM_GET_TAG, (int)tag_len, tag) != 1)
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    return 0;
+}
+
+int mbedtls_gcm_auth_decrypt(mbedtls_gcm_context* ctx, size_t length, const unsigned char* iv, size_t iv_len,
+                             const unsigned char* add, size_t add_len, const unsigned char* tag, size_t tag_len,
+                             const unsigned char* input, unsigned char* output) {
+    int len;
+    if (tag_len < 4 || tag_len > 16)
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    int ret = gcm_start(ctx, 0, iv, iv_len, add, add_len);
+    if (ret != 0)
+        return ret;
+    host_interleave_point();
+    if (length > 0 && EVP_CipherUpdate(ctx->evp, output, &len, input, (int)length) != 1)
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    if (EVP_CIPHER_CTX_ctrl(ctx->evp, EVP_CTRL_GCM_SET_TAG, (int)tag_len, (void*)tag) != 1)
+        return MBEDTLS_ERR_GCM_BAD_INPUT;
+    if (EVP_CipherFinal_ex(ctx->evp, output + length, &len) != 1) {
+        memset(output, 0, length);          // like mbedTLS: no unauthenticated plaintext
+        return MBEDTLS_ERR_GCM_AUTH_FAILED;
+    }
+    return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+typedef enum {
+    MBEDTLS_CIPHER_ID_NONE = 0,
+    MBEDTLS_CIPHER_ID_NULL,
+    MBEDTLS_CIPHER_ID_AES,
+} mbedtls_cipher_id_t;
@@ -0,0 +1,32 @@
+#pragma once
+// Subset of the mbedTLS GCM API, see aes.h
+#include <stddef.h>
+#include "cipher.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MBEDTLS_GCM_ENCRYPT             1
+#define MBEDTLS_GCM_DECRYPT             0
+#define MBEDTLS_ERR_GCM_AUTH_FAILED     -0x0012
+#define MBEDTLS_ERR_GCM_BAD_INPUT       -0x0014
+
+typedef struct mbedtls_gcm_context {
+    void* evp;                  // EVP_CIPHER_CTX in GCM mode, NULL until setkey
+} mbedtls_gcm_context;
+
+void mbedtls_gcm_init(mbedtls_gcm_context* ctx);
+void mbedtls_gcm_free(mbedtls_gcm_context* ctx);
+int mbedtls_gcm_setkey(mbedtls_gcm_context* ctx, mbedtls_cipher_id_t cipher, const unsigned char* key,
+                       unsigned int keybits);
+int mbedtls_gcm_crypt_and_tag(mbedtls_gcm_context* ctx, int mode, size_t length, const unsigned char* iv,
+                              size_t iv_len, const unsigned char* add, size_t add_len, const unsigned char* input,
+                              unsigned char* output, size_t tag_len, unsigned char* tag);
+int mbedtls_gcm_auth_decrypt(mbedtls_gcm_context* ctx, size_t length, const unsigned char* iv, size_t iv_len,
+                             const unsigned char* add, size_t add_len, const unsigned char* tag, size_t tag_len,
+                             const unsigned char* input, unsigned char* output);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,429 @@
+// NVS on the host: an in-memory store with the error semantics of ESP-IDF.
+// Like the real library a set reaches the flash immediately (nvs_commit only
+// flushes the cache), writing the same value again writes nothing, and the
+// flash cost of an item is counted in 32-byte entries.
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "host_fakes.h"
+
+#define NVS_ENTRY_SIZE  32
+#define MAX_HANDLES     32
+
+typedef enum { ITEM_U8, ITEM_U16, ITEM_U32, ITEM_BLOB } item_type_t;
+
+typedef struct item {
+    struct item* next;
+    char part[16];
+    char ns[NVS_KEY_NAME_MAX_SIZE];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    item_type_t type;
+    size_t len;
+    uint8_t* data;
+} item_t;
+
+typedef struct {
+    bool open;
+    bool writable;
+    char part[16];
+    char ns[NVS_KEY_NAME_MAX_SIZE];
+} handle_t;
+
+typedef struct {
+    const char* name;
+    bool present;
+    bool initialised;
+} partition_t;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static item_t* s_items = NULL;
+static handle_t s_handles[MAX_HANDLES + 1];     // 0 non e' un handle valido
+static partition_t s_parts[] = {
+    { NVS_DEFAULT_PART_NAME, true, false },
+    { "userdb", true, false },
+};
+static host_nvs_stats_t s_stats;
+static bool s_powered = true;
+
+static partition_t* find_part(const char* name) {
+    for (size_t i = 0; i < sizeof(s_parts) / sizeof(s_parts[0]); ++i) {
+        if (strcmp(s_parts[i].name, name) == 0)
+            return &s_parts[i];
+    }
+    return NULL;
+}
+
+// Header entry plus the data entries (blobs) of an item
+static size_t item_footprint(item_type_t type, size_t len) {
+    if (type != ITEM_BLOB)
+        return NVS_ENTRY_SIZE;
+    return NVS_ENTRY_SIZE * (1 + (len + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE);
+}
+
+static item_t* find_item(const char* part, const char* ns, const char* key) {
+    for (item_t* it = s_items; it; it = it->next) {
+        if (strcmp(it->part, part) == 0 && strcmp(it->ns, ns) == 0 && strcmp(it->key, key) == 0)
+            return it;
+    }
+    return NULL;
+}
+
+static void free_item(item_t* it) {
+    free(it->data);
+    free(it);
+}
+
+// Drops every item of part (and of ns, if not NULL)
+static void erase_items(const char* part, const char* ns) {
+    item_t** link = &s_items;
+    while (*link) {
+        item_t* it = *link;
+        if (strcmp(it->part, part) == 0 && (ns == NULL || strcmp(it->ns, ns) == 0)) {
+            *link = it->next;
+            free_item(it);
+        } else {
+            link = &it->next;
+        }
+    }
+}
+
+static handle_t* get_handle(nvs_handle_t handle) {
+    if (handle == 0 || handle > MAX_HANDLES || !s_handles[handle].open)
+        return NULL;
+    return &s_handles[handle];
+}
+
+/************* Test controls ****************/
+
+void host_nvs_format(void) {
+    pthread_mutex_lock(&s_lock);
+    while (s_items) {
+        item_t* it = s_items;
+        s_items = it->next;
+        free_item(it);
+    }
+    memset(s_handles, 0, sizeof(s_handles));
+    for (size_t i = 0; i < sizeof(s_parts) / sizeof(s_parts[0]); ++i) {
+        s_parts[i].present = true;
+        s_parts[i].initialised = false;
+    }
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_powered = true;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_nvs_drop_partition(const char* part) {
+    pthread_mutex_lock(&s_lock);
+    partition_t* p = find_part(part);
+    if (p) {
+        p->present = false;
+        p->initialised = false;
+        erase_items(part, NULL);
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_nvs_add_partition(const char* part) {
+    pthread_mutex_lock(&s_lock);
+    partition_t* p = find_part(part);
+    if (p && !p->present) {
+        p->present = true;
+        p->initialised = false;
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_nvs_set_powered(bool powered) {
+    pthread_mutex_lock(&s_lock);
+    s_powered = powered;
+    if (powered) {
+        // Boot: handles and initialised partitions do not survive the reset
+        memset(s_handles, 0, sizeof(s_handles));
+        for (size_t i = 0; i < sizeof(s_parts) / sizeof(s_parts[0]); ++i)
+            s_parts[i].initialised = false;
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_nvs_get_stats(host_nvs_stats_t* out) {
+    pthread_mutex_lock(&s_lock);
+    *out = s_stats;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_nvs_reset_stats(void) {
+    pthread_mutex_lock(&s_lock);
+    memset(&s_stats, 0, sizeof(s_stats));
+    pthread_mutex_unlock(&s_lock);
+}
+
+size_t host_nvs_stored_bytes(const char* part) {
+    size_t total = 0;
+    pthread_mutex_lock(&s_lock);
+    for (item_t* it = s_items; it; it = it->next) {
+        if (strcmp(it->part, part) == 0)
+            total += item_footprint(it->type, it->len);
+    }
+    pthread_mutex_unlock(&s_lock);
+    return total;
+}
+
+/************* nvs_flash ****************/
+
+esp_err_t nvs_flash_init_partition(const char* part) {
+    pthread_mutex_lock(&s_lock);
+    partition_t* p = find_part(part);
+    esp_err_t err = ESP_ERR_NVS_PART_NOT_FOUND;
+    if (p && p->present) {
+        p->initialised = true;
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_flash_init(void) {
+    return nvs_flash_init_partition(NVS_DEFAULT_PART_NAME);
+}
+
+esp_err_t nvs_flash_erase_partition(const char* part) {
+    pthread_mutex_lock(&s_lock);
+    partition_t* p = find_part(part);
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if (p && p->present && s_powered) {
+        p->initialised = false;
+        erase_items(part, NULL);
+        s_stats.erases++;
+        err = ESP_OK;
+    } else if (p && p->present) {
+        err = ESP_FAIL;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    return nvs_flash_erase_partition(NVS_DEFAULT_PART_NAME);
+}
+
+/************* nvs ****************/
+
+esp_err_t nvs_open_from_partition(const char* part, const char* name, nvs_open_mode_t mode, nvs_handle_t* out) {
+    if (part == NULL || name == NULL || out == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (strlen(name) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    pthread_mutex_lock(&s_lock);
+    partition_t* p = find_part(part);
+    esp_err_t err = ESP_OK;
+    if (p == NULL || !p->present) {
+        err = ESP_ERR_NVS_PART_NOT_FOUND;
+    } else if (!p->initialised) {
+        err = ESP_ERR_NVS_NOT_INITIALIZED;
+    } else if (mode == NVS_READONLY) {
+        // Un namespace esiste solo se contiene qualcosa
+        err = ESP_ERR_NVS_NOT_FOUND;
+        for (item_t* it = s_items; it; it = it->next) {
+            if (strcmp(it->part, part) == 0 && strcmp(it->ns, name) == 0) {
+                err = ESP_OK;
+                break;
+            }
+        }
+    }
+    if (err == ESP_OK) {
+        err = ESP_ERR_NO_MEM;
+        for (nvs_handle_t h = 1; h <= MAX_HANDLES; ++h) {
+            if (!s_handles[h].open) {
+                s_handles[h].open = true;
+                s_handles[h].writable = mode == NVS_READWRITE;
+                strcpy(s_handles[h].part, part);
+                strcpy(s_handles[h].ns, name);
+                *out = h;
+                err = ESP_OK;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t mode, nvs_handle_t* out) {
+    return nvs_open_from_partition(NVS_DEFAULT_PART_NAME, name, mode, out);
+}
+
+void nvs_close(nvs_handle_t handle) {
+    pthread_mutex_lock(&s_lock);
+    if (handle > 0 && handle <= MAX_HANDLES)
+        s_handles[handle].open = false;
+    pthread_mutex_unlock(&s_lock);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    host_interleave_point();
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = get_handle(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+    if (err == ESP_OK)
+        s_stats.commits++;
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+// Common checks of the write paths, with s_lock held
+static esp_err_t writable_handle(nvs_handle_t handle, handle_t** out) {
+    handle_t* h = get_handle(handle);
+    if (h == NULL)
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!h->writable)
+        return ESP_ERR_NVS_READ_ONLY;
+    if (!s_powered)
+        return ESP_FAIL;
+    *out = h;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    handle_t* h;
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = writable_handle(handle, &h);
+    if (err == ESP_OK) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+        for (item_t** link = &s_items; *link; link = &(*link)->next) {
+            item_t* it = *link;
+            if (strcmp(it->part, h->part) == 0 && strcmp(it->ns, h->ns) == 0 && strcmp(it->key, key) == 0) {
+                *link = it->next;
+                free_item(it);
+                s_stats.erases++;
+                err = ESP_OK;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    handle_t* h;
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = writable_handle(handle, &h);
+    if (err == ESP_OK) {
+        erase_items(h->part, h->ns);
+        s_stats.erases++;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+static esp_err_t set_item(nvs_handle_t handle, const char* key, item_type_t type, const void* value, size_t len) {
+    handle_t* h;
+    if (key == NULL || (value == NULL && len > 0))
+        return ESP_ERR_INVALID_ARG;
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    host_interleave_point();            // a flash write blocks the task on the device
+    pthread_mutex_lock(&s_lock);
+    esp_err_t err = writable_handle(handle, &h);
+    if (err != ESP_OK) {
+        pthread_mutex_unlock(&s_lock);
+        return err;
+    }
+    s_stats.sets++;
+    item_t* it = find_item(h->part, h->ns, key);
+    if (it && it->type == type && it->len == len && memcmp(it->data, value, len) == 0) {
+        // Stesso valore: NVS non riscrive l'entry
+        pthread_mutex_unlock(&s_lock);
+        return ESP_OK;
+    }
+    uint8_t* data = malloc(len ? len : 1);
+    if (data == NULL) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(data, value, len);
+    if (it == NULL) {
+        it = calloc(1, sizeof(*it));
+        if (it == NULL) {
+            free(data);
+            pthread_mutex_unlock(&s_lock);
+            return ESP_ERR_NO_MEM;
+        }
+        strcpy(it->part, h->part);
+        strcpy(it->ns, h->ns);
+        strcpy(it->key, key);
+        it->next = s_items;
+        s_items = it;
+    } else {
+        free(it->data);
+    }
+    it->type = type;
+    it->len = len;
+    it->data = data;
+    s_stats.bytes_written += item_footprint(type, len);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+static esp_err_t get_item(nvs_handle_t handle, const char* key, item_type_t type, void* out, size_t* len) {
+    if (key == NULL || len == NULL)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_lock);
+    handle_t* h = get_handle(handle);
+    esp_err_t err = ESP_ERR_NVS_INVALID_HANDLE;
+    if (h) {
+        item_t* it = find_item(h->part, h->ns, key);
+        if (it == NULL || it->type != type) {
+            err = ESP_ERR_NVS_NOT_FOUND;        // la ricerca di NVS e' per chiave e tipo
+        } else if (out == NULL) {
+            *len = it->len;
+            err = ESP_OK;
+        } else if (*len < it->len) {
+            *len = it->len;
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            memcpy(out, it->data, it->len);
+            *len = it->len;
+            err = ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value) {
+    return set_item(handle, key, ITEM_U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char* key, uint16_t value) {
+    return set_item(handle, key, ITEM_U16, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value) {
+    return set_item(handle, key, ITEM_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t len) {
+    return set_item(handle, key, ITEM_BLOB, value, len);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out) {
+    size_t len = sizeof(*out);
+    return out ? get_item(handle, key, ITEM_U8, out, &len) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char* key, uint16_t* out) {
+    size_t len = sizeof(*out);
+    return out ? get_item(handle, key, ITEM_U16, out, &len) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out) {
+    size_t len = sizeof(*out);
+    return out ? get_item(handle, key, ITEM_U32, out, &len) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out, size_t* len) {
+    return get_item(handle, key, ITEM_BLOB, out, len);
+}
@@ -0,0 +1,154 @@
+// TinyUSB device HID on the host: a USB host polls the keyboard IN endpoint
+// every bInterval ms (read from the configuration descriptor) and completes
+// the transfer with tud_hid_report_complete_cb, like the real stack.
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "tinyusb.h"
+#include "class/hid/hid_device.h"
+#include "host_fakes.h"
+
+#define KEYBOARD_REPORT_LEN     8
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t s_poll_thread;
+static bool s_installed = false;
+static bool s_mounted = false;
+static bool s_pending = false;
+static uint8_t s_report[KEYBOARD_REPORT_LEN];
+static host_usb_stats_t s_stats;
+static uint8_t s_poll_override = 0;     // host_usb_set_poll_interval
+static host_ble_report_cb_t s_report_cb = NULL;
+static void* s_report_arg = NULL;
+
+// bInterval of the first interrupt IN endpoint of the configuration
+static uint8_t descriptor_interval(const uint8_t* desc) {
+    uint16_t total = desc[2] | (desc[3] << 8);
+    for (uint16_t off = 0; off + 1 < total && desc[off] > 0; off += desc[off]) {
+        if (desc[off + 1] == TUSB_DESC_ENDPOINT && (desc[off + 2] & 0x80) && (desc[off + 3] & 0x03) == 0x03)
+            return desc[off + 6];
+    }
+    return 0;
+}
+
+static void* poll_thread(void* arg) {
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (;;) {
+        pthread_mutex_lock(&s_lock);
+        uint8_t interval = s_poll_override ? s_poll_override : s_stats.interval_ms ? s_stats.interval_ms : 1;
+        bool have = s_mounted && s_pending;
+        uint8_t report[KEYBOARD_REPORT_LEN];
+        if (s_mounted)
+            s_stats.polls++;
+        if (have) {
+            memcpy(report, s_report, sizeof(report));
+            s_pending = false;
+            s_stats.reports++;
+        }
+        host_ble_report_cb_t cb = s_report_cb;
+        void* cb_arg = s_report_arg;
+        pthread_mutex_unlock(&s_lock);
+
+        if (have) {
+            if (cb)
+                cb(report, sizeof(report), host_now_us(), cb_arg);
+            // Counted before the callback: the device may send the next report from it
+            pthread_mutex_lock(&s_lock);
+            s_stats.completions++;
+            pthread_mutex_unlock(&s_lock);
+            tud_hid_report_complete_cb(0, report, sizeof(report));
+        }
+        next.tv_nsec += (long)interval * 1000000L;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    return NULL;
+}
+
+esp_err_t tinyusb_driver_install(const tinyusb_config_t* config) {
+    if (config == NULL || config->configuration_descriptor == NULL)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_lock);
+    if (s_installed) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_installed = true;
+    s_mounted = true;       // il PC enumera subito il dispositivo
+    s_stats.interval_ms = descriptor_interval(config->configuration_descriptor);
+    pthread_mutex_unlock(&s_lock);
+    pthread_create(&s_poll_thread, NULL, poll_thread, NULL);
+    pthread_detach(s_poll_thread);
+    return ESP_OK;
+}
+
+bool tud_mounted(void) {
+    pthread_mutex_lock(&s_lock);
+    bool mounted = s_mounted;
+    pthread_mutex_unlock(&s_lock);
+    return mounted;
+}
+
+bool tud_hid_ready(void) {
+    pthread_mutex_lock(&s_lock);
+    bool ready = s_mounted && !s_pending;
+    pthread_mutex_unlock(&s_lock);
+    return ready;
+}
+
+bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, const uint8_t keycode[6]) {
+    pthread_mutex_lock(&s_lock);
+    bool accepted = s_mounted && !s_pending;
+    if (accepted) {
+        if (s_stats.completions < s_stats.reports)
+            s_stats.early++;
+        s_report[0] = modifier;
+        s_report[1] = 0;
+        memcpy(&s_report[2], keycode, 6);
+        s_pending = true;
+    } else {
+        s_stats.busy++;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return accepted;
+}
+
+void host_usb_set_mounted(bool mounted) {
+    pthread_mutex_lock(&s_lock);
+    s_mounted = mounted;
+    if (!mounted)
+        s_pending = false;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_usb_set_report_cb(host_ble_report_cb_t cb, void* arg) {
+    pthread_mutex_lock(&s_lock);
+    s_report_cb = cb;
+    s_report_arg = arg;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_usb_set_poll_interval(uint8_t ms) {
+    pthread_mutex_lock(&s_lock);
+    s_poll_override = ms;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_usb_get_stats(host_usb_stats_t* out) {
+    pthread_mutex_lock(&s_lock);
+    *out = s_stats;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_usb_reset_stats(void) {
+    pthread_mutex_lock(&s_lock);
+    uint8_t interval = s_stats.interval_ms;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.interval_ms = interval;
+    pthread_mutex_unlock(&s_lock);
+}
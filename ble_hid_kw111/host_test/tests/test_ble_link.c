@@ -0,0 +1,227 @@
+// user-012/013: report pacing on the connection interval and the connection
+// parameter policy. The BLE fake drains a small controller buffer at the
+// interval and drops what does not fit; the peer's keyboard must type back
+// every character. The relax may still be in flight when typing starts.
+#include <pthread.h>
+
+#include "esp_hidd_prf_api.h"
+#include "hid_device_ble.h"
+#include "hid_layout.h"
+#include "hid_program.h"
+#include "test_util.h"
+
+#define TX_BUFFERS  3
+#define PASSWORD    "Z!9@x#Y$w%V^u&T*s(R)q_P+o=aaBB12"
+
+static pthread_mutex_t s_kbd_lock = PTHREAD_MUTEX_INITIALIZER;
+static test_kbd_t s_kbd;
+static uint64_t s_last_report_us;
+
+static void peer_report(const uint8_t* report, size_t len, uint64_t t_us, void* arg) {
+    pthread_mutex_lock(&s_kbd_lock);
+    test_kbd_feed(&s_kbd, report, len);
+    s_last_report_us = t_us;
+    pthread_mutex_unlock(&s_kbd_lock);
+}
+
+// Link at conn_int that keeps it: the peer refuses the fast interval request
+static void link_up(uint16_t conn_int) {
+    test_ble_connect(conn_int, 0);
+    host_ble_set_update_mode(HOST_BLE_UPDATE_REJECT);
+    host_ble_set_tx_buffers(TX_BUFFERS);
+    test_kbd_reset(&s_kbd, HID_LAYOUT_DEVICE);
+    s_last_report_us = 0;
+    host_ble_set_report_cb(peer_report, NULL);
+}
+
+// Waits for the controller buffer to drain; returns the ms from start to
+// the last report the peer received
+static uint64_t link_drain(host_ble_stats_t* stats, uint16_t conn_int, uint64_t start_us) {
+    vTaskDelay(pdMS_TO_TICKS((TX_BUFFERS + 2) * conn_int * 5 / 4));
+    host_ble_get_stats(stats);
+    pthread_mutex_lock(&s_kbd_lock);
+    uint64_t last = s_last_report_us;
+    pthread_mutex_unlock(&s_kbd_lock);
+    return last > start_us ? (last - start_us) / 1000 : 0;
+}
+
+// The fixed 10 ms spacing of the original ble_send_hid_key, on the same link
+static void naive_report(void* ctx, uint8_t modifier, const uint8_t* keys, uint8_t count) {
+    esp_hidd_send_keyboard_value(0, modifier, (uint8_t*)keys, count);
+    vTaskDelay(pdMS_TO_TICKS(10));
+}
+
+static void naive_delay(void* ctx, uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+static void test_paced_typing(void) {
+    static const uint16_t intervals[] = { 0x06, 0x0C, 0x18, 0x30 };    // 7.5, 15, 30, 60 ms
+    hid_program_t prog;
+    CHECK_EQ(hid_program_compile(PASSWORD, false, false, HID_LAYOUT_DEVICE, HID_FALLBACK_SKIP, &prog), ESP_OK);
+
+    for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); ++i) {
+        uint16_t conn_int = intervals[i];
+        host_ble_stats_t stats;
+
+        link_up(conn_int);
+        uint64_t start = host_now_us();
+        ble_send_program(&prog);
+        uint64_t paced_ms = link_drain(&stats, conn_int, start);
+        uint32_t reports = s_kbd.reports;
+
+        CHECK_EQ(stats.lost, 0);
+        CHECK_EQ(s_kbd.violations, 0);
+        if (strcmp(s_kbd.text, PASSWORD) != 0) {
+            fprintf(stderr, "conn_int %u: typed \"%s\"\n", conn_int, s_kbd.text);
+            test_failures++;
+        }
+        // One report per connection event at most, plus the initial burst
+        CHECK(paced_ms * 1000 >= (uint64_t)(reports - TX_BUFFERS) * conn_int * 1250 * 9 / 10);
+
+        link_up(conn_int);
+        hid_encoder_sink_t naive = { .send_report = naive_report, .delay_ms = naive_delay };
+        start = host_now_us();
+        hid_encoder_run(&prog, &naive);
+        uint64_t naive_ms = link_drain(&stats, conn_int, start);
+
+        printf("conn_int %5.1f ms: paced %4llu ms, lost 0 | fixed 10 ms %4llu ms, lost %u\n",
+               conn_int * 1.25, (unsigned long long)paced_ms, (unsigned long long)naive_ms, stats.lost);
+        if (conn_int * 5 / 4 < 10)
+            CHECK(paced_ms < naive_ms);             // short interval: faster than the fixed delay
+        else if (conn_int * 5 / 4 > 10)
+            CHECK(stats.lost > 0);                  // long interval: the fixed delay drops keys
+    }
+    hid_program_wipe(&prog);
+    test_ble_disconnect();
+}
+
+// Interval changed by the peer while typing: pacing follows the update event
+static void test_interval_update(void) {
+    link_up(0x06);
+    host_ble_peer_update(0x30, 0);
+    host_ble_sync();
+
+    ble_conn_policy_stats_t policy;
+    ble_conn_policy_get(&policy);
+    CHECK_EQ(policy.conn_int, 0x30);
+
+    host_ble_stats_t stats;
+    ble_send_string("slow link");
+    link_drain(&stats, 0x30, 0);
+    CHECK_EQ(stats.lost, 0);
+    CHECK(strcmp(s_kbd.text, "slow link") == 0);
+    test_ble_disconnect();
+}
+
+// Slow link with latency, as the host leaves it when idle; the peer answers
+// the fast interval request as set by mode
+static void policy_typing(host_ble_update_mode_t mode, ble_conn_policy_stats_t* policy) {
+    test_ble_connect(0x30, 4);
+    host_ble_set_update_mode(mode);
+    ble_conn_policy_reset_stats();
+    ble_send_string("x");
+    host_ble_sync();
+    ble_conn_policy_get(policy);
+}
+
+// The answer may come before esp_ble_gap_update_conn_params returns, or later
+static void test_policy_answer_order(void) {
+    static const host_ble_update_mode_t modes[] = { HOST_BLE_UPDATE_BEFORE_RETURN, HOST_BLE_UPDATE_ASYNC };
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+        ble_conn_policy_stats_t policy;
+        policy_typing(modes[i], &policy);
+        CHECK_EQ(policy.state, BLE_CONN_POLICY_FAST);
+        CHECK_EQ(policy.fast_requests, 1);
+        CHECK_EQ(policy.accepted, 1);
+        CHECK_EQ(policy.peer_updates, 0);
+        CHECK_EQ(policy.timeouts, 0);
+        CHECK(policy.conn_int <= 0x0C);
+    }
+
+    ble_conn_policy_stats_t policy;
+    policy_typing(HOST_BLE_UPDATE_REJECT, &policy);
+    CHECK_EQ(policy.state, BLE_CONN_POLICY_IDLE);
+    CHECK_EQ(policy.rejected, 1);
+    test_ble_disconnect();
+}
+
+// No answer: typing goes on after the wait and the next burst asks again
+static void test_policy_timeout(void) {
+    ble_conn_policy_stats_t policy;
+    policy_typing(HOST_BLE_UPDATE_NEVER, &policy);
+    CHECK_EQ(policy.state, BLE_CONN_POLICY_IDLE);
+    CHECK_EQ(policy.timeouts, 1);
+
+    ble_send_string("y");
+    ble_conn_policy_get(&policy);
+    CHECK_EQ(policy.fast_requests, 2);
+    CHECK_EQ(policy.state, BLE_CONN_POLICY_IDLE);
+    test_ble_disconnect();
+}
+
+// The idle relax waits for the end of a burst (a list dump) on the link
+static void test_policy_burst(void) {
+    ble_conn_policy_stats_t policy;
+    policy_typing(HOST_BLE_UPDATE_ASYNC, &policy);
+    CHECK_EQ(policy.state, BLE_CONN_POLICY_FAST);
+
+    ble_conn_begin_burst();
+    vTaskDelay(pdMS_TO_TICKS(3500));        // past BLE_CONN_IDLE_AFTER_MS
+    ble_conn_policy_get(&policy);
+    CHECK_EQ(policy.relax_requests, 0);
+    CHECK_EQ(policy.state, BLE_CONN_POLICY_FAST);
+
+    ble_conn_end_burst();
+    vTaskDelay(pdMS_TO_TICKS(3500));
+    host_ble_sync();
+    ble_conn_policy_get(&policy);
+    CHECK_EQ(policy.relax_requests, 1);
+    CHECK_EQ(policy.state, BLE_CONN_POLICY_IDLE);
+    CHECK(policy.latency > 0);
+    test_ble_disconnect();
+}
+
+// Typing starts while the idle relax is in flight: the relax answer must not
+// leave the login on the slow interval, the fast interval is asked again
+static void test_policy_relax_in_flight(void) {
+    ble_conn_policy_stats_t policy;
+    test_ble_connect(0x06, 0);
+    ble_conn_policy_reset_stats();
+    ble_send_string("a");
+    host_ble_sync();
+    ble_conn_policy_get(&policy);
+    CHECK_EQ(policy.state, BLE_CONN_POLICY_FAST);
+    CHECK_EQ(policy.fast_requests, 0);
+
+    host_ble_set_update_mode(HOST_BLE_UPDATE_HOLD);
+    vTaskDelay(pdMS_TO_TICKS(3500));        // past BLE_CONN_IDLE_AFTER_MS
+    ble_conn_policy_get(&policy);
+    CHECK_EQ(policy.relax_requests, 1);
+    CHECK_EQ(policy.state, BLE_CONN_POLICY_RELAX_PENDING);
+    CHECK(policy.conn_int <= 0x0C);         // relax not answered yet
+
+    // The relax answer arrives first, then the one to the new fast request
+    host_ble_set_update_mode(HOST_BLE_UPDATE_ASYNC);
+    ble_send_string("login");
+    host_ble_release_update();              // the relax answer, if nothing asked after it
+    host_ble_sync();
+    ble_conn_policy_get(&policy);
+    CHECK_EQ(policy.fast_requests, 1);
+    CHECK_EQ(policy.timeouts, 0);
+    CHECK_EQ(policy.state, BLE_CONN_POLICY_FAST);
+    CHECK(policy.conn_int <= 0x0C);
+    CHECK_EQ(policy.latency, 0);
+    test_ble_disconnect();
+}
+
+int main(void) {
+    host_log_set_level(ESP_LOG_ERROR);
+    RUN_TEST(test_paced_typing);
+    RUN_TEST(test_interval_update);
+    RUN_TEST(test_policy_answer_order);
+    RUN_TEST(test_policy_timeout);
+    RUN_TEST(test_policy_burst);
+    RUN_TEST(test_policy_relax_in_flight);
+    return test_report("test_ble_link");
+}
@@ -0,0 +1,217 @@
+// user-006/007: the AES key is derived once per session and shared by every
+// task; AES-GCM records with a random nonce
+#include <stdlib.h>
+
+#include "esp_hmac.h"
+#include "freertos/semphr.h"
+#include "mbedtls/gcm.h"
+#include "test_util.h"
+
+#define RACERS 4
+
+static void test_key_derived_once(void) {
+    test_storage_boot();
+    uint8_t enc[USERDB_PASSWORD_ENC_LEN];
+    char plain[MAX_PASSWORD_LEN + 1];
+    uint32_t derivations = host_hmac_calls();
+    for (int i = 0; i < 100; ++i) {
+        int len = userdb_encrypt_password("session", enc);
+        CHECK_EQ(userdb_decrypt_password(enc, len, plain), 0);
+    }
+    CHECK_EQ(host_hmac_calls(), derivations);
+
+    // Sleep drops the key, the next password operation derives it again
+    userdb_crypto_wipe();
+    int len = userdb_encrypt_password("session", enc);
+    CHECK_EQ(host_hmac_calls(), derivations + 1);
+    CHECK_EQ(userdb_decrypt_password(enc, len, plain), 0);
+    CHECK(strcmp(plain, "session") == 0);
+}
+
+typedef struct {
+    SemaphoreHandle_t start;
+    SemaphoreHandle_t done;
+} race_t;
+
+static void racer(void* arg) {
+    race_t* race = arg;
+    uint8_t enc[USERDB_PASSWORD_ENC_LEN];
+    xSemaphoreTake(race->start, portMAX_DELAY);
+    userdb_encrypt_password("race", enc);
+    xSemaphoreGive(race->done);
+    vTaskDelete(NULL);
+}
+
+// First use after a wipe from several tasks at once: one derivation only
+static void test_first_use_race(void) {
+    test_storage_boot();
+    host_set_interleave(true);
+    for (int round = 0; round < 20; ++round) {
+        race_t race = { xSemaphoreCreateCounting(RACERS, 0), xSemaphoreCreateCounting(RACERS, 0) };
+        userdb_crypto_wipe();
+        uint32_t derivations = host_hmac_calls();
+        for (int i = 0; i < RACERS; ++i)
+            xTaskCreate(racer, "racer", 4096, &race, 5, NULL);
+        for (int i = 0; i < RACERS; ++i)
+            xSemaphoreGive(race.start);
+        for (int i = 0; i < RACERS; ++i)
+            xSemaphoreTake(race.done, portMAX_DELAY);
+        CHECK_EQ(host_hmac_calls(), derivations + 1);
+        vSemaphoreDelete(race.start);
+        vSemaphoreDelete(race.done);
+    }
+    host_set_interleave(false);
+}
+
+static size_t unhex(const char* hex, uint8_t* out) {
+    size_t n = 0;
+    for (; hex[0] && hex[1]; hex += 2)
+        out[n++] = (uint8_t)strtoul((char[]){ hex[0], hex[1], 0 }, NULL, 16);
+    return n;
+}
+
+typedef struct {
+    const char *key, *iv, *plain, *aad, *cipher, *tag;
+} gcm_vector_t;
+
+// "The Galois/Counter Mode of Operation", test cases 2-4 (AES-128)
+static const gcm_vector_t s_vectors[] = {
+    { "00000000000000000000000000000000", "000000000000000000000000",
+      "00000000000000000000000000000000", "",
+      "0388dace60b6a392f328c2b971b2fe78", "ab6e47d42cec13bdf53a67b21257bddf" },
+    { "feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+      "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+      "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255", "",
+      "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+      "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091473f5985",
+      "4d5c2af327cd64a62cf35abd2ba6fab4" },
+    { "feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+      "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+      "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+      "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+      "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+      "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091",
+      "5bc94fbc3221a5db94fae95ae7121a47" },
+};
+
+static void test_gcm_vectors(void) {
+    for (size_t v = 0; v < sizeof(s_vectors) / sizeof(s_vectors[0]); ++v) {
+        uint8_t key[16], iv[12], plain[64], aad[20], cipher[64], tag[16], out[64], out_tag[16];
+        unhex(s_vectors[v].key, key);
+        unhex(s_vectors[v].iv, iv);
+        size_t len = unhex(s_vectors[v].plain, plain);
+        size_t aad_len = unhex(s_vectors[v].aad, aad);
+        unhex(s_vectors[v].cipher, cipher);
+        unhex(s_vectors[v].tag, tag);
+
+        mbedtls_gcm_context gcm;
+        mbedtls_gcm_init(&gcm);
+        CHECK_EQ(mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, 128), 0);
+        CHECK_EQ(mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, len, iv, sizeof(iv), aad, aad_len,
+                                           plain, out, sizeof(out_tag), out_tag), 0);
+        CHECK(memcmp(out, cipher, len) == 0);
+        CHECK(memcmp(out_tag, tag, sizeof(tag)) == 0);
+        CHECK_EQ(mbedtls_gcm_auth_decrypt(&gcm, len, iv, sizeof(iv), aad, aad_len, tag, sizeof(tag),
+                                          cipher, out), 0);
+        CHECK(memcmp(out, plain, len) == 0);
+        tag[0] ^= 1;
+        CHECK_EQ(mbedtls_gcm_auth_decrypt(&gcm, len, iv, sizeof(iv), aad, aad_len, tag, sizeof(tag),
+                                          cipher, out), MBEDTLS_ERR_GCM_AUTH_FAILED);
+        mbedtls_gcm_free(&gcm);
+    }
+}
+
+// Record = nonce | tag | ciphertext under the eFuse-derived key, fresh nonce
+// on every encryption, any altered byte rejected
+static void test_record_format(void) {
+    test_storage_boot();
+    uint8_t enc[USERDB_PASSWORD_ENC_LEN], enc2[USERDB_PASSWORD_ENC_LEN];
+    char plain[MAX_PASSWORD_LEN + 1];
+    const char* password = "Tr0ub4dor&3";
+    int len = userdb_encrypt_password(password, enc);
+    CHECK_EQ(len, USERDB_GCM_NONCE_LEN + USERDB_GCM_TAG_LEN + strlen(password));
+    CHECK_EQ(userdb_encrypt_password(password, enc2), len);
+    CHECK(memcmp(enc, enc2, USERDB_GCM_NONCE_LEN) != 0);
+    CHECK(memcmp(enc + USERDB_GCM_NONCE_LEN, enc2 + USERDB_GCM_NONCE_LEN, len - USERDB_GCM_NONCE_LEN) != 0);
+
+    uint8_t hmac[32];
+    const char* context = "userdb-password-key";
+    esp_hmac_calculate(HMAC_KEY0, context, strlen(context), hmac);
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, hmac, 128);
+    size_t plain_len = len - USERDB_GCM_NONCE_LEN - USERDB_GCM_TAG_LEN;
+    CHECK_EQ(mbedtls_gcm_auth_decrypt(&gcm, plain_len, enc, USERDB_GCM_NONCE_LEN, NULL, 0,
+                                      enc + USERDB_GCM_NONCE_LEN, USERDB_GCM_TAG_LEN,
+                                      enc + USERDB_GCM_NONCE_LEN + USERDB_GCM_TAG_LEN, (uint8_t*)plain), 0);
+    plain[plain_len] = '\0';
+    CHECK(strcmp(plain, password) == 0);
+    mbedtls_gcm_free(&gcm);
+
+    for (int i = 0; i < len; ++i) {
+        enc[i] ^= 0x80;
+        CHECK(userdb_decrypt_password(enc, len, plain) != 0);
+        CHECK_EQ(plain[0], '\0');
+        enc[i] ^= 0x80;
+    }
+    CHECK_EQ(userdb_decrypt_password(enc, len, plain), 0);
+    CHECK_EQ(userdb_decrypt_password(enc, USERDB_GCM_NONCE_LEN + USERDB_GCM_TAG_LEN - 1, plain), -1);
+    CHECK_EQ(userdb_decrypt_password(enc, USERDB_PASSWORD_ENC_LEN + 1, plain), -1);
+}
+
+// Logins, the GATT listing and the edits use the shared context from their
+// own tasks while sleep wipes it: every operation still succeeds
+#define USERS_OF_CONTEXT 3
+#define CONTEXT_ROUNDS   300
+
+typedef struct {
+    int id;
+    volatile int failures;
+    volatile bool done;
+} context_user_t;
+
+static void context_user(void* arg) {
+    context_user_t* u = arg;
+    uint8_t enc[USERDB_PASSWORD_ENC_LEN];
+    char expected[MAX_PASSWORD_LEN + 1], plain[MAX_PASSWORD_LEN + 1];
+    for (int i = 0; i < CONTEXT_ROUNDS; ++i) {
+        snprintf(expected, sizeof(expected), "task %d round %d", u->id, i);
+        int len = userdb_encrypt_password(expected, enc);
+        if (len < 0 || userdb_decrypt_password(enc, len, plain) != 0 || strcmp(plain, expected) != 0)
+            u->failures++;
+    }
+    u->done = true;
+    vTaskDelete(NULL);
+}
+
+static void test_shared_context(void) {
+    test_storage_boot();
+    host_log_set_level(ESP_LOG_NONE);
+    host_set_interleave(true);
+    context_user_t users[USERS_OF_CONTEXT];
+    for (int i = 0; i < USERS_OF_CONTEXT; ++i) {
+        users[i] = (context_user_t){ .id = i };
+        xTaskCreate(context_user, "ctx_user", 4096, &users[i], 5, NULL);
+    }
+    bool running = true;
+    while (running) {
+        userdb_crypto_wipe();
+        vTaskDelay(1);
+        running = false;
+        for (int i = 0; i < USERS_OF_CONTEXT; ++i)
+            running |= !users[i].done;
+    }
+    host_set_interleave(false);
+    host_log_set_level(ESP_LOG_WARN);
+    for (int i = 0; i < USERS_OF_CONTEXT; ++i)
+        CHECK_EQ(users[i].failures, 0);
+}
+
+int main(void) {
+    RUN_TEST(test_key_derived_once);
+    RUN_TEST(test_first_use_race);
+    RUN_TEST(test_gcm_vectors);
+    RUN_TEST(test_record_format);
+    RUN_TEST(test_shared_context);
+    return test_report("test_crypto");
+}
@@ -0,0 +1,220 @@
+// user-019: characters missing from the account layout. The fallback
+// sequences (ALT + keypad digits, CTRL+SHIFT+U + hex digits + SPACE) are
+// checked report by report, SKIP must not send anything for the dropped
+// character and REJECT refuses the password when it is enrolled.
+#include "hid_device_prf.h"
+#include "hid_keys.h"
+#include "hid_layout.h"
+#include "hid_program.h"
+#include "test_util.h"
+#include "user_proto.h"
+
+#define MAX_REPORTS 64
+
+typedef struct {
+    uint8_t reports[MAX_REPORTS][8];    // modifier, 0, keys
+    int count;
+} capture_t;
+
+static void capture_report(void* ctx, uint8_t modifier, const uint8_t* keys, uint8_t count) {
+    capture_t* c = ctx;
+    if (c->count < MAX_REPORTS) {
+        memset(c->reports[c->count], 0, 8);
+        c->reports[c->count][0] = modifier;
+        memcpy(&c->reports[c->count][2], keys, count);
+    }
+    c->count++;
+}
+
+static void capture_delay(void* ctx, uint32_t ms) {
+}
+
+static int type_text(const char* text, uint8_t layout, uint8_t fallback, capture_t* c) {
+    hid_program_t prog;
+    memset(c, 0, sizeof(*c));
+    esp_err_t ret = hid_program_compile(text, false, false, layout, fallback, &prog);
+    if (ret != ESP_OK)
+        return -1;
+    hid_encoder_sink_t sink = { .send_report = capture_report, .delay_ms = capture_delay, .ctx = c };
+    hid_encoder_run(&prog, &sink);
+    hid_program_wipe(&prog);
+    return c->count;
+}
+
+// Reports expected at offset of the capture: { modifier, key1, key2 }
+static void check_reports(const capture_t* c, int offset, const uint8_t (*exp)[3], int n) {
+    CHECK(offset + n <= c->count);
+    for (int i = 0; i < n && offset + i < c->count; ++i) {
+        const uint8_t* r = c->reports[offset + i];
+        bool same = r[0] == exp[i][0] && r[2] == exp[i][1] && r[3] == exp[i][2] && r[4] == 0;
+        if (!same)
+            fprintf(stderr, "report %d: %02x %02x %02x instead of %02x %02x %02x\n", offset + i,
+                    r[0], r[2], r[3], exp[i][0], exp[i][1], exp[i][2]);
+        CHECK(same);
+    }
+}
+
+static uint8_t keypad(char digit) {
+    return digit == '0' ? HID_KEY_KEYPAD_0 : HID_KEY_KEYPAD_1 + (digit - '1');
+}
+
+// ALT alone, then press/release of each keypad digit with ALT held, then release
+static void expect_alt(const char* digits, uint8_t (*exp)[3]) {
+    int n = 0;
+    exp[n][0] = HID_MODIFIER_LEFT_ALT, exp[n][1] = 0, exp[n++][2] = 0;
+    for (const char* d = digits; *d; ++d) {
+        exp[n][0] = HID_MODIFIER_LEFT_ALT, exp[n][1] = keypad(*d), exp[n++][2] = 0;
+        exp[n][0] = HID_MODIFIER_LEFT_ALT, exp[n][1] = 0, exp[n++][2] = 0;
+    }
+    exp[n][0] = 0, exp[n][1] = 0, exp[n][2] = 0;
+}
+
+static void test_alt_code(void) {
+    static const struct {
+        const char* text;
+        const char* digits;
+    } cases[] = {
+        { "ñ", "0241" },        // Latin-1: codice ANSI
+        { "€", "0128" },        // cp1252 0x80
+        { "—", "0151" },        // cp1252 0x97
+        { "☺", "9786" },        // fuori da cp1252: codepoint decimale
+        { "😀", "128512" },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        capture_t c;
+        uint8_t exp[16][3];
+        expect_alt(cases[i].digits, exp);
+        int n = 2 + 2 * strlen(cases[i].digits);
+        CHECK_EQ(type_text(cases[i].text, HID_LAYOUT_US, HID_FALLBACK_ALT_CODE, &c), n);
+        check_reports(&c, 0, exp, n);
+    }
+}
+
+static void test_hex_code(void) {
+    capture_t c;
+    // "ñ" = U+00F1: CTRL+SHIFT+U, "f1" in rollover, SPACE
+    static const uint8_t exp_f1[][3] = {
+        { HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_SHIFT, HID_KEY_U, 0 }, { 0, 0, 0 },
+        { 0, HID_KEY_F, 0 }, { 0, HID_KEY_F, HID_KEY_1 }, { 0, 0, 0 },
+        { 0, HID_KEY_SPACE, 0 }, { 0, 0, 0 },
+    };
+    CHECK_EQ(type_text("ñ", HID_LAYOUT_US, HID_FALLBACK_HEX_CODE, &c), 7);
+    check_reports(&c, 0, exp_f1, 7);
+
+    // U+0101 "101": the repeated digit releases the held keys
+    static const uint8_t exp_101[][3] = {
+        { HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_SHIFT, HID_KEY_U, 0 }, { 0, 0, 0 },
+        { 0, HID_KEY_1, 0 }, { 0, HID_KEY_1, HID_KEY_0 }, { 0, 0, 0 }, { 0, HID_KEY_1, 0 }, { 0, 0, 0 },
+        { 0, HID_KEY_SPACE, 0 }, { 0, 0, 0 },
+    };
+    CHECK_EQ(type_text("ā", HID_LAYOUT_US, HID_FALLBACK_HEX_CODE, &c), 9);
+    check_reports(&c, 0, exp_101, 9);
+
+    // The hex digits are typed with the host layout: on FR the digits need SHIFT
+    const hid_layout_key_t* f = hid_layout_lookup(HID_LAYOUT_FR, 'f');
+    const hid_layout_key_t* one = hid_layout_lookup(HID_LAYOUT_FR, '1');
+    CHECK(f != NULL && one != NULL && one->modifier != f->modifier);
+    if (f != NULL && one != NULL) {
+        const uint8_t exp_fr[][3] = {
+            { HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_SHIFT, HID_KEY_U, 0 }, { 0, 0, 0 },
+            { f->modifier, f->key, 0 }, { 0, 0, 0 }, { one->modifier, one->key, 0 }, { 0, 0, 0 },
+            { 0, HID_KEY_SPACE, 0 }, { 0, 0, 0 },
+        };
+        CHECK_EQ(type_text("ñ", HID_LAYOUT_FR, HID_FALLBACK_HEX_CODE, &c), 8);
+        check_reports(&c, 0, exp_fr, 8);
+    }
+}
+
+// The fallback sequence releases the keys typed before it and the text goes on after it
+static void test_fallback_in_text(void) {
+    capture_t c;
+    uint8_t exp[16][3];
+    static const uint8_t exp_a[][3] = { { 0, HID_KEY_A, 0 }, { 0, 0, 0 } };
+    static const uint8_t exp_b[][3] = { { 0, HID_KEY_B, 0 }, { 0, 0, 0 } };
+    expect_alt("0241", exp);
+    CHECK_EQ(type_text("añb", HID_LAYOUT_US, HID_FALLBACK_ALT_CODE, &c), 2 + 10 + 2);
+    check_reports(&c, 0, exp_a, 2);
+    check_reports(&c, 2, (const uint8_t (*)[3])exp, 10);
+    check_reports(&c, 12, exp_b, 2);
+}
+
+// SKIP: the missing character sends no report at all (no empty report for it)
+static void test_skip(void) {
+    capture_t with, without;
+    CHECK_EQ(type_text("añb", HID_LAYOUT_US, HID_FALLBACK_SKIP, &with), type_text("ab", HID_LAYOUT_US, HID_FALLBACK_SKIP, &without));
+    CHECK(memcmp(with.reports, without.reports, sizeof(with.reports)) == 0);
+    CHECK_EQ(type_text("ñ€", HID_LAYOUT_US, HID_FALLBACK_SKIP, &with), 0);
+}
+
+static void test_reject_compile(void) {
+    hid_program_t prog;
+    host_stdout_mute(true);
+    CHECK_EQ(hid_program_compile("añb", false, false, HID_LAYOUT_US, HID_FALLBACK_REJECT, &prog), ESP_ERR_NOT_SUPPORTED);
+    CHECK_EQ(prog.count, 0);
+    CHECK_EQ(hid_program_compile("àèì", false, false, HID_LAYOUT_IT, HID_FALLBACK_REJECT, &prog), ESP_OK);
+    host_stdout_mute(false);
+    hid_program_wipe(&prog);
+}
+
+static void write_user(const char* label, const char* password, uint8_t layout, uint8_t fallback) {
+    user_proto_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.fields = USER_FIELD(USER_TAG_LABEL) | USER_FIELD(USER_TAG_PASSWORD) |
+                   USER_FIELD(USER_TAG_LAYOUT) | USER_FIELD(USER_TAG_FALLBACK);
+    entry.label_len = strlen(label);
+    memcpy(entry.label, label, entry.label_len);
+    entry.password_len = strlen(password);
+    memcpy(entry.password, password, entry.password_len);
+    entry.layout = layout;
+    entry.fallback = fallback;
+
+    uint8_t frame[USER_PROTO_FRAME_MAX];
+    size_t len = user_proto_encode(WRITE_USER, user_count, &entry, frame, sizeof(frame));
+    CHECK(len > 0);
+    test_mgmt_write(frame, len);
+}
+
+// REJECT at enrollment: the account is not stored, with another fallback it is
+static void test_reject_enroll(void) {
+    test_storage_boot();
+    test_ble_connect(0x18, 0);
+    host_stdout_mute(true);
+    write_user("rejected", "añb", HID_LAYOUT_US, HID_FALLBACK_REJECT);
+    CHECK_EQ(user_count, 0);
+    write_user("typeable", "àèì", HID_LAYOUT_IT, HID_FALLBACK_REJECT);
+    CHECK_EQ(user_count, 1);
+    write_user("alt", "añb", HID_LAYOUT_US, HID_FALLBACK_ALT_CODE);
+    CHECK_EQ(user_count, 2);
+    host_stdout_mute(false);
+
+    user_entry_t user;
+    CHECK_EQ(userdb_get(1, &user), 0);
+    CHECK_EQ(user.fallback, HID_FALLBACK_ALT_CODE);
+    test_ble_disconnect();
+}
+
+// Reports per fallback character (press and release of every key included)
+static void test_report_counts(void) {
+    static const char* chars[] = { "ñ", "€", "ā", "☺", "😀" };
+    printf("%-6s %8s %8s\n", "char", "alt", "hex");
+    for (size_t i = 0; i < sizeof(chars) / sizeof(chars[0]); ++i) {
+        capture_t c;
+        int alt = type_text(chars[i], HID_LAYOUT_US, HID_FALLBACK_ALT_CODE, &c);
+        int hex = type_text(chars[i], HID_LAYOUT_US, HID_FALLBACK_HEX_CODE, &c);
+        printf("%-6s %8d %8d\n", chars[i], alt, hex);
+        // ALT: 2 + 2 per cifra (3..7); HEX: 5 + una per cifra (max 6), +1 per cifra ripetuta
+        CHECK(alt >= 2 + 2 * 3 && alt <= 2 + 2 * 7);
+        CHECK(hex >= 7 && hex <= 5 + 2 * 6);
+    }
+}
+
+int main(void) {
+    RUN_TEST(test_alt_code);
+    RUN_TEST(test_hex_code);
+    RUN_TEST(test_fallback_in_text);
+    RUN_TEST(test_skip);
+    RUN_TEST(test_reject_compile);
+    RUN_TEST(test_reject_enroll);
+    RUN_TEST(test_report_counts);
+    return test_report("test_fallback");
+}
@@ -0,0 +1,118 @@
+// user-011: multi-key rollover reports. The encoder output is replayed into
+// a virtual host keyboard, which must type back the original text.
+#include "hid_keys.h"
+#include "hid_layout.h"
+#include "hid_program.h"
+#include "test_util.h"
+
+// Types text through a compiled program; returns the reports it took
+static uint32_t type_text(test_kbd_t* kbd, const char* text, uint8_t layout, bool send_enter) {
+    hid_program_t prog;
+    CHECK_EQ(hid_program_compile(text, false, send_enter, layout, HID_FALLBACK_SKIP, &prog), ESP_OK);
+    test_kbd_reset(kbd, hid_layout_resolve(layout));
+    hid_encoder_sink_t sink = test_kbd_sink(kbd);
+    hid_encoder_run(&prog, &sink);
+    hid_program_wipe(&prog);
+    CHECK_EQ(kbd->violations, 0);
+    CHECK_EQ(kbd->count, 0);        // everything released at the end
+    CHECK_EQ(kbd->modifier, 0);
+    return kbd->reports;
+}
+
+static void test_round_trip(void) {
+    static const char* texts[] = {
+        "Password1",
+        "correct horse battery staple",
+        "aaaa",
+        "AbCdEfGh",
+        "Z!9@x#Y$w%V^u&T*s(R)q_P+o=",
+        "12345678901234567890123456789012",
+        "perché è così",
+    };
+    static const uint8_t layouts[] = { HID_LAYOUT_IT, HID_LAYOUT_US, HID_LAYOUT_DE };
+
+    test_kbd_t kbd;
+    for (size_t l = 0; l < sizeof(layouts); ++l) {
+        for (size_t t = 0; t < sizeof(texts) / sizeof(texts[0]); ++t) {
+            if (layouts[l] != HID_LAYOUT_IT && t == 6)
+                continue;   // accenti non presenti (o tasti morti) negli altri layout
+            type_text(&kbd, texts[t], layouts[l], false);
+            if (strcmp(kbd.text, texts[t]) != 0) {
+                fprintf(stderr, "layout %s: typed \"%s\" instead of \"%s\"\n",
+                        hid_layout_name(layouts[l]), kbd.text, texts[t]);
+                test_failures++;
+            }
+        }
+    }
+
+    type_text(&kbd, "user", HID_LAYOUT_IT, true);
+    CHECK(strcmp(kbd.text, "user\n") == 0);
+}
+
+static void test_report_count(void) {
+    test_kbd_t kbd;
+    // 9 presses, releases before the shifted "P" run ends and before "s" repeats, and at the end
+    CHECK_EQ(type_text(&kbd, "Password1", HID_LAYOUT_US, false), 12);
+    // Every repeat needs a release in between
+    CHECK_EQ(type_text(&kbd, "aaaa", HID_LAYOUT_US, false), 8);
+    // Six distinct keys fill the report, the seventh starts a new one
+    CHECK_EQ(type_text(&kbd, "abcdefgh", HID_LAYOUT_US, false), 10);
+    // Modifier change: one release each time shift goes on or off
+    CHECK_EQ(type_text(&kbd, "aBc", HID_LAYOUT_US, false), 6);
+    // One press and one release per key was 2 * 32
+    CHECK(type_text(&kbd, "12345678901234567890123456789012", HID_LAYOUT_US, false) < 2 * 32 * 3 / 4);
+}
+
+typedef struct {
+    uint8_t modifier[32];
+    uint8_t count[32];
+    int n;
+} report_log_t;
+
+static void log_report(void* ctx, uint8_t modifier, const uint8_t* keys, uint8_t count) {
+    report_log_t* log = ctx;
+    if (log->n < 32) {
+        log->modifier[log->n] = modifier;
+        log->count[log->n] = count;
+        log->n++;
+    }
+}
+
+static void log_delay(void* ctx, uint32_t ms) {
+}
+
+// Combinations and placeholders are sent on their own, never packed
+static void test_alone_keys(void) {
+    hid_program_t prog;
+    hid_program_init(&prog);
+    hid_program_add_text(&prog, "ab", HID_LAYOUT_US, HID_FALLBACK_SKIP);
+    hid_program_add_key(&prog, HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, HID_KEY_DELETE);
+    hid_program_add_text(&prog, "cd", HID_LAYOUT_US, HID_FALLBACK_SKIP);
+
+    report_log_t log = {0};
+    hid_encoder_sink_t sink = { .send_report = log_report, .delay_ms = log_delay, .ctx = &log };
+    hid_encoder_run(&prog, &sink);
+    hid_program_wipe(&prog);
+
+    // a, ab, release, CTRL+ALT+DEL, release, c, cd, release
+    static const uint8_t counts[] = { 1, 2, 0, 1, 0, 1, 2, 0 };
+    CHECK_EQ(log.n, sizeof(counts));
+    for (int i = 0; i < log.n && i < (int)sizeof(counts); ++i)
+        CHECK_EQ(log.count[i], counts[i]);
+    CHECK_EQ(log.modifier[3], HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT);
+
+    // A single tap is still a press and a release
+    log.n = 0;
+    hid_encoder_tap(HID_MODIFIER_LEFT_SHIFT, HID_KEY_A, &sink);
+    CHECK_EQ(log.n, 2);
+    CHECK_EQ(log.count[0], 1);
+    CHECK_EQ(log.count[1], 0);
+}
+
+int main(void) {
+    host_log_set_level(ESP_LOG_ERROR);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_report_count);
+    RUN_TEST(test_alone_keys);
+    return test_report("test_keyboard");
+}
@@ -0,0 +1,174 @@
+// user-016: keyboard layouts. Every character a layout can type is compiled,
+// replayed into the virtual keyboard and must come back unchanged; the
+// unshifted and shifted keys are also checked against a reference written
+// from the printed keyboards, row by row.
+#include <wchar.h>
+
+#include "hid_keys.h"
+#include "hid_layout.h"
+#include "hid_program.h"
+#include "test_util.h"
+
+#define NONE    0   // tasto assente nella riga
+// \x01 nelle righe: carattere non controllato (nessuno, o digitato altrove dal layout)
+
+// Physical keys of the four character rows (ISO: one more key next to Enter
+// and one left of Z); hash_key is the code the layout uses next to Enter
+typedef struct {
+    uint8_t layout;
+    uint8_t hash_key;           // 0: ANSI (US), the key is BACKSLASH on row 1
+    const wchar_t* rows[4][2];  // unshifted, shifted
+} reference_t;
+
+static const reference_t s_reference[] = {
+    { HID_LAYOUT_US, 0, {
+        { L"`1234567890-=", L"~!@#$%^&*()_+" },
+        { L"qwertyuiop[]\\", L"QWERTYUIOP{}|" },
+        { L"asdfghjkl;'", L"ASDFGHJKL:\"" },
+        { L"zxcvbnm,./", L"ZXCVBNM<>?" } } },
+    { HID_LAYOUT_UK, HID_KEY_EUROPE_1, {
+        { L"`1234567890-=", L"¬!\"£$%^&*()_+" },
+        { L"qwertyuiop[]", L"QWERTYUIOP{}" },
+        { L"asdfghjkl;'#", L"ASDFGHJKL:@~" },
+        { L"\\zxcvbnm,./", L"|ZXCVBNM<>?" } } },
+    { HID_LAYOUT_DE, HID_KEY_EUROPE_1, {
+        { L"^1234567890ß´", L"°!\"§$%&/()=?`" },
+        { L"qwertzuiopü+", L"QWERTZUIOPÜ*" },
+        { L"asdfghjklöä#", L"ASDFGHJKLÖÄ'" },
+        { L"<yxcvbnm,.-", L">YXCVBNM;:_" } } },
+    { HID_LAYOUT_FR, HID_KEY_EUROPE_1, {
+        { L"²&é\"'(-è_çà)=", L"\x01" L"1234567890°+" },
+        { L"azertyuiop\x01$", L"AZERTYUIOP¨£" },     // ^ morto: il layout usa AltGr+9
+        { L"qsdfghjklmù*", L"QSDFGHJKLM%µ" },
+        { L"<wxcvbn,;:!", L">WXCVBN?./§" } } },
+    { HID_LAYOUT_IT, HID_KEY_BACKSLASH, {
+        { L"\\1234567890'ì", L"|!\"£$%&/()=?^" },
+        { L"qwertyuiopè+", L"QWERTYUIOPé*" },
+        { L"asdfghjklòàù", L"ASDFGHJKLç°§" },
+        { L"<zxcvbnm,.-", L">ZXCVBNM;:_" } } },
+};
+
+static void row_keys(const reference_t* ref, int row, uint8_t keys[13]) {
+    static const uint8_t row0[] = { HID_KEY_GRAVE, HID_KEY_1, HID_KEY_2, HID_KEY_3, HID_KEY_4, HID_KEY_5,
+                                    HID_KEY_6, HID_KEY_7, HID_KEY_8, HID_KEY_9, HID_KEY_0, HID_KEY_MINUS, HID_KEY_EQUAL };
+    static const uint8_t row1[] = { HID_KEY_Q, HID_KEY_W, HID_KEY_E, HID_KEY_R, HID_KEY_T, HID_KEY_Y, HID_KEY_U,
+                                    HID_KEY_I, HID_KEY_O, HID_KEY_P, HID_KEY_BRACKET_LEFT, HID_KEY_BRACKET_RIGHT,
+                                    HID_KEY_BACKSLASH };
+    static const uint8_t row2[] = { HID_KEY_A, HID_KEY_S, HID_KEY_D, HID_KEY_F, HID_KEY_G, HID_KEY_H, HID_KEY_J,
+                                    HID_KEY_K, HID_KEY_L, HID_KEY_SEMICOLON, HID_KEY_APOSTROPHE, NONE };
+    static const uint8_t row3[] = { HID_KEY_Z, HID_KEY_X, HID_KEY_C, HID_KEY_V, HID_KEY_B, HID_KEY_N, HID_KEY_M,
+                                    HID_KEY_COMMA, HID_KEY_PERIOD, HID_KEY_SLASH };
+    memset(keys, 0, 13);
+    switch (row) {
+        case 0: memcpy(keys, row0, sizeof(row0)); break;
+        case 1: memcpy(keys, row1, sizeof(row1)); break;
+        case 2:
+            memcpy(keys, row2, sizeof(row2));
+            keys[11] = ref->hash_key;
+            break;
+        case 3:
+            if (ref->hash_key) {
+                keys[0] = HID_KEY_EUROPE_2;
+                memcpy(&keys[1], row3, sizeof(row3));
+            } else {
+                memcpy(keys, row3, sizeof(row3));
+            }
+            break;
+    }
+}
+
+// The layout puts every printed character on the printed key (dead or not)
+static void test_reference_rows(void) {
+    for (size_t r = 0; r < sizeof(s_reference) / sizeof(s_reference[0]); ++r) {
+        const reference_t* ref = &s_reference[r];
+        for (int row = 0; row < 4; ++row) {
+            uint8_t keys[13];
+            row_keys(ref, row, keys);
+            for (int shift = 0; shift < 2; ++shift) {
+                const wchar_t* chars = ref->rows[row][shift];
+                uint8_t modifier = shift ? HID_MODIFIER_LEFT_SHIFT : HID_MODIFIER_NONE;
+                for (size_t i = 0; i < wcslen(chars); ++i) {
+                    if (chars[i] == 0x01)
+                        continue;
+                    const hid_layout_key_t* k = hid_layout_lookup(ref->layout, chars[i]);
+                    if (k == NULL || k->key != keys[i] || k->modifier != modifier) {
+                        fprintf(stderr, "%s: U+%04X expected on key 0x%02x mod 0x%02x, got %s 0x%02x mod 0x%02x\n",
+                                hid_layout_name(ref->layout), (unsigned)chars[i], keys[i], modifier,
+                                k ? "key" : "nothing", k ? k->key : 0, k ? k->modifier : 0);
+                        test_failures++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Every Latin-1 character of every layout survives compile + encode + the
+// virtual keyboard, alone and in the middle of a word
+static void test_round_trip(void) {
+    for (uint8_t layout = HID_LAYOUT_DEFAULT + 1; layout < HID_LAYOUT_NB; ++layout) {
+        int typeable = 0;
+        for (uint32_t cp = 0x20; cp <= 0xFF; ++cp) {
+            if (cp == 0x7F)
+                cp = 0xA0;
+            if (hid_layout_lookup(layout, cp) == NULL)
+                continue;
+            typeable++;
+
+            char text[8];
+            if (cp < 0x80)
+                snprintf(text, sizeof(text), "a%cb", (char)cp);
+            else
+                snprintf(text, sizeof(text), "a%c%cb", (char)(0xC0 | (cp >> 6)), (char)(0x80 | (cp & 0x3F)));
+            hid_program_t prog;
+            test_kbd_t kbd;
+            CHECK_EQ(hid_program_compile(text, false, false, layout, HID_FALLBACK_REJECT, &prog), ESP_OK);
+            test_kbd_reset(&kbd, layout);
+            hid_encoder_sink_t sink = test_kbd_sink(&kbd);
+            hid_encoder_run(&prog, &sink);
+            hid_program_wipe(&prog);
+            if (strcmp(kbd.text, text) != 0) {
+                fprintf(stderr, "%s: U+%04X typed as \"%s\"\n", hid_layout_name(layout), (unsigned)cp, kbd.text);
+                test_failures++;
+            }
+        }
+        printf("%s: %d Latin-1 characters\n", hid_layout_name(layout), typeable);
+        CHECK(typeable >= 90);
+    }
+}
+
+// No two characters on the same key with the same modifiers
+static void test_no_ambiguity(void) {
+    for (uint8_t layout = HID_LAYOUT_DEFAULT + 1; layout < HID_LAYOUT_NB; ++layout) {
+        static uint32_t owner[256][256];
+        memset(owner, 0, sizeof(owner));
+        for (uint32_t cp = 0x20; cp <= 0x20FF; ++cp) {
+            const hid_layout_key_t* k = hid_layout_lookup(layout, cp);
+            if (k == NULL || cp == 0x7F)
+                continue;
+            uint32_t* o = &owner[k->modifier][k->key];
+            if (*o != 0) {
+                fprintf(stderr, "%s: U+%04X and U+%04X on the same key\n", hid_layout_name(layout),
+                        (unsigned)*o, (unsigned)cp);
+                test_failures++;
+            }
+            *o = cp;
+        }
+    }
+}
+
+static void test_us_ascii_complete(void) {
+    for (uint32_t cp = 0x20; cp < 0x7F; ++cp)
+        CHECK(hid_layout_lookup(HID_LAYOUT_US, cp) != NULL);
+    CHECK(hid_layout_lookup(HID_LAYOUT_DEFAULT, 0xE0) == hid_layout_lookup(HID_LAYOUT_DEVICE, 0xE0));
+    CHECK_EQ(hid_layout_resolve(HID_LAYOUT_NB), HID_LAYOUT_DEVICE);
+}
+
+int main(void) {
+    host_log_set_level(ESP_LOG_ERROR);
+    RUN_TEST(test_reference_rows);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_no_ambiguity);
+    RUN_TEST(test_us_ascii_complete);
+    return test_report("test_layout");
+}
@@ -0,0 +1,407 @@
+// user-021: listing the accounts from the client side. The GET_USERS_LIST
+// ping-pong (one write with response and one indication per entry) and the
+// GET_USERS_DUMP stream (one write, then notifications with sequence numbers
+// and an end record) must give the client the same list; the simulator
+// prints the ATT round-trips and the wall-clock time of both at 10 and 200
+// entries, with writes paced on the connection events.
+// user-022: the same dump at ATT MTU 23, 128, 247 and 517 (bytes and PDUs of
+// a full-list sync; records span the frames, the end record never does).
+// user-023: delta sync from a revision, valid only with the DB epoch.
+// user-024: a legacy EDIT_USER from an app that listed without passwords, and
+// a record whose password does not decrypt.
+#include "hid_device_prf.h"
+#include "test_util.h"
+
+#define CONN_INT        0x06        // 7.5 ms
+#define MTU             247
+#define MTU_MAX         517         // ESP_GATT_MAX_MTU_SIZE
+#define ENTRY_LEN       (MAX_LABEL_LEN + MAX_PASSWORD_LEN + 7)
+#define MATRIX_ENTRIES  100
+#define END_LEN         10          // <LIST_EMPTY><count><revision u32><epoch u32>
+
+typedef struct {
+    int count;                      // size of the list
+    int records;                    // entries received (a delta: only the changed ones)
+    uint32_t revision;              // end record of the dump
+    uint32_t epoch;
+    char label[MAX_USERS][MAX_LABEL_LEN + 1];
+    char password[MAX_USERS][MAX_PASSWORD_LEN + 1];
+    uint32_t round_trips;           // write + response, indication + confirmation
+    uint32_t pdus;                  // notifications and indications received
+    uint64_t bytes;                 // ATT payload of those
+    double ms;
+} client_list_t;
+
+static void client_store(client_list_t* list, uint8_t index, const uint8_t* entry) {
+    CHECK(index < MAX_USERS);
+    if (index >= MAX_USERS)
+        return;
+    memcpy(list->label[index], entry, MAX_LABEL_LEN);
+    memcpy(list->password[index], entry + MAX_LABEL_LEN, MAX_PASSWORD_LEN);
+}
+
+static void client_begin(client_list_t* list) {
+    memset(list, 0, sizeof(*list));
+    host_ble_reset_stats();
+}
+
+static void client_end(client_list_t* list, uint64_t start_us) {
+    host_ble_stats_t stats;
+    list->ms = (host_now_us() - start_us) / 1000.0;
+    host_ble_get_stats(&stats);
+    list->round_trips = stats.writes + stats.indications;
+    list->pdus = stats.notifications;
+    list->bytes = stats.notification_bytes;
+}
+
+// Client before the bulk dump: asks index 0, then index + 1 at every answer
+static void list_ping_pong(client_list_t* list) {
+    uint8_t frame[MTU];
+    client_begin(list);
+    uint64_t start = host_now_us();
+    for (int index = 0;; ++index) {
+        uint8_t request[2] = { GET_USERS_LIST, index };
+        test_mgmt_write(request, sizeof(request));
+        size_t len = test_mgmt_take(frame, sizeof(frame), 1000);
+        if (len < 2 + ENTRY_LEN)
+            break;      // frame vuoto: fine della lista
+        CHECK_EQ(frame[0], GET_USERS_LIST);
+        CHECK_EQ(frame[1], index);
+        client_store(list, frame[1], &frame[2]);
+        list->count++;
+        list->records++;
+    }
+    client_end(list, start);
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+// Client of the bulk dump: frames reassembled into one record stream
+static void list_dump_request(client_list_t* list, const uint8_t* request, size_t request_len) {
+    uint8_t stream[MAX_USERS * (1 + ENTRY_LEN) + 16];
+    size_t stream_len = 0;
+    uint8_t frame[MTU_MAX];
+    uint8_t seq = 0;
+    client_begin(list);
+    uint64_t start = host_now_us();
+    test_mgmt_write(request, request_len);
+
+    size_t pos = 0;
+    bool end = false;
+    while (!end) {
+        size_t len = test_mgmt_take(frame, sizeof(frame), 2000);
+        CHECK(len > 2);
+        if (len <= 2)
+            break;
+        CHECK_EQ(frame[0], GET_USERS_DUMP);
+        CHECK_EQ(frame[1], seq);        // nessuna notifica persa
+        seq++;
+        CHECK(stream_len + len - 2 <= sizeof(stream));
+        if (stream_len + len - 2 > sizeof(stream))
+            break;
+        memcpy(&stream[stream_len], &frame[2], len - 2);
+        stream_len += len - 2;
+
+        // Record completi: <index><entry>, chiusi da <LIST_EMPTY><count><revision><epoch>
+        while (!end) {
+            if (pos < stream_len && stream[pos] == LIST_EMPTY) {
+                if (stream_len - pos < END_LEN)
+                    break;
+                list->count = stream[pos + 1];
+                list->revision = get_u32(&stream[pos + 2]);
+                list->epoch = get_u32(&stream[pos + 6]);
+                end = true;
+            } else if (stream_len - pos >= 1 + ENTRY_LEN) {
+                client_store(list, stream[pos], &stream[pos + 1]);
+                list->records++;
+                pos += 1 + ENTRY_LEN;
+            } else {
+                break;
+            }
+        }
+    }
+    // The dump task logs after the last frame
+    client_end(list, start);
+}
+
+// <cmd><revision><epoch>; since 0: a client without cache, <cmd> only
+static void list_dump_since(client_list_t* list, uint32_t since, uint32_t epoch) {
+    uint8_t request[9] = { GET_USERS_DUMP };
+    put_u32(&request[1], since);
+    put_u32(&request[5], epoch);
+    list_dump_request(list, request, since ? sizeof(request) : 1);
+}
+
+static void list_dump(client_list_t* list) {
+    list_dump_since(list, 0, 0);
+}
+
+static void check_list(const client_list_t* list, int n) {
+    CHECK_EQ(list->count, n);
+    CHECK_EQ(list->records, n);
+    for (int i = 0; i < n && i < list->count; ++i) {
+        char label[MAX_LABEL_LEN];
+        snprintf(label, sizeof(label), "acct%03d", i);
+        CHECK(strcmp(list->label[i], label) == 0);
+        CHECK(strcmp(list->password[i], "password") == 0);
+    }
+}
+
+static void test_list(int n) {
+    client_list_t* ping = calloc(1, sizeof(*ping));
+    client_list_t* dump = calloc(1, sizeof(*dump));
+
+    test_storage_boot();
+    test_populate("acct", n);
+    test_ble_connect(CONN_INT, 0);
+    host_ble_set_mtu(MTU);
+    host_ble_sync();
+    host_ble_set_write_timing(true);
+
+    host_stdout_mute(true);
+    list_ping_pong(ping);
+    list_dump(dump);
+    host_stdout_mute(false);
+    host_ble_set_write_timing(false);
+    test_ble_disconnect();
+
+    check_list(ping, n);
+    check_list(dump, n);
+    // Ping-pong: 2 round-trip per voce piu' la richiesta oltre la fine; dump: la sola scrittura
+    CHECK_EQ(ping->round_trips, 2 * (n + 1));
+    CHECK_EQ(dump->round_trips, 1);
+    CHECK(dump->ms < ping->ms);
+
+    printf("%8d %-10s %12u %8u %12.1f\n", n, "ping-pong", ping->round_trips, ping->pdus, ping->ms);
+    printf("%8d %-10s %12u %8u %12.1f\n", n, "dump", dump->round_trips, dump->pdus, dump->ms);
+    free(ping);
+    free(dump);
+}
+
+static void test_list_sizes(void) {
+    printf("%8s %-10s %12s %8s %12s\n", "entries", "method", "round-trips", "PDUs", "ms");
+    test_list(10);
+    test_list(200);
+}
+
+// Full dump of MATRIX_ENTRIES at every MTU: each frame carries min(MTU - 3,
+// USER_MGMT_VALUE_MAX) bytes, 2 of them <cmd><seq>
+static void test_mtu_matrix(void) {
+    static const uint16_t mtus[] = { 23, 128, 247, MTU_MAX };
+    const size_t stream = MATRIX_ENTRIES * (1 + ENTRY_LEN) + END_LEN;
+    client_list_t* dump = calloc(1, sizeof(*dump));
+    uint32_t prev_pdus = UINT32_MAX;
+
+    test_storage_boot();
+    test_populate("acct", MATRIX_ENTRIES);
+    printf("%6s %8s %8s %10s %10s %10s\n", "MTU", "PDUs", "bytes", "overhead", "bytes/PDU", "ms");
+    for (size_t i = 0; i < sizeof(mtus) / sizeof(mtus[0]); ++i) {
+        test_ble_connect(CONN_INT, 0);
+        host_ble_set_packets_per_event(6);     // data length extension: piu' PDU per connection event
+        host_ble_set_mtu(mtus[i]);
+        host_ble_sync();
+        host_stdout_mute(true);
+        list_dump(dump);
+        host_stdout_mute(false);
+        test_ble_disconnect();
+
+        check_list(dump, MATRIX_ENTRIES);
+        size_t room = mtus[i] - 3 < USER_MGMT_VALUE_MAX ? mtus[i] - 3 : USER_MGMT_VALUE_MAX;
+        uint32_t min_pdus = (stream + room - 3) / (room - 2);
+        CHECK_EQ(dump->bytes, stream + 2 * dump->pdus);
+        CHECK(dump->pdus >= min_pdus && dump->pdus <= min_pdus + 1);
+        CHECK(dump->pdus < prev_pdus);
+        prev_pdus = dump->pdus;
+        printf("%6u %8u %8llu %9.1f%% %10.1f %10.1f\n", mtus[i], dump->pdus, (unsigned long long)dump->bytes,
+               100.0 * (dump->bytes - stream) / dump->bytes, (double)dump->bytes / dump->pdus, dump->ms);
+    }
+    free(dump);
+}
+
+static void connect_for_sync(void) {
+    test_ble_connect(CONN_INT, 0);
+    host_ble_set_mtu(MTU);
+    host_ble_sync();
+}
+
+// A delta carries only the records changed after the client's revision, and
+// only when the client's epoch is the DB's one
+static void test_delta_epoch(void) {
+    client_list_t* list = calloc(1, sizeof(*list));
+    user_entry_t user;
+
+    test_storage_boot();
+    test_populate("acct", 5);
+    connect_for_sync();
+    host_stdout_mute(true);
+    list_dump(list);
+    check_list(list, 5);
+    uint32_t revision = list->revision, epoch = list->epoch;
+    CHECK_EQ(revision, userdb_revision());
+    CHECK(epoch != 0);
+    CHECK_EQ(epoch, userdb_epoch());
+
+    // Un record modificato: il delta porta solo quello
+    CHECK_EQ(userdb_get(2, &user), 0);
+    user.winlogin = true;
+    userdb_edit(2, &user);
+    list_dump_since(list, revision, epoch);
+    CHECK_EQ(list->count, 5);
+    CHECK_EQ(list->records, 1);
+    CHECK(strcmp(list->label[2], "acct002") == 0);
+    CHECK(list->revision > revision);
+    CHECK_EQ(list->epoch, epoch);
+    revision = list->revision;
+
+    // Another epoch, or none (older app): full list
+    list_dump_since(list, revision, epoch ^ 1);
+    check_list(list, 5);
+    uint8_t request[5] = { GET_USERS_DUMP };
+    put_u32(&request[1], revision);
+    list_dump_request(list, request, sizeof(request));
+    check_list(list, 5);
+    host_stdout_mute(false);
+    test_ble_disconnect();
+
+    // The epoch survives a reboot, a clear makes a new one
+    test_storage_reboot();
+    CHECK_EQ(userdb_epoch(), epoch);
+    host_stdout_mute(true);
+    userdb_clear();
+    host_stdout_mute(false);
+    CHECK(userdb_epoch() != epoch && userdb_epoch() != 0);
+    free(list);
+}
+
+// Flash erased: the new DB counts its revisions from zero again and reaches
+// the client's number with other records. The epoch tells them apart.
+static void test_epoch_after_erase(void) {
+    client_list_t* list = calloc(1, sizeof(*list));
+
+    test_storage_boot();
+    test_populate("acct", 5);
+    connect_for_sync();
+    host_stdout_mute(true);
+    list_dump(list);
+    host_stdout_mute(false);
+    uint32_t revision = list->revision, epoch = list->epoch;
+    test_ble_disconnect();
+
+    test_storage_boot();
+    test_populate("other", 5);
+    CHECK_EQ(userdb_revision(), revision);
+    CHECK(userdb_epoch() != epoch);
+    connect_for_sync();
+    host_stdout_mute(true);
+    list_dump_since(list, revision, epoch);
+    host_stdout_mute(false);
+    test_ble_disconnect();
+    CHECK_EQ(list->records, 5);
+    CHECK(strcmp(list->label[0], "other000") == 0);
+    free(list);
+}
+
+static void legacy_edit(uint8_t index, const char* label, const char* password, bool winlogin) {
+    uint8_t frame[71] = { EDIT_USER, index };
+    memcpy(&frame[2], label, strlen(label));
+    if (password != NULL)
+        memcpy(&frame[2 + MAX_LABEL_LEN], password, strlen(password));
+    frame[2 + MAX_LABEL_LEN + MAX_PASSWORD_LEN] = winlogin;
+    test_mgmt_write(frame, sizeof(frame));
+}
+
+static void check_password(uint8_t index, const char* expected) {
+    user_entry_t user;
+    char plain[MAX_PASSWORD_LEN + 1] = { 0 };
+    CHECK_EQ(userdb_get(index, &user), 0);
+    CHECK(userdb_decrypt_password(user.password_enc, user.password_len, plain) >= 0);
+    CHECK(strcmp(plain, expected) == 0);
+}
+
+// The list has no passwords: an EDIT_USER with the password field all zero
+// changes the other fields and keeps the stored password
+static void test_legacy_edit(void) {
+    user_entry_t user;
+
+    test_storage_boot();
+    test_populate("acct", 3);
+    connect_for_sync();
+    host_stdout_mute(true);
+    legacy_edit(1, "renamed", NULL, true);
+    host_stdout_mute(false);
+    CHECK_EQ(userdb_get(1, &user), 0);
+    CHECK(strcmp(user.label, "renamed") == 0);
+    CHECK(user.winlogin);
+    check_password(1, "password");
+
+    // A password in the frame replaces the stored one
+    host_stdout_mute(true);
+    legacy_edit(1, "renamed", "changed", false);
+    host_stdout_mute(false);
+    check_password(1, "changed");
+    test_ble_disconnect();
+}
+
+// A password that fails the GCM check never goes out as an empty one:
+// GET_USERS_LIST answers with an error message, the dump leaves the entry out
+static void test_corrupted_record(void) {
+    client_list_t* list = calloc(1, sizeof(*list));
+    user_entry_t user;
+    uint8_t frame[MTU];
+
+    test_storage_boot();
+    test_populate("acct", 3);
+    CHECK_EQ(userdb_get(1, &user), 0);
+    user.password_enc[USERDB_GCM_NONCE_LEN] ^= 0x01;     // tag
+    host_stdout_mute(true);
+    userdb_edit(1, &user);
+    connect_for_sync();
+
+    uint8_t request[2] = { GET_USERS_LIST, 1 };
+    test_mgmt_write(request, sizeof(request));
+    size_t len = test_mgmt_take(frame, sizeof(frame), 1000);
+    CHECK(len >= 3);
+    CHECK_EQ(frame[0], BLE_MESSAGE);
+    CHECK_EQ(frame[1], 1);      // errore
+
+    list_dump(list);
+    len = test_mgmt_take(frame, sizeof(frame), 2000);
+    host_stdout_mute(false);
+    CHECK_EQ(list->count, 3);
+    CHECK_EQ(list->records, 2);
+    CHECK_EQ(list->label[1][0], 0);
+    CHECK(strcmp(list->label[0], "acct000") == 0 && strcmp(list->password[0], "password") == 0);
+    CHECK(strcmp(list->label[2], "acct002") == 0 && strcmp(list->password[2], "password") == 0);
+    CHECK(len >= 3);
+    CHECK_EQ(frame[0], BLE_MESSAGE);
+    CHECK_EQ(frame[1], 1);
+
+    // The other entries still answer one by one
+    request[1] = 2;
+    test_mgmt_write(request, sizeof(request));
+    len = test_mgmt_take(frame, sizeof(frame), 1000);
+    CHECK_EQ(len, 2 + ENTRY_LEN);
+    CHECK_EQ(frame[0], GET_USERS_LIST);
+    test_ble_disconnect();
+    free(list);
+}
+
+int main(void) {
+    host_log_set_level(ESP_LOG_ERROR);
+    RUN_TEST(test_list_sizes);
+    RUN_TEST(test_mtu_matrix);
+    RUN_TEST(test_delta_epoch);
+    RUN_TEST(test_epoch_after_erase);
+    RUN_TEST(test_legacy_edit);
+    RUN_TEST(test_corrupted_record);
+    return test_report("test_list_sync");
+}
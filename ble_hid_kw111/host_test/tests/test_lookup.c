@@ -0,0 +1,200 @@
+// user-009/010: fingerprint template id -> account index, label search and
+// alphabetical jump groups
+#include "hid_device_prf.h"
+#include "test_util.h"
+
+static void add_finger_user(const char* label, uint8_t finger, bool magic) {
+    user_entry_t user;
+    test_make_user(&user, label, "pw");
+    user.fingerprint_id = finger;
+    user.magicfinger = magic;
+    host_stdout_mute(true);
+    userdb_add(&user);
+    host_stdout_mute(false);
+}
+
+static void test_finger_map(void) {
+    test_storage_boot();
+    add_finger_user("zero", 0, true);
+    add_finger_user("no magic", 5, false);
+    add_finger_user("five", 5, true);
+    add_finger_user("five again", 5, true);
+    add_finger_user("last id", USERDB_FINGER_IDS - 1, true);
+
+    CHECK_EQ(userdb_find_magicfinger(0), 0);
+    CHECK_EQ(userdb_find_magicfinger(5), 2);    // first magicfinger account on the template
+    CHECK_EQ(userdb_find_magicfinger(USERDB_FINGER_IDS - 1), 4);
+    CHECK_EQ(userdb_find_magicfinger(1), -1);
+    CHECK_EQ(userdb_find_magicfinger(USERDB_FINGER_IDS), -1);
+
+    // Edit: template moved, magicfinger dropped
+    user_entry_t user;
+    userdb_get(2, &user);
+    user.fingerprint_id = 9;
+    host_stdout_mute(true);
+    userdb_edit(2, &user);
+    host_stdout_mute(false);
+    CHECK_EQ(userdb_find_magicfinger(9), 2);
+    CHECK_EQ(userdb_find_magicfinger(5), 3);
+    userdb_get(0, &user);
+    user.magicfinger = false;
+    host_stdout_mute(true);
+    userdb_edit(0, &user);
+    host_stdout_mute(false);
+    CHECK_EQ(userdb_find_magicfinger(0), -1);
+
+    // Remove shifts the indices that followed
+    host_stdout_mute(true);
+    userdb_remove(1);
+    host_stdout_mute(false);
+    CHECK_EQ(userdb_find_magicfinger(9), 1);
+    CHECK_EQ(userdb_find_magicfinger(5), 2);
+    CHECK_EQ(userdb_find_magicfinger(USERDB_FINGER_IDS - 1), 3);
+
+    // Rebuilt at boot
+    test_storage_reboot();
+    CHECK_EQ(userdb_find_magicfinger(9), 1);
+    CHECK_EQ(userdb_find_magicfinger(5), 2);
+
+    host_stdout_mute(true);
+    userdb_clear();
+    host_stdout_mute(false);
+    CHECK_EQ(userdb_find_magicfinger(9), -1);
+}
+
+// Lookup cost doesn't depend on the number of accounts
+static void test_lookup_is_constant(void) {
+    uint64_t ns[2];
+    const int sizes[2] = { 10, MAX_USERS };
+    for (int s = 0; s < 2; ++s) {
+        test_storage_boot();
+        test_populate("f", sizes[s] - 1);
+        add_finger_user("target", 77, true);
+        uint64_t start = test_now_ns();
+        int found = 0;
+        for (int i = 0; i < 100000; ++i)
+            found += userdb_find_magicfinger(77) == sizes[s] - 1;
+        ns[s] = test_now_ns() - start;
+        CHECK_EQ(found, 100000);
+    }
+    printf("100k lookups: %llu ns with 10 accounts, %llu ns with %d\n",
+           (unsigned long long)ns[0], (unsigned long long)ns[1], MAX_USERS);
+    CHECK(ns[1] < 4 * ns[0] + 1000000);
+}
+
+static void add_labels(const char* const* labels, int n) {
+    host_stdout_mute(true);
+    for (int i = 0; i < n; ++i)
+        test_add_user(labels[i], "pw");
+    host_stdout_mute(false);
+}
+
+static const char* const s_labels[] = {
+    "Gmail", "github", "Bank", "account_alpha", "account_beta", "amazon", "Zoom", "gitlab", "\xc3\xa8 utf",
+};
+#define LABELS (int)(sizeof(s_labels) / sizeof(s_labels[0]))
+
+static void check_found(const uint8_t* got, int n, const int* expected, int m) {
+    CHECK_EQ(n, m);
+    for (int i = 0; i < n && i < m; ++i)
+        CHECK_EQ(got[i], expected[i]);
+}
+
+static void test_prefix_search(void) {
+    test_storage_boot();
+    add_labels(s_labels, LABELS);
+    uint8_t out[USERDB_SEARCH_MAX];
+
+    check_found(out, userdb_search_prefix("g", out, USERDB_SEARCH_MAX), (int[]){ 1, 7, 0 }, 3);
+    check_found(out, userdb_search_prefix("GIT", out, USERDB_SEARCH_MAX), (int[]){ 1, 7 }, 2);
+    check_found(out, userdb_search_prefix("gmail", out, USERDB_SEARCH_MAX), (int[]){ 0 }, 1);
+    // Longer than the resident key: decided on the full labels
+    check_found(out, userdb_search_prefix("account_b", out, USERDB_SEARCH_MAX), (int[]){ 4 }, 1);
+    check_found(out, userdb_search_prefix("account_", out, USERDB_SEARCH_MAX), (int[]){ 3, 4 }, 2);
+    check_found(out, userdb_search_prefix("account_alphabet", out, USERDB_SEARCH_MAX), NULL, 0);
+    check_found(out, userdb_search_prefix("\xc3\xa8", out, USERDB_SEARCH_MAX), (int[]){ 8 }, 1);
+    check_found(out, userdb_search_prefix("x", out, USERDB_SEARCH_MAX), NULL, 0);
+    CHECK_EQ(userdb_search_prefix("", out, USERDB_SEARCH_MAX), LABELS);
+    CHECK_EQ(userdb_search_prefix("", out, 2), 2);
+
+    // Kept up to date by edit and remove
+    user_entry_t user;
+    userdb_get(6, &user);
+    strcpy(user.label, "GitKraken");
+    host_stdout_mute(true);
+    userdb_edit(6, &user);
+    userdb_remove(1);
+    host_stdout_mute(false);
+    check_found(out, userdb_search_prefix("git", out, USERDB_SEARCH_MAX), (int[]){ 5, 6 }, 2);
+}
+
+static void test_fuzzy_search(void) {
+    test_storage_boot();
+    add_labels(s_labels, LABELS);
+    uint8_t out[USERDB_SEARCH_MAX];
+    check_found(out, userdb_search_fuzzy("gml", out, USERDB_SEARCH_MAX), (int[]){ 0 }, 1);
+    check_found(out, userdb_search_fuzzy("GTB", out, USERDB_SEARCH_MAX), (int[]){ 1, 7 }, 2);
+    check_found(out, userdb_search_fuzzy("act_bt", out, USERDB_SEARCH_MAX), (int[]){ 4 }, 1);
+    check_found(out, userdb_search_fuzzy("zz", out, USERDB_SEARCH_MAX), NULL, 0);
+    CHECK_EQ(userdb_search_fuzzy("a", out, 3), 3);
+}
+
+static void test_jump_groups(void) {
+    test_storage_boot();
+    CHECK_EQ(userdb_label_group_next(-1, 1), -1);
+    add_labels(s_labels, LABELS);
+    // Alphabetical: account_alpha account_beta amazon Bank github gitlab Gmail Zoom è
+    CHECK_EQ(userdb_label_group_next(-1, 1), 3);
+    CHECK_EQ(userdb_label_group_next(3, 1), 2);
+    CHECK_EQ(userdb_label_group_next(5, 1), 2);     // from inside the group
+    CHECK_EQ(userdb_label_group_next(2, 1), 1);
+    CHECK_EQ(userdb_label_group_next(0, 1), 6);
+    CHECK_EQ(userdb_label_group_next(6, 1), 8);
+    CHECK_EQ(userdb_label_group_next(8, 1), 3);     // wraps
+    CHECK_EQ(userdb_label_group_next(3, -1), 8);    // wraps back
+    CHECK_EQ(userdb_label_group_next(7, -1), 2);
+    CHECK_EQ(userdb_label_group_next(2, -1), 3);
+}
+
+// SEARCH_USERS over the user management characteristic
+static void test_gatt_search(void) {
+    test_storage_boot();
+    add_labels(s_labels, LABELS);
+    test_ble_connect(24, 0);
+
+    uint8_t req[2 + MAX_LABEL_LEN] = { SEARCH_USERS, SEARCH_PREFIX, 'g', 'i' };
+    uint8_t reply[2 + USERDB_SEARCH_MAX];
+    test_mgmt_write(req, 4);
+    size_t len = test_mgmt_take(reply, sizeof(reply), 1000);
+    CHECK_EQ(len, 4);
+    CHECK_EQ(reply[0], SEARCH_USERS);
+    CHECK_EQ(reply[1], 2);
+    CHECK_EQ(reply[2], 1);
+    CHECK_EQ(reply[3], 7);
+
+    req[1] = SEARCH_FUZZY;
+    memcpy(&req[2], "gml", 3);
+    test_mgmt_write(req, 5);
+    len = test_mgmt_take(reply, sizeof(reply), 1000);
+    CHECK_EQ(len, 3);
+    CHECK_EQ(reply[1], 1);
+    CHECK_EQ(reply[2], 0);
+
+    req[1] = SEARCH_PREFIX;
+    req[2] = 'q';
+    test_mgmt_write(req, 3);
+    len = test_mgmt_take(reply, sizeof(reply), 1000);
+    CHECK_EQ(len, 2);
+    CHECK_EQ(reply[1], 0);
+    test_ble_disconnect();
+}
+
+int main(void) {
+    RUN_TEST(test_finger_map);
+    RUN_TEST(test_lookup_is_constant);
+    RUN_TEST(test_prefix_search);
+    RUN_TEST(test_fuzzy_search);
+    RUN_TEST(test_jump_groups);
+    RUN_TEST(test_gatt_search);
+    return test_report("test_lookup");
+}
@@ -0,0 +1,192 @@
+// user-014: per-transport typing tasks. Mock transports stand in for BLE and
+// USB: they record the programs and take a fixed time per key, or fail as a
+// dropped link would.
+#include "freertos/semphr.h"
+#include "hid_keys.h"
+#include "hid_output.h"
+#include "test_util.h"
+
+#define KEY_MS      2
+
+typedef struct {
+    SemaphoreHandle_t gate;         // held by the test: the transport blocks on it
+    uint8_t first_key[8];           // first key of every program received
+    int programs;
+    esp_err_t result;               // returned by send_program (a failure stops after the first key)
+} mock_transport_t;
+
+static mock_transport_t s_mock[HID_TRANSPORT_NB];
+
+static esp_err_t mock_send(mock_transport_t* m, const hid_program_t* prog) {
+    if (m->gate) {
+        xSemaphoreTake(m->gate, portMAX_DELAY);
+        xSemaphoreGive(m->gate);
+    }
+    if (m->programs < 8)
+        m->first_key[m->programs] = prog->count ? prog->ops[0].key : 0;
+    m->programs++;
+    vTaskDelay(pdMS_TO_TICKS((m->result == ESP_OK ? prog->count : 1) * KEY_MS));
+    return m->result;
+}
+
+static esp_err_t mock_ble_send(const hid_program_t* prog) { return mock_send(&s_mock[HID_TRANSPORT_BLE], prog); }
+static esp_err_t mock_usb_send(const hid_program_t* prog) { return mock_send(&s_mock[HID_TRANSPORT_USB], prog); }
+
+typedef struct {
+    int calls;
+    esp_err_t result;
+    uint32_t typing_us;
+    hid_transport_t transport;
+} done_t;
+
+static void on_done(hid_transport_t transport, esp_err_t result, uint32_t queued_us,
+                    uint32_t typing_us, void* arg) {
+    done_t* done = arg;
+    done->calls++;
+    done->result = result;
+    done->typing_us = typing_us;
+    done->transport = transport;
+}
+
+static void make_program(hid_program_t* prog, uint8_t first_key, int keys) {
+    hid_program_init(prog);
+    for (int i = 0; i < keys; ++i)
+        hid_program_add_key(prog, 0, i == 0 ? first_key : HID_KEY_A);
+}
+
+static void test_not_started(void) {
+    hid_program_t prog;
+    make_program(&prog, HID_KEY_A, 1);
+    CHECK_EQ(hid_output_submit(HID_TRANSPORT_USB, &prog, NULL, NULL), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(hid_output_submit(HID_TRANSPORT_NB, &prog, NULL, NULL), ESP_ERR_INVALID_ARG);
+    CHECK(hid_output_is_idle(HID_TRANSPORT_USB));
+
+    static const hid_transport_ops_t ble_ops = { .send_program = mock_ble_send };
+    static const hid_transport_ops_t usb_ops = { .send_program = mock_usb_send };
+    CHECK_EQ(hid_output_start(HID_TRANSPORT_BLE, &ble_ops), ESP_OK);
+    CHECK_EQ(hid_output_start(HID_TRANSPORT_USB, &usb_ops), ESP_OK);
+    CHECK_EQ(hid_output_start(HID_TRANSPORT_USB, &usb_ops), ESP_ERR_INVALID_STATE);
+    hid_output_stats_reset(HID_TRANSPORT_USB);
+}
+
+// The caller gets control back at once; the program is a copy it may wipe
+static void test_submit_returns_at_once(void) {
+    hid_program_t prog;
+    make_program(&prog, HID_KEY_Z, 50);     // 100 ms of typing
+    done_t done = {0};
+
+    uint64_t start = test_now_ns();
+    CHECK_EQ(hid_output_submit(HID_TRANSPORT_BLE, &prog, on_done, &done), ESP_OK);
+    uint64_t submit_us = (test_now_ns() - start) / 1000;
+    hid_program_wipe(&prog);
+    CHECK(submit_us < 5000);
+    CHECK(!hid_output_is_idle(HID_TRANSPORT_BLE));
+
+    CHECK_EQ(hid_output_wait_idle(HID_TRANSPORT_BLE, pdMS_TO_TICKS(1000)), ESP_OK);
+    CHECK_EQ(done.calls, 1);
+    CHECK_EQ(done.result, ESP_OK);
+    CHECK_EQ(done.transport, HID_TRANSPORT_BLE);
+    CHECK(done.typing_us >= 50 * KEY_MS * 1000 * 9 / 10);
+    CHECK_EQ(s_mock[HID_TRANSPORT_BLE].first_key[0], HID_KEY_Z);
+
+    hid_output_stats_t stats;
+    hid_output_stats_get(HID_TRANSPORT_BLE, &stats);
+    CHECK_EQ(stats.jobs, 1);
+    CHECK_EQ(stats.last_typing_us, done.typing_us);
+    printf("submit %llu us, typing %u us\n", (unsigned long long)submit_us, done.typing_us);
+}
+
+// BLE and USB type at the same time, each on its own task
+static void test_transports_in_parallel(void) {
+    hid_program_t prog;
+    make_program(&prog, HID_KEY_A, 50);
+    done_t ble = {0}, usb = {0};
+
+    uint64_t start = test_now_ns();
+    CHECK_EQ(hid_output_submit(HID_TRANSPORT_BLE, &prog, on_done, &ble), ESP_OK);
+    CHECK_EQ(hid_output_submit(HID_TRANSPORT_USB, &prog, on_done, &usb), ESP_OK);
+    CHECK_EQ(hid_output_wait_idle(HID_TRANSPORT_BLE, pdMS_TO_TICKS(1000)), ESP_OK);
+    CHECK_EQ(hid_output_wait_idle(HID_TRANSPORT_USB, pdMS_TO_TICKS(1000)), ESP_OK);
+    uint64_t total_ms = (test_now_ns() - start) / 1000000;
+    hid_program_wipe(&prog);
+
+    CHECK_EQ(ble.calls, 1);
+    CHECK_EQ(usb.calls, 1);
+    CHECK_EQ(usb.transport, HID_TRANSPORT_USB);
+    CHECK(total_ms < 2 * 50 * KEY_MS);
+}
+
+// Jobs run in order; a full queue refuses the job instead of blocking
+static void test_queue_full(void) {
+    mock_transport_t* m = &s_mock[HID_TRANSPORT_USB];
+    m->programs = 0;
+    m->gate = xSemaphoreCreateMutex();
+    xSemaphoreTake(m->gate, portMAX_DELAY);
+    hid_output_stats_reset(HID_TRANSPORT_USB);
+
+    hid_program_t prog;
+    done_t done = {0};
+    // One job in the task, HID_OUTPUT_QUEUE_LEN waiting
+    for (int i = 0; i < 1 + HID_OUTPUT_QUEUE_LEN; ++i) {
+        make_program(&prog, HID_KEY_1 + i, 1);
+        CHECK_EQ(hid_output_submit(HID_TRANSPORT_USB, &prog, on_done, &done), ESP_OK);
+        if (i == 0)
+            vTaskDelay(pdMS_TO_TICKS(20));  // il task prende il primo job
+    }
+    make_program(&prog, HID_KEY_9, 1);
+    CHECK_EQ(hid_output_submit(HID_TRANSPORT_USB, &prog, on_done, &done), ESP_ERR_TIMEOUT);
+    CHECK_EQ(hid_output_wait_idle(HID_TRANSPORT_USB, pdMS_TO_TICKS(50)), ESP_ERR_TIMEOUT);
+
+    xSemaphoreGive(m->gate);
+    CHECK_EQ(hid_output_wait_idle(HID_TRANSPORT_USB, pdMS_TO_TICKS(1000)), ESP_OK);
+    CHECK_EQ(done.calls, 1 + HID_OUTPUT_QUEUE_LEN);
+    CHECK_EQ(m->programs, 1 + HID_OUTPUT_QUEUE_LEN);
+    for (int i = 0; i < 1 + HID_OUTPUT_QUEUE_LEN; ++i)
+        CHECK_EQ(m->first_key[i], HID_KEY_1 + i);
+
+    hid_output_stats_t stats;
+    hid_output_stats_get(HID_TRANSPORT_USB, &stats);
+    CHECK_EQ(stats.jobs, 1 + HID_OUTPUT_QUEUE_LEN);
+    CHECK_EQ(stats.dropped, 1);
+    hid_program_wipe(&prog);
+}
+
+// A transport error reaches the callback and the stats; the next job is typed
+static void test_transport_error(void) {
+    mock_transport_t* m = &s_mock[HID_TRANSPORT_BLE];
+    static const esp_err_t errors[] = { ESP_ERR_INVALID_STATE, ESP_ERR_TIMEOUT };
+    hid_program_t prog;
+    make_program(&prog, HID_KEY_A, 20);
+    hid_output_stats_reset(HID_TRANSPORT_BLE);
+
+    for (size_t i = 0; i < sizeof(errors) / sizeof(errors[0]); ++i) {
+        done_t done = {0};
+        m->result = errors[i];
+        CHECK_EQ(hid_output_submit(HID_TRANSPORT_BLE, &prog, on_done, &done), ESP_OK);
+        CHECK_EQ(hid_output_wait_idle(HID_TRANSPORT_BLE, pdMS_TO_TICKS(1000)), ESP_OK);
+        CHECK_EQ(done.calls, 1);
+        CHECK_EQ(done.result, errors[i]);
+    }
+    m->result = ESP_OK;
+    done_t done = {0};
+    CHECK_EQ(hid_output_submit(HID_TRANSPORT_BLE, &prog, on_done, &done), ESP_OK);
+    CHECK_EQ(hid_output_wait_idle(HID_TRANSPORT_BLE, pdMS_TO_TICKS(1000)), ESP_OK);
+    CHECK_EQ(done.result, ESP_OK);
+    hid_program_wipe(&prog);
+
+    hid_output_stats_t stats;
+    hid_output_stats_get(HID_TRANSPORT_BLE, &stats);
+    CHECK_EQ(stats.jobs, 3);
+    CHECK_EQ(stats.failed, 2);
+    CHECK_EQ(stats.last_result, ESP_OK);
+}
+
+int main(void) {
+    host_log_set_level(ESP_LOG_ERROR);
+    RUN_TEST(test_not_started);
+    RUN_TEST(test_submit_returns_at_once);
+    RUN_TEST(test_transports_in_parallel);
+    RUN_TEST(test_queue_full);
+    RUN_TEST(test_transport_error);
+    return test_report("test_output");
+}
@@ -0,0 +1,89 @@
+// user-005: records paged from their own partition, RAM independent of the
+// number of accounts
+#include <malloc.h>
+
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "test_util.h"
+
+static void check_label(int index, const char* prefix) {
+    char expected[MAX_LABEL_LEN];
+    user_entry_t user;
+    snprintf(expected, sizeof(expected), "%s%03d", prefix, index);
+    CHECK_EQ(userdb_get(index, &user), 0);
+    CHECK(strcmp(user.label, expected) == 0);
+}
+
+static void test_full_db_pages_through_cache(void) {
+    test_storage_boot();
+    test_populate("page", MAX_USERS);
+    CHECK_EQ(user_count, MAX_USERS);
+    user_entry_t extra;
+    test_make_user(&extra, "one too many", "pw");
+    CHECK_EQ(userdb_add(&extra), -1);
+
+    test_storage_reboot();
+    CHECK_EQ(user_count, MAX_USERS);
+    for (int i = 0; i < MAX_USERS; ++i)
+        check_label(i, "page");
+    uint32_t lcg = 7;
+    for (int i = 0; i < 1000; ++i) {
+        lcg = lcg * 1103515245u + 12345u;
+        check_label((lcg >> 16) % MAX_USERS, "page");
+    }
+    // Browsing back and forth over the cache window
+    for (int i = 0; i < 3 * USERDB_CACHE_SIZE; ++i)
+        check_label(i % (USERDB_CACHE_SIZE + 1), "page");
+}
+
+static size_t heap_in_use(void) {
+    return mallinfo2().uordblks;
+}
+
+static void test_ram_is_flat(void) {
+    size_t ram = userdb_ram_usage();
+    size_t heap[2];
+    const int sizes[2] = { 10, MAX_USERS };
+    for (int s = 0; s < 2; ++s) {
+        test_storage_boot();
+        test_populate("ram", sizes[s]);
+        size_t before = heap_in_use();
+        test_storage_reboot();
+        for (int i = 0; i < sizes[s]; ++i)
+            check_label(i, "ram");
+        heap[s] = heap_in_use() - before;
+        CHECK_EQ(userdb_ram_usage(), ram);
+    }
+    CHECK_EQ(heap[0], 0);
+    CHECK_EQ(heap[1], 0);
+    printf("resident RAM: %zu B for 10 and %d accounts\n", ram, MAX_USERS);
+}
+
+// Old partition table: the DB lives in the default NVS partition until the
+// table with USERDB_PARTITION is flashed, then it moves there
+static void test_partition_fallback_and_move(void) {
+    host_nvs_format();
+    host_nvs_drop_partition(USERDB_PARTITION);
+    test_storage_reboot();
+    test_populate("moved", 3);
+    test_storage_reboot();
+    CHECK_EQ(user_count, 3);
+
+    host_nvs_add_partition(USERDB_PARTITION);
+    size_t in_default = host_nvs_stored_bytes("nvs");
+    test_storage_reboot();
+    CHECK_EQ(user_count, 3);
+    for (int i = 0; i < 3; ++i)
+        check_label(i, "moved");
+    CHECK(host_nvs_stored_bytes(USERDB_PARTITION) > 0);
+    CHECK(host_nvs_stored_bytes("nvs") < in_default);
+    test_storage_reboot();
+    CHECK_EQ(user_count, 3);
+}
+
+int main(void) {
+    RUN_TEST(test_full_db_pages_through_cache);
+    RUN_TEST(test_ram_is_flat);
+    RUN_TEST(test_partition_fallback_and_move);
+    return test_report("test_paging");
+}
@@ -0,0 +1,145 @@
+// user-015: compiled login programs and their encrypted cache
+#include "freertos/semphr.h"
+#include "hid_layout.h"
+#include "hid_program.h"
+#include "test_util.h"
+
+#define LOADERS     4
+
+static const char* s_passwords[] = { "first!", "Second2", "third_3", "FOURTH4", "fifth5" };
+
+static bool program_of(int index, const char* password) {
+    hid_program_t loaded, expected;
+    if (hid_program_load(index, &loaded) != ESP_OK)
+        return false;
+    hid_program_compile(password, false, false, HID_LAYOUT_DEFAULT, HID_FALLBACK_SKIP, &expected);
+    bool same = loaded.count == expected.count && loaded.layout == expected.layout &&
+                memcmp(loaded.ops, expected.ops, loaded.count * sizeof(hid_op_t)) == 0;
+    hid_program_wipe(&loaded);
+    hid_program_wipe(&expected);
+    return same;
+}
+
+static void add_accounts(int n) {
+    char label[16];
+    test_storage_boot();
+    host_stdout_mute(true);
+    for (int i = 0; i < n; ++i) {
+        snprintf(label, sizeof(label), "acct%d", i);
+        CHECK_EQ(test_add_user(label, s_passwords[i]), i);
+    }
+    host_stdout_mute(false);
+}
+
+typedef struct {
+    SemaphoreHandle_t start;
+    SemaphoreHandle_t done;
+    int index;
+    bool ok;
+} loader_t;
+
+static void loader(void* arg) {
+    loader_t* l = arg;
+    xSemaphoreTake(l->start, portMAX_DELAY);
+    l->ok = program_of(l->index, s_passwords[l->index]);
+    xSemaphoreGive(l->done);
+    vTaskDelete(NULL);
+}
+
+// First logins on several tasks at once: the cache is keyed once, so the
+// programs stored by one task still decrypt for the others
+static void test_first_use_race(void) {
+    add_accounts(LOADERS);
+    host_set_interleave(true);
+    SemaphoreHandle_t start = xSemaphoreCreateCounting(LOADERS, 0);
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(LOADERS, 0);
+    loader_t loaders[LOADERS];
+    for (int i = 0; i < LOADERS; ++i) {
+        loaders[i] = (loader_t){ start, done, i, false };
+        xTaskCreate(loader, "loader", 8192, &loaders[i], 5, NULL);
+    }
+    for (int i = 0; i < LOADERS; ++i)
+        xSemaphoreGive(start);
+    for (int i = 0; i < LOADERS; ++i)
+        xSemaphoreTake(done, portMAX_DELAY);
+    host_set_interleave(false);
+    vSemaphoreDelete(start);
+    vSemaphoreDelete(done);
+
+    for (int i = 0; i < LOADERS; ++i) {
+        CHECK(loaders[i].ok);
+        CHECK(program_of(i, s_passwords[i]));   // from the cache now
+    }
+}
+
+static void test_hit_and_invalidate(void) {
+    add_accounts(2);
+    hid_program_stats_t before, after;
+    hid_program_stats_get(&before);
+    CHECK(program_of(0, s_passwords[0]));
+    CHECK(program_of(0, s_passwords[0]));
+    hid_program_stats_get(&after);
+    CHECK_EQ(after.misses - before.misses, 1);
+    CHECK_EQ(after.hits - before.hits, 1);
+
+    // userdb_edit drops the old program
+    user_entry_t user;
+    test_make_user(&user, "acct0", "changed");
+    host_stdout_mute(true);
+    userdb_edit(0, &user);
+    host_stdout_mute(false);
+    CHECK(program_of(0, "changed"));
+    CHECK(program_of(1, s_passwords[1]));
+
+    hid_program_stats_get(&before);
+    hid_program_invalidate(-1);             // all of them
+    CHECK(program_of(0, "changed"));
+    CHECK(program_of(1, s_passwords[1]));
+    hid_program_stats_get(&after);
+    CHECK_EQ(after.misses - before.misses, 2);
+    CHECK_EQ(after.hits - before.hits, 0);
+}
+
+// -1 is the "all accounts" of hid_program_invalidate, never a cached program:
+// free slots must not answer for it
+static void test_free_slots(void) {
+    add_accounts(1);
+    hid_program_invalidate(-1);
+    hid_program_t prog;
+    hid_program_stats_t before, after;
+    hid_program_stats_get(&before);
+    CHECK_EQ(hid_program_load(-1, &prog), ESP_ERR_NOT_FOUND);
+    CHECK_EQ(hid_program_load(5, &prog), ESP_ERR_NOT_FOUND);
+    hid_program_stats_get(&after);
+    CHECK_EQ(after.hits, before.hits);
+    CHECK(program_of(0, s_passwords[0]));
+    hid_program_wipe(&prog);
+}
+
+// One more account than slots: the least recently used program goes
+static void test_eviction(void) {
+    add_accounts(HID_PROGRAM_CACHE_SIZE + 1);
+    for (int i = 0; i < HID_PROGRAM_CACHE_SIZE; ++i)
+        CHECK(program_of(i, s_passwords[i]));
+    CHECK(program_of(0, s_passwords[0]));   // 1 is now the oldest
+
+    hid_program_stats_t before, after;
+    CHECK(program_of(HID_PROGRAM_CACHE_SIZE, s_passwords[HID_PROGRAM_CACHE_SIZE]));
+    hid_program_stats_get(&before);
+    CHECK(program_of(0, s_passwords[0]));
+    CHECK(program_of(2, s_passwords[2]));
+    hid_program_stats_get(&after);
+    CHECK_EQ(after.hits - before.hits, 2);
+    CHECK(program_of(1, s_passwords[1]));
+    hid_program_stats_get(&before);
+    CHECK_EQ(before.misses - after.misses, 1);
+}
+
+int main(void) {
+    host_log_set_level(ESP_LOG_ERROR);
+    RUN_TEST(test_first_use_race);          // first: the cache is still unkeyed
+    RUN_TEST(test_hit_and_invalidate);
+    RUN_TEST(test_free_slots);
+    RUN_TEST(test_eviction);
+    return test_report("test_program");
+}
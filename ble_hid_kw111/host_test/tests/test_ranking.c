@@ -0,0 +1,91 @@
+// user-004: usage ranking kept as an index next to records that never move
+#include "test_util.h"
+
+static uint32_t s_lcg = 12345;
+
+static int next_rand(int n) {
+    s_lcg = s_lcg * 1103515245u + 12345u;
+    return (int)((s_lcg >> 16) % (uint32_t)n);
+}
+
+static uint32_t usage_of(int index) {
+    user_entry_t user;
+    return userdb_get(index, &user) == 0 ? user.usage_count : UINT32_MAX;
+}
+
+// Ranking is a permutation of the indices, sorted by descending usage
+static void check_ranking(void) {
+    bool seen[MAX_USERS] = { false };
+    uint32_t prev = UINT32_MAX;
+    for (int r = 0; r < (int)user_count; ++r) {
+        int index = userdb_rank_to_index(r);
+        CHECK(index >= 0 && index < (int)user_count);
+        if (index < 0 || index >= (int)user_count)
+            return;
+        CHECK(!seen[index]);
+        seen[index] = true;
+        CHECK_EQ(userdb_index_to_rank(index), r);
+        uint32_t usage = usage_of(index);
+        CHECK(usage <= prev);
+        prev = usage;
+    }
+    CHECK_EQ(userdb_rank_to_index(user_count), -1);
+    CHECK_EQ(userdb_index_to_rank(-1), -1);
+}
+
+static void test_bumps_keep_order(void) {
+    test_storage_boot();
+    test_populate("rank", 40);
+    for (int i = 0; i < 400; ++i) {
+        // Skewed: a few accounts get most of the logins
+        int index = next_rand(4) ? next_rand(6) : next_rand(40);
+        userdb_increment_usage(index);
+        if (i % 50 == 0)
+            check_ranking();
+    }
+    check_ranking();
+    CHECK(usage_of(userdb_rank_to_index(0)) >= usage_of(userdb_rank_to_index(39)));
+}
+
+// Indices held by the UI and the client survive a login
+static void test_indices_are_stable(void) {
+    test_storage_boot();
+    test_populate("stable", 10);
+    user_index = 7;
+    for (int i = 0; i < 5; ++i)
+        userdb_increment_usage(7);
+    CHECK_EQ(user_index, 7);
+    CHECK_EQ(userdb_rank_to_index(0), 7);
+    user_entry_t user;
+    CHECK_EQ(userdb_get(7, &user), 0);
+    CHECK(strcmp(user.label, "stable007") == 0);
+    CHECK_EQ(userdb_get(0, &user), 0);
+    CHECK(strcmp(user.label, "stable000") == 0);
+}
+
+// Ties keep the list order after a full rebuild (boot)
+static void test_rebuild_and_remove(void) {
+    test_storage_boot();
+    test_populate("tie", 6);
+    userdb_increment_usage(4);
+    userdb_increment_usage(2);
+    userdb_flush();
+    test_storage_reboot();
+    CHECK_EQ(userdb_rank_to_index(0), 2);
+    CHECK_EQ(userdb_rank_to_index(1), 4);
+    CHECK_EQ(userdb_rank_to_index(2), 0);
+    CHECK_EQ(userdb_rank_to_index(5), 5);
+
+    host_stdout_mute(true);
+    userdb_remove(2);
+    host_stdout_mute(false);
+    check_ranking();
+    CHECK_EQ(userdb_rank_to_index(0), 3);     // old index 4 moved up
+}
+
+int main(void) {
+    RUN_TEST(test_bumps_keep_order);
+    RUN_TEST(test_indices_are_stable);
+    RUN_TEST(test_rebuild_and_remove);
+    return test_report("test_ranking");
+}
@@ -0,0 +1,397 @@
+// user-002/003/008: per-record NVS layout, migration of the legacy "users"
+// blob, flash bytes written per operation, usage bumps lost on a power cut
+// and the packed record format
+#include "esp_hmac.h"
+#include "mbedtls/aes.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "test_util.h"
+
+// Raw struct of the firmware that stored the whole list as one blob
+typedef struct {
+    char label[MAX_LABEL_LEN];
+    uint8_t password_enc[MAX_PASSWORD_LEN + 16];
+    size_t password_len;
+    uint32_t usage_count;
+    uint8_t fingerprint_id;
+    bool magicfinger;
+    bool winlogin;
+    bool sendEnter;
+    uint8_t login_type;
+} legacy_entry_t;
+
+// Entries the fake flash charges for a blob (header + 32-byte chunks)
+static uint64_t nvs_blob_cost(size_t len) {
+    return 32 * (1 + (len + 31) / 32);
+}
+
+// What the blob layout wrote for any change: the whole array plus "count"
+static uint64_t legacy_save_cost(size_t count) {
+    return nvs_blob_cost(count * sizeof(legacy_entry_t)) + 32;
+}
+
+// Old password encryption: AES-128-CBC, zero IV, zero padding
+static void legacy_encrypt(const char* plain, legacy_entry_t* out) {
+    uint8_t hmac[32], key[16], iv[16] = {0}, in[MAX_PASSWORD_LEN] = {0};
+    const char* context = "userdb-password-key";
+    esp_hmac_calculate(HMAC_KEY0, context, strlen(context), hmac);
+    memcpy(key, hmac, sizeof(key));
+    size_t len = (strlen(plain) + 15) / 16 * 16;
+    memcpy(in, plain, strlen(plain));
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, key, 128);
+    mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_ENCRYPT, len, iv, in, out->password_enc);
+    mbedtls_aes_free(&aes);
+    out->password_len = len;
+}
+
+static void write_legacy_db(const legacy_entry_t* users, uint32_t count) {
+    nvs_handle_t h;
+    CHECK_EQ(nvs_open("userdb", NVS_READWRITE, &h), ESP_OK);
+    nvs_set_blob(h, "users", users, count * sizeof(legacy_entry_t));
+    nvs_set_u32(h, "count", count);
+    nvs_commit(h);
+    nvs_close(h);
+}
+
+static void check_password(int index, const char* expected) {
+    user_entry_t user;
+    char plain[MAX_PASSWORD_LEN + 1];
+    CHECK_EQ(userdb_get(index, &user), 0);
+    CHECK_EQ(userdb_decrypt_password(user.password_enc, user.password_len, plain), 0);
+    CHECK(strcmp(plain, expected) == 0);
+}
+
+static void test_legacy_migration(void) {
+    host_nvs_format();
+    nvs_flash_init();
+
+    legacy_entry_t users[3];
+    memset(users, 0, sizeof(users));
+    const char* labels[3] = { "mail", "bank", "work" };
+    const char* passwords[3] = { "hunter2", "a longer password!", "x" };
+    for (int i = 0; i < 3; ++i) {
+        strcpy(users[i].label, labels[i]);
+        legacy_encrypt(passwords[i], &users[i]);
+        users[i].usage_count = 10 * i;
+        users[i].fingerprint_id = i + 1;
+        users[i].magicfinger = i == 1;
+        users[i].sendEnter = true;
+        users[i].login_type = i;
+    }
+    write_legacy_db(users, 3);
+
+    test_storage_reboot();
+    CHECK_EQ(user_count, 3);
+    for (int i = 0; i < 3; ++i) {
+        user_entry_t user;
+        CHECK_EQ(userdb_get(i, &user), 0);
+        CHECK(strcmp(user.label, labels[i]) == 0);
+        CHECK_EQ(user.usage_count, 10 * i);
+        CHECK_EQ(user.fingerprint_id, i + 1);
+        CHECK_EQ(user.magicfinger, i == 1);
+        CHECK(user.sendEnter);
+        CHECK_EQ(user.login_type, i);
+        check_password(i, passwords[i]);
+    }
+    CHECK_EQ(userdb_find_magicfinger(2), 1);
+
+    // The blob is gone from the default partition and a reboot reads the new layout
+    nvs_handle_t h;
+    size_t size = 0;
+    if (nvs_open("userdb", NVS_READONLY, &h) == ESP_OK) {
+        CHECK_EQ(nvs_get_blob(h, "users", NULL, &size), ESP_ERR_NVS_NOT_FOUND);
+        nvs_close(h);
+    }
+    test_storage_reboot();
+    CHECK_EQ(user_count, 3);
+    check_password(2, passwords[2]);
+}
+
+static uint64_t nvs_written_by(void (*op)(void)) {
+    host_nvs_stats_t st;
+    host_nvs_reset_stats();
+    op();
+    host_nvs_get_stats(&st);
+    return st.bytes_written;
+}
+
+#define DB_SIZE 50
+
+static void op_add(void) { test_add_user("one more", "password"); }
+static void op_login(void) { userdb_increment_usage(DB_SIZE / 2); userdb_flush(); }
+static void op_remove(void) { userdb_remove(DB_SIZE / 3); }
+static void op_edit(void) {
+    user_entry_t user;
+    userdb_get(DB_SIZE / 4, &user);
+    user.winlogin = !user.winlogin;
+    userdb_edit(DB_SIZE / 4, &user);
+}
+
+static void test_bytes_per_operation(void) {
+    test_storage_boot();
+    host_stdout_mute(true);
+    char label[MAX_LABEL_LEN];
+    for (int i = 0; i < DB_SIZE; ++i) {
+        snprintf(label, sizeof(label), "account %02d", i);
+        test_add_user(label, "password");
+    }
+    uint64_t add = nvs_written_by(op_add);
+    uint64_t login = nvs_written_by(op_login);
+    uint64_t edit = nvs_written_by(op_edit);
+    uint64_t remove = nvs_written_by(op_remove);
+    host_stdout_mute(false);
+
+    uint64_t before = legacy_save_cost(DB_SIZE);
+    printf("flash bytes per operation, %d accounts (blob layout: %llu)\n", DB_SIZE,
+           (unsigned long long)before);
+    printf("  add %llu, login %llu, edit %llu, remove %llu\n", (unsigned long long)add,
+           (unsigned long long)login, (unsigned long long)edit, (unsigned long long)remove);
+    CHECK(add > 0 && add * 10 < before);
+    CHECK(login > 0 && login * 10 < before);
+    CHECK(edit > 0 && edit * 10 < before);
+    CHECK(remove > 0 && remove * 10 < before);
+    // A login rewrites a single record: the cost doesn't grow with the DB
+    CHECK(login <= nvs_blob_cost(sizeof(user_entry_t)));
+}
+
+// user-003: usage bumps lost on a power cut. The counters are written back
+// in batches by the write-back task, so once it has run at most
+// USERDB_USAGE_FLUSH_PENDING - 1 bumps may be lost, wherever the cut falls.
+#define CRASH_ACCOUNTS 4
+
+static uint32_t flush_calls(void) {
+    userdb_op_stats_t stats;
+    userdb_stats_get(USERDB_OP_FLUSH, &stats);
+    return stats.calls;
+}
+
+// Logins are seconds apart, one NVS commit takes milliseconds: before the
+// next login the write-back task has flushed the batch the last one completed
+static bool wait_flush(uint32_t calls) {
+    for (int ms = 0; ms < 1000; ++ms) {
+        if (flush_calls() > calls)
+            return true;
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    return false;
+}
+
+static uint32_t total_usage(void) {
+    uint32_t total = 0;
+    user_entry_t user;
+    for (size_t i = 0; i < user_count; ++i) {
+        if (userdb_get(i, &user) == 0)
+            total += user.usage_count;
+    }
+    return total;
+}
+
+static void test_crash_loss(void) {
+    int worst = 0;
+    host_stdout_mute(true);
+    for (int bumps = 0; bumps <= 3 * USERDB_USAGE_FLUSH_PENDING; ++bumps) {
+        test_storage_boot();
+        for (int i = 0; i < CRASH_ACCOUNTS; ++i)
+            test_add_user("crash", "pw");
+        for (int i = 0; i < bumps; ++i) {
+            uint32_t calls = flush_calls();
+            userdb_increment_usage(i % CRASH_ACCOUNTS);
+            if ((i + 1) % USERDB_USAGE_FLUSH_PENDING == 0)
+                CHECK(wait_flush(calls));
+        }
+
+        host_nvs_set_powered(false);    // power cut right after the last login
+        test_storage_reboot();
+        CHECK_EQ(user_count, CRASH_ACCOUNTS);
+        int lost = bumps - (int)total_usage();
+        CHECK(lost >= 0);
+        CHECK(lost < USERDB_USAGE_FLUSH_PENDING);
+        if (lost > worst)
+            worst = lost;
+    }
+    host_stdout_mute(false);
+    printf("worst case: %d bumps lost (bound %d)\n", worst, USERDB_USAGE_FLUSH_PENDING - 1);
+}
+
+// Before deep sleep userdb_flush() leaves nothing pending
+static void test_flush_before_sleep(void) {
+    host_stdout_mute(true);
+    test_storage_boot();
+    test_add_user("sleep", "pw");
+    for (int i = 0; i < USERDB_USAGE_FLUSH_PENDING - 1; ++i)
+        userdb_increment_usage(0);
+    userdb_flush();
+    host_nvs_set_powered(false);
+    test_storage_reboot();
+    CHECK_EQ(total_usage(), USERDB_USAGE_FLUSH_PENDING - 1);
+    host_stdout_mute(false);
+}
+
+// Packed record: every field survives a reboot
+static void test_record_round_trip(void) {
+    test_storage_boot();
+    user_entry_t in;
+    test_make_user(&in, "a label of exactly 31 chars....", "p@ss");
+    in.fingerprint_id = 200;
+    in.magicfinger = true;
+    in.winlogin = false;
+    in.sendEnter = true;
+    in.login_type = 2;
+    in.layout = 3;
+    in.fallback = 1;
+    host_stdout_mute(true);
+    userdb_add(&in);
+    test_add_user("", "");
+    test_add_user("\xc3\xa8 utf-8 label", "pw with spaces");
+    for (int i = 0; i < 300; ++i)
+        userdb_increment_usage(0);
+    userdb_flush();
+    host_stdout_mute(false);
+
+    test_storage_reboot();
+    CHECK_EQ(user_count, 3);
+    user_entry_t out;
+    CHECK_EQ(userdb_get(0, &out), 0);
+    CHECK(strcmp(out.label, in.label) == 0);
+    CHECK_EQ(out.password_len, in.password_len);
+    CHECK(memcmp(out.password_enc, in.password_enc, in.password_len) == 0);
+    CHECK_EQ(out.usage_count, 300);
+    CHECK_EQ(out.fingerprint_id, 200);
+    CHECK(out.magicfinger && !out.winlogin && out.sendEnter);
+    CHECK_EQ(out.login_type, 2);
+    CHECK_EQ(out.layout, 3);
+    CHECK_EQ(out.fallback, 1);
+    CHECK_EQ(out.revision, in.revision);
+    CHECK_EQ(userdb_get(1, &out), 0);
+    CHECK_EQ(out.label[0], '\0');
+    CHECK_EQ(userdb_get(2, &out), 0);
+    CHECK(strcmp(out.label, "\xc3\xa8 utf-8 label") == 0);
+}
+
+// Struct dumped raw by the firmware before the packed format (GCM password)
+typedef struct {
+    char label[MAX_LABEL_LEN];
+    uint8_t password_enc[USERDB_PASSWORD_ENC_LEN];
+    size_t password_len;
+    uint32_t usage_count;
+    uint8_t fingerprint_id;
+    bool magicfinger;
+    bool winlogin;
+    bool sendEnter;
+    uint8_t login_type;
+} raw_entry_t;
+
+static void write_slot_db(const void* record, size_t len) {
+    nvs_handle_t h;
+    const uint8_t index[3] = { 1, 1, 0 };       // version, count, slot 0
+    nvs_flash_init_partition(USERDB_PARTITION);
+    CHECK_EQ(nvs_open_from_partition(USERDB_PARTITION, "userdb", NVS_READWRITE, &h), ESP_OK);
+    nvs_set_blob(h, "u00", record, len);
+    nvs_set_blob(h, "index", index, sizeof(index));
+    nvs_commit(h);
+    nvs_close(h);
+}
+
+static size_t slot_size(void) {
+    nvs_handle_t h;
+    size_t size = 0;
+    if (nvs_open_from_partition(USERDB_PARTITION, "userdb", NVS_READONLY, &h) == ESP_OK) {
+        nvs_get_blob(h, "u00", NULL, &size);
+        nvs_close(h);
+    }
+    return size;
+}
+
+// A raw record is rewritten packed on first access; report the saving
+static void test_raw_record_upgrade(void) {
+    host_nvs_format();
+    nvs_flash_init();
+    raw_entry_t raw;
+    memset(&raw, 0, sizeof(raw));
+    strcpy(raw.label, "raw record");
+    int len = userdb_encrypt_password("raw password", raw.password_enc);
+    raw.password_len = len;
+    raw.usage_count = 42;
+    raw.fingerprint_id = 7;
+    raw.magicfinger = true;
+    raw.login_type = 1;
+    write_slot_db(&raw, sizeof(raw));
+
+    test_storage_reboot();
+    CHECK_EQ(user_count, 1);
+    CHECK_EQ(userdb_find_magicfinger(7), 0);
+    user_entry_t out;
+    CHECK_EQ(userdb_get(0, &out), 0);
+    CHECK(strcmp(out.label, "raw record") == 0);
+    CHECK_EQ(out.usage_count, 42);
+    CHECK_EQ(out.login_type, 1);
+    check_password(0, "raw password");
+    size_t packed = slot_size();
+    CHECK(packed < sizeof(raw));
+    printf("bytes per entry: raw struct %zu, packed %zu (label 10, password 12)\n",
+           sizeof(raw), packed);
+    test_storage_reboot();
+    check_password(0, "raw password");
+}
+
+// A version 1 record (no layout, fallback, revision) reads with defaults, and
+// a newer record with unknown trailing fields still reads
+static void test_record_versions(void) {
+    host_nvs_format();
+    nvs_flash_init();
+    uint8_t rec[80];
+    size_t n = 0;
+    rec[n++] = 0xA5;                    // magic
+    rec[n++] = 1;                       // version
+    rec[n++] = 0x04;                    // sendEnter
+    rec[n++] = 0;                       // login_type
+    rec[n++] = 3;                       // fingerprint_id
+    rec[n++] = 5; rec[n++] = 0; rec[n++] = 0; rec[n++] = 0;
+    rec[n++] = 2; rec[n++] = 'v'; rec[n++] = '1';
+    uint8_t enc[USERDB_PASSWORD_ENC_LEN];
+    int len = userdb_encrypt_password("old", enc);
+    rec[n++] = len;
+    memcpy(&rec[n], enc, len);
+    n += len;
+    write_slot_db(rec, n);
+    test_storage_reboot();
+    user_entry_t out;
+    CHECK_EQ(userdb_get(0, &out), 0);
+    CHECK(strcmp(out.label, "v1") == 0);
+    CHECK(out.sendEnter && !out.magicfinger);
+    CHECK_EQ(out.usage_count, 5);
+    CHECK_EQ(out.layout, 0);
+    CHECK_EQ(out.fallback, 0);
+    CHECK_EQ(out.revision, 0);
+    check_password(0, "old");
+
+    // Version 9 with layout, fallback, revision and two unknown bytes
+    rec[1] = 9;
+    rec[n++] = 1;
+    rec[n++] = 0;
+    rec[n++] = 7; rec[n++] = 0; rec[n++] = 0; rec[n++] = 0;
+    rec[n++] = 0xEE;
+    rec[n++] = 0xEE;
+    host_nvs_format();
+    nvs_flash_init();
+    write_slot_db(rec, n);
+    test_storage_reboot();
+    CHECK_EQ(user_count, 1);
+    CHECK_EQ(userdb_get(0, &out), 0);
+    CHECK_EQ(out.layout, 1);
+    CHECK_EQ(out.revision, 7);
+    check_password(0, "old");
+}
+
+int main(void) {
+    RUN_TEST(test_legacy_migration);
+    RUN_TEST(test_bytes_per_operation);
+    RUN_TEST(test_crash_loss);
+    RUN_TEST(test_flush_before_sleep);
+    RUN_TEST(test_record_round_trip);
+    RUN_TEST(test_raw_record_upgrade);
+    RUN_TEST(test_record_versions);
+    return test_report("test_storage");
+}
@@ -0,0 +1,210 @@
+// user-017: BLE and USB are thin sinks of the shared encoder. The same input
+// must reach the BLE peer and the USB host as the same report stream, equal
+// to what the encoder produces on its own. A link lost halfway stops the
+// program and the sender reports it (user-014).
+#include <pthread.h>
+
+#include "hid_device_ble.h"
+#include "hid_device_usb.h"
+#include "hid_keys.h"
+#include "hid_layout.h"
+#include "hid_program.h"
+#include "password_placeholders.h"
+#include "test_util.h"
+
+#define MAX_REPORTS 256
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint8_t reports[MAX_REPORTS][8];
+    int count;
+} stream_t;
+
+static stream_t s_ble = { PTHREAD_MUTEX_INITIALIZER };
+static stream_t s_usb = { PTHREAD_MUTEX_INITIALIZER };
+
+static void stream_reset(stream_t* s) {
+    pthread_mutex_lock(&s->lock);
+    s->count = 0;
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void stream_add(stream_t* s, const uint8_t* report) {
+    pthread_mutex_lock(&s->lock);
+    if (s->count < MAX_REPORTS)
+        memcpy(s->reports[s->count++], report, 8);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void peer_report(const uint8_t* report, size_t len, uint64_t t_us, void* arg) {
+    stream_add(arg, report);
+}
+
+static void encoder_report(void* ctx, uint8_t modifier, const uint8_t* keys, uint8_t count) {
+    uint8_t report[8] = { modifier };
+    memcpy(&report[2], keys, count);
+    stream_add(ctx, report);
+}
+
+static void encoder_delay(void* ctx, uint32_t ms) {
+}
+
+static bool same_stream(stream_t* a, stream_t* b) {
+    pthread_mutex_lock(&a->lock);
+    pthread_mutex_lock(&b->lock);
+    bool same = a->count == b->count && memcmp(a->reports, b->reports, a->count * 8) == 0;
+    pthread_mutex_unlock(&b->lock);
+    pthread_mutex_unlock(&a->lock);
+    return same;
+}
+
+// Last reports still in the controller buffer / on the endpoint
+static void settle(void) {
+    vTaskDelay(pdMS_TO_TICKS(100));
+}
+
+static void check_streams(const char* what, stream_t* expected) {
+    settle();
+    if (!same_stream(&s_ble, expected) || !same_stream(&s_usb, expected)) {
+        fprintf(stderr, "%s: encoder %d reports, BLE %d, USB %d\n", what, expected->count, s_ble.count, s_usb.count);
+        test_failures++;
+    }
+    CHECK(expected->count > 0);
+}
+
+static void compare_program(const char* what, const hid_program_t* prog) {
+    static stream_t expected = { PTHREAD_MUTEX_INITIALIZER };
+    stream_reset(&expected);
+    hid_encoder_sink_t sink = { .send_report = encoder_report, .delay_ms = encoder_delay, .ctx = &expected };
+    hid_encoder_run(prog, &sink);
+
+    stream_reset(&s_ble);
+    stream_reset(&s_usb);
+    CHECK_EQ(ble_send_program(prog), ESP_OK);
+    CHECK_EQ(usb_send_program(prog), ESP_OK);
+    check_streams(what, &expected);
+}
+
+static void test_strings(void) {
+    static const char* texts[] = {
+        "Password1",
+        "perché è così",
+        "aaa" "\x80" "bb",                      // ENTER in mezzo
+        "x" "\x84" "y",                         // pausa 500 ms
+        "\x86" "pw" "\x81" "\x87",              // CTRL+ALT+DEL, TAB, SHIFT+TAB
+        "Z!9@x#Y$w%V^u&T*s(R)q_P+o=aaBB12",
+    };
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+        static stream_t expected = { PTHREAD_MUTEX_INITIALIZER };
+        hid_program_t prog;
+        hid_program_init(&prog);
+        hid_program_add_text(&prog, texts[i], HID_LAYOUT_DEVICE, HID_FALLBACK_SKIP);
+        stream_reset(&expected);
+        hid_encoder_sink_t sink = { .send_report = encoder_report, .delay_ms = encoder_delay, .ctx = &expected };
+        hid_encoder_run(&prog, &sink);
+        hid_program_wipe(&prog);
+
+        stream_reset(&s_ble);
+        stream_reset(&s_usb);
+        ble_send_string(texts[i]);
+        usb_send_string(texts[i]);
+        check_streams(texts[i], &expected);
+    }
+}
+
+static void test_programs(void) {
+    hid_program_t prog;
+    CHECK_EQ(hid_program_compile("Login!", true, true, HID_LAYOUT_US, HID_FALLBACK_SKIP, &prog), ESP_OK);
+    compare_program("winlogin + enter", &prog);
+    CHECK_EQ(hid_program_compile("año", false, false, HID_LAYOUT_IT, HID_FALLBACK_ALT_CODE, &prog), ESP_OK);
+    compare_program("alt code", &prog);
+    CHECK_EQ(hid_program_compile("año", false, false, HID_LAYOUT_DE, HID_FALLBACK_HEX_CODE, &prog), ESP_OK);
+    compare_program("hex code", &prog);
+    hid_program_wipe(&prog);
+}
+
+static void test_single_keys(void) {
+    static stream_t expected = { PTHREAD_MUTEX_INITIALIZER };
+    hid_encoder_sink_t sink = { .send_report = encoder_report, .delay_ms = encoder_delay, .ctx = &expected };
+    stream_reset(&expected);
+    const hid_layout_key_t* k = hid_layout_lookup(HID_LAYOUT_DEVICE, 0xE8);   // è
+    hid_encoder_tap(k->modifier, k->key, &sink);
+    hid_encoder_tap(HID_MODIFIER_LEFT_CTRL, HID_KEY_L, &sink);
+
+    stream_reset(&s_ble);
+    stream_reset(&s_usb);
+    ble_send_char(0xE8);
+    ble_send_key_combination(HID_MODIFIER_LEFT_CTRL, HID_KEY_L);
+    usb_send_char(0xE8);
+    usb_send_key_combination(HID_MODIFIER_LEFT_CTRL, HID_KEY_L);
+    check_streams("single keys", &expected);
+}
+
+// The sleep placeholder goes to the board on both transports
+static void test_sleep_placeholder(void) {
+    uint32_t before = host_board_sleep_requests();
+    ble_send_string("z" "\x88");
+    usb_send_string("z" "\x88");
+    CHECK_EQ(host_board_sleep_requests(), before + 2);
+}
+
+static void* drop_links(void* arg) {
+    vTaskDelay(pdMS_TO_TICKS(200));         // during the pause placeholder
+    host_ble_disconnect();
+    host_usb_set_mounted(false);
+    return NULL;
+}
+
+// Link down before or during a program: an error, and nothing typed after it
+static void test_link_lost(void) {
+    // Only the keys before the pause reach the peer
+    static stream_t expected = { PTHREAD_MUTEX_INITIALIZER };
+    hid_program_t prog;
+    hid_program_init(&prog);
+    hid_program_add_text(&prog, "ab", HID_LAYOUT_DEVICE, HID_FALLBACK_SKIP);
+    hid_encoder_sink_t sink = { .send_report = encoder_report, .delay_ms = encoder_delay, .ctx = &expected };
+    stream_reset(&expected);
+    hid_encoder_run(&prog, &sink);
+    hid_program_init(&prog);
+    hid_program_add_text(&prog, "ab" "\x84" "cd", HID_LAYOUT_DEVICE, HID_FALLBACK_SKIP);
+
+    settle();
+    stream_reset(&s_ble);
+    stream_reset(&s_usb);
+    pthread_t thread;
+    pthread_create(&thread, NULL, drop_links, NULL);
+    CHECK_EQ(ble_send_program(&prog), ESP_ERR_INVALID_STATE);
+    pthread_join(thread, NULL);
+    host_ble_sync();
+    CHECK(same_stream(&s_ble, &expected));
+
+    CHECK_EQ(ble_send_program(&prog), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(usb_send_program(&prog), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(s_usb.count, 0);
+
+    host_usb_set_mounted(true);
+    pthread_create(&thread, NULL, drop_links, NULL);
+    CHECK_EQ(usb_send_program(&prog), ESP_ERR_INVALID_STATE);
+    pthread_join(thread, NULL);
+    settle();
+    CHECK(same_stream(&s_usb, &expected));
+    host_usb_set_mounted(true);
+    hid_program_wipe(&prog);
+}
+
+int main(void) {
+    host_log_set_level(ESP_LOG_ERROR);
+    CHECK_EQ(usb_device_init(), ESP_OK);
+    host_usb_set_report_cb(peer_report, &s_usb);
+    test_ble_connect(0x06, 0);
+    host_ble_set_update_mode(HOST_BLE_UPDATE_REJECT);
+    host_ble_set_report_cb(peer_report, &s_ble);
+
+    RUN_TEST(test_strings);
+    RUN_TEST(test_programs);
+    RUN_TEST(test_single_keys);
+    RUN_TEST(test_sleep_placeholder);
+    RUN_TEST(test_link_lost);
+    test_ble_disconnect();
+    return test_report("test_transports");
+}
@@ -0,0 +1,116 @@
+// user-020: USB typing paced by transfer completion. The fake host polls the
+// IN endpoint every bInterval ms; whatever the interval, the sink hands over
+// one report per transfer and never before the completion callback of the
+// previous one (no fixed delays), and the host receives exactly the typed
+// text. The reports/s are printed for information only: on the pthread
+// FreeRTOS stand-in a 1 ms poll depends on the host scheduler.
+#include <pthread.h>
+
+#include "config.h"
+#include "hid_device_usb.h"
+#include "hid_keys.h"
+#include "hid_layout.h"
+#include "hid_program.h"
+#include "test_util.h"
+
+#define TEXT            "Password1 the quick brown fox"
+#define LEGACY_MS_CHAR  25          // old sender: 20 ms after the press, 5 ms after the release
+
+typedef struct {
+    test_kbd_t kbd;
+    uint64_t first_us;
+    uint64_t last_us;
+} host_rx_t;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_rx_t s_rx;
+
+static void host_report(const uint8_t* report, size_t len, uint64_t t_us, void* arg) {
+    pthread_mutex_lock(&s_lock);
+    if (s_rx.kbd.reports == 0)
+        s_rx.first_us = t_us;
+    s_rx.last_us = t_us;
+    test_kbd_feed(&s_rx.kbd, report, len);
+    pthread_mutex_unlock(&s_lock);
+}
+
+// Reports/s received by the host while typing TEXT, polled every interval_ms
+static double type_at(uint8_t interval_ms, bool print) {
+    hid_program_t prog;
+    CHECK_EQ(hid_program_compile(TEXT, false, false, HID_LAYOUT_DEVICE, HID_FALLBACK_SKIP, &prog), ESP_OK);
+
+    host_usb_set_poll_interval(interval_ms);
+    host_usb_reset_stats();
+    pthread_mutex_lock(&s_lock);
+    test_kbd_reset(&s_rx.kbd, HID_LAYOUT_DEVICE);
+    pthread_mutex_unlock(&s_lock);
+
+    uint64_t start = host_now_us();
+    usb_send_program(&prog);
+    uint64_t elapsed_us = host_now_us() - start;
+    hid_program_wipe(&prog);
+
+    host_usb_stats_t stats;
+    host_usb_get_stats(&stats);
+    pthread_mutex_lock(&s_lock);
+    host_rx_t rx = s_rx;
+    pthread_mutex_unlock(&s_lock);
+
+    // Pacing: one report per transfer, each handed over after the previous one completed
+    CHECK_EQ(stats.reports, rx.kbd.reports);
+    CHECK_EQ(stats.completions, stats.reports);
+    CHECK(stats.polls >= stats.reports);
+    CHECK_EQ(stats.busy, 0);
+    CHECK_EQ(stats.early, 0);
+    CHECK_EQ(rx.kbd.violations, 0);
+    CHECK(strcmp(rx.kbd.text, TEXT) == 0);
+
+    // Il primo report parte a meta' di un polling: conta gli intervalli tra il primo e l'ultimo
+    double rate = rx.kbd.reports > 1 ? (rx.kbd.reports - 1) * 1e6 / (rx.last_us - rx.first_us) : 0;
+    if (print) {
+        double chars = strlen(TEXT);
+        printf("%8u %8u %10.1f %12.0f %12.1f %12.1f\n", interval_ms, rx.kbd.reports, elapsed_us / 1000.0,
+               rate, chars * 1e6 / elapsed_us, 1000.0 / LEGACY_MS_CHAR);
+    }
+    return rate;
+}
+
+// The descriptor carries USB_HID_POLL_INTERVAL_MS as bInterval
+static void test_descriptor_interval(void) {
+    host_usb_stats_t stats;
+    host_usb_get_stats(&stats);
+    CHECK_EQ(stats.interval_ms, USB_HID_POLL_INTERVAL_MS);
+}
+
+// The pacing rule at every interval; the rate is compared with the polling
+// rate only in the printed table
+static void test_report_rate(void) {
+    static const uint8_t intervals[] = { 1, 2, 4, 8, 10, 16 };
+    printf("%8s %8s %10s %12s %12s %12s\n", "bInt ms", "reports", "total ms", "reports/s", "chars/s",
+           "legacy c/s");
+    for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); ++i) {
+        type_at(intervals[i], true);
+    }
+}
+
+// Host not reading (suspended): the report is dropped after the timeout, typing resumes afterwards
+static void test_unmounted(void) {
+    host_usb_set_mounted(false);
+    uint64_t start = host_now_us();
+    usb_send_key_combination(0, HID_KEY_A);
+    CHECK(host_now_us() - start < 500000);
+    host_usb_set_mounted(true);
+    type_at(USB_HID_POLL_INTERVAL_MS, false);
+}
+
+int main(void) {
+    host_log_set_level(ESP_LOG_ERROR);
+    CHECK_EQ(usb_device_init(), ESP_OK);
+    host_usb_set_report_cb(host_report, NULL);
+
+    RUN_TEST(test_descriptor_interval);
+    RUN_TEST(test_report_rate);
+    RUN_TEST(test_unmounted);
+    host_usb_set_poll_interval(0);
+    return test_report("test_usb_rate");
+}
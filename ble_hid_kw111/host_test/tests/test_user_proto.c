@@ -0,0 +1,204 @@
+// user-025: the TLV frame of WRITE_USER. Round trip of every field, frames
+// cut at any byte, labels and passwords over USER_PROTO_TEXT_MAX, tags of a
+// later version, a version above USER_PROTO_VERSION and encode buffers too
+// small for the frame.
+#include <stdlib.h>
+
+#include "hid_device_prf.h"
+#include "test_util.h"
+#include "user_proto.h"
+
+#define ALL_FIELDS  ((uint16_t)(USER_FIELD(USER_TAG_NB) - USER_FIELD(USER_TAG_LABEL)))
+
+static void full_entry(user_proto_entry_t* entry) {
+    memset(entry, 0, sizeof(*entry));
+    entry->fields = ALL_FIELDS;
+    entry->label_len = USER_PROTO_TEXT_MAX;
+    memset(entry->label, 'L', entry->label_len);
+    entry->password_len = 8;
+    memcpy(entry->password, "p\x80ssw0rd", entry->password_len);
+    entry->winlogin = 1;
+    entry->send_enter = 1;
+    entry->magicfinger = 1;
+    entry->fingerprint_id = 7;
+    entry->login_type = 2;
+    entry->layout = 3;
+    entry->fallback = 1;
+}
+
+static bool same_entry(const user_proto_entry_t* a, const user_proto_entry_t* b) {
+    return a->fields == b->fields && a->label_len == b->label_len && a->password_len == b->password_len &&
+           memcmp(a->label, b->label, a->label_len) == 0 &&
+           memcmp(a->password, b->password, a->password_len) == 0 &&
+           a->winlogin == b->winlogin && a->send_enter == b->send_enter && a->magicfinger == b->magicfinger &&
+           a->fingerprint_id == b->fingerprint_id && a->login_type == b->login_type &&
+           a->layout == b->layout && a->fallback == b->fallback;
+}
+
+static void test_round_trip(void) {
+    user_proto_entry_t entry, decoded;
+    uint8_t frame[USER_PROTO_FRAME_MAX], index = 0;
+
+    full_entry(&entry);
+    size_t len = user_proto_encode(WRITE_USER, 42, &entry, frame, sizeof(frame));
+    CHECK_EQ(len, USER_PROTO_FRAME_MAX - (USER_PROTO_TEXT_MAX - entry.password_len));
+    CHECK_EQ(frame[0], WRITE_USER);
+    CHECK_EQ(frame[1], USER_PROTO_VERSION);
+    CHECK_EQ(user_proto_decode(frame, len, &index, &decoded), USER_PROTO_OK);
+    CHECK_EQ(index, 42);
+    CHECK(same_entry(&entry, &decoded));
+
+    // Una modifica porta solo il campo cambiato: header + un tag di un byte
+    memset(&entry, 0, sizeof(entry));
+    entry.fields = USER_FIELD(USER_TAG_SEND_ENTER);
+    entry.send_enter = 1;
+    len = user_proto_encode(WRITE_USER, 1, &entry, frame, sizeof(frame));
+    CHECK_EQ(len, USER_PROTO_HEADER_LEN + 3);
+    CHECK_EQ(user_proto_decode(frame, len, &index, &decoded), USER_PROTO_OK);
+    CHECK(same_entry(&entry, &decoded));
+}
+
+// Cut at a tag boundary the frame is valid with the fields before the cut,
+// anywhere else it is truncated
+static void test_truncated(void) {
+    user_proto_entry_t entry, decoded;
+    uint8_t frame[USER_PROTO_FRAME_MAX], index;
+    bool boundary[USER_PROTO_FRAME_MAX + 1] = { false };
+
+    full_entry(&entry);
+    size_t len = user_proto_encode(WRITE_USER, 0, &entry, frame, sizeof(frame));
+    for (size_t n = USER_PROTO_HEADER_LEN; n <= len; n += 2 + frame[n + 1]) {
+        boundary[n] = true;
+        if (n == len)
+            break;
+    }
+
+    for (size_t cut = 0; cut < len; ++cut) {
+        user_proto_err_t err = user_proto_decode(frame, cut, &index, &decoded);
+        if (cut < USER_PROTO_HEADER_LEN || !boundary[cut]) {
+            if (err != USER_PROTO_ERR_LENGTH)
+                fprintf(stderr, "frame cut at %zu: %d\n", cut, err);
+            CHECK_EQ(err, USER_PROTO_ERR_LENGTH);
+        } else {
+            CHECK_EQ(err, USER_PROTO_OK);
+            CHECK((decoded.fields & ~entry.fields) == 0);
+            CHECK(decoded.fields != entry.fields);
+        }
+    }
+}
+
+static void test_oversize(void) {
+    user_proto_entry_t entry, decoded;
+    uint8_t frame[USER_PROTO_FRAME_MAX + 8], index;
+
+    // The encoder refuses texts over USER_PROTO_TEXT_MAX
+    full_entry(&entry);
+    entry.label_len = USER_PROTO_TEXT_MAX + 1;
+    CHECK_EQ(user_proto_encode(WRITE_USER, 0, &entry, frame, sizeof(frame)), 0);
+    full_entry(&entry);
+    entry.password_len = USER_PROTO_TEXT_MAX + 1;
+    CHECK_EQ(user_proto_encode(WRITE_USER, 0, &entry, frame, sizeof(frame)), 0);
+
+    // The decoder refuses them too, even when the frame holds all the bytes
+    static const uint8_t tags[] = { USER_TAG_LABEL, USER_TAG_PASSWORD };
+    for (size_t i = 0; i < sizeof(tags); ++i) {
+        size_t n = 0;
+        frame[n++] = WRITE_USER;
+        frame[n++] = USER_PROTO_VERSION;
+        frame[n++] = 0;
+        frame[n++] = tags[i];
+        frame[n++] = USER_PROTO_TEXT_MAX + 1;
+        memset(&frame[n], 'x', USER_PROTO_TEXT_MAX + 1);
+        n += USER_PROTO_TEXT_MAX + 1;
+        CHECK_EQ(user_proto_decode(frame, n, &index, &decoded), USER_PROTO_ERR_LENGTH);
+
+        // Exactly USER_PROTO_TEXT_MAX is valid
+        frame[4] = USER_PROTO_TEXT_MAX;
+        CHECK_EQ(user_proto_decode(frame, n - 1, &index, &decoded), USER_PROTO_OK);
+        CHECK_EQ(decoded.fields, USER_FIELD(tags[i]));
+    }
+}
+
+// Tags of a later version are skipped, the known ones around them still count
+static void test_unknown_tags(void) {
+    user_proto_entry_t decoded;
+    uint8_t index;
+    static const uint8_t frame[] = {
+        WRITE_USER, USER_PROTO_VERSION, 5,
+        0, 0,                                       // tag 0: mai assegnato
+        USER_TAG_LABEL, 3, 'a', 'b', 'c',
+        USER_TAG_NB, 2, 0xAA, 0xBB,
+        0xFF, 4, 1, 2, 3, 4,
+        USER_TAG_WINLOGIN, 1, 1,
+    };
+    CHECK_EQ(user_proto_decode(frame, sizeof(frame), &index, &decoded), USER_PROTO_OK);
+    CHECK_EQ(index, 5);
+    CHECK_EQ(decoded.fields, USER_FIELD(USER_TAG_LABEL) | USER_FIELD(USER_TAG_WINLOGIN));
+    CHECK_EQ(decoded.label_len, 3);
+    CHECK(memcmp(decoded.label, "abc", 3) == 0);
+    CHECK_EQ(decoded.winlogin, 1);
+
+    // An unknown tag must still fit in the frame
+    CHECK_EQ(user_proto_decode(frame, 12, &index, &decoded), USER_PROTO_ERR_LENGTH);
+}
+
+static void test_version(void) {
+    user_proto_entry_t entry, decoded;
+    uint8_t frame[USER_PROTO_FRAME_MAX], index;
+
+    full_entry(&entry);
+    size_t len = user_proto_encode(WRITE_USER, 0, &entry, frame, sizeof(frame));
+    frame[1] = USER_PROTO_VERSION + 1;
+    CHECK_EQ(user_proto_decode(frame, len, &index, &decoded), USER_PROTO_ERR_VERSION);
+    CHECK_EQ(decoded.fields, 0);
+    frame[1] = 0xFF;
+    CHECK_EQ(user_proto_decode(frame, USER_PROTO_HEADER_LEN, &index, &decoded), USER_PROTO_ERR_VERSION);
+    frame[1] = USER_PROTO_VERSION;
+    CHECK_EQ(user_proto_decode(frame, len, &index, &decoded), USER_PROTO_OK);
+}
+
+// Below the frame size the encoder returns 0 and writes nothing past size
+static void test_small_buffer(void) {
+    user_proto_entry_t entry;
+    uint8_t frame[USER_PROTO_FRAME_MAX + 1];
+
+    full_entry(&entry);
+    size_t len = user_proto_encode(WRITE_USER, 0, &entry, frame, sizeof(frame));
+    for (size_t size = 0; size < len; ++size) {
+        memset(frame, 0xEE, sizeof(frame));
+        CHECK_EQ(user_proto_encode(WRITE_USER, 0, &entry, frame, size), 0);
+        bool untouched = true;
+        for (size_t i = size; i < sizeof(frame); ++i)
+            untouched &= frame[i] == 0xEE;
+        CHECK(untouched);
+    }
+    CHECK_EQ(user_proto_encode(WRITE_USER, 0, &entry, frame, len), len);
+}
+
+// Random frames: always a result, never a text over USER_PROTO_TEXT_MAX
+static void test_random_frames(void) {
+    user_proto_entry_t decoded;
+    uint8_t frame[USER_PROTO_FRAME_MAX], index;
+    srand(25);
+    for (int round = 0; round < 20000; ++round) {
+        size_t len = rand() % sizeof(frame);
+        for (size_t i = 0; i < len; ++i)
+            frame[i] = rand();
+        if (len > 1)
+            frame[1] %= USER_PROTO_VERSION + 1;
+        user_proto_err_t err = user_proto_decode(frame, len, &index, &decoded);
+        CHECK(err == USER_PROTO_OK || err == USER_PROTO_ERR_LENGTH);
+        CHECK(decoded.label_len <= USER_PROTO_TEXT_MAX && decoded.password_len <= USER_PROTO_TEXT_MAX);
+    }
+}
+
+int main(void) {
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_truncated);
+    RUN_TEST(test_oversize);
+    RUN_TEST(test_unknown_tags);
+    RUN_TEST(test_version);
+    RUN_TEST(test_small_buffer);
+    RUN_TEST(test_random_frames);
+    return test_report("test_user_proto");
+}
@@ -0,0 +1,146 @@
+// user-001: per-operation counters of the user DB
+#include "test_util.h"
+
+#define WORKERS       3
+#define WORKER_ROUNDS 2000
+#define WRITER_ADDS   100
+
+static void test_counts_and_flash(void) {
+    test_storage_boot();
+    userdb_stats_reset();
+    host_nvs_reset_stats();
+
+    test_add_user("alpha", "secret-1");
+    test_add_user("beta", "secret-2");
+
+    userdb_op_stats_t add, enc, save;
+    userdb_stats_get(USERDB_OP_ADD, &add);
+    userdb_stats_get(USERDB_OP_ENCRYPT, &enc);
+    userdb_stats_get(USERDB_OP_SAVE, &save);
+    CHECK_EQ(add.calls, 2);
+    CHECK_EQ(enc.calls, 2);
+    CHECK(add.flash_bytes > 0);
+    CHECK(add.commits >= 2);
+    CHECK_EQ(enc.flash_bytes, 0);
+    CHECK_EQ(enc.commits, 0);
+    CHECK(add.max_us <= add.total_us);
+
+    // Every byte the fake flash saw was charged to an add
+    host_nvs_stats_t nvs;
+    host_nvs_get_stats(&nvs);
+    CHECK(nvs.commits >= add.commits);
+}
+
+// Crypto outside DB_LOCK racing with flash writes: each task must only be
+// charged for the writes of its own call path.
+
+typedef struct {
+    int id;
+    volatile int encrypt, decrypt;
+} worker_t;
+
+static void crypto_worker(void* arg) {
+    worker_t* w = arg;
+    uint8_t enc[USERDB_PASSWORD_ENC_LEN];
+    char plain[MAX_PASSWORD_LEN + 1];
+    for (int i = 0; i < WORKER_ROUNDS; ++i) {
+        int len = userdb_encrypt_password("concurrent", enc);
+        w->encrypt++;
+        int ret = len > 0 ? userdb_decrypt_password(enc, len, plain) : -1;
+        CHECK(ret == 0 && strcmp(plain, "concurrent") == 0);
+        w->decrypt++;
+    }
+    vTaskDelete(NULL);
+}
+
+static void writer_worker(void* arg) {
+    worker_t* w = arg;
+    char label[16];
+    for (int i = 0; i < WRITER_ADDS; ++i) {
+        snprintf(label, sizeof(label), "w%d-%02d", w->id, i);
+        test_add_user(label, "pw");
+        w->encrypt++;
+    }
+    vTaskDelete(NULL);
+}
+
+static void test_concurrent_tasks(void) {
+    test_storage_boot();
+    host_stdout_mute(true);             // user_print of every add
+    host_set_interleave(true);
+
+    // Baseline: flash written by one add with a label of the same length
+    userdb_stats_reset();
+    test_add_user("w9-99", "pw");
+    userdb_op_stats_t one;
+    userdb_stats_get(USERDB_OP_ADD, &one);
+
+    userdb_stats_reset();
+    worker_t w[WORKERS] = { { 0 }, { 1 }, { 2 } };
+    TaskHandle_t t[WORKERS];
+    xTaskCreate(crypto_worker, "crypto0", 4096, &w[0], 5, &t[0]);
+    xTaskCreate(crypto_worker, "crypto1", 4096, &w[1], 5, &t[1]);
+    xTaskCreate(writer_worker, "writer", 4096, &w[2], 5, &t[2]);
+    while (w[0].decrypt < WORKER_ROUNDS || w[1].decrypt < WORKER_ROUNDS ||
+           w[2].encrypt < WRITER_ADDS)
+        vTaskDelay(2);
+    vTaskDelay(5);
+
+    userdb_op_stats_t add, enc, dec;
+    userdb_stats_get(USERDB_OP_ADD, &add);
+    userdb_stats_get(USERDB_OP_ENCRYPT, &enc);
+    userdb_stats_get(USERDB_OP_DECRYPT, &dec);
+    CHECK_EQ(add.calls, WRITER_ADDS);
+    CHECK_EQ(enc.calls, 2 * WORKER_ROUNDS + WRITER_ADDS);
+    CHECK_EQ(dec.calls, 2 * WORKER_ROUNDS);
+    CHECK_EQ(enc.flash_bytes, 0);
+    CHECK_EQ(dec.flash_bytes, 0);
+    CHECK_EQ(enc.commits, 0);
+    // Index and revision grow with the DB: at least the baseline per add
+    CHECK(add.flash_bytes >= (uint64_t)one.flash_bytes * WRITER_ADDS);
+    CHECK(add.commits >= WRITER_ADDS);
+    host_set_interleave(false);
+    host_stdout_mute(false);
+}
+
+static void stack_probe(void* arg) {
+    test_add_user("stack", "probe");
+}
+
+static void test_stack_watermark(void) {
+    test_storage_boot();
+    userdb_stats_reset();
+    test_run_in_task("probe", stack_probe, NULL, 8192);
+    userdb_op_stats_t add;
+    userdb_stats_get(USERDB_OP_ADD, &add);
+    CHECK_EQ(add.calls, 1);
+    CHECK(add.min_free_stack > 0);
+    CHECK(add.min_free_stack < 8192);
+}
+
+// The device key is the first half of a 32-byte HMAC: a key that differs
+// only past byte 16 of the eFuse output still decrypts the same records
+static void test_device_key(void) {
+    test_storage_boot();
+    uint8_t enc[USERDB_PASSWORD_ENC_LEN];
+    char plain[MAX_PASSWORD_LEN + 1];
+    int len = userdb_encrypt_password("hmac", enc);
+    CHECK(len == USERDB_GCM_NONCE_LEN + USERDB_GCM_TAG_LEN + 4);
+    CHECK(userdb_decrypt_password(enc, len, plain) >= 0);
+    CHECK(strcmp(plain, "hmac") == 0);
+
+    // Another eFuse key: the record does not authenticate any more
+    uint8_t key[32];
+    memset(key, 0x5a, sizeof(key));
+    host_hmac_set_key(key);
+    userdb_crypto_wipe();
+    CHECK(userdb_decrypt_password(enc, len, plain) < 0);
+}
+
+int main(void) {
+    RUN_TEST(test_counts_and_flash);
+    RUN_TEST(test_concurrent_tasks);
+    RUN_TEST(test_stack_watermark);
+    RUN_TEST(test_device_key);
+    return test_report("test_userdb");
+}
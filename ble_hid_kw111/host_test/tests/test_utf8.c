@@ -0,0 +1,213 @@
+// user-018: UTF-8 decoding in the keystroke compiler. Random and hand-made
+// byte strings are compiled and compared op by op with a reference decoder
+// written here; every input ends on a guard page, so reading past the
+// terminator crashes the test.
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "hid_keys.h"
+#include "hid_layout.h"
+#include "hid_program.h"
+#include "password_placeholders.h"
+#include "test_util.h"
+
+#define FUZZ_ROUNDS     200000
+#define FUZZ_MAX_LEN    32          // at most 2 ops per byte: always fits a program
+#define INVALID         0xFFFFFFFFu
+
+static char* s_page_end;            // first byte of the guard page
+
+static void guard_init(void) {
+    long page = sysconf(_SC_PAGESIZE);
+    char* mem = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(mem != MAP_FAILED);
+    mprotect(mem + page, page, PROT_NONE);
+    s_page_end = mem + page;
+}
+
+// Copy of bytes[0..len) whose terminator is the last readable byte
+static const char* guarded(const uint8_t* bytes, size_t len) {
+    char* text = s_page_end - len - 1;
+    memcpy(text, bytes, len);
+    text[len] = 0;
+    return text;
+}
+
+// Reference: sequence length from the lead byte, then every continuation
+// checked; a malformed sequence is skipped up to the first bad byte, a
+// complete but non-shortest/surrogate/too large one as a whole
+static uint32_t ref_decode(const uint8_t* s, size_t* used) {
+    static const struct { uint8_t lo, hi; int len; uint32_t mask, min; } leads[] = {
+        { 0x00, 0x7F, 1, 0x7F, 0 },
+        { 0xC2, 0xDF, 2, 0x1F, 0x80 },
+        { 0xE0, 0xEF, 3, 0x0F, 0x800 },
+        { 0xF0, 0xF4, 4, 0x07, 0x10000 },
+    };
+    for (size_t l = 0; l < sizeof(leads) / sizeof(leads[0]); ++l) {
+        if (s[0] < leads[l].lo || s[0] > leads[l].hi)
+            continue;
+        uint32_t cp = s[0] & leads[l].mask;
+        for (int j = 1; j < leads[l].len; ++j) {
+            if (s[j] < 0x80 || s[j] > 0xBF) {
+                *used = j;
+                return INVALID;
+            }
+            cp = cp << 6 | (s[j] & 0x3F);
+        }
+        *used = leads[l].len;
+        bool bad = cp < leads[l].min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF);
+        return bad ? INVALID : cp;
+    }
+    *used = 1;
+    return INVALID;
+}
+
+// Ops the compiler must produce for bytes (layout US, Ctrl+Shift+U fallback)
+static int ref_compile(const uint8_t* bytes, size_t len, hid_op_t* ops) {
+    uint8_t s[FUZZ_MAX_LEN + 4] = {0};      // terminated, the decoder may look at it
+    memcpy(s, bytes, len);
+    int n = 0;
+    size_t i = 0;
+    while (i < len) {
+        if (PW_IS_PLACEHOLDER(s[i])) {
+            hid_program_t one;
+            const char ph[2] = { (char)s[i], 0 };
+            hid_program_init(&one);
+            hid_program_add_text(&one, ph, HID_LAYOUT_US, HID_FALLBACK_HEX_CODE);
+            memcpy(&ops[n], one.ops, one.count * sizeof(hid_op_t));
+            n += one.count;
+            i++;
+            continue;
+        }
+        size_t used;
+        uint32_t cp = ref_decode(&s[i], &used);
+        i += used;
+        const hid_layout_key_t* k = cp == INVALID ? NULL : hid_layout_lookup(HID_LAYOUT_US, cp);
+        memset(&ops[n], 0, sizeof(hid_op_t));
+        if (k) {
+            ops[n].modifier = k->modifier;
+            ops[n].key = k->key;
+            if (k->flags & HID_LAYOUT_F_DEAD) {
+                ops[n++].flags = HID_OP_ALONE;
+                memset(&ops[n], 0, sizeof(hid_op_t));
+                ops[n].key = HID_KEY_SPACE;
+            }
+            n++;
+        } else if (cp != INVALID && cp >= 0x20 && cp != 0x7F) {
+            ops[n].flags = HID_OP_HEX_CODE;
+            ops[n].modifier = cp & 0xFF;
+            ops[n].key = (cp >> 8) & 0xFF;
+            ops[n].delay = cp >> 16;
+            n++;
+        }
+    }
+    return n;
+}
+
+static bool compare(const uint8_t* bytes, size_t len) {
+    hid_op_t expected[2 * FUZZ_MAX_LEN];
+    int n = ref_compile(bytes, len, expected);
+    hid_program_t prog;
+    hid_program_init(&prog);
+    size_t consumed = hid_program_add_text(&prog, guarded(bytes, len), HID_LAYOUT_US, HID_FALLBACK_HEX_CODE);
+    bool same = consumed == len && prog.count == n && memcmp(prog.ops, expected, n * sizeof(hid_op_t)) == 0;
+    if (!same) {
+        fprintf(stderr, "mismatch (consumed %zu of %zu, %d ops instead of %d):", consumed, len, prog.count, n);
+        for (size_t i = 0; i < len; ++i)
+            fprintf(stderr, " %02x", bytes[i]);
+        fprintf(stderr, "\n");
+        test_failures++;
+    }
+    return same;
+}
+
+static void test_known_sequences(void) {
+    static const struct { const char* bytes; int ops; } cases[] = {
+        { "abc", 3 },
+        { "\xC3\xA8", 1 },                      // è: Ctrl+Shift+U on US
+        { "\xE2\x82\xAC", 1 },                  // €
+        { "\xF0\x9F\x98\x80", 1 },              // U+1F600
+        { "\xC3", 0 },                          // troncato prima del terminatore
+        { "\xE2\x82", 0 },
+        { "\xF0\x9F\x98", 0 },
+        { "\xC0\xAF", 0 },                      // overlong '/'
+        { "\xE0\x80\xAF", 0 },
+        { "\xED\xA0\x80", 0 },                  // surrogato
+        { "\xF4\x90\x80\x80", 0 },              // oltre U+10FFFF
+        { "\xFF\xFE", 0 },
+        { "\xC3" "A", 1 },                      // continuazione mancante: la 'A' resta
+        { "\xE2\x82" "B", 1 },
+        { "\xBF" "z", 1 },                      // continuazione isolata
+        { "\x80" "x", 2 },                      // placeholder ENTER in testa
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        const uint8_t* bytes = (const uint8_t*)cases[i].bytes;
+        size_t len = strlen(cases[i].bytes);
+        compare(bytes, len);
+        hid_op_t ops[2 * FUZZ_MAX_LEN];
+        CHECK_EQ(ref_compile(bytes, len, ops), cases[i].ops);
+    }
+}
+
+// Random bytes, weighted towards lead and continuation bytes so that most
+// strings hit the multi-byte paths
+static void test_fuzz(void) {
+    srand(18);
+    int valid = 0;
+    for (int round = 0; round < FUZZ_ROUNDS; ++round) {
+        uint8_t bytes[FUZZ_MAX_LEN];
+        size_t len = rand() % (FUZZ_MAX_LEN + 1);
+        for (size_t i = 0; i < len; ++i) {
+            switch (rand() % 6) {
+                case 0: bytes[i] = 0x20 + rand() % 0x5F; break;
+                case 1: bytes[i] = 0x80 + rand() % 0x40; break;
+                case 2: bytes[i] = 0xC0 + rand() % 0x20; break;
+                case 3: bytes[i] = 0xE0 + rand() % 0x10; break;
+                case 4: bytes[i] = 0xF0 + rand() % 0x10; break;
+                default: bytes[i] = 1 + rand() % 0xFF; break;
+            }
+        }
+        if (!compare(bytes, len) && test_failures > 20)
+            return;
+        uint8_t terminated[FUZZ_MAX_LEN + 4] = {0};
+        memcpy(terminated, bytes, len);
+        size_t used, i = 0;
+        bool all_valid = true;
+        while (i < len) {
+            all_valid &= ref_decode(&terminated[i], &used) != INVALID;
+            i += used;
+        }
+        valid += all_valid;
+    }
+    printf("%d strings, %d entirely valid UTF-8\n", FUZZ_ROUNDS, valid);
+}
+
+// Text longer than a program: every chunk stops on a character boundary
+static void test_chunk_boundaries(void) {
+    char text[3 * MAX_PASSWORD_LEN * 2 + 1] = "";
+    for (int i = 0; i < 3 * MAX_PASSWORD_LEN; ++i)
+        strcat(text, "\xC3\xA8");           // è, one op in IT
+    size_t total = 0;
+    int ops = 0;
+    hid_program_t prog;
+    while (text[total]) {
+        hid_program_init(&prog);
+        size_t n = hid_program_add_text(&prog, &text[total], HID_LAYOUT_IT, HID_FALLBACK_SKIP);
+        CHECK(n > 0);
+        CHECK_EQ(n % 2, 0);
+        total += n;
+        ops += prog.count;
+    }
+    CHECK_EQ(ops, 3 * MAX_PASSWORD_LEN);
+    hid_program_wipe(&prog);
+}
+
+int main(void) {
+    host_log_set_level(ESP_LOG_ERROR);
+    guard_init();
+    RUN_TEST(test_known_sequences);
+    RUN_TEST(test_fuzz);
+    RUN_TEST(test_chunk_boundaries);
+    return test_report("test_utf8");
+}
@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <time.h>
+
+#include "freertos/semphr.h"
+#include "hid_device_ble.h"
+#include "hid_device_prf.h"
+#include "hid_keys.h"
+#include "hid_layout.h"
+#include "nvs_flash.h"
+#include "test_util.h"
+
+int test_failures = 0;
+
+int test_report(const char* suite) {
+    if (test_failures == 0)
+        printf("%s: all checks passed\n", suite);
+    else
+        printf("%s: %d check(s) failed\n", suite, test_failures);
+    return test_failures == 0 ? 0 : 1;
+}
+
+void test_storage_boot(void) {
+    host_nvs_format();
+    test_storage_reboot();
+}
+
+void test_storage_reboot(void) {
+    host_nvs_set_powered(true);
+    nvs_flash_init();
+    userdb_load();
+}
+
+void test_make_user(user_entry_t* user, const char* label, const char* password) {
+    memset(user, 0, sizeof(*user));
+    strncpy(user->label, label, MAX_LABEL_LEN - 1);
+    int len = userdb_encrypt_password(password, user->password_enc);
+    user->password_len = len > 0 ? (size_t)len : 0;
+}
+
+int test_add_user(const char* label, const char* password) {
+    user_entry_t user;
+    test_make_user(&user, label, password);
+    size_t before = user_count;
+    userdb_add(&user);
+    memset(&user, 0, sizeof(user));
+    return user_count == before + 1 ? (int)before : -1;
+}
+
+void test_populate(const char* prefix, int n) {
+    char label[MAX_LABEL_LEN];
+    bool muted = host_stdout_muted();
+    host_stdout_mute(true);
+    for (int i = 0; i < n; ++i) {
+        snprintf(label, sizeof(label), "%s%03d", prefix, i);
+        test_add_user(label, "password");
+    }
+    host_stdout_mute(muted);
+}
+
+void test_ble_connect(uint16_t conn_int, uint16_t latency) {
+    static bool started = false;
+    if (!started) {
+        ble_device_init();
+        host_ble_sync();
+        started = true;
+    }
+    test_ble_disconnect();
+    host_ble_reset();
+    host_ble_set_report_handle(hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_KEY_IN_VAL]);
+    host_ble_connect(conn_int, latency);
+    host_ble_sync();
+    ble_userlist_set_authenticated(true);
+    uint8_t auth[USER_MGMT_PAYLOAD_LEN];
+    test_mgmt_take(auth, sizeof(auth), 1000);
+}
+
+void test_ble_disconnect(void) {
+    host_ble_disconnect();
+    host_ble_sync();
+}
+
+uint16_t test_mgmt_handle(void) {
+    return user_mgmt_handle[USER_MGMT_IDX_VAL];
+}
+
+void test_mgmt_write(const uint8_t* data, size_t len) {
+    host_ble_write(test_mgmt_handle(), data, len);
+}
+
+size_t test_mgmt_take(uint8_t* out, size_t max, uint32_t timeout_ms) {
+    return host_ble_take_notification(test_mgmt_handle(), out, max, timeout_ms);
+}
+
+void test_kbd_reset(test_kbd_t* kbd, uint8_t layout) {
+    memset(kbd, 0, sizeof(*kbd));
+    kbd->layout = layout;
+}
+
+static void kbd_put(test_kbd_t* kbd, uint32_t cp) {
+    char utf8[4];
+    size_t n;
+    if (cp < 0x80) {
+        utf8[0] = cp;
+        n = 1;
+    } else {
+        utf8[0] = 0xC0 | (cp >> 6);
+        utf8[1] = 0x80 | (cp & 0x3F);
+        n = 2;
+    }
+    if (kbd->len + n < TEST_KBD_TEXT_MAX) {
+        memcpy(&kbd->text[kbd->len], utf8, n);
+        kbd->len += n;
+        kbd->text[kbd->len] = 0;
+    }
+}
+
+// Character of a key press: the layout table read backwards (Latin-1 only),
+// '?' for keys that type nothing known. A dead key types its character only
+// when SPACE follows, as the encoder sends it.
+static void kbd_press(test_kbd_t* kbd, uint8_t modifier, uint8_t key) {
+    uint32_t dead = kbd->dead;
+    kbd->dead = 0;
+    if (dead && key == HID_KEY_SPACE && modifier == 0) {
+        kbd_put(kbd, dead);
+        return;
+    }
+    if (key == HID_KEY_ENTER && modifier == 0) {
+        kbd_put(kbd, '\n');
+        return;
+    }
+    if (key == HID_KEY_TAB && modifier == 0) {
+        kbd_put(kbd, '\t');
+        return;
+    }
+    for (uint32_t cp = 0x20; cp <= 0xFF; ++cp) {
+        if (cp == 0x7F)
+            cp = 0xA0;
+        const hid_layout_key_t* k = hid_layout_lookup(kbd->layout, cp);
+        if (k && k->key == key && k->modifier == modifier) {
+            if (k->flags & HID_LAYOUT_F_DEAD)
+                kbd->dead = cp;
+            else
+                kbd_put(kbd, cp);
+            return;
+        }
+    }
+    kbd_put(kbd, '?');
+}
+
+void test_kbd_feed(test_kbd_t* kbd, const uint8_t* report, size_t len) {
+    uint8_t modifier = report[0];
+    uint8_t keys[6] = {0};
+    uint8_t count = 0;
+    for (size_t i = 2; i < len && i < 8; ++i) {
+        if (report[i])
+            keys[count++] = report[i];
+    }
+
+    kbd->reports++;
+    bool valid = count == 0 ||
+                 (count == kbd->count + 1 && memcmp(keys, kbd->keys, kbd->count) == 0 &&
+                  (kbd->count == 0 || modifier == kbd->modifier));
+    if (!valid)
+        kbd->violations++;
+
+    for (int i = 0; i < count; ++i) {
+        if (memchr(kbd->keys, keys[i], kbd->count) == NULL)
+            kbd_press(kbd, modifier, keys[i]);
+    }
+    kbd->modifier = modifier;
+    memcpy(kbd->keys, keys, sizeof(keys));
+    kbd->count = count;
+}
+
+static void kbd_sink_report(void* ctx, uint8_t modifier, const uint8_t* keys, uint8_t count) {
+    uint8_t report[8] = { modifier };
+    memcpy(&report[2], keys, count);
+    test_kbd_feed(ctx, report, sizeof(report));
+}
+
+static void kbd_sink_delay(void* ctx, uint32_t ms) {
+}
+
+hid_encoder_sink_t test_kbd_sink(test_kbd_t* kbd) {
+    hid_encoder_sink_t sink = {
+        .send_report = kbd_sink_report,
+        .delay_ms = kbd_sink_delay,
+        .ctx = kbd,
+    };
+    return sink;
+}
+
+typedef struct {
+    void (*fn)(void*);
+    void* arg;
+    SemaphoreHandle_t done;
+} task_call_t;
+
+static void task_trampoline(void* param) {
+    task_call_t* call = param;
+    call->fn(call->arg);
+    xSemaphoreGive(call->done);
+    vTaskDelete(NULL);
+}
+
+void test_run_in_task(const char* name, void (*fn)(void*), void* arg, uint32_t stack) {
+    task_call_t call = { fn, arg, xSemaphoreCreateBinary() };
+    if (xTaskCreate(task_trampoline, name, stack, &call, 5, NULL) != pdPASS) {
+        fprintf(stderr, "task %s not created\n", name);
+        abort();
+    }
+    xSemaphoreTake(call.done, portMAX_DELAY);
+    vSemaphoreDelete(call.done);
+}
+
+uint64_t test_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
@@ -0,0 +1,85 @@
+#pragma once
+// Helpers shared by the host tests and benchmarks: checks, boot sequences
+// mirroring app_main, accounts and tasks.
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "hid_encoder.h"
+#include "host_fakes.h"
+#include "user_list.h"
+
+extern int test_failures;
+
+#define CHECK(cond) do {                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(a, b) do {                                                     \
+        long long a_ = (long long)(a), b_ = (long long)(b);                     \
+        if (a_ != b_) {                                                         \
+            fprintf(stderr, "%s:%d: %s == %s failed (%lld != %lld)\n",          \
+                    __FILE__, __LINE__, #a, #b, a_, b_);                        \
+            test_failures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+#define RUN_TEST(fn) do { printf("-- %s\n", #fn); fflush(stdout); fn(); } while (0)
+
+// Summary line and exit status of the test executable
+int test_report(const char* suite);
+
+// Empty flash, NVS initialised and the user DB loaded, like app_main
+void test_storage_boot(void);
+// Reboot on the same flash: RAM state is rebuilt by userdb_load()
+void test_storage_reboot(void);
+
+// Account with a freshly encrypted password; returns its index or -1
+int test_add_user(const char* label, const char* password);
+void test_make_user(user_entry_t* user, const char* label, const char* password);
+// Adds n accounts labelled "<prefix>NNN" (firmware output muted)
+void test_populate(const char* prefix, int n);
+
+// BLE stack started once (ble_device_init), then a fresh peer connected at
+// conn_int (1.25 ms units) and authenticated for the user management service
+void test_ble_connect(uint16_t conn_int, uint16_t latency);
+void test_ble_disconnect(void);
+uint16_t test_mgmt_handle(void);            // user management characteristic value
+void test_mgmt_write(const uint8_t* data, size_t len);
+size_t test_mgmt_take(uint8_t* out, size_t max, uint32_t timeout_ms);
+
+// Host side of a keyboard: replays 8-byte boot reports and types, for every
+// key that goes down, the character the layout puts on it with the report's
+// modifiers. Also checks the rollover rule of the encoder: each report holds
+// at most six keys and either releases the keys or adds one new key to the
+// keys already held, with the same modifiers.
+#define TEST_KBD_TEXT_MAX   256
+
+typedef struct {
+    uint8_t layout;
+    uint8_t modifier;
+    uint8_t keys[6];
+    uint8_t count;
+    uint32_t dead;              // dead key waiting for the next key
+    char text[TEST_KBD_TEXT_MAX];
+    size_t len;
+    uint32_t reports;
+    uint32_t violations;        // reports breaking the rollover rule
+} test_kbd_t;
+
+void test_kbd_reset(test_kbd_t* kbd, uint8_t layout);
+void test_kbd_feed(test_kbd_t* kbd, const uint8_t* report, size_t len);
+// Encoder sink feeding the keyboard (no pacing, delays and sleep ignored)
+hid_encoder_sink_t test_kbd_sink(test_kbd_t* kbd);
+
+// Runs fn(arg) in a FreeRTOS task with the given stack and waits for it
+void test_run_in_task(const char* name, void (*fn)(void*), void* arg, uint32_t stack);
+
+// Monotonic time in ns, for benchmarks
+uint64_t test_now_ns(void);
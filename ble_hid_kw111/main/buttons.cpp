@@ -19,6 +19,27 @@
 static const char *TAG = "BUTTONS";
 extern uint32_t last_interaction_time;        
 
+// Selects an account and shows its label
+static void select_user(int index)
+{
+    user_entry_t user = {};
+    user_index = index;
+    userdb_get(user_index, &user);
+    const char* username = user.label;
+    printf("Selected account (%d): %s\n", user_index, username);
+    display_oled_post_info(username);
+
+    #if DEBUG_PASSWD
+    uint8_t* encoded = user.password_enc;
+    size_t len = user.password_len;
+    char plain[128];
+    if (userdb_decrypt_password(encoded, len, plain) == 0)
+        printf("Password (decrypted): %s\n", plain);
+    else 
+        printf("Decrypt error");
+    #endif
+}
+
 
 void button_task(void *pvParameters)
 {
@@ -26,6 +47,8 @@ void button_task(void *pvParameters)
     uint32_t both_buttons_pressed_time = 0;
     bool both_buttons_active = false;
     const uint32_t DISCONNECT_HOLD_TIME_MS = 3000; // 3 secondi
+    const uint32_t GROUP_JUMP_HOLD_MS = 800;       // pulsante tenuto: salto alla lettera successiva
+    uint32_t btn_hold_time = 0;
 
     // Buzzer now handled by dedicated component (initialized in app_main)
 
@@ -70,6 +93,7 @@ void button_task(void *pvParameters)
         } else {
             if (both_buttons_active) {
                 both_buttons_active = false;
+                btn_hold_time = xTaskGetTickCount();
                 ESP_LOGI(TAG, "Both buttons released before disconnect timeout");
                 display_oled_post_info("BLE PassMan");
             }
@@ -77,50 +101,36 @@ void button_task(void *pvParameters)
             // Single button logic (only if both buttons are not active)
             if (!both_buttons_active) {
                 // Up button (PIN 6) pressed (HIGH to LOW transition)
-                if (last_btn_up == 1 && btn_up == 0) {
+                // Scorre gli account in ordine di utilizzo (rank 0 = piu' usato)
+                if (last_btn_up == 1 && btn_up == 0 && user_count > 0) {
                     last_interaction_time = xTaskGetTickCount();
-                    user_index = (user_index + 1) ;
+                    btn_hold_time = xTaskGetTickCount();
+                    int rank = userdb_index_to_rank(user_index) + 1;
 
-                    if (user_index >= user_count) {
-                        user_index = 0;
+                    if (rank >= (int)user_count) {
+                        rank = 0;
                     } 
-                
-                    const char* username = user_list[user_index].label;                            
-                    printf("Selected account (%d): %s\n", user_index, username);
-                    display_oled_post_info(username);            
-                    
-                    #if DEBUG_PASSWD
-                    uint8_t* encoded = user_list[user_index].password_enc;
-                    size_t len = user_list[user_index].password_len;
-                    char plain[128];
-                    if (userdb_decrypt_password(encoded, len, plain) == 0)            
-                        printf("Password (decrypted): %s\n", plain);
-                    else 
-                        printf("Decrypt error");
-                    #endif
-                    
+                    select_user(userdb_rank_to_index(rank));
                 }
                 // Down button (PIN 7) pressed (HIGH to LOW transition)
-                if (last_btn_down == 1 && btn_down == 0) {
+                if (last_btn_down == 1 && btn_down == 0 && user_count > 0) {
                     last_interaction_time = xTaskGetTickCount();
-                    user_index = (user_index - 1);            
-                    if (user_index < 0) {
-                        user_index = user_count - 1;
+                    btn_hold_time = xTaskGetTickCount();
+                    int rank = userdb_index_to_rank(user_index) - 1;
+                    if (rank < 0) {
+                        rank = user_count - 1;
                     }
+                    select_user(userdb_rank_to_index(rank));
+                }
 
-                    const char* username = user_list[user_index].label;
-                    printf("Selected account (%d): %s\n", user_index, username);
-                    display_oled_post_info(username);            
-                    
-                    #if DEBUG_PASSWD
-                    uint8_t* encoded = user_list[user_index].password_enc;
-                    size_t len = user_list[user_index].password_len;
-                    char plain[128];
-                    if (userdb_decrypt_password(encoded, len, plain) == 0)
-                        printf("Password (decrypted): %s\n", plain);
-                    else 
-                        printf("Decrypt error");
-                    #endif            
+                // Button held: jump to the next/previous initial letter (alphabetical order)
+                if ((last_btn_up == 0 && btn_up == 0) || (last_btn_down == 0 && btn_down == 0)) {
+                    uint32_t current_time = xTaskGetTickCount();
+                    if (user_count > 0 && (current_time - btn_hold_time) >= pdMS_TO_TICKS(GROUP_JUMP_HOLD_MS)) {
+                        last_interaction_time = current_time;
+                        btn_hold_time = current_time;
+                        select_user(userdb_label_group_next(user_index, btn_up == 0 ? 1 : -1));
+                    }
                 }
             }
         }
@@ -137,6 +147,9 @@ void button_task(void *pvParameters)
 
 
 void enter_deep_sleep() {
+    // Usage counters are written back lazily: save them before RAM is lost
+    userdb_flush();
+    userdb_crypto_wipe();
     gpio_set_level((gpio_num_t)FP_ACTIVATE, 1);
     
 #if CONFIG_IDF_TARGET_ESP32C3
@@ -1,3 +1,4 @@
+#include <string.h>
 #include "esp_log.h"
 
 #include "fingerprint.h"
@@ -7,6 +8,7 @@
 
 #include "hid_dev.h"
 #include "hid_device_ble.h"
+#include "hid_output.h"
 #include "buzzer.h"
 
 #if CONFIG_IDF_TARGET_ESP32S3
@@ -22,6 +24,19 @@ extern uint32_t last_interaction_time;
 static const char *TAG = "FPM TASK";
 #define NUM_SNAPSHOTS 10
 
+// Runs in the typing task of the transport once the login has been typed
+static void login_typing_done(hid_transport_t transport, esp_err_t result,
+                              uint32_t queued_us, uint32_t typing_us, void* arg)
+{
+    (void)arg;
+    ESP_LOGI(TAG, "Login typed via %s in %lu ms (%lu ms in queue)", transport == HID_TRANSPORT_USB ? "USB" : "BLE",
+             (unsigned long)(typing_us / 1000), (unsigned long)(queued_us / 1000));
+    if (result != ESP_OK) {
+        ESP_LOGW(TAG, "Login not typed completely: %s", esp_err_to_name(result));
+        display_oled_post_error("Send error");
+    }
+}
+
 bool enrollFinger() 
 {
     FPMStatus status;    
@@ -363,123 +378,65 @@ void fingerprint_task(void *pvParameters) {
 
                 // Search in the user database if there is an equivalent fingerprint_id with the magicfinger option
                 if (user_index == -1) {
-                    for (int i = 0; i < MAX_USERS; ++i) {
-                        if (user_list[i].fingerprint_id == finger_index && user_list[i].magicfinger) {
-                            user_index = i;
-                            ESP_LOGI(TAG, "User %s with fingerprint ID %d found at index %d\n", user_list[i].label, finger_index, i);
-                            break;
-                        }
-                    }                
+                    user_index = userdb_find_magicfinger(finger_index);
                 }
                 
                 // If user selected BLE or BOTH, ensure BLE link is ready before attempting to send
                 bool ble_ready = ble_is_connected();
 
-                // Index selected with buttons or magic finder, let's check if is a windows login (CTRL+ALT+DEL)
-                user_entry_t user = user_list[user_index];
-                if (user_index != -1 && user.winlogin) {  // CTRL+ALT+DELETE
-                    ESP_LOGI(TAG, "Sending CTRL+ALT+DEL combination for user %s...", user.label);
+                user_entry_t user = {};
+                if (user_index != -1 && userdb_get(user_index, &user) != 0) {
+                    user_index = -1;
+                }
+
+                if (user_index != -1) {
+                    ESP_LOGI(TAG, "Login with user %s (fingerprint ID %d, index %d)", user.label, finger_index, user_index);
+
+                    // Choose the transport for the account (USB first in "Both" mode)
+                    hid_transport_t transport = HID_TRANSPORT_NB;
                     switch (user.login_type)  {
                         case 0:  // BLE only
-                            if (ble_ready) {
-                                ESP_LOGI(TAG, "Sending via BLE: modifiers=0x%02X, key=0x%02X", 
-                                         HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, 0x4C);
-                                ble_send_key_combination(HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, 0x4C);
-                            } else {
-                                display_oled_post_error("BLE not connected");
-                            }
+                            if (ble_ready) transport = HID_TRANSPORT_BLE;
+                            else display_oled_post_error("BLE not connected");
                             break;
-                        
+
                         #if CONFIG_IDF_TARGET_ESP32S3
                         case 1:  // USB only
-                            ESP_LOGI(TAG, "Sending via USB: modifiers=0x%02X, key=0x%02X", 
-                                     HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, 0x4C);
-                            usb_send_key_combination(HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, 0x4C);
+                            transport = HID_TRANSPORT_USB;
                             break;
                         case 2:  // Both
-                            if (usb_available) {
-                                ESP_LOGI(TAG, "Sending via USB (both mode): modifiers=0x%02X, key=0x%02X", 
-                                         HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, 0x4C);
-                                usb_send_key_combination(HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, 0x4C);
-                            } else if (ble_ready) {
-                                ESP_LOGI(TAG, "Sending via BLE (both mode): modifiers=0x%02X, key=0x%02X", 
-                                         HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, 0x4C);
-                                ble_send_key_combination(HID_MODIFIER_LEFT_CTRL | HID_MODIFIER_LEFT_ALT, 0x4C);
-                            } else {
-                                display_oled_post_error("BLE not connected");
-                            }
+                            if (usb_available) transport = HID_TRANSPORT_USB;
+                            else if (ble_ready) transport = HID_TRANSPORT_BLE;
+                            else display_oled_post_error("BLE not connected");
                             break;
                         #endif
                     }
-                    ESP_LOGI(TAG, "CTRL+ALT+DEL combination sent successfully");
-                    vTaskDelay(pdMS_TO_TICKS(1000));
-                }
 
-                if (user_index != -1) {
-                    // Send the password corresponding to the current index
-                    uint8_t* encoded = user.password_enc;
-                    size_t len = user.password_len;
-
-                    char plain[128];
-                    if (userdb_decrypt_password(encoded, len, plain) == 0) {                        
-                        switch (user.login_type)  {
-                            case 0:  // BLE only
-                                if (ble_ready) {
-                                    ble_send_string(plain);
-                                } else {
-                                    display_oled_post_error("BLE not connected");
-                                }
-                                break;
-                            
-                            #if CONFIG_IDF_TARGET_ESP32S3
-                            case 1:  // USB only
-                                usb_send_string(plain);
-                                break;
-                            case 2:  // Both
-                                if (usb_available) {
-                                    usb_send_string(plain);
-                                } else if (ble_ready) {
-                                    ble_send_string(plain);
-                                } else {
-                                    display_oled_post_error("BLE not connected");
-                                }
-                                break;
-                            #endif
-                        }
+                    if (user.winlogin) {
+                        ESP_LOGI(TAG, "Sending CTRL+ALT+DEL combination for user %s...", user.label);
+                    }
 
-                        if (user.sendEnter) {
-                            ESP_LOGI(TAG, "Sending ENTER key");
-                            // Send an ENTER key
-                            switch (user.login_type)  {
-                                case 0:  // BLE only
-                                    if (ble_ready) {
-                                        ble_send_key_combination(KEYBOARD_MODIFIER_NONE, HID_KEY_ENTER);
-                                    } else {
-                                        display_oled_post_error("BLE not connected");
-                                    }
-                                    break;
-                                
-                                #if CONFIG_IDF_TARGET_ESP32S3
-                                case 1:  // USB only
-                                    usb_send_key_combination(KEYBOARD_MODIFIER_NONE, HID_KEY_ENTER);
-                                    break;
-                                case 2:  // Both
-                                    if (usb_available) {
-                                        usb_send_key_combination(KEYBOARD_MODIFIER_NONE, HID_KEY_ENTER);
-                                    } else if (ble_ready) {
-                                        ble_send_key_combination(KEYBOARD_MODIFIER_NONE, HID_KEY_ENTER);
-                                    } else {
-                                        display_oled_post_error("BLE not connected");
-                                    }
-                                    break;
-                                #endif
+                    // The login program (CTRL+ALT+DEL, password, ENTER) is compiled once and cached;
+                    // the typing task of the transport sends it while the sensor loop goes on
+                    hid_program_t prog;
+                    esp_err_t ret = hid_program_load(user_index, &prog);
+                    if (ret == ESP_OK) {
+                        if (transport != HID_TRANSPORT_NB) {
+                            ret = hid_output_submit(transport, &prog, login_typing_done, NULL);
+                            if (ret != ESP_OK) {
+                                display_oled_post_error("Send error");
                             }
                         }
+                        hid_program_wipe(&prog);
 
                         userdb_increment_usage(user_index);                        
                         display_oled_post_info("Finger ID: %02d", finger_index);
                         user_index = -1;
                     }  
+                    else if (ret == ESP_ERR_NOT_SUPPORTED) {
+                        // fallback "reject" and a character missing from the layout
+                        display_oled_post_error("Layout err");
+                    }
                     else {
                         ESP_LOGE(TAG, "Decrypt error");
                         display_oled_post_error("Decrypt err");
@@ -134,6 +134,11 @@
 #endif
 
 
+// Intervallo di polling dell'endpoint HID USB (bInterval, 1..255 ms in full speed):
+// con l'invio guidato dal completamento dei report ogni report occupa un polling
+#define USB_HID_POLL_INTERVAL_MS 1
+
+
 #define R503_FINGERPRINT 1
 #define ZW111_FINGERPRINT 2
 
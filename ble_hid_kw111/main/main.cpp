@@ -103,7 +103,7 @@ extern "C" void app_main(void) {
     if (usb_available) {
         // Check if any user needs USB HID functionality
         for (size_t i = 0; i < user_count; ++i) {
-            if (user_list[i].login_type >= 1) {
+            if (userdb_get_login_type(i) >= 1) {
                 usb_needed = true;
                 break;
             }